@@ -174,11 +174,6 @@ void CPUInfo::Detect() {
 		if ((cpu_id[2] >> 9)  & 1) bSSSE3 = true;
 		if ((cpu_id[2] >> 19) & 1) bSSE4_1 = true;
 		if ((cpu_id[2] >> 20) & 1) bSSE4_2 = true;
-		if ((cpu_id[2] >> 28) & 1) {
-			bAVX = true;
-			if ((cpu_id[2] >> 12) & 1)
-				bFMA = true;
-		}
 		if ((cpu_id[2] >> 25) & 1) bAES = true;
 
 		if ((cpu_id[3] >> 24) & 1)
@@ -212,6 +207,8 @@ void CPUInfo::Detect() {
 				bBMI1 = true;
 			if ((cpu_id[1] >> 8) & 1)
 				bBMI2 = true;
+			if ((cpu_id[1] >> 29) & 1)
+				bSHA = true;
 		}
 	}
 	if (max_ex_fn >= 0x80000004) {
@@ -290,6 +287,7 @@ std::string CPUInfo::Summarize()
 	if (bAVX) sum += ", AVX";
 	if (bAVX) sum += ", FMA";
 	if (bAES) sum += ", AES";
+	if (bSHA) sum += ", SHA";
 	if (bLongMode) sum += ", 64-bit support";
 	return sum;
 }
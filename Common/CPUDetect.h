@@ -58,6 +58,7 @@ struct CPUInfo {
 	bool bAVX2;
 	bool bFMA;
 	bool bAES;
+	bool bSHA;
 	bool bLAHFSAHF64;
 	bool bLongMode;
 	bool bAtom;
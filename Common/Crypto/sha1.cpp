@@ -35,6 +35,17 @@
 #include "sha1.h"
 #include <string.h>
 #include <stdio.h>
+#include "Common/CPUDetect.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define SHA1_HAVE_SHANI
+#if defined(__GNUC__) || defined(__clang__)
+#define SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#else
+#define SHANI_TARGET
+#endif
+#endif
 
 /*
  * 32-bit integer manipulation macros (big endian)
@@ -230,6 +241,82 @@ static void sha1_process( sha1_context *ctx, unsigned char data[64] )
     ctx->state[4] += E;
 }
 
+#ifdef SHA1_HAVE_SHANI
+// Four rounds with the SHA extensions, the round function must be an immediate.
+#define SHA1_RNDS4(abcd, e, g) \
+    ( (g) < 20 ? _mm_sha1rnds4_epu32( abcd, e, 0 ) : \
+      (g) < 40 ? _mm_sha1rnds4_epu32( abcd, e, 1 ) : \
+      (g) < 60 ? _mm_sha1rnds4_epu32( abcd, e, 2 ) : \
+                 _mm_sha1rnds4_epu32( abcd, e, 3 ) )
+
+// Processes whole 64-byte blocks with the SHA extensions, keeping the state in registers.
+SHANI_TARGET static void sha1_process_shani( sha1_context *ctx, const unsigned char *data, int blocks )
+{
+    const __m128i MASK = _mm_set_epi64x( 0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL );
+    __m128i abcd, e0, e1, abcdSave, e0Save;
+    __m128i msgs[4];
+
+    abcd = _mm_set_epi32( (int) ctx->state[0], (int) ctx->state[1], (int) ctx->state[2], (int) ctx->state[3] );
+    e0   = _mm_set_epi32( (int) ctx->state[4], 0, 0, 0 );
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        abcdSave = abcd;
+        e0Save = e0;
+
+        for( int i = 0; i < 4; i++ )
+            msgs[i] = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( data + i * 16 ) ), MASK );
+
+        // Four rounds per step, alternating between the two E registers.
+        for( int g = 0; g < 20; g++ )
+        {
+            __m128i &cur = msgs[g & 3];
+            if( ( g & 1 ) == 0 )
+            {
+                e0 = g == 0 ? _mm_add_epi32( e0, cur ) : _mm_sha1nexte_epu32( e0, cur );
+                e1 = abcd;
+                abcd = SHA1_RNDS4( abcd, e0, g * 4 );
+            }
+            else
+            {
+                e1 = _mm_sha1nexte_epu32( e1, cur );
+                e0 = abcd;
+                abcd = SHA1_RNDS4( abcd, e1, g * 4 );
+            }
+
+            if( g >= 3 && g < 19 )
+                msgs[(g + 1) & 3] = _mm_sha1msg2_epu32( msgs[(g + 1) & 3], cur );
+            if( g >= 1 && g < 17 )
+                msgs[(g - 1) & 3] = _mm_sha1msg1_epu32( msgs[(g - 1) & 3], cur );
+            if( g >= 2 && g < 18 )
+                msgs[(g - 2) & 3] = _mm_xor_si128( msgs[(g - 2) & 3], cur );
+        }
+
+        e0 = _mm_sha1nexte_epu32( e0, e0Save );
+        abcd = _mm_add_epi32( abcd, abcdSave );
+    }
+
+    ctx->state[0] = (unsigned int) _mm_extract_epi32( abcd, 3 );
+    ctx->state[1] = (unsigned int) _mm_extract_epi32( abcd, 2 );
+    ctx->state[2] = (unsigned int) _mm_extract_epi32( abcd, 1 );
+    ctx->state[3] = (unsigned int) _mm_extract_epi32( abcd, 0 );
+    ctx->state[4] = (unsigned int) _mm_extract_epi32( e0, 3 );
+}
+#endif
+
+static void sha1_process_blocks( sha1_context *ctx, unsigned char *data, int blocks )
+{
+#ifdef SHA1_HAVE_SHANI
+    if( cpu_info.bSHA && cpu_info.bSSE4_1 )
+    {
+        sha1_process_shani( ctx, data, blocks );
+        return;
+    }
+#endif
+    for( ; blocks > 0; blocks--, data += 64 )
+        sha1_process( ctx, data );
+}
+
 /*
  * SHA-1 process buffer
  */
@@ -254,17 +341,17 @@ void sha1_update( sha1_context *ctx, unsigned char *input, int ilen )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        sha1_process( ctx, ctx->buffer );
+        sha1_process_blocks( ctx, ctx->buffer, 1 );
         input += fill;
         ilen  -= fill;
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        sha1_process( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        sha1_process_blocks( ctx, input, ilen / 64 );
+        input += ilen & ~63;
+        ilen  &= 63;
     }
 
     if( ilen > 0 )
@@ -21,6 +21,17 @@
 #include <string.h>
 
 #include "sha256.h"
+#include "Common/CPUDetect.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define SHA256_HAVE_SHANI
+#if defined(__GNUC__) || defined(__clang__)
+#define SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#else
+#define SHANI_TARGET
+#endif
+#endif
 
 #define GET_uint32_t(n,b,i)                       \
 {                                               \
@@ -184,6 +195,89 @@ void sha256_process( sha256_context *ctx, const uint8_t data[64] )
     ctx->state[7] += H;
 }
 
+#ifdef SHA256_HAVE_SHANI
+static const uint32_t sha256_k[64] =
+{
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+// Processes whole 64-byte blocks with the SHA extensions, keeping the state in registers.
+SHANI_TARGET static void sha256_process_shani( sha256_context *ctx, const uint8_t *data, uint32_t blocks )
+{
+    const __m128i MASK = _mm_set_epi64x( 0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL );
+    __m128i state0, state1, msg, tmp, abefSave, cdghSave;
+    __m128i msgs[4];
+
+    // The instructions want the state as ABEF and CDGH.
+    tmp    = _mm_loadu_si128( (const __m128i *) &ctx->state[0] );
+    state1 = _mm_loadu_si128( (const __m128i *) &ctx->state[4] );
+    tmp    = _mm_shuffle_epi32( tmp, 0xB1 );
+    state1 = _mm_shuffle_epi32( state1, 0x1B );
+    state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1 = _mm_blend_epi16( state1, tmp, 0xF0 );
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        abefSave = state0;
+        cdghSave = state1;
+
+        for( int i = 0; i < 4; i++ )
+            msgs[i] = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( data + i * 16 ) ), MASK );
+
+        // Four rounds per step, scheduling the message words for later steps as we go.
+        for( int i = 0; i < 16; i++ )
+        {
+            __m128i &cur = msgs[i & 3];
+            msg = _mm_add_epi32( cur, _mm_loadu_si128( (const __m128i *) &sha256_k[i * 4] ) );
+            state1 = _mm_sha256rnds2_epu32( state1, state0, msg );
+            if( i >= 3 && i < 15 )
+            {
+                __m128i &next = msgs[(i + 1) & 3];
+                tmp = _mm_alignr_epi8( cur, msgs[(i - 1) & 3], 4 );
+                next = _mm_sha256msg2_epu32( _mm_add_epi32( next, tmp ), cur );
+            }
+            msg = _mm_shuffle_epi32( msg, 0x0E );
+            state0 = _mm_sha256rnds2_epu32( state0, state1, msg );
+            if( i >= 1 && i < 13 )
+            {
+                __m128i &prev = msgs[(i - 1) & 3];
+                prev = _mm_sha256msg1_epu32( prev, cur );
+            }
+        }
+
+        state0 = _mm_add_epi32( state0, abefSave );
+        state1 = _mm_add_epi32( state1, cdghSave );
+    }
+
+    tmp    = _mm_shuffle_epi32( state0, 0x1B );
+    state1 = _mm_shuffle_epi32( state1, 0xB1 );
+    state0 = _mm_blend_epi16( tmp, state1, 0xF0 );
+    state1 = _mm_alignr_epi8( state1, tmp, 8 );
+    _mm_storeu_si128( (__m128i *) &ctx->state[0], state0 );
+    _mm_storeu_si128( (__m128i *) &ctx->state[4], state1 );
+}
+#endif
+
+static void sha256_process_blocks( sha256_context *ctx, const uint8_t *data, uint32_t blocks )
+{
+#ifdef SHA256_HAVE_SHANI
+    if( cpu_info.bSHA && cpu_info.bSSE4_1 )
+    {
+        sha256_process_shani( ctx, data, blocks );
+        return;
+    }
+#endif
+    for( ; blocks > 0; blocks--, data += 64 )
+        sha256_process( ctx, data );
+}
+
 void sha256_update( sha256_context *ctx, const uint8_t *input, uint32_t length )
 {
     uint32_t left, fill;
@@ -203,17 +297,17 @@ void sha256_update( sha256_context *ctx, const uint8_t *input, uint32_t length )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        sha256_process( ctx, ctx->buffer );
+        sha256_process_blocks( ctx, ctx->buffer, 1 );
         length -= fill;
         input  += fill;
         left = 0;
     }
 
-    while( length >= 64 )
+    if( length >= 64 )
     {
-        sha256_process( ctx, input );
-        length -= 64;
-        input  += 64;
+        sha256_process_blocks( ctx, input, length / 64 );
+        input  += length & ~63;
+        length &= 63;
     }
 
     if( length )
@@ -47,6 +47,11 @@
 #include "util/text/utf8.h"
 
 #include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
 
 #ifndef S_ISDIR
 #define S_ISDIR(m)  (((m)&S_IFMT) == S_IFDIR)
@@ -471,6 +476,19 @@ tm GetModifTime(const std::string &filename)
 	return return_time;
 }
 
+bool Touch(const std::string &filename)
+{
+#ifdef _WIN32
+	if (_wutime(ConvertUTF8ToWString(filename).c_str(), NULL) == 0)
+		return true;
+#else
+	if (utime(filename.c_str(), NULL) == 0)
+		return true;
+#endif
+	WARN_LOG(COMMON, "Touch: failed %s: %s", filename.c_str(), GetLastErrorMsg());
+	return false;
+}
+
 // Returns the size of filename (64bit)
 u64 GetSize(const std::string &filename)
 {
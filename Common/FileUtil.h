@@ -59,6 +59,9 @@ bool IsDirectory(const std::string &filename);
 // Returns struct with modification date of file
 tm GetModifTime(const std::string &filename);
 
+// Sets the modification date of filename to now, returns true on success
+bool Touch(const std::string &filename);
+
 // Returns the size of filename (64bit)
 u64 GetSize(const std::string &filename);
 
@@ -85,6 +85,8 @@ struct Config {
 	bool bScreenshotsAsPNG;
 	bool bEnableLogging;
 	bool bDumpDecryptedEboot;
+	// Disk space for decrypted PRX/EBOOT images, so they're not decrypted on every boot. 0 disables.
+	int iModuleCacheSizeMB;
 #if defined(USING_WIN_UI)
 	bool bPauseOnLostFocus;
 	bool bTopMost;
@@ -118,6 +120,8 @@ struct Config {
 	bool bSeparateCPUThread;
 	int iIOTimingMethod;
 	bool bSeparateIOThread;
+	// Number of host threads for async file reads and writes, 1 runs them all on the IO thread.
+	int iIOWorkerThreads;
 	bool bAtomicAudioLocks;
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
@@ -155,6 +159,10 @@ struct Config {
 	bool bVertexCache;
 	bool bTextureBackoffCache;
 	bool bTextureSecondaryCache;
+	bool bBackgroundTextureDecode;
+	// Most texture memory the cache and the secondary cache may use, least recently used go first.  0 is no limit.
+	int iTextureCacheBudgetMB;
+	int iTextureSecondCacheBudgetMB;
 	bool bVertexDecoderJit;
 	bool bFullScreen;
 	int iInternalResolution;  // 0 = Auto (native), 1 = 1x (480x272), 2 = 2x, 3 = 3x, 4 = 4x and so on.
@@ -164,6 +172,8 @@ struct Config {
 	int iTexScalingLevel; // 1 = off, 2 = 2x, ..., 5 = 5x
 	int iTexScalingType; // 0 = xBRZ, 1 = Hybrid
 	bool bTexDeposterize;
+	// Disk space per game for upscaled textures, so they're only scaled once. 0 disables.
+	int iScaledTextureCacheSizeMB;
 	int iFpsLimit;
 	int iForceMaxEmulatedFPS;
 	int iMaxRecent;
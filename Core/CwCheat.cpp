@@ -134,8 +134,12 @@ static inline std::vector<std::string> makeCodeParts(const std::vector<std::stri
 	return finalList;
 }
 
-void CWCheatEngine::CreateCodeList() { //Creates code list to be used in function GetNextCode
-	initialCodesList = GetCodesList();
+void CWCheatEngine::CreateCodeList() { //Creates code list to be used in function Run
+	CreateCodeList(GetCodesList());
+}
+
+void CWCheatEngine::CreateCodeList(const std::vector<std::string> &codesList) {
+	initialCodesList = codesList;
 	std::string currentcode, codename;
 	std::vector<std::string> codelist;
 	for (size_t i = 0; i < initialCodesList.size(); i ++) {
@@ -172,52 +176,32 @@ void CWCheatEngine::CreateCodeList() { //Creates code list to be used in functio
 		}
 	}
 	parts = makeCodeParts(codelist);
-}
 
-std::vector<int> CWCheatEngine::GetNextCode() { // Feeds a size-2 vector of ints to Run() which contains the address and value of one cheat.
-	std::string code1;
-	std::string code2;
-	std::vector<std::string> splitCode;
-	std::vector<int> finalCode;
-	std::string modifier2 = "0";
-	while (true)  {
-		if (currentCode >= parts.size()) {
-			code1.clear();
-			code2.clear();
-			break;
-		}
-		code1 = parts[currentCode++];
+	// Parse and compile it all once here, since Run() goes through it every few frames.
+	codeLines.clear();
+	for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+		std::string code1 = parts[i];
+		std::string code2 = parts[i + 1];
 		trim2(code1);
-		code2 = parts[currentCode++];
 		trim2(code2);
-		splitCode.push_back(code1);
-		splitCode.push_back(code2);
-
-		int var1 = (int) parseHexLong(splitCode[0]);
-		int var2 = (int) parseHexLong(splitCode[1]);
-		finalCode.push_back(var1);
-		finalCode.push_back(var2);
-		if (splitCode[0].substr(0,1) == modifier2) {
-			break;
-		}
+		CheatLine line = { (u32)parseHexLong(code1), (u32)parseHexLong(code2) };
+		codeLines.push_back(line);
 	}
-	return finalCode;
-}
 
-void CWCheatEngine::SkipCodes(int count) {
-	for (int i = 0; i < count; i ++) {
-		if (GetNextCode()[0] == 0) {
-			break;
-		}
+	operations.clear();
+	operations.reserve(codeLines.size());
+	for (size_t i = 0; i < codeLines.size(); i++) {
+		operations.push_back(CompileLine(i));
 	}
 }
 
-void CWCheatEngine::SkipAllCodes() {
-	currentCode = codes.size();
+const CWCheatEngine::CheatLine &CWCheatEngine::GetLine(size_t index) const {
+	static const CheatLine missingLine = { 0, 0 };
+	return index < codeLines.size() ? codeLines[index] : missingLine;
 }
 
-int CWCheatEngine::GetAddress(int value) { //Returns static address used by ppsspp. Some games may not like this, and causes cheats to not work without offset
-	int address = (value + 0x08800000) & 0x3FFFFFFF;
+u32 CWCheatEngine::GetAddress(u32 value) const { //Returns static address used by ppsspp. Some games may not like this, and causes cheats to not work without offset
+	u32 address = (value + 0x08800000) & 0x3FFFFFFF;
 	if (gameTitle == "ULUS10563" || gameTitle == "ULJS-00351" || gameTitle == "NPJH50352" ) //Offset to make God Eater Burst codes work
 		address -= 0x7EF00;
 	return address;
@@ -257,441 +241,415 @@ std::vector<std::string> CWCheatEngine::GetCodesList() { //Reads the entire chea
 	return codesList;
 }
 
+static inline u32 ReadCheatValue(const u8 *ptr, int size) {
+	switch (size) {
+	case 1:
+		return *ptr;
+	case 2:
+		return *(const u16_le *)ptr;
+	case 4:
+		return *(const u32_le *)ptr;
+	default:
+		return 0;
+	}
+}
+
+static inline void WriteCheatValue(u8 *ptr, int size, u32 value) {
+	switch (size) {
+	case 1:
+		*ptr = (u8)value;
+		break;
+	case 2:
+		*(u16_le *)ptr = (u16)value;
+		break;
+	case 4:
+		*(u32_le *)ptr = value;
+		break;
+	}
+}
+
+static inline bool TestCheatCondition(int cond, u32 value1, u32 value2) {
+	switch (cond) {
+	case 0: // Equal
+		return value1 == value2;
+	case 1: // Not Equal
+		return value1 != value2;
+	case 2: // Less Than
+		return (s32)value1 < (s32)value2;
+	case 3: // Greater Than
+		return (s32)value1 > (s32)value2;
+	default:
+		return false;
+	}
+}
+
+CWCheatEngine::CheatOperation CWCheatEngine::CompileLine(size_t index) const {
+	const u32 comm = codeLines[index].comm;
+	const u32 arg = codeLines[index].arg;
+	const CheatLine &nextLine = GetLine(index + 1);
+
+	CheatOperation op;
+	memset(&op, 0, sizeof(op));
+	op.op = CHEAT_NOP;
+	op.lines = 1;
+	op.addr = GetAddress(comm & 0x0FFFFFFF);
+	u32 addr2 = 0;
+
+	switch (comm >> 28) {
+	case 0: // 8-bit write.But need more check
+		op.op = CHEAT_WRITE;
+		if (arg < 0x00000100) // 8-bit
+			op.size = 1;
+		else if (arg < 0x00010000) // 16-bit
+			op.size = 2;
+		else // 32-bit
+			op.size = 4;
+		op.val = arg;
+		break;
+	case 0x1: // 16-bit write
+		op.op = CHEAT_WRITE;
+		op.size = 2;
+		op.val = arg;
+		break;
+	case 0x2: // 32-bit write
+		op.op = CHEAT_WRITE;
+		op.size = 4;
+		op.val = arg;
+		break;
+	case 0x3: // Increment/Decrement
+		op.addr = GetAddress(arg & 0x0FFFFFFF);
+		switch ((comm >> 20) & 0xF) {
+		case 1:
+		case 2: // 8-bit
+			op.size = 1;
+			op.val = comm & 0xFF;
+			break;
+		case 3:
+		case 4: // 16-bit
+			op.size = 2;
+			op.val = comm & 0xFFFF;
+			break;
+		case 5:
+		case 6: // 32-bit, the amount is on the next line.
+			op.size = 4;
+			op.val = nextLine.comm;
+			op.lines = 2;
+			break;
+		}
+		if (op.size != 0) {
+			op.op = CHEAT_INCREMENT;
+			// Even ones decrement.
+			if ((comm & 0x00100000) == 0)
+				op.val = 0 - op.val;
+		}
+		break;
+	case 0x4: // 32-bit patch code
+		op.op = CHEAT_PATCH;
+		op.size = 4;
+		op.lines = 2;
+		op.val = nextLine.comm;
+		op.val2 = nextLine.arg;
+		op.count = (arg >> 16) & 0xFFFF;
+		op.step = (arg & 0xFFFF) * 4;
+		break;
+	case 0x5: // Memcpy command
+		op.lines = 2;
+		addr2 = GetAddress(nextLine.comm);
+		op.count = arg;
+		// Check the whole range up front, then it's just a memmove.
+		if (arg != 0 && Memory::IsValidAddress(op.addr + arg - 1) && Memory::IsValidAddress(addr2 + arg - 1)) {
+			op.op = CHEAT_MEMCPY;
+		}
+		break;
+	case 0x6: // Pointer commands
+		{
+			op.op = CHEAT_POINTER;
+			int count = nextLine.comm & 0xFFFF;
+			op.lines = 2 + (count > 2 ? count - 2 : 0);
+		}
+		break;
+	case 0x7: // Boolean commands.
+		switch (arg >> 16) {
+		case 0x0000: // 8-bit OR.
+		case 0x0002: // 8-bit AND.
+		case 0x0004: // 8-bit XOR.
+			op.size = 1;
+			op.val = arg & 0xFF;
+			break;
+		case 0x0001: // 16-bit OR.
+		case 0x0003: // 16-bit AND.
+		case 0x0005: // 16-bit XOR.
+			op.size = 2;
+			op.val = arg & 0xFFFF;
+			break;
+		}
+		switch (arg >> 16) {
+		case 0x0000:
+		case 0x0001:
+			op.op = CHEAT_OR;
+			break;
+		case 0x0002:
+		case 0x0003:
+			op.op = CHEAT_AND;
+			break;
+		case 0x0004:
+		case 0x0005:
+			op.op = CHEAT_XOR;
+			break;
+		}
+		break;
+	case 0x8: // 8-bit and 16-bit patch code
+		{
+			bool is8Bit = (nextLine.comm >> 16) == 0x0000;
+			op.op = CHEAT_PATCH;
+			op.size = is8Bit ? 1 : 2;
+			op.lines = 2;
+			op.val = nextLine.comm;
+			op.val2 = nextLine.arg;
+			op.count = (arg >> 16) & 0xFFFF;
+			op.step = (arg & 0xFFFF) * (is8Bit ? 1 : 2);
+		}
+		break;
+	case 0xB: // Time command (not sure what to do?)
+		break;
+	case 0xC: // Code stopper
+		op.op = CHEAT_STOP_IF_NOT_EQUAL;
+		op.size = 4;
+		op.val = arg;
+		break;
+	case 0xD: // Test commands & Jocker codes
+		if (arg >> 28 == 0x0 || arg >> 28 == 0x2) { // 8Bit & 16Bit ignore next line cheat code
+			bool is8Bit = (arg >> 28) == 0x2;
+			op.op = CHEAT_SKIP_UNLESS;
+			op.size = is8Bit ? 1 : 2;
+			op.val = arg & (is8Bit ? 0xFF : 0xFFFF);
+			op.cond = (arg >> 20) & 0xF;
+			op.count = 1;
+		} else if (arg >> 28 == 0x1 || arg >> 28 == 0x3) { // Buttons dependent ignore cheat code
+			// See __CtrlPeekButtons() for the button bits, cheat codes look like 0xD00000nn 0x1bbbbbbb.
+			op.op = CHEAT_SKIP_UNLESS_BUTTONS;
+			op.val = arg & 0x0FFFFFFF;
+			op.cond = arg >> 28 == 0x1 ? CHEAT_COND_EQUAL : CHEAT_COND_NOT_EQUAL;
+			op.count = (comm & 0xFF) + 1;
+		} else if (arg >> 28 >= 0x4 && arg >> 28 <= 0x7) { // Compare two addresses
+			static const u8 compareSizes[] = { 1, 2, 4 };
+			static const u8 compareConds[] = { CHEAT_COND_EQUAL, CHEAT_COND_NOT_EQUAL, CHEAT_COND_LESS, CHEAT_COND_GREATER };
+			op.op = CHEAT_SKIP_UNLESS_COMPARE;
+			op.lines = 2;
+			addr2 = GetAddress(arg & 0x0FFFFFFF);
+			// An unknown size compares zeros.
+			op.size = (nextLine.arg & 0xF) < 3 ? compareSizes[nextLine.arg & 0xF] : 0;
+			op.cond = compareConds[(arg >> 28) - 4];
+			op.count = nextLine.comm;
+		}
+		break;
+	case 0xE: // Test commands, multiple skip
+		{
+			bool is8Bit = (comm >> 24) == 0xE1;
+			op.op = CHEAT_SKIP_UNLESS;
+			op.addr = GetAddress(arg & 0x0FFFFFFF);
+			op.size = is8Bit ? 1 : 2;
+			op.val = comm & (is8Bit ? 0xFF : 0xFFFF);
+			op.cond = arg >> 28;
+			op.count = (comm >> 16) & (is8Bit ? 0xFF : 0xFFF);
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (op.cond > CHEAT_COND_NEVER)
+		op.cond = CHEAT_COND_NEVER;
+	if (Memory::IsValidAddress(op.addr))
+		op.ptr = Memory::GetPointer(op.addr);
+	if (addr2 != 0 && Memory::IsValidAddress(addr2))
+		op.ptr2 = Memory::GetPointer(addr2);
+	return op;
+}
+
+size_t CWCheatEngine::SkipLines(size_t index, u32 count) const {
+	for (u32 i = 0; i < count && index < codeLines.size(); i++) {
+		// As before, skipping stops after a line that's all zero up front.
+		if (codeLines[index++].comm == 0) {
+			break;
+		}
+	}
+	return index;
+}
+
 void CWCheatEngine::Run() {
 	exit2 = false;
-	while (!exit2) {
-		currentCode = 0;
+	size_t index = 0;
+	while (!exit2 && index < operations.size()) {
+		index = ExecuteOperation(index);
+	}
+}
 
-		while (true) {
-			std::vector<int> code = GetNextCode();
-			if (code.size() < 2) {
-				Exit();
-				break;
+size_t CWCheatEngine::ExecuteOperation(size_t index) {
+	const CheatOperation &op = operations[index];
+	const size_t next = index + op.lines;
+
+	switch (op.op) {
+	case CHEAT_WRITE:
+		if (op.ptr)
+			WriteCheatValue(op.ptr, op.size, op.val);
+		break;
+
+	case CHEAT_INCREMENT:
+		if (op.ptr)
+			WriteCheatValue(op.ptr, op.size, ReadCheatValue(op.ptr, op.size) + op.val);
+		break;
+
+	case CHEAT_PATCH:
+		{
+			u32 addr = op.addr;
+			u32 data = op.val;
+			for (u32 a = 0; a < op.count; a++) {
+				if (Memory::IsValidAddress(addr)) {
+					WriteCheatValue(Memory::GetPointerUnchecked(addr), op.size, data);
+				}
+				addr += op.step;
+				data += op.val2;
 			}
+		}
+		break;
+
+	case CHEAT_MEMCPY:
+		if (op.ptr && op.ptr2)
+			memmove(op.ptr2, op.ptr, op.count);
+		break;
+
+	case CHEAT_POINTER:
+		return ExecutePointerCommand(index);
+
+	case CHEAT_OR:
+		if (op.ptr)
+			WriteCheatValue(op.ptr, op.size, ReadCheatValue(op.ptr, op.size) | op.val);
+		break;
+
+	case CHEAT_AND:
+		if (op.ptr)
+			WriteCheatValue(op.ptr, op.size, ReadCheatValue(op.ptr, op.size) & op.val);
+		break;
+
+	case CHEAT_XOR:
+		if (op.ptr)
+			WriteCheatValue(op.ptr, op.size, ReadCheatValue(op.ptr, op.size) ^ op.val);
+		break;
+
+	case CHEAT_STOP_IF_NOT_EQUAL:
+		if (op.ptr && ReadCheatValue(op.ptr, 4) != op.val)
+			return operations.size();
+		break;
+
+	case CHEAT_SKIP_UNLESS:
+		if (op.ptr && !TestCheatCondition(op.cond, ReadCheatValue(op.ptr, op.size), op.val))
+			return SkipLines(next, op.count);
+		break;
+
+	case CHEAT_SKIP_UNLESS_BUTTONS:
+		if (!TestCheatCondition(op.cond, __CtrlPeekButtons(), op.val))
+			return SkipLines(next, op.count);
+		break;
+
+	case CHEAT_SKIP_UNLESS_COMPARE:
+		if (op.ptr && op.ptr2 && !TestCheatCondition(op.cond, ReadCheatValue(op.ptr, op.size), ReadCheatValue(op.ptr2, op.size)))
+			return SkipLines(next, op.count);
+		break;
+
+	default:
+		break;
+	}
 
-			int value;
-			unsigned int comm = code[0];
-			u32 arg = code[1];
-			int addr = GetAddress(comm & 0x0FFFFFFF);
-
-			switch (comm >> 28) {
-			case 0: // 8-bit write.But need more check
-				if (Memory::IsValidAddress(addr)){
-					if (arg < 0x00000100) // 8-bit 
-						Memory::Write_U8((u8) arg, addr);
-					else if (arg < 0x00010000) // 16-bit
-						Memory::Write_U16((u16) arg, addr);
-					else // 32-bit
-						Memory::Write_U32((u32) arg, addr);
-				}
-				break;
-			case 0x1: // 16-bit write
-				if (Memory::IsValidAddress(addr)){
-					Memory::Write_U16((u16) arg, addr);
-				}
-				break;
-			case 0x2: // 32-bit write
-				if (Memory::IsValidAddress(addr)){
-					Memory::Write_U32((u32) arg, addr);
-				}
-				break;
-			case 0x3: // Increment/Decrement
+	return next;
+}
+
+// Rare and walks through game memory, so this is still done from the lines.
+size_t CWCheatEngine::ExecutePointerCommand(size_t index) {
+	u32 arg = codeLines[index].arg;
+	int addr = operations[index].addr;
+	size_t next = index + 1;
+
+	const CheatLine &code = GetLine(next++);
+	int arg2 = code.comm;
+	int offset = code.arg;
+	int baseOffset = (arg2 >> 20) * 4;
+	int base = Memory::Read_U32(addr + baseOffset);
+	int count = arg2 & 0xFFFF;
+	int type = (arg2 >> 16) & 0xF;
+	for (int i = 1; i < count; i ++ ) {
+		if (i+1 < count) {
+			const CheatLine &code2 = GetLine(next++);
+			int arg3 = code2.comm;
+			int arg4 = code2.arg;
+			int comm3 = arg3 >> 28;
+			switch (comm3) {
+			case 0x1: // type copy byte
 				{
-					addr = GetAddress(arg & 0x0FFFFFFF);
-					value = 0;
-					int increment = 0;
-					// Read value from memory
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 2: // 8-bit
-						value = Memory::Read_U8(addr);
-						increment = comm & 0xFF;
-						break;
-					case 3:
-					case 4: // 16-bit
-						value = Memory::Read_U16(addr);
-						increment = comm & 0xFFFF;
-						break;
-					case 5:
-					case 6: // 32-bit
-						value = Memory::Read_U32(addr);
-						code = GetNextCode();
-						if (code[0] != 0) {
-							increment = code[0];
-						}
-						break;
-					}
-					// Increment/Decrement value
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 3:
-					case 5: // increment
-						value += increment;
-						break;
-					case 2:
-					case 4:
-					case 6: // Decrement
-						value -= increment;
-						break;
-					}
-					// Write value back to memory
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 2: // 8-bit
-						Memory::Write_U8((u8) value, addr);
-						break;
-					case 3:
-					case 4: // 16-bit
-						Memory::Write_U16((u16) value, addr);
-						break;
-					case 5:
-					case 6: // 32-bit
-						Memory::Write_U32((u32) value, addr);
-						break;
+					int srcAddr = Memory::Read_U32(addr) + offset;
+					int dstAddr = Memory::Read_U16(addr + baseOffset) + (arg3 & 0x0FFFFFFF);
+					Memory::Memcpy(dstAddr, Memory::GetPointer(srcAddr), arg);
+					type = -1; //Done
+					break; }
+			case 0x2:
+			case 0x3: // type pointer walk
+				{
+					int walkOffset = arg3 & 0x0FFFFFFF;
+					if (comm3 == 0x3) {
+						walkOffset = -walkOffset;
 					}
-					break;
-				}
-			case 0x4: // 32-bit patch code
-				code = GetNextCode();
-				if (true) {
-					int data = code[0];
-					int dataAdd = code[1];
-
-					int maxAddr = (arg >> 16) & 0xFFFF;
-					int stepAddr = (arg & 0xFFFF) * 4;
-					for (int a  = 0; a < maxAddr; a++) {
-						if (Memory::IsValidAddress(addr)) {
-							Memory::Write_U32((u32) data, addr);
+					base = Memory::Read_U32(base + walkOffset);
+					int comm4 = arg4 >> 28;
+					switch (comm4) {
+					case 0x2:
+					case 0x3: // type pointer walk
+						walkOffset = arg4 & 0x0FFFFFFF;
+						if (comm4 == 0x3) {
+							walkOffset = -walkOffset;
 						}
-						addr += stepAddr;
-						data += dataAdd;
-					}
-				}
-				break;
-			case 0x5: // Memcpy command
-				code = GetNextCode();
-				if (true) {
-					int destAddr = GetAddress(code[0]);
-					if (Memory::IsValidAddress(addr) && Memory::IsValidAddress(destAddr)) {
-						Memory::Memcpy(destAddr, Memory::GetPointer(addr), arg);
-					}
-				}
-				break;
-			case 0x6: // Pointer commands
-				code = GetNextCode();
-				if (true) {
-					int arg2 = code[0];
-					int offset = code[1];
-					int baseOffset = (arg2 >> 20) * 4;
-					int base = Memory::Read_U32(addr + baseOffset);
-					int count = arg2 & 0xFFFF;
-					int type = (arg2 >> 16) & 0xF;
-					for (int i = 1; i < count; i ++ ) {
-						if (i+1 < count) {
-							code = GetNextCode();
-							int arg3 = code[0];
-							int arg4 = code[1];
-							int comm3 = arg3 >> 28;
-							switch (comm3) {
-							case 0x1: // type copy byte
-								{
-									int srcAddr = Memory::Read_U32(addr) + offset;
-									int dstAddr = Memory::Read_U16(addr + baseOffset) + (arg3 & 0x0FFFFFFF);
-									Memory::Memcpy(dstAddr, Memory::GetPointer(srcAddr), arg);
-									type = -1; //Done
-									break; }
-							case 0x2:
-							case 0x3: // type pointer walk
-								{
-									int walkOffset = arg3 & 0x0FFFFFFF;
-									if (comm3 == 0x3) {
-										walkOffset = -walkOffset;
-									}
-									base = Memory::Read_U32(base + walkOffset);
-									int comm4 = arg4 >> 28;
-									switch (comm4) {
-									case 0x2:
-									case 0x3: // type pointer walk
-										walkOffset = arg4 & 0x0FFFFFFF;
-										if (comm4 == 0x3) {
-											walkOffset = -walkOffset;
-										}
-										base = Memory::Read_U32(base + walkOffset);
-										break;
-									}
-									break; }
-							case 0x9: // type multi address write
-								base += arg3 & 0x0FFFFFFF;
-								arg += arg4;
-								break;
-							default:
-								break;
-
-							}
-						}
-					}
-
-					switch (type) {
-					case 0: // 8 bit write
-						Memory::Write_U8((u8) arg, base + offset);
-						break;
-					case 1: // 16-bit write
-						Memory::Write_U16((u16) arg, base + offset);
-						break;
-					case 2: // 32-bit write
-						Memory::Write_U32((u32) arg, base + offset);
-						break;
-					case 3: // 8 bit inverse write
-						Memory::Write_U8((u8) arg, base - offset);
-						break;
-					case 4: // 16-bit inverse write
-						Memory::Write_U16((u16) arg, base - offset);
-						break;
-					case 5: // 32-bit inverse write
-						Memory::Write_U32((u32) arg, base - offset);
-						break;
-					case -1: // Operation already performed, nothing to do
+						base = Memory::Read_U32(base + walkOffset);
 						break;
 					}
-				}
+					break; }
+			case 0x9: // type multi address write
+				base += arg3 & 0x0FFFFFFF;
+				arg += arg4;
 				break;
-			case 0x7: // Boolean commands.
-				switch (arg >> 16) {
-				case 0x0000: // 8-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 | val2), addr);
-					}
-					break;
-				case 0x0002: // 8-bit AND.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 & val2), addr);
-					}
-					break;
-				case 0x0004: // 8-bit XOR.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 ^ val2), addr);
-					}
-					break;
-				case 0x0001: // 16-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 | val2), addr);
-					}
-					break;
-				case 0x0003: // 16-bit AND.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 & val2), addr);
-					}
-					break;
-				case 0x0005: // 16-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 ^ val2), addr);
-					}
-					break;
-				}
-				break;
-			case 0x8: // 8-bit and 16-bit patch code
-				code = GetNextCode();
-				if (true) {
-					int data = code[0];
-					int dataAdd = code[1];
-
-					bool is8Bit = (data >> 16) == 0x0000;
-					int maxAddr = (arg >> 16) & 0xFFFF;
-					int stepAddr = (arg & 0xFFFF) * (is8Bit ? 1 : 2);
-					for (int a = 0; a < maxAddr; a++) {
-						if (Memory::IsValidAddress(addr)) {
-							if (is8Bit) {
-								Memory::Write_U8((u8) (data & 0xFF), addr);
-							}
-							else {
-								Memory::Write_U16((u16) (data & 0xFFFF), addr);
-							}
-						}
-						addr += stepAddr;
-						data += dataAdd;
-					}
-				}
-				break;
-			case 0xB: // Time command (not sure what to do?)
-				break;
-			case 0xC: // Code stopper
-				if (Memory::IsValidAddress(addr)) { 
-					value = Memory::Read_U32(addr);
-					if ((u32)value != arg) {
-						SkipAllCodes();
-					}
-				}
-				break;
-			case 0xD: // Test commands & Jocker codes
-				if (arg >> 28 == 0x0 || arg >> 28 == 0x2) { // 8Bit & 16Bit ignore next line cheat code
-					bool is8Bit = (arg >> 28) == 0x2;
-					addr = GetAddress(comm & 0x0FFFFFFF);
-					if (Memory::IsValidAddress(addr)) {
-						int memoryValue = is8Bit ? Memory::Read_U8(addr) : Memory::Read_U16(addr);
-						int testValue = arg & (is8Bit ? 0xFF : 0xFFFF);
-						bool executeNextLines = false;
-						switch ((arg >> 20) & 0xF) {
-						case 0x0: // Equal
-							executeNextLines = memoryValue == testValue;
-							break;
-						case 0x1: // Not Equal
-							executeNextLines = memoryValue != testValue;
-							break;
-						case 0x2: // Less Than
-							executeNextLines = memoryValue < testValue;
-							break;
-						case 0x3: // Greater Than
-							executeNextLines = memoryValue > testValue;
-							break;
-						default:
-							break;
-						}
-						if (!executeNextLines)
-							SkipCodes(1);
-					}
-					break;
-				}
-				else if (arg >> 28 == 0x1 || arg >> 28 == 0x3) { // Buttons dependent ignore cheat code
-					// Button	Code
-					// SELECT	0x00000001
-					// START	0x00000008
-					// DPAD UP	0x00000010
-					// DPAD RIGHT	0x00000020
-					// DPAD DOWN	0x00000040
-					// DPAD LEFT	0x00000080
-					// L TRIGGER	0x00000100
-					// R TRIGGER	0x00000200
-					// TRIANGLE	0x00001000
-					// CIRCLE	0x00002000
-					// CROSS	0x00004000
-					// SQUARE	0x00008000
-					// HOME		0x00010000
-					// HOLD		0x00020000
-					// WLAN		0x00040000
-					// REMOTE HOLD	0x00080000
-					// VOLUME UP	0x00100000
-					// VOLUME DOWN	0x00200000
-					// SCREEN	0x00400000
-					// NOTE		0x00800000
-					u32 buttonStatus = __CtrlPeekButtons();
-					int skip = (comm & 0xFF) + 1;
-					if (arg >> 28 == 0x1)
-						if (buttonStatus == (arg & 0x0FFFFFFF))	// cheat code likes: 0xD00000nn 0x1bbbbbbb;
-							break;
-						else
-							SkipCodes(skip);
-					else
-						if (buttonStatus != (arg & 0x0FFFFFFF))	// cheat code likes: 0xD00000nn 0x3bbbbbbb;
-							break;
-						else
-							SkipCodes(skip);
-					break;
-				}
-				else if (arg >> 28 == 0x4 || arg >> 28 == 0x5 || arg >> 28 == 0x6 || arg >> 28 == 0x7) {
-					int addr1 = GetAddress(comm & 0x0FFFFFFF);
-					int addr2 = GetAddress(arg & 0x0FFFFFFF);
-					code = GetNextCode();
-					if (true)
-						if (Memory::IsValidAddress(addr1) && Memory::IsValidAddress(addr2)) {
-							int comm2 = code[0];
-							int arg2 = code[1];
-							int skip = (comm2 & 0xFFFFFFFF);
-							int memoryValue1 = 0;
-							int memoryValue2 = 0;
-							switch (arg2 & 0xF) {
-							case 0x0: // 8Bit
-								memoryValue1 = Memory::Read_U8(addr1);
-								memoryValue2 = Memory::Read_U8(addr2);
-								break;
-							case 0x1: // 16Bit
-								memoryValue1 = Memory::Read_U16(addr1);
-								memoryValue2 = Memory::Read_U16(addr2);
-								break;
-							case 0x2: // 32Bit
-								memoryValue1 = Memory::Read_U32(addr1);
-								memoryValue2 = Memory::Read_U32(addr2);
-								break;
-							default:
-								break;
-							}
-							switch (arg >> 28) {
-							case 0x4: // Equal
-								if (memoryValue1 != memoryValue2)
-									SkipCodes(skip);
-								break;
-							case 0x5: // Not Equal
-								if (memoryValue1 == memoryValue2)
-									SkipCodes(skip);
-								break;
-							case 0x6: // Less Than
-								if (memoryValue1 >= memoryValue2)
-									SkipCodes(skip);
-								break;
-							case 0x7: // Greater Than
-								if (memoryValue1 <= memoryValue2)
-									SkipCodes(skip);
-								break;
-							default:
-								break;
-							}
-						}
-				}
-				else
-					break;
-			case 0xE: // Test commands, multiple skip
-				{
-					bool is8Bit = (comm >> 24) == 0xE1;
-					addr = GetAddress(arg & 0x0FFFFFFF);
-					if (Memory::IsValidAddress(addr)) {
-						int memoryValue = is8Bit ? Memory::Read_U8(addr) : Memory::Read_U16(addr);
-						int testValue = comm & (is8Bit ? 0xFF : 0xFFFF);
-						bool executeNextLines = false;
-						switch ( arg >> 28) {
-						case 0x0: // Equal
-							executeNextLines = memoryValue == testValue;
-							break;
-						case 0x1: // Not Equal
-							executeNextLines = memoryValue != testValue;
-							break;
-						case 0x2: // Less Than
-							executeNextLines = memoryValue < testValue;
-							break;
-						case 0x3: // Greater Than
-							executeNextLines = memoryValue > testValue;
-							break;
-						}
-						if (!executeNextLines) {
-							int skip = (comm >> 16) & (is8Bit ? 0xFF : 0xFFF);
-							SkipCodes(skip);
-						}
-					}
-					break;
-				}
 			default:
-				{
-					break;
-				}
+				break;
+
 			}
 		}
 	}
-	// exiting...
-	Exit();
+
+	switch (type) {
+	case 0: // 8 bit write
+		Memory::Write_U8((u8) arg, base + offset);
+		break;
+	case 1: // 16-bit write
+		Memory::Write_U16((u16) arg, base + offset);
+		break;
+	case 2: // 32-bit write
+		Memory::Write_U32((u32) arg, base + offset);
+		break;
+	case 3: // 8 bit inverse write
+		Memory::Write_U8((u8) arg, base - offset);
+		break;
+	case 4: // 16-bit inverse write
+		Memory::Write_U16((u16) arg, base - offset);
+		break;
+	case 5: // 32-bit inverse write
+		Memory::Write_U32((u32) arg, base - offset);
+		break;
+	case -1: // Operation already performed, nothing to do
+		break;
+	}
+
+	return next;
 }
 
 bool CWCheatEngine::HasCheats() {
-	return !parts.empty();
+	return !operations.empty();
 }
 
 bool CheatsInEffect() {
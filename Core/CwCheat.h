@@ -23,18 +23,68 @@ class CWCheatEngine {
 	CWCheatEngine();
 	std::vector<std::string> GetCodesList();
 	void CreateCodeList();
+	void CreateCodeList(const std::vector<std::string> &codesList);
 	void Exit();
 	void Run();
-	std::vector<int> GetNextCode();
 	bool HasCheats();
 
 private:
-	void SkipCodes(int count);
-	void SkipAllCodes();
-	bool cheatsOn, exit2, cheatEnabled;
-	int GetAddress(int value);
+	enum CheatOp {
+		CHEAT_NOP,
+		CHEAT_WRITE,
+		CHEAT_INCREMENT,
+		CHEAT_PATCH,
+		CHEAT_MEMCPY,
+		CHEAT_POINTER,
+		CHEAT_OR,
+		CHEAT_AND,
+		CHEAT_XOR,
+		CHEAT_STOP_IF_NOT_EQUAL,
+		CHEAT_SKIP_UNLESS,
+		CHEAT_SKIP_UNLESS_BUTTONS,
+		CHEAT_SKIP_UNLESS_COMPARE,
+	};
+
+	enum CheatCondition {
+		CHEAT_COND_EQUAL,
+		CHEAT_COND_NOT_EQUAL,
+		CHEAT_COND_LESS,
+		CHEAT_COND_GREATER,
+		CHEAT_COND_NEVER,
+	};
+
+	struct CheatLine {
+		u32 comm;
+		u32 arg;
+	};
+
+	// One per line, so skips can land anywhere.  Those that use the next lines too say how many in lines.
+	struct CheatOperation {
+		u8 op;
+		u8 size;
+		u8 cond;
+		u32 lines;
+		u32 addr;
+		// Pre-resolved, null if the address isn't valid memory.
+		u8 *ptr;
+		u8 *ptr2;
+		u32 val;
+		u32 val2;
+		u32 count;
+		s32 step;
+	};
+
+	CheatOperation CompileLine(size_t index) const;
+	size_t ExecuteOperation(size_t index);
+	size_t ExecutePointerCommand(size_t index);
+	size_t SkipLines(size_t index, u32 count) const;
+	const CheatLine &GetLine(size_t index) const;
+
+	bool exit2, cheatEnabled;
+	u32 GetAddress(u32 value) const;
 	std::vector<std::string> codeNameList;
 
-	std::vector<std::string> codes, initialCodesList, parts;
-	size_t currentCode;
+	std::vector<std::string> initialCodesList, parts;
+	std::vector<CheatLine> codeLines;
+	std::vector<CheatOperation> operations;
 };
@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
+#include "base/timeutil.h"
 #include "i18n/i18n.h"
 #include "native/thread/thread.h"
 #include "native/thread/threadutil.h"
@@ -26,6 +29,7 @@
 #include "Core/HLE/sceCtrl.h"
 #include "Core/MemMap.h"
 #include "Core/Config.h"
+#include "Core/CoreTiming.h"
 #include "Core/Reporting.h"
 #include "Core/HW/MemoryStick.h"
 #include "Core/Dialog/PSPSaveDialog.h"
@@ -36,6 +40,10 @@ const static float FONT_SCALE = 0.55f;
 // Some games seem to required slightly longer delays to work, so we try 200ms as a compromise.
 const static int SAVEDATA_INIT_DELAY_US = 200000;
 const static int SAVEDATA_SHUTDOWN_DELAY_US = 2000;
+// How long the io takes in emulated time, whatever the host does.  Reads finish by the next frame as before,
+// writes (with encryption and the SFO hash) get long enough to hide slow storage, and are still quick for a memory stick.
+const static int SAVEDATA_IO_READ_DELAY_US = 10000;
+const static int SAVEDATA_IO_WRITE_DELAY_US = 250000;
 
 // These are the only sizes which are allowed.
 // TODO: We should test what the different behavior is for each.
@@ -49,6 +57,12 @@ PSPSaveDialog::PSPSaveDialog()
 	, display(DS_NONE)
 	, currentSelectedSave(0)
 	, ioThread(0)
+	, ioThreadStatus(SAVEIO_NONE)
+	, ioResult(DS_NONE)
+	, ioDoneTicks(0)
+	, ioHostTime(0.0)
+	, ioLastCheckTime(0.0)
+	, ioLongestFrame(0.0)
 {
 	param.SetPspParam(0);
 }
@@ -300,7 +314,6 @@ void PSPSaveDialog::DisplayBanner(int which)
 
 void PSPSaveDialog::DisplaySaveList(bool canMove)
 {
-	lock_guard guard(paramLock);
 	static int upFramesHeld = 0;
 	static int downFramesHeld = 0;
 
@@ -360,7 +373,6 @@ void PSPSaveDialog::DisplaySaveList(bool canMove)
 
 void PSPSaveDialog::DisplaySaveIcon()
 {
-	lock_guard guard(paramLock);
 	int textureColor = CalcFadedColor(0xFFFFFFFF);
 	auto curSave = param.GetFileInfo(currentSelectedSave);
 
@@ -389,7 +401,6 @@ void PSPSaveDialog::DisplaySaveIcon()
 
 void PSPSaveDialog::DisplaySaveDataInfo1()
 {
-	lock_guard guard(paramLock);
 	if (param.GetFileInfo(currentSelectedSave).size == 0) {
 		I18NCategory *d = GetI18NCategory("Dialog");
 		PPGeDrawText(d->T("NEW DATA"), 180, 136, PPGE_ALIGN_VCENTER, 0.6f, CalcFadedColor(0xFFFFFFFF));
@@ -462,7 +473,6 @@ void PSPSaveDialog::DisplaySaveDataInfo1()
 
 void PSPSaveDialog::DisplaySaveDataInfo2()
 {
-	lock_guard guard(paramLock);
 	if (param.GetFileInfo(currentSelectedSave).size == 0) {		
 	} else {
 		char txt[1024];
@@ -583,8 +593,9 @@ int PSPSaveDialog::Update(int animSpeed)
 	// The struct may have been updated by the game.  This happens in "Where Is My Heart?"
 	// Check if it has changed, reload it.
 	// TODO: Cut down on preloading?  This rebuilds the list from scratch.
+	// Not while the io thread is using it, though.
 	int size = Memory::Read_U32(requestAddr);
-	if (memcmp(Memory::GetPointer(requestAddr), &originalRequest, size) != 0) {
+	if (!ioThread && memcmp(Memory::GetPointer(requestAddr), &originalRequest, size) != 0) {
 		memset(&request, 0, sizeof(request));
 		Memory::Memcpy(&request, requestAddr, size);
 		Memory::Memcpy(&originalRequest, requestAddr, size);
@@ -681,8 +692,10 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_SAVE_SAVING:
-			if (ioThreadStatus != SAVEIO_PENDING) {
-				JoinIOThread();
+			if (IOActionFinished()) {
+				display = ioResult;
+				if (display == DS_SAVE_DONE)
+					param.SetPspParam(param.GetPspParam());
 			}
 
 			StartDraw();
@@ -697,7 +710,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_SAVE_FAILED:
-			JoinIOThread();
 			StartDraw();
 
 			DisplaySaveIcon();
@@ -721,10 +733,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_SAVE_DONE:
-			if (ioThread) {
-				JoinIOThread();
-				param.SetPspParam(param.GetPspParam());
-			}
 			StartDraw();
 
 			DisplaySaveIcon();
@@ -786,8 +794,8 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_LOAD_LOADING:
-			if (ioThreadStatus != SAVEIO_PENDING) {
-				JoinIOThread();
+			if (IOActionFinished()) {
+				display = ioResult;
 			}
 
 			StartDraw();
@@ -802,7 +810,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_LOAD_FAILED:
-			JoinIOThread();
 			StartDraw();
 
 			DisplaySaveIcon();
@@ -826,7 +833,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_LOAD_DONE:
-			JoinIOThread();
 			StartDraw();
 			
 			DisplaySaveIcon();
@@ -911,8 +917,10 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_DELETE_DELETING:
-			if (ioThreadStatus != SAVEIO_PENDING) {
-				JoinIOThread();
+			if (IOActionFinished()) {
+				display = ioResult;
+				if (display == DS_DELETE_DONE)
+					param.SetPspParam(param.GetPspParam());
 			}
 
 			StartDraw();
@@ -924,7 +932,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_DELETE_FAILED:
-			JoinIOThread();
 			StartDraw();
 
 			DisplayMessage(d->T("DeleteFailed", "Unable to delete data."));
@@ -939,10 +946,6 @@ int PSPSaveDialog::Update(int animSpeed)
 			EndDraw();
 		break;
 		case DS_DELETE_DONE:
-			if (ioThread) {
-				JoinIOThread();
-				param.SetPspParam(param.GetPspParam());
-			}
 			StartDraw();
 			
 			DisplayMessage(d->T("Delete completed"));
@@ -982,9 +985,10 @@ int PSPSaveDialog::Update(int animSpeed)
 				break;
 			case SAVEIO_PENDING:
 			case SAVEIO_DONE:
-				// To make sure there aren't any timing variations, we sync the next frame.
-				JoinIOThread();
-				ChangeStatus(SCE_UTILITY_STATUS_FINISHED, 0);
+				// The game keeps running meanwhile, and sees it finish at the same emulated time every run.
+				if (IOActionFinished()) {
+					ChangeStatus(SCE_UTILITY_STATUS_FINISHED, 0);
+				}
 				break;
 			}
 		break;
@@ -1001,27 +1005,28 @@ int PSPSaveDialog::Update(int animSpeed)
 }
 
 void PSPSaveDialog::ExecuteIOAction() {
+	const double start = real_time_now();
 	lock_guard guard(paramLock);
 	switch (display) {
 	case DS_LOAD_LOADING:
 		if (param.Load(param.GetPspParam(), GetSelectedSaveDirName(), currentSelectedSave)) {
-			display = DS_LOAD_DONE;
+			ioResult = DS_LOAD_DONE;
 		} else {
-			display = DS_LOAD_FAILED;
+			ioResult = DS_LOAD_FAILED;
 		}
 		break;
 	case DS_SAVE_SAVING:
 		if (param.Save(param.GetPspParam(), GetSelectedSaveDirName())) {
-			display = DS_SAVE_DONE;
+			ioResult = DS_SAVE_DONE;
 		} else {
-			display = DS_SAVE_FAILED;
+			ioResult = DS_SAVE_FAILED;
 		}
 		break;
 	case DS_DELETE_DELETING:
 		if (param.Delete(param.GetPspParam(),currentSelectedSave)) {
-			display = DS_DELETE_DONE;
+			ioResult = DS_DELETE_DONE;
 		} else {
-			display = DS_DELETE_FAILED;
+			ioResult = DS_DELETE_FAILED;
 		}
 		break;
 	case DS_NONE:
@@ -1033,6 +1038,7 @@ void PSPSaveDialog::ExecuteIOAction() {
 		break;
 	}
 
+	ioHostTime = real_time_now() - start;
 	ioThreadStatus = SAVEIO_DONE;
 }
 
@@ -1145,9 +1151,64 @@ void PSPSaveDialog::StartIOThread() {
 	}
 
 	ioThreadStatus = SAVEIO_PENDING;
+	ioResult = display;
+	ioDoneTicks = CoreTiming::GetTicks() + usToCycles(IOActionDelayUs());
+	ioHostTime = 0.0;
+	ioLastCheckTime = real_time_now();
+	ioLongestFrame = 0.0;
 	ioThread = new std::thread(&DoExecuteIOAction, this);
 }
 
+bool PSPSaveDialog::IOActionFinished() {
+	// This runs once a frame while the action is pending, so the gaps between calls are the frame times.
+	const double now = real_time_now();
+	const double frame = now - ioLastCheckTime;
+	ioLongestFrame = std::max(ioLongestFrame, frame);
+	ioLastCheckTime = now;
+	if (CoreTiming::GetTicks() < ioDoneTicks) {
+		return false;
+	}
+
+	// If the host is slower than our estimate, the game has to wait for it.
+	if (ioThreadStatus == SAVEIO_PENDING) {
+		JoinIOThread();
+		const double waited = real_time_now() - now;
+		INFO_LOG(SCEUTILITY, "Savedata io ran %0.1f ms past its emulated time", waited * 1000.0);
+		ioLongestFrame = std::max(ioLongestFrame, frame + waited);
+	} else {
+		JoinIOThread();
+	}
+	// Before the io finished at an emulated time, the frame that started it took all of the host time.
+	INFO_LOG(SCEUTILITY, "Savedata io took %0.1f ms on the host, longest frame meanwhile %0.1f ms", ioHostTime * 1000.0, ioLongestFrame * 1000.0);
+	return true;
+}
+
+int PSPSaveDialog::IOActionDelayUs() {
+	switch (display) {
+	case DS_SAVE_SAVING:
+	case DS_DELETE_DELETING:
+		return SAVEDATA_IO_WRITE_DELAY_US;
+
+	case DS_NONE:
+		switch ((SceUtilitySavedataType)(u32)param.GetPspParam()->mode) {
+		case SCE_UTILITY_SAVEDATA_TYPE_SAVE:
+		case SCE_UTILITY_SAVEDATA_TYPE_AUTOSAVE:
+		case SCE_UTILITY_SAVEDATA_TYPE_MAKEDATA:
+		case SCE_UTILITY_SAVEDATA_TYPE_MAKEDATASECURE:
+		case SCE_UTILITY_SAVEDATA_TYPE_WRITEDATA:
+		case SCE_UTILITY_SAVEDATA_TYPE_WRITEDATASECURE:
+		case SCE_UTILITY_SAVEDATA_TYPE_DELETEDATA:
+		case SCE_UTILITY_SAVEDATA_TYPE_SINGLEDELETE:
+			return SAVEDATA_IO_WRITE_DELAY_US;
+		default:
+			return SAVEDATA_IO_READ_DELAY_US;
+		}
+
+	default:
+		return SAVEDATA_IO_READ_DELAY_US;
+	}
+}
+
 int PSPSaveDialog::Shutdown(bool force) {
 	if (GetStatus() != SCE_UTILITY_STATUS_FINISHED && !force)
 		return SCE_ERROR_UTILITY_INVALID_STATUS;
@@ -1168,7 +1229,7 @@ void PSPSaveDialog::DoState(PointerWrap &p) {
 	JoinIOThread();
 	PSPDialog::DoState(p);
 
-	auto s = p.Section("PSPSaveDialog", 1, 2);
+	auto s = p.Section("PSPSaveDialog", 1, 3);
 	if (!s) {
 		return;
 	}
@@ -1185,10 +1246,16 @@ void PSPSaveDialog::DoState(PointerWrap &p) {
 	p.Do(requestAddr);
 	p.Do(currentSelectedSave);
 	p.Do(yesnoChoice);
+	// The io thread was joined above, so a pending action only has its emulated time left to run.
 	if (s > 2) {
 		p.Do(ioThreadStatus);
+		p.Do(ioResult);
+		p.Do(ioDoneTicks);
 	} else {
+		// These finished the io before saving, so display already has its result.
 		ioThreadStatus = SAVEIO_NONE;
+		ioResult = display;
+		ioDoneTicks = 0;
 	}
 }
 
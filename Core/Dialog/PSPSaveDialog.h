@@ -98,6 +98,8 @@ class PSPSaveDialog: public PSPDialog {
 
 	void JoinIOThread();
 	void StartIOThread();
+	bool IOActionFinished();
+	int IOActionDelayUs();
 	void ExecuteNotVisibleIOAction();
 
 	enum DisplayState
@@ -154,7 +156,15 @@ class PSPSaveDialog: public PSPDialog {
 	};
 
 	std::thread *ioThread;
+	// Held by the io thread while it works.  Only SetPspParam() changes the save list, so drawing doesn't need it.
 	recursive_mutex paramLock;
 	volatile SaveIOStatus ioThreadStatus;
+	// Where the io thread leaves the next display state, applied once the emulated time is up.
+	DisplayState ioResult;
+	u64 ioDoneTicks;
+	// Host timing, in seconds, logged when the action finishes.
+	double ioHostTime;
+	double ioLastCheckTime;
+	double ioLongestFrame;
 };
 
@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <vector>
+
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
 #include "Core/MIPS/MIPSTables.h"
@@ -55,10 +58,53 @@ void addrToHiLo(u32 addr, u16 &hi, s16 &lo)
 	}
 }
 
+void ElfReader::SetRelocationRange(u32 start, u32 end) {
+	if (start < end && end - start >= 4 && Memory::IsValidAddress(start) && Memory::IsValidAddress(end - 1)) {
+		relocBase = Memory::GetPointer(start);
+		relocStart = start;
+		relocEnd = end;
+	} else {
+		relocBase = 0;
+		relocStart = 0;
+		relocEnd = 0;
+	}
+}
+
+// Relocations nearly always land in the segments we just copied, so those go straight to host memory.
+// The copy also overwrote any emuhacks, so there's nothing to resolve there.
+u32 ElfReader::ReadRelocationOp(u32 addr) const {
+	if (IsInRelocationRange(addr)) {
+		u32_le op;
+		memcpy(&op, relocBase + (addr - relocStart), sizeof(op));
+		return op;
+	}
+	return Memory::Read_Instruction(addr, true).encoding;
+}
+
+void ElfReader::WriteRelocationOp(u32 addr, u32 op) {
+	if (IsInRelocationRange(addr)) {
+		u32_le value = op;
+		memcpy(relocBase + (addr - relocStart), &value, sizeof(value));
+	} else {
+		Memory::Write_U32(op, addr);
+	}
+}
+
 bool ElfReader::LoadRelocations(Elf32_Rel *rels, int numRelocs)
 {
 	int numErrors = 0;
 	DEBUG_LOG(LOADER, "Loading %i relocations...", numRelocs);
+
+	// For each relocation, the index of the next R_MIPS_LO16 after it, so HI16s don't rescan the table.
+	std::vector<int> nextLo16(numRelocs);
+	int nextLo = numRelocs;
+	for (int r = numRelocs - 1; r >= 0; r--) {
+		nextLo16[r] = nextLo;
+		if ((rels[r].r_info & 0xF) == R_MIPS_LO16) {
+			nextLo = r;
+		}
+	}
+
 	for (int r = 0; r < numRelocs; r++)
 	{
 		// INFO_LOG(LOADER, "Loading reloc %i  (%p)...", r, rels + r);
@@ -86,7 +132,7 @@ bool ElfReader::LoadRelocations(Elf32_Rel *rels, int numRelocs)
 		// It appears that misaligned relocations are allowed.
 		// Will they work correctly on big-endian?
 
-		if (((addr & 3) && type != R_MIPS_32) || !Memory::IsValidAddress(addr)) {
+		if (((addr & 3) && type != R_MIPS_32) || (!IsInRelocationRange(addr) && !Memory::IsValidAddress(addr))) {
 			if (numErrors < 10) {
 				WARN_LOG_REPORT(LOADER, "Suspicious address %08x, skipping reloc, type = %d", addr, type);
 			} else if (numErrors == 10) {
@@ -96,7 +142,7 @@ bool ElfReader::LoadRelocations(Elf32_Rel *rels, int numRelocs)
 			continue;
 		}
 
-		u32 op = Memory::Read_Instruction(addr, true).encoding;
+		u32 op = ReadRelocationOp(addr);
 
 		const bool log = false;
 		//log=true;
@@ -129,24 +175,21 @@ bool ElfReader::LoadRelocations(Elf32_Rel *rels, int numRelocs)
 				u32 cur = (op & 0xFFFF) << 16;
 				u16 hi = 0;
 				bool found = false;
-				for (int t = r + 1; t<numRelocs; t++)
+				for (int t = nextLo16[r]; t < numRelocs; t = nextLo16[t])
 				{
-					if ((rels[t].r_info & 0xF) == R_MIPS_LO16) 
-					{
-						u32 corrLoAddr = rels[t].r_offset + segmentVAddr[readwrite];
-						if (log) {
-							DEBUG_LOG(LOADER,"Corresponding lo found at %08x", corrLoAddr);
-						}
-						if (Memory::IsValidAddress(corrLoAddr)) {
-							s16 lo = (s32)(s16)(u16)(Memory::ReadUnchecked_U32(corrLoAddr) & 0xFFFF); //signed??
-							cur += lo;
-							cur += relocateTo;
-							addrToHiLo(cur, hi, lo);
-							found = true;
-							break;
-						} else {
-							ERROR_LOG(LOADER, "Bad corrLoAddr %08x", corrLoAddr);
-						}
+					u32 corrLoAddr = rels[t].r_offset + segmentVAddr[readwrite];
+					if (log) {
+						DEBUG_LOG(LOADER,"Corresponding lo found at %08x", corrLoAddr);
+					}
+					if (IsInRelocationRange(corrLoAddr) || Memory::IsValidAddress(corrLoAddr)) {
+						s16 lo = (s32)(s16)(u16)(ReadRelocationOp(corrLoAddr) & 0xFFFF); //signed??
+						cur += lo;
+						cur += relocateTo;
+						addrToHiLo(cur, hi, lo);
+						found = true;
+						break;
+					} else {
+						ERROR_LOG(LOADER, "Bad corrLoAddr %08x", corrLoAddr);
 					}
 				}
 				if (!found) {
@@ -191,7 +234,7 @@ bool ElfReader::LoadRelocations(Elf32_Rel *rels, int numRelocs)
 			}
 			break;
 		}
-		Memory::Write_U32(op, addr);
+		WriteRelocationOp(addr, op);
 	}
 	if (numErrors) {
 		WARN_LOG(LOADER, "%i bad relocations found!!!", numErrors);
@@ -309,7 +352,7 @@ void ElfReader::LoadRelocations2(int rel_seg)
 				ERROR_LOG_REPORT(LOADER, "Rel2: invalid lo16 type! %x", flag);
 			}
 
-			op = Memory::Read_Instruction(rel_offset, true).encoding;
+			op = ReadRelocationOp(rel_offset);
 			DEBUG_LOG(LOADER, "Rel2: %5d: CMD=0x%04X flag=%x type=%d off_seg=%d offset=%08x addr_seg=%d op=%08x\n", rcount, cmd, flag, type, off_seg, rel_base, addr_seg, op);
 
 			switch(type){
@@ -343,7 +386,7 @@ void ElfReader::LoadRelocations2(int rel_seg)
 				break;
 			}
 
-			Memory::Write_U32(op, rel_offset);
+			WriteRelocationOp(rel_offset, op);
 			rcount += 1;
 		}
 	}
@@ -445,6 +488,8 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 
 	// First pass : Get the damn bits into RAM
 	u32 baseAddress = bRelocate?vaddr:0;
+	u32 loadedStart = 0xFFFFFFFF;
+	u32 loadedEnd = 0;
 
 	for (int i=0; i<header->e_phnum; i++)
 	{
@@ -468,10 +513,13 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 
 			memcpy(dst, src, srcSize);
 			CBreakPoints::ExecMemCheck(writeAddr, true, dstSize, currentMIPS->pc);
+			loadedStart = std::min(loadedStart, writeAddr);
+			loadedEnd = std::max(loadedEnd, writeAddr + dstSize);
 			DEBUG_LOG(LOADER,"Loadable Segment Copied to %08x, size %08x", writeAddr, (u32)p->p_memsz);
 		}
 	}
 	memblock.ListBlocks();
+	SetRelocationRange(loadedStart, loadedEnd);
 
 	DEBUG_LOG(LOADER,"%i sections:", header->e_shnum);
 
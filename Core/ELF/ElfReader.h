@@ -54,7 +54,10 @@ class ElfReader
 		sectionAddrs(0),
 		bRelocate(false),
 		entryPoint(0),
-		vaddr(0) {
+		vaddr(0),
+		relocBase(0),
+		relocStart(0),
+		relocEnd(0) {
 		base = (char*)ptr;
 		base32 = (u32 *)ptr;
 		header = (Elf32_Ehdr*)ptr;
@@ -142,6 +145,13 @@ class ElfReader
 
 
 private:
+	void SetRelocationRange(u32 start, u32 end);
+	bool IsInRelocationRange(u32 addr) const {
+		return addr >= relocStart && addr < relocEnd && relocEnd - addr >= 4;
+	}
+	u32 ReadRelocationOp(u32 addr) const;
+	void WriteRelocationOp(u32 addr, u32 op);
+
 	char *base;
 	u32 *base32;
 	Elf32_Ehdr *header;
@@ -154,4 +164,8 @@ class ElfReader
 	u32 totalSize;
 	u32 vaddr;
 	u32 segmentVAddr[32];
+	// Where the loaded segments are, so relocations there can skip the memory map.
+	u8 *relocBase;
+	u32 relocStart;
+	u32 relocEnd;
 };
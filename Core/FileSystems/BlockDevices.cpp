@@ -16,6 +16,8 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 
+#include "base/timeutil.h"
+#include "thread/threadutil.h"
 #include "Common/FileUtil.h"
 #include "Core/Loaders.h"
 #include "Core/FileSystems/BlockDevices.h"
@@ -45,24 +47,54 @@ BlockDevice *constructBlockDevice(FileLoader *fileLoader) {
 		return new FileBlockDevice(fileLoader);
 }
 
-RAMBlockDevice::RAMBlockDevice(BlockDevice *device) {
+RAMBlockDevice::RAMBlockDevice(BlockDevice *device) : device_(device), stopFill_(false) {
 	totalBlocks_ = device->GetNumBlocks();
 	u32 blockSize = GetBlockSize();
-	image_ = new u8[totalBlocks_ * blockSize];
-	for (int i = 0; i < totalBlocks_; i++) {
-		device->ReadBlock(i, image_ + i * blockSize);
-	}
-	delete device;
+	image_ = new u8[(size_t)totalBlocks_ * blockSize];
+	blockReady_.resize((totalBlocks_ + 31) / 32, 0);
+	fillThread_ = new std::thread([this] { FillThread(); });
 }
 
 RAMBlockDevice::~RAMBlockDevice() {
+	stopFill_ = true;
+	fillThread_->join();
+	delete fillThread_;
+	delete device_;
 	delete[] image_;
 }
 
+void RAMBlockDevice::EnsureBlock(int blockNumber) {
+	if (!IsReady(blockNumber)) {
+		u32 blockSize = GetBlockSize();
+		device_->ReadBlock(blockNumber, image_ + (size_t)blockSize * blockNumber);
+		blockReady_[blockNumber >> 5] |= 1 << (blockNumber & 31);
+	}
+}
+
+void RAMBlockDevice::FillThread() {
+	setCurrentThreadName("RAMBlockDevice");
+
+	double start = real_time_now();
+	for (int i = 0; i < totalBlocks_ && !stopFill_; i++) {
+		// Take the lock per block, so game reads only ever wait for one block.
+		lock_guard guard(lock_);
+		EnsureBlock(i);
+	}
+
+	if (!stopFill_) {
+		INFO_LOG(FILESYS, "Cached %d blocks in RAM in %0.2f seconds", totalBlocks_, real_time_now() - start);
+	}
+}
+
 bool RAMBlockDevice::ReadBlock(int blockNumber, u8 *outPtr) {
 	if (blockNumber >= 0 && blockNumber < totalBlocks_) {
 		u32 blockSize = GetBlockSize();
-		memcpy(outPtr, image_ + blockSize * blockNumber, blockSize);
+		{
+			lock_guard guard(lock_);
+			EnsureBlock(blockNumber);
+		}
+		// Once ready, a block is never written again, so no need to hold the lock.
+		memcpy(outPtr, image_ + (size_t)blockSize * blockNumber, blockSize);
 		return true;
 	}
 	return false;
@@ -372,8 +404,11 @@ bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 }
 
 
+recursive_mutex amctrlLock;
+
 NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
-	: fileLoader_(fileLoader)
+	: fileLoader_(fileLoader), lastBlock_(-1), readaheadThread_(nullptr), shuttingDown_(false),
+	  cacheHits_(0), decryptedBlocks_(0), readaheadBlocks_(0), decryptSeconds_(0.0)
 {
 	MAC_KEY mkey;
 	CIPHER_KEY ckey;
@@ -387,6 +422,7 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 		ERROR_LOG(LOADER, "Invalid NPUMDIMG header!");
 	}
 
+	lock_guard amctrlGuard(amctrlLock);
 	kirk_init();
 
 	// getkey
@@ -407,8 +443,8 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 	blockSize = blockLBAs*2048;
 	numBlocks = (lbaSize+blockLBAs-1)/blockLBAs; // total blocks;
 
-	blockBuf = new u8[blockSize];
 	tempBuf  = new u8[blockSize];
+	maxCachedBlocks_ = std::max((size_t)MIN_CACHED_BLOCKS, (size_t)CACHE_BYTES / blockSize);
 
 	tableOffset = *(u32*)(np_header+0x6c); // table offset
 
@@ -434,36 +470,95 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 		p += 8;
 	}
 
-	currentBlock = -1;
-
+	readaheadThread_ = new std::thread([this] { ReadaheadThread(); });
 }
 
 NPDRMDemoBlockDevice::~NPDRMDemoBlockDevice()
 {
+	{
+		lock_guard guard(lock_);
+		shuttingDown_ = true;
+		readaheadWait_.notify_one();
+	}
+	readaheadThread_->join();
+	delete readaheadThread_;
+
+	INFO_LOG(LOADER, "NPDRM: decrypted %d blocks (%d ahead) in %0.2f seconds, %d cache hits", decryptedBlocks_, readaheadBlocks_, decryptSeconds_, cacheHits_);
+
+	for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+		delete [] it->second.data;
+	}
 	delete [] table;
 	delete [] tempBuf;
-	delete [] blockBuf;
 }
 
 int lzrc_decompress(void *out, int out_len, void *in, int in_len);
 
 bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 {
-	CIPHER_KEY ckey;
-	int block, lba, lzsize;
-	size_t readSize;
-	u8 *readBuf;
+	int block = blockNumber/blockLBAs;
+	int lba = blockNumber%blockLBAs;
+
+	lock_guard guard(lock_);
+	u8 *data = GetCachedBlock(block);
+	if(data){
+		cacheHits_++;
+	}else if(!DecryptBlock(block, data)){
+		return false;
+	}
 
-	lba = blockNumber-currentBlock;
-	if(lba>=0 && lba<blockLBAs){
-		memcpy(outPtr, blockBuf+lba*2048, 2048);
-		return true;
+	if(block!=lastBlock_){
+		// Games mostly stream through the image, so get the next blocks ready.
+		if(block==lastBlock_+1)
+			QueueReadahead(block+1);
+		lastBlock_ = block;
+	}
+
+	// Demos made by fake_np may have an unreadable last block.
+	if(data)
+		memcpy(outPtr, data+lba*2048, 2048);
+
+	return true;
+}
+
+u8 *NPDRMDemoBlockDevice::GetCachedBlock(int block)
+{
+	auto it = cache_.find(block);
+	if(it==cache_.end())
+		return nullptr;
+
+	lru_.splice(lru_.end(), lru_, it->second.lruPos);
+	return it->second.data;
+}
+
+u8 *NPDRMDemoBlockDevice::AllocateCacheBlock(int block)
+{
+	u8 *data;
+	if(cache_.size()>=maxCachedBlocks_){
+		// Reuse the least recently used block's buffer.
+		int oldest = lru_.front();
+		lru_.pop_front();
+		data = cache_[oldest].data;
+		cache_.erase(oldest);
+	}else{
+		data = new u8[blockSize];
 	}
 
-	block = blockNumber/blockLBAs;
-	lba = blockNumber%blockLBAs;
-	currentBlock = block*blockLBAs;
+	CachedBlock &entry = cache_[block];
+	entry.data = data;
+	entry.lruPos = lru_.insert(lru_.end(), block);
+	return data;
+}
 
+bool NPDRMDemoBlockDevice::DecryptBlock(int block, u8 *&data)
+{
+	CIPHER_KEY ckey;
+	int lzsize;
+	size_t readSize;
+	u8 *readBuf;
+	u8 *blockBuf;
+
+	data = nullptr;
 	if(table[block].unk_1c!=0){
 		if((u32)block==(numBlocks-1))
 			return true; // demos make by fake_np
@@ -471,6 +566,8 @@ bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 			return false;
 	}
 
+	double start = real_time_now();
+	blockBuf = AllocateCacheBlock(block);
 	if(table[block].size<blockSize)
 		readBuf = tempBuf;
 	else
@@ -478,6 +575,9 @@ bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 
 	readSize = fileLoader_->ReadAt(psarOffset+table[block].offset, 1, table[block].size, readBuf);
 	if(readSize != (size_t)table[block].size){
+		lru_.erase(cache_[block].lruPos);
+		cache_.erase(block);
+		delete [] blockBuf;
 		if((u32)block==(numBlocks-1))
 			return true;
 		else
@@ -489,6 +589,7 @@ bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 	}
 
 	if((table[block].flag&4)==0){
+		lock_guard amctrlGuard(amctrlLock);
 		sceDrmBBCipherInit(&ckey, 1, 2, hkey, vkey, table[block].offset>>4);
 		sceDrmBBCipherUpdate(&ckey, readBuf, table[block].size);
 		sceDrmBBCipherFinal(&ckey);
@@ -498,11 +599,49 @@ bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 		lzsize = lzrc_decompress(blockBuf, 0x00100000, readBuf, table[block].size);
 		if(lzsize!=blockSize){
 			ERROR_LOG(LOADER, "LZRC decompress error! lzsize=%d\n", lzsize);
+			lru_.erase(cache_[block].lruPos);
+			cache_.erase(block);
+			delete [] blockBuf;
 			return false;
 		}
 	}
 
-	memcpy(outPtr, blockBuf+lba*2048, 2048);
-
+	decryptedBlocks_++;
+	decryptSeconds_ += real_time_now() - start;
+	data = blockBuf;
 	return true;
 }
+
+void NPDRMDemoBlockDevice::QueueReadahead(int block)
+{
+	for(int i = 0; i < READAHEAD_BLOCKS; i++){
+		if((u32)(block+i)>=numBlocks)
+			break;
+		if(cache_.find(block+i)==cache_.end() && std::find(readahead_.begin(), readahead_.end(), block+i)==readahead_.end())
+			readahead_.push_back(block+i);
+	}
+	readaheadWait_.notify_one();
+}
+
+void NPDRMDemoBlockDevice::ReadaheadThread()
+{
+	setCurrentThreadName("NPDRMReadahead");
+
+	lock_guard guard(lock_);
+	while(!shuttingDown_){
+		if(readahead_.empty()){
+			readaheadWait_.wait(lock_);
+			continue;
+		}
+
+		int block = readahead_.front();
+		readahead_.pop_front();
+		// The game may have gotten to it first.
+		if(cache_.find(block)!=cache_.end())
+			continue;
+
+		u8 *data;
+		if(DecryptBlock(block, data) && data)
+			readaheadBlocks_++;
+	}
+}
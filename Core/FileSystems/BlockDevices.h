@@ -23,6 +23,13 @@
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "native/base/mutex.h"
+#include "native/thread/thread.h"
 #include "Common/CommonTypes.h"
 #include "Core/ELF/PBPReader.h"
 
@@ -95,6 +102,9 @@ struct table_info {
 	int unk_1c;
 };
 
+// libkirk's amctrl (sceDrmBB*, pgd_*) works in a static buffer, hold this while using it.
+extern recursive_mutex amctrlLock;
+
 class NPDRMDemoBlockDevice : public BlockDevice
 {
 public:
@@ -105,6 +115,26 @@ class NPDRMDemoBlockDevice : public BlockDevice
 	u32 GetNumBlocks() override {return (u32)lbaSize;}
 
 private:
+	enum {
+		// Decrypted blocks are kept up to this many bytes.
+		CACHE_BYTES = 8 * 1024 * 1024,
+		MIN_CACHED_BLOCKS = 4,
+		// How many blocks to decrypt ahead once reads look sequential.
+		READAHEAD_BLOCKS = 2,
+	};
+
+	struct CachedBlock {
+		u8 *data;
+		std::list<int>::iterator lruPos;
+	};
+
+	// These are all called with lock_ held.
+	bool DecryptBlock(int block, u8 *&data);
+	u8 *GetCachedBlock(int block);
+	u8 *AllocateCacheBlock(int block);
+	void QueueReadahead(int block);
+	void ReadaheadThread();
+
 	FileLoader *fileLoader_;
 	u32 lbaSize;
 
@@ -117,13 +147,29 @@ class NPDRMDemoBlockDevice : public BlockDevice
 	u8 hkey[16];
 	struct table_info *table;
 
-	int currentBlock;
-	u8 *blockBuf;
 	u8 *tempBuf;
+
+	recursive_mutex lock_;
+	std::unordered_map<int, CachedBlock> cache_;
+	// Most recently used at the back.
+	std::list<int> lru_;
+	size_t maxCachedBlocks_;
+	int lastBlock_;
+
+	std::deque<int> readahead_;
+	condition_variable readaheadWait_;
+	std::thread *readaheadThread_;
+	bool shuttingDown_;
+
+	// Stats, logged on close.
+	int cacheHits_;
+	int decryptedBlocks_;
+	int readaheadBlocks_;
+	double decryptSeconds_;
 };
 
-// This simply fully reads another block device and caches it in RAM.
-// A bit slow to initialize.
+// This caches another block device fully in RAM.  Blocks are read on first access,
+// while a background thread fills in the rest in disc order.
 class RAMBlockDevice : public BlockDevice
 {
 public:
@@ -134,8 +180,22 @@ class RAMBlockDevice : public BlockDevice
 	u32 GetNumBlocks() override;
 
 private:
+	bool IsReady(int blockNumber) const {
+		return (blockReady_[blockNumber >> 5] & (1 << (blockNumber & 31))) != 0;
+	}
+	// Call with lock_ held.
+	void EnsureBlock(int blockNumber);
+	void FillThread();
+
+	BlockDevice *device_;
 	int totalBlocks_;
 	u8 *image_;
+	// One bit per block, set once the block is in image_.
+	std::vector<u32> blockReady_;
+	// Held only while reading a single block from device_.
+	recursive_mutex lock_;
+	std::thread *fillThread_;
+	volatile bool stopFill_;
 };
 
 
@@ -49,20 +49,98 @@ QTM_USE_NAMESPACE
 #endif
 
 #if HOST_IS_CASE_SENSITIVE
-static bool FixFilenameCase(const std::string &path, std::string &filename)
+static std::string LowerCase(const std::string &s)
+{
+	std::string lower = s;
+	for (size_t i = 0; i < lower.size(); i++)
+	{
+		lower[i] = tolower(lower[i]);
+	}
+	return lower;
+}
+
+bool PathCaseCache::FixFilenameCase(const std::string &dir, std::string &filename)
+{
+	auto cached = dirs_.find(dir);
+	if (cached == dirs_.end())
+	{
+		struct dirent_large { struct dirent entry; char padding[FILENAME_MAX+1]; } diren;
+		struct dirent *result = NULL;
+
+		DIR *dirp = opendir(dir.c_str());
+		if (!dirp)
+			return false;
+
+		NameMap &names = dirs_[dir];
+		while (!readdir_r(dirp, (dirent*) &diren, &result) && result)
+		{
+			names[LowerCase(result->d_name)] = result->d_name;
+		}
+		closedir(dirp);
+
+		++diskLookups_;
+		cached = dirs_.find(dir);
+	}
+	else
+	{
+		++cacheLookups_;
+	}
+
+	auto found = cached->second.find(LowerCase(filename));
+	if (found == cached->second.end())
+		return false;
+
+	filename = found->second;
+	return true;
+}
+
+void PathCaseCache::Invalidate(const std::string &hostPath)
+{
+	// Keys never contain empty components or a trailing slash on the last one.
+	std::string path;
+	path.reserve(hostPath.size());
+	for (size_t i = 0; i < hostPath.size(); i++)
+	{
+		if (hostPath[i] != '/' || path.empty() || path[path.size() - 1] != '/')
+			path.push_back(hostPath[i]);
+	}
+	if (!path.empty() && path[path.size() - 1] == '/')
+		path.resize(path.size() - 1);
+
+	size_t slash = path.find_last_of('/');
+	if (slash != path.npos)
+		dirs_.erase(path.substr(0, slash + 1));
+
+	const std::string prefix = path + "/";
+	for (auto it = dirs_.begin(); it != dirs_.end(); )
+	{
+		if (it->first.compare(0, prefix.size(), prefix) == 0)
+			it = dirs_.erase(it);
+		else
+			++it;
+	}
+}
+
+void PathCaseCache::Clear()
+{
+	dirs_.clear();
+}
+
+static bool FixFilenameCase(const std::string &path, std::string &filename, PathCaseCache *cache)
 {
 	// Are we lucky?
 	if (File::Exists(path + filename))
 		return true;
 
+	if (cache)
+		return cache->FixFilenameCase(path, filename);
+
 	size_t filenameSize = filename.size();  // size in bytes, not characters
 	for (size_t i = 0; i < filenameSize; i++)
 	{
 		filename[i] = tolower(filename[i]);
 	}
 
-	//TODO: lookup filename in cache for "path"
-
 	struct dirent_large { struct dirent entry; char padding[FILENAME_MAX+1]; } diren;
 	struct dirent_large;
 	struct dirent *result = NULL;
@@ -97,7 +175,7 @@ static bool FixFilenameCase(const std::string &path, std::string &filename)
 	return retValue;
 }
 
-bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior)
+bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior, PathCaseCache *cache)
 {
 	size_t len = path.size();
 
@@ -128,7 +206,7 @@ bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior b
 			std::string component = path.substr(start, i - start);
 
 			// Fix case and stop on nonexistant path component
-			if (FixFilenameCase(fullPath, component) == false) {
+			if (FixFilenameCase(fullPath, component, cache) == false) {
 				// Still counts as success if partial matches allowed or if this
 				// is the last component and only the ones before it are required
 				return (behavior == FPC_PARTIAL_ALLOWED || (behavior == FPC_PATH_MUST_EXIST && i >= len));
@@ -170,7 +248,7 @@ std::string DirectoryFileHandle::GetLocalPath(std::string& basePath, std::string
 	return basePath + localpath;
 }
 
-bool DirectoryFileHandle::Open(std::string &basePath, std::string &fileName, FileAccess access, u32 &error)
+bool DirectoryFileHandle::Open(std::string &basePath, std::string &fileName, FileAccess access, u32 &error, PathCaseCache *caseCache)
 {
 	error = 0;
 
@@ -178,7 +256,7 @@ bool DirectoryFileHandle::Open(std::string &basePath, std::string &fileName, Fil
 	if (access & (FILEACCESS_APPEND|FILEACCESS_CREATE|FILEACCESS_WRITE))
 	{
 		DEBUG_LOG(FILESYS, "Checking case for path %s", fileName.c_str());
-		if ( ! FixPathCase(basePath, fileName, FPC_PATH_MUST_EXIST) )
+		if ( ! FixPathCase(basePath, fileName, FPC_PATH_MUST_EXIST, caseCache) )
 			return false;  // or go on and attempt (for a better error code than just 0?)
 	}
 	// else we try fopen first (in case we're lucky) before simulating case insensitivity
@@ -247,7 +325,7 @@ bool DirectoryFileHandle::Open(std::string &basePath, std::string &fileName, Fil
 
 #if HOST_IS_CASE_SENSITIVE
 	if (!success && !(access & FILEACCESS_CREATE)) {
-		if ( ! FixPathCase(basePath,fileName, FPC_PATH_MUST_EXIST) )
+		if ( ! FixPathCase(basePath,fileName, FPC_PATH_MUST_EXIST, caseCache) )
 			return 0;  // or go on and attempt (for a better error code than just 0?)
 		fullName = GetLocalPath(basePath,fileName); 
 		const char *fullNameC = fullName.c_str();
@@ -404,6 +482,11 @@ void DirectoryFileSystem::CloseAll() {
 
 DirectoryFileSystem::~DirectoryFileSystem() {
 	CloseAll();
+#if HOST_IS_CASE_SENSITIVE
+	if (caseCache_.CacheLookups() + caseCache_.DiskLookups() > 0) {
+		INFO_LOG(FILESYS, "Case lookups in %s: %d from cache, %d from disk", basePath.c_str(), caseCache_.CacheLookups(), caseCache_.DiskLookups());
+	}
+#endif
 }
 
 std::string DirectoryFileSystem::GetLocalPath(std::string localpath) {
@@ -422,15 +505,26 @@ std::string DirectoryFileSystem::GetLocalPath(std::string localpath) {
 	return basePath + localpath;
 }
 
+void DirectoryFileSystem::InvalidateCaseCache(const std::string &localPath) {
+#if HOST_IS_CASE_SENSITIVE
+	caseCache_.Invalidate(GetLocalPath(localPath));
+#endif
+}
+
 bool DirectoryFileSystem::MkDir(const std::string &dirname) {
 #if HOST_IS_CASE_SENSITIVE
 	// Must fix case BEFORE attempting, because MkDir would create
 	// duplicate (different case) directories
 
 	std::string fixedCase = dirname;
-	if ( ! FixPathCase(basePath,fixedCase, FPC_PARTIAL_ALLOWED) )
+	if ( ! FixPathCase(basePath,fixedCase, FPC_PARTIAL_ALLOWED, &caseCache_) )
 		return false;
 
+	// Any of the parents may be created too.
+	for (size_t pos = fixedCase.find('/', 1); pos != fixedCase.npos; pos = fixedCase.find('/', pos + 1))
+		InvalidateCaseCache(fixedCase.substr(0, pos));
+	InvalidateCaseCache(fixedCase);
+
 	return File::CreateFullPath(GetLocalPath(fixedCase));
 #else
 	return File::CreateFullPath(GetLocalPath(dirname));
@@ -442,15 +536,18 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 
 #if HOST_IS_CASE_SENSITIVE
 	// Maybe we're lucky?
-	if (File::DeleteDirRecursively(fullName))
+	if (File::DeleteDirRecursively(fullName)) {
+		InvalidateCaseCache(dirname);
 		return true;
+	}
 
 	// Nope, fix case and try again
-	fullName = dirname;
-	if ( ! FixPathCase(basePath,fullName, FPC_FILE_MUST_EXIST) )
+	std::string fixedCase = dirname;
+	if ( ! FixPathCase(basePath,fixedCase, FPC_FILE_MUST_EXIST, &caseCache_) )
 		return false;  // or go on and attempt (for a better error code than just false?)
 
-	fullName = GetLocalPath(fullName);
+	fullName = GetLocalPath(fixedCase);
+	InvalidateCaseCache(fixedCase);
 #endif
 
 /*#ifdef _WIN32
@@ -482,10 +579,11 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 
 #if HOST_IS_CASE_SENSITIVE
 	// In case TO should overwrite a file with different case
-	if ( ! FixPathCase(basePath,fullTo, FPC_PATH_MUST_EXIST) )
+	if ( ! FixPathCase(basePath,fullTo, FPC_PATH_MUST_EXIST, &caseCache_) )
 		return -1;  // or go on and attempt (for a better error code than just false?)
 #endif
 
+	InvalidateCaseCache(fullTo);
 	fullTo = GetLocalPath(fullTo);
 	const char * fullToC = fullTo.c_str();
 
@@ -500,8 +598,9 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 	{
 		// May have failed due to case sensitivity on FROM, so try again
 		fullFrom = from;
-		if ( ! FixPathCase(basePath,fullFrom, FPC_FILE_MUST_EXIST) )
+		if ( ! FixPathCase(basePath,fullFrom, FPC_FILE_MUST_EXIST, &caseCache_) )
 			return -1;  // or go on and attempt (for a better error code than just false?)
+		InvalidateCaseCache(fullFrom);
 		fullFrom = GetLocalPath(fullFrom);
 
 #ifdef _WIN32
@@ -512,6 +611,9 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 	}
 #endif
 
+	if (retValue)
+		InvalidateCaseCache(from);
+
 	// TODO: Better error codes.
 	return retValue ? 0 : (int)SCE_KERNEL_ERROR_ERRNO_FILE_ALREADY_EXISTS;
 }
@@ -529,8 +631,9 @@ bool DirectoryFileSystem::RemoveFile(const std::string &filename) {
 	{
 		// May have failed due to case sensitivity, so try again
 		fullName = filename;
-		if ( ! FixPathCase(basePath,fullName, FPC_FILE_MUST_EXIST) )
+		if ( ! FixPathCase(basePath,fullName, FPC_FILE_MUST_EXIST, &caseCache_) )
 			return false;  // or go on and attempt (for a better error code than just false?)
+		InvalidateCaseCache(fullName);
 		fullName = GetLocalPath(fullName);
 
 #ifdef _WIN32
@@ -541,13 +644,22 @@ bool DirectoryFileSystem::RemoveFile(const std::string &filename) {
 	}
 #endif
 
+	if (retValue)
+		InvalidateCaseCache(filename);
+
 	return retValue;
 }
 
 u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename) {
 	OpenFileEntry entry;
 	u32 err = 0;
+#if HOST_IS_CASE_SENSITIVE
+	bool success = entry.hFile.Open(basePath, filename, access, err, &caseCache_);
+#else
 	bool success = entry.hFile.Open(basePath, filename, access, err);
+#endif
+	if (success && (access & FILEACCESS_CREATE))
+		InvalidateCaseCache(filename);
 
 	if (!success) {
 #ifdef _WIN32
@@ -568,6 +680,7 @@ u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access, const
 		entry.guestFilename = filename;
 		entry.access = access;
 
+		lock_guard guard(entriesLock_);
 		entries[newHandle] = entry;
 
 		return newHandle;
@@ -575,6 +688,7 @@ u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access, const
 }
 
 void DirectoryFileSystem::CloseFile(u32 handle) {
+	lock_guard guard(entriesLock_);
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter != entries.end()) {
 		hAlloc->FreeHandle(handle);
@@ -587,6 +701,7 @@ void DirectoryFileSystem::CloseFile(u32 handle) {
 }
 
 bool DirectoryFileSystem::OwnsHandle(u32 handle) {
+	lock_guard guard(entriesLock_);
 	EntryMap::iterator iter = entries.find(handle);
 	return (iter != entries.end());
 }
@@ -605,7 +720,12 @@ size_t DirectoryFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size) {
 }
 
 size_t DirectoryFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
-	EntryMap::iterator iter = entries.find(handle);
+	EntryMap::iterator iter;
+	{
+		lock_guard guard(entriesLock_);
+		iter = entries.find(handle);
+	}
+	// The handle can't be closed during an async read, so the entry stays valid unlocked.
 	if (iter != entries.end())
 	{
 		size_t bytesRead = iter->second.hFile.Read(pointer,size);
@@ -623,7 +743,11 @@ size_t DirectoryFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size) {
 }
 
 size_t DirectoryFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec) {
-	EntryMap::iterator iter = entries.find(handle);
+	EntryMap::iterator iter;
+	{
+		lock_guard guard(entriesLock_);
+		iter = entries.find(handle);
+	}
 	if (iter != entries.end())
 	{
 		size_t bytesWritten = iter->second.hFile.Write(pointer,size);
@@ -636,6 +760,7 @@ size_t DirectoryFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, i
 }
 
 size_t DirectoryFileSystem::SeekFile(u32 handle, s32 position, FileMove type) {
+	lock_guard guard(entriesLock_);
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter != entries.end()) {
 		return iter->second.hFile.Seek(position,type);
@@ -653,7 +778,7 @@ PSPFileInfo DirectoryFileSystem::GetFileInfo(std::string filename) {
 	std::string fullName = GetLocalPath(filename);
 	if (! File::Exists(fullName)) {
 #if HOST_IS_CASE_SENSITIVE
-		if (! FixPathCase(basePath,filename, FPC_FILE_MUST_EXIST))
+		if (! FixPathCase(basePath,filename, FPC_FILE_MUST_EXIST, &caseCache_))
 			return x;
 		fullName = GetLocalPath(filename);
 
@@ -750,7 +875,7 @@ std::vector<PSPFileInfo> DirectoryFileSystem::GetDirListing(std::string path) {
 	DIR *dp = opendir(localPath.c_str());
 
 #if HOST_IS_CASE_SENSITIVE
-	if (dp == NULL && FixPathCase(basePath,path, FPC_FILE_MUST_EXIST)) {
+	if (dp == NULL && FixPathCase(basePath,path, FPC_FILE_MUST_EXIST, &caseCache_)) {
 		// May have failed due to case sensitivity, try again
 		localPath = GetLocalPath(path);
 		dp = opendir(localPath.c_str());
@@ -800,7 +925,7 @@ u64 DirectoryFileSystem::FreeSpace(const std::string &path) {
 
 #if HOST_IS_CASE_SENSITIVE
 	std::string fixedCase = path;
-	if (res != 0 && FixPathCase(basePath, fixedCase, FPC_FILE_MUST_EXIST)) {
+	if (res != 0 && FixPathCase(basePath, fixedCase, FPC_FILE_MUST_EXIST, &caseCache_)) {
 		// May have failed due to case sensitivity, try again.
 		localPath = GetLocalPath(fixedCase);
 		res = statvfs(localPath.c_str(), &diskstat);
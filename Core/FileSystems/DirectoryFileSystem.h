@@ -20,7 +20,9 @@
 // TODO: Remove the Windows-specific code, FILE is fine there too.
 
 #include <map>
+#include <unordered_map>
 
+#include "native/base/mutex.h"
 #include "../Core/FileSystems/FileSystem.h"
 
 #ifdef _WIN32
@@ -47,6 +49,8 @@ typedef void * HANDLE;
 
 #endif
 
+class PathCaseCache;
+
 #if HOST_IS_CASE_SENSITIVE
 enum FixPathCaseBehavior {
 	FPC_FILE_MUST_EXIST,  // all path components must exist (rmdir, move from)
@@ -54,7 +58,30 @@ enum FixPathCaseBehavior {
 	FPC_PARTIAL_ALLOWED,  // don't care how many exist (mkdir recursive)
 };
 
-bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior);
+// Remembers the real names of entries in host directories, keyed by lowercase name,
+// so mismatched case doesn't need a readdir scan on every lookup.
+// Only sees changes made through Invalidate(), so the owner must call it on writes.
+class PathCaseCache {
+public:
+	PathCaseCache() : cacheLookups_(0), diskLookups_(0) {}
+
+	// dir must end with a slash.  Returns false if the name isn't in the directory.
+	bool FixFilenameCase(const std::string &dir, std::string &filename);
+	// Forget the directory containing hostPath, and anything below hostPath.
+	void Invalidate(const std::string &hostPath);
+	void Clear();
+
+	int CacheLookups() const { return cacheLookups_; }
+	int DiskLookups() const { return diskLookups_; }
+
+private:
+	typedef std::unordered_map<std::string, std::string> NameMap;
+	std::unordered_map<std::string, NameMap> dirs_;
+	int cacheLookups_;
+	int diskLookups_;
+};
+
+bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior, PathCaseCache *cache = nullptr);
 #endif
 
 struct DirectoryFileHandle
@@ -77,7 +104,7 @@ struct DirectoryFileHandle
 	}
 
 	std::string GetLocalPath(std::string& basePath, std::string localpath);
-	bool Open(std::string& basePath, std::string& fileName, FileAccess access, u32 &err);
+	bool Open(std::string& basePath, std::string& fileName, FileAccess access, u32 &err, PathCaseCache *caseCache = nullptr);
 	size_t Read(u8* pointer, s64 size);
 	size_t Write(const u8* pointer, s64 size);
 	size_t Seek(s32 position, FileMove type);
@@ -110,7 +137,7 @@ class DirectoryFileSystem : public IFileSystem {
 	int  RenameFile(const std::string &from, const std::string &to) override;
 	bool RemoveFile(const std::string &filename) override;
 	bool GetHostPath(const std::string &inpath, std::string &outpath) override;
-	int Flags() override { return flags; }
+	int Flags() override { return flags | FILESYSTEM_CONCURRENT_IO; }
 	u64 FreeSpace(const std::string &path) override;
 
 private:
@@ -122,11 +149,18 @@ class DirectoryFileSystem : public IFileSystem {
 
 	typedef std::map<u32, OpenFileEntry> EntryMap;
 	EntryMap entries;
+	// Async reads and writes look up entries from worker threads.
+	recursive_mutex entriesLock_;
 	std::string basePath;
 	IHandleAllocator *hAlloc;
 	int flags;
+#if HOST_IS_CASE_SENSITIVE
+	PathCaseCache caseCache_;
+#endif
 	// In case of Windows: Translate slashes, etc.
 	std::string GetLocalPath(std::string localpath);
+	// Call after anything that may add or remove host directory entries.
+	void InvalidateCaseCache(const std::string &localPath);
 };
 
 // VFSFileSystem: Ability to map in Android APK paths as well! Does not support all features, only meant for fonts.
@@ -53,6 +53,8 @@ enum DevType
 enum FileSystemFlags
 {
 	FILESYSTEM_SIMULATE_FAT32 = 1,
+	// ReadFile/WriteFile on different handles may be called from several threads at once.
+	FILESYSTEM_CONCURRENT_IO = 2,
 };
 
 class IHandleAllocator {
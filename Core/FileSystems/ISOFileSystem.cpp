@@ -203,6 +203,7 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 	treeroot->size = 0;
 	treeroot->flags = 0;
 	treeroot->parent = NULL;
+	treeroot->valid = true;
 
 	if (memcmp(desc.cd001, "CD001", 5)) {
 		ERROR_LOG(FILESYS, "ISO looks bogus? Giving up...");
@@ -221,8 +222,22 @@ ISOFileSystem::~ISOFileSystem()
 	delete treeroot;
 }
 
+static std::string LowerCase(const std::string &s) {
+	std::string lower = s;
+	for (size_t i = 0; i < lower.size(); i++) {
+		lower[i] = tolower(lower[i]);
+	}
+	return lower;
+}
+
 void ISOFileSystem::ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root, size_t level)
 {
+	root->valid = true;
+
+	std::string indexPrefix = LowerCase(EntryFullPath(root));
+	if (!indexPrefix.empty())
+		indexPrefix = indexPrefix.substr(1) + "/";
+
 	for (u32 secnum = startsector, endsector = dirsize/2048 + startsector; secnum < endsector; ++secnum)
 	{
 		u8 theSector[2048];
@@ -276,6 +291,8 @@ void ISOFileSystem::ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root,
 			// Let's not excessively spam the log - I commented this line out.
 			//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", e->isDirectory?"D":"F", e->name.c_str(), dir.firstDataSectorLE, e->startingPosition, e->startingPosition);
 
+			// Subdirectories are read later, on first access.  Everything else has no children.
+			e->valid = true;
 			if (e->isDirectory && !relative)
 			{
 				if (dir.firstDataSector() == startsector)
@@ -289,79 +306,109 @@ void ISOFileSystem::ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root,
 						doRecurse = level < restrictTree.size() && restrictTree[level] == e->name;
 
 					if (doRecurse)
-						ReadDirectory(dir.firstDataSector(), dir.dataLength(), e, level + 1);
+					{
+						e->valid = false;
+					}
 					else
+					{
+						delete e;
 						continue;
+					}
 				}
 			}
 			root->children.push_back(e);
+			// Keep the first match for duplicate names, like the old linear search.
+			pathIndex_.insert(std::make_pair(indexPrefix + LowerCase(e->name), e));
 		}
 	}
 }
 
-ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(std::string path, bool catchError)
+void ISOFileSystem::LoadDirectory(TreeEntry *e)
+{
+	if (e->valid)
+		return;
+
+	size_t level = 0;
+	for (TreeEntry *cur = e; cur->parent != NULL; cur = cur->parent)
+		++level;
+	ReadDirectory(e->startingPosition / 2048, (u32)e->size, e, level);
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bool catchError)
 {
-	if (path.length() == 0) {
+	const size_t pathLength = path.length();
+	if (pathLength == 0) {
 		// Ah, the device!	"umd0:"
 		return &entireISO;
 	}
 
-	if (path.substr(0,2) == "./")
-		path.erase(0,2);
-
-	if (path[0] == '/')
-		path.erase(0,1);
-
-	TreeEntry *e = treeroot;
-	if (path.length() == 0)
-		return e;
+	size_t pos = 0;
+	if (path.compare(0, 2, "./") == 0)
+		pos += 2;
+	if (pos < pathLength && path[pos] == '/')
+		++pos;
+	if (pos == pathLength)
+		return treeroot;
 
+	// Build the index key: lowercase, with runs of slashes collapsed.
+	// Note that a trailing double slash, or a double slash at the start, doesn't match anything.
+	std::string key;
+	key.reserve(pathLength - pos);
+	bool validPath = true;
 	while (true)
 	{
-		TreeEntry *ne = 0;
-		std::string name = "";
-		if (path.length()>0)
+		size_t end = path.find('/', pos);
+		if (end == path.npos)
+			end = pathLength;
+		if (end == pos)
 		{
-			for (size_t i=0; i<e->children.size(); i++)
-			{
-				std::string n = (e->children[i]->name);
-				for (size_t j = 0; j < n.size(); j++) {
-					n[j] = tolower(n[j]);
-				}
-				std::string curPath = path.substr(0, path.find_first_of('/'));
-				for (size_t j = 0; j < curPath.size(); j++) {
-					curPath[j] = tolower(curPath[j]);
-				}
-
-				if (curPath == n)
-				{
-					//yay we got it
-					ne = e->children[i];
-					name = n;
-					break;
-				}
-			}
+			validPath = false;
+			break;
 		}
-		if (ne)
+
+		if (!key.empty())
+			key.push_back('/');
+		for (size_t i = pos; i < end; ++i)
+			key.push_back(tolower(path[i]));
+
+		if (end == pathLength || end + 1 == pathLength)
+			break;
+		pos = end + 1;
+		while (pos < pathLength && path[pos] == '/')
+			++pos;
+		if (pos == pathLength)
 		{
-			e = ne;
-			size_t l = name.length();
-			path.erase(0, l);
-			if (path.length() == 0 || (path.length()==1 && path[0] == '/'))
-				return e;
-			path.erase(0, 1);
-			while (path[0] == '/')
-				path.erase(0, 1);
+			validPath = false;
+			break;
 		}
-		else
+	}
+
+	TreeEntry *e = NULL;
+	if (validPath)
+	{
+		auto found = pathIndex_.find(key);
+		if (found != pathIndex_.end())
+			return found->second;
+
+		// Might be inside a directory we haven't read yet, walk down to it.
+		e = treeroot;
+		size_t slash = 0;
+		while (e != NULL)
 		{
-			if (catchError)
-			{
-				ERROR_LOG(FILESYS,"File %s not found", path.c_str());
-			}
-			return 0;
+			LoadDirectory(e);
+			slash = key.find('/', slash + 1);
+			found = pathIndex_.find(slash == key.npos ? key : key.substr(0, slash));
+			e = found == pathIndex_.end() ? NULL : found->second;
+			if (slash == key.npos)
+				break;
 		}
 	}
+
+	if (!e && catchError)
+	{
+		ERROR_LOG(FILESYS,"File %s not found", path.c_str());
+	}
+	return e;
 }
 
 u32 ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename)
@@ -704,6 +751,7 @@ std::vector<PSPFileInfo> ISOFileSystem::GetDirListing(std::string path)
 	{
 		return myVector;
 	}
+	LoadDirectory(entry);
 
 	for (size_t i=0; i<entry->children.size(); i++)
 	{
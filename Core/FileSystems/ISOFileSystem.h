@@ -19,6 +19,7 @@
 
 #include <map>
 #include <list>
+#include <unordered_map>
 
 #include "FileSystem.h"
 
@@ -58,7 +59,7 @@ class ISOFileSystem : public IFileSystem
 private:
 	struct TreeEntry
 	{
-		TreeEntry(){}
+		TreeEntry() : valid(false) {}
 		~TreeEntry();
 
 		std::string name;
@@ -66,6 +67,8 @@ class ISOFileSystem : public IFileSystem
 		u32 startingPosition;
 		s64 size;
 		bool isDirectory;
+		// False until the children of a directory have been read from disc.
+		bool valid;
 
 		TreeEntry *parent;
 		std::vector<TreeEntry*> children;
@@ -93,8 +96,12 @@ class ISOFileSystem : public IFileSystem
 	// Don't use this in the emu, not savestated.
 	std::vector<std::string> restrictTree;
 
+	// Lowercase full paths (without leading slash) of every entry read so far.
+	std::unordered_map<std::string, TreeEntry *> pathIndex_;
+
 	void ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root, size_t level);
-	TreeEntry *GetFromPath(std::string path, bool catchError = true);
+	void LoadDirectory(TreeEntry *e);
+	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
 	std::string EntryFullPath(TreeEntry *e);
 };
 
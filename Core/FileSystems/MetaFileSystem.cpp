@@ -572,8 +572,15 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 {
-	lock_guard guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	IFileSystem *sys;
+	{
+		lock_guard guard(lock);
+		sys = GetHandleOwner(handle);
+		if (sys && !(sys->Flags() & FILESYSTEM_CONCURRENT_IO))
+			return sys->ReadFile(handle, pointer, size, usec);
+	}
+
+	// This one protects its own handles, so don't block other async IO during the read.
 	if (sys)
 		return sys->ReadFile(handle, pointer, size, usec);
 	else
@@ -582,8 +589,14 @@ size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec)
 {
-	lock_guard guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	IFileSystem *sys;
+	{
+		lock_guard guard(lock);
+		sys = GetHandleOwner(handle);
+		if (sys && !(sys->Flags() & FILESYSTEM_CONCURRENT_IO))
+			return sys->WriteFile(handle, pointer, size, usec);
+	}
+
 	if (sys)
 		return sys->WriteFile(handle, pointer, size, usec);
 	else
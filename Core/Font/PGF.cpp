@@ -20,6 +20,8 @@
 // Thanks to the JPCSP project! This sceFont implementation is basically a C++ take on JPCSP's font code.
 // Some parts, especially in this file, were simply copied, so I guess this really makes this file GPL3.
 
+#include <algorithm>
+
 #include "Common/ChunkFile.h"
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
@@ -29,6 +31,13 @@
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
 
+// Decoded glyphs are kept up to this size per font, enough for a whole Japanese font.
+static const size_t GLYPH_CACHE_MAX_SIZE = 4 * 1024 * 1024;
+// Marks pixels the bitmap data ran out before, which are left alone like before.
+static const u8 GLYPH_PIXEL_MISSING = 0xFF;
+
+static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
+
 // These fonts, created by ttf2pgf, don't have complete glyph info and need to be identified.
 static bool isJPCSPFont(const char *fontName) {
 	return !strcmp(fontName, "Liberation Sans") || !strcmp(fontName, "Liberation Serif") || !strcmp(fontName, "Sazanami") || !strcmp(fontName, "UnDotum") || !strcmp(fontName, "Microsoft YaHei");
@@ -73,7 +82,7 @@ static std::vector<int> getTable(const u8 *buf, int bpe, size_t length) {
 }
 
 PGF::PGF()
-	: fontData(0) {
+	: fontData(0), glyphCacheSize(0) {
 
 }
 
@@ -135,6 +144,7 @@ void PGF::DoState(PointerWrap &p) {
 	p.Do(fontDataSizeTemp);
 	fontDataSize = (size_t)fontDataSizeTemp;
 	if (p.mode == p.MODE_READ) {
+		ClearGlyphCache();
 		if (fontData) {
 			delete [] fontData;
 		}
@@ -182,6 +192,8 @@ bool PGF::ReadPtr(const u8 *ptr, size_t dataSize) {
 		return false;
 	}
 
+	ClearGlyphCache();
+
 	DEBUG_LOG(SCEFONT, "Reading %d bytes of PGF header", (int)sizeof(header));
 	memcpy(&header, ptr, sizeof(header));
 	ptr += sizeof(header);
@@ -551,6 +563,65 @@ bool PGF::GetCharGlyph(int charCode, int glyphType, Glyph &glyph) const {
 	return true;
 }
 
+void PGF::ClearGlyphCache() {
+	glyphCache.clear();
+	glyphCacheSize = 0;
+}
+
+const u8 *PGF::GetGlyphPixels(const Glyph &glyph) const {
+	auto cached = glyphCache.find(glyph.ptr);
+	if (cached != glyphCache.end()) {
+		return &cached->second[0];
+	}
+
+	const int numberPixels = glyph.w * glyph.h;
+	if (glyphCacheSize + numberPixels > GLYPH_CACHE_MAX_SIZE) {
+		// Simplest is to start over, games only tend to use a part of the font.
+		glyphCache.clear();
+		glyphCacheSize = 0;
+	}
+
+	std::vector<u8> &pixels = glyphCache[glyph.ptr];
+	pixels.resize(numberPixels, GLYPH_PIXEL_MISSING);
+	glyphCacheSize += numberPixels;
+
+	const bool hRows = (glyph.flags & FONT_PGF_BMP_OVERLAY) == FONT_PGF_BMP_H_ROWS;
+	size_t bitPtr = glyph.ptr * 8;
+	int pixelIndex = 0;
+	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
+		// This is some kind of nibble based RLE compression.
+		int nibble = consumeBits(4, fontData, bitPtr);
+
+		int count;
+		int value = 0;
+		if (nibble < 8) {
+			value = consumeBits(4, fontData, bitPtr);
+			count = nibble + 1;
+		} else {
+			count = 16 - nibble;
+		}
+
+		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
+			if (nibble >= 8) {
+				value = consumeBits(4, fontData, bitPtr);
+			}
+
+			if (hRows) {
+				pixels[pixelIndex] = (u8)value;
+			} else {
+				// Stored in columns, flip it around so drawing can go by rows.
+				int xx = pixelIndex / glyph.h;
+				int yy = pixelIndex % glyph.h;
+				pixels[yy * glyph.w + xx] = (u8)value;
+			}
+
+			pixelIndex++;
+		}
+	}
+
+	return &pixels[0];
+}
+
 void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipWidth, int clipHeight, int charCode, int altCharCode, int glyphType) const {
 	Glyph glyph;
 	if (!GetCharGlyph(charCode, glyphType, glyph)) {
@@ -570,9 +641,13 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 			return;
 	}
 
-	size_t bitPtr = glyph.ptr * 8;
-	int numberPixels = glyph.w * glyph.h;
-	int pixelIndex = 0;
+	const int pixelformat = (FontPixelFormat)(u32)image->pixelFormat;
+	if (pixelformat < PSP_FONT_PIXELFORMAT_4 || pixelformat > PSP_FONT_PIXELFORMAT_32) {
+		ERROR_LOG_REPORT(SCEFONT, "Unhandled font pixel format: %d", pixelformat);
+		return;
+	}
+
+	const u8 *pixels = GetGlyphPixels(glyph);
 
 	int x = image->xPos64 >> 6;
 	int y = image->yPos64 >> 6;
@@ -587,72 +662,79 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 	if (clipHeight < 0)
 		clipHeight = 8192;
 
-	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
-		// This is some kind of nibble based RLE compression.
-		int nibble = consumeBits(4, fontData, bitPtr);
-
-		int count;
-		int value = 0;
-		if (nibble < 8) {
-			value = consumeBits(4, fontData, bitPtr);
-			count = nibble + 1;
-		} else {
-			count = 16 - nibble;
+	// Clip against the buffer too, once, rather than for each pixel.
+	const u32 base = image->bufferPtr;
+	const int bpl = image->bytesPerLine;
+	const int pixelBytes = fontPixelSizeInBytes[pixelformat];
+	const int bufMaxWidth = pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes;
+	const int startX = std::max(std::max(x, clipX), 0);
+	const int endX = std::min(std::min(x + glyph.w, clipX + clipWidth), std::min((int)image->bufWidth, bufMaxWidth));
+	const int startY = std::max(std::max(y, clipY), 0);
+	const int endY = std::min(std::min(y + glyph.h, clipY + clipHeight), (int)image->bufHeight);
+
+	for (int pixelY = startY; pixelY < endY && startX < endX; ++pixelY) {
+		const u8 *src = pixels + (pixelY - y) * glyph.w + (startX - x);
+		const u32 rowAddr = base + pixelY * bpl;
+		const u32 firstAddr = rowAddr + (pixelBytes == 0 ? startX / 2 : startX * pixelBytes);
+		const u32 lastAddr = rowAddr + (pixelBytes == 0 ? (endX - 1) / 2 : endX * pixelBytes - 1);
+		if (!Memory::IsValidAddress(firstAddr) || !Memory::IsValidAddress(lastAddr)) {
+			for (int pixelX = startX; pixelX < endX; ++pixelX, ++src) {
+				if (*src != GLYPH_PIXEL_MISSING) {
+					SetFontPixel(base, bpl, image->bufWidth, image->bufHeight, pixelX, pixelY, *src * (pixelBytes == 0 ? 1 : 0x11111111), pixelformat);
+				}
+			}
+			continue;
 		}
 
-		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
-			if (nibble >= 8) {
-				value = consumeBits(4, fontData, bitPtr);
+		u8 *dst = Memory::GetPointer(firstAddr);
+		switch (pixelformat) {
+		case PSP_FONT_PIXELFORMAT_4:
+		case PSP_FONT_PIXELFORMAT_4_REV:
+			for (int pixelX = startX; pixelX < endX; ++pixelX, ++src) {
+				if (*src == GLYPH_PIXEL_MISSING)
+					continue;
+				u8 &dstByte = dst[pixelX / 2 - startX / 2];
+				if ((pixelX & 1) != pixelformat) {
+					dstByte = (*src << 4) | (dstByte & 0xF);
+				} else {
+					dstByte = (dstByte & 0xF0) | *src;
+				}
 			}
+			break;
 
-			int xx, yy;
-			if ((glyph.flags & FONT_PGF_BMP_OVERLAY) == FONT_PGF_BMP_H_ROWS) {
-				xx = pixelIndex % glyph.w;
-				yy = pixelIndex / glyph.w;
-			} else {
-				xx = pixelIndex / glyph.h;
-				yy = pixelIndex % glyph.h;
+		// The wider formats are just the 4-bit value repeated in every nibble.
+		case PSP_FONT_PIXELFORMAT_8:
+			for (int pixelX = startX; pixelX < endX; ++pixelX, ++src, ++dst) {
+				if (*src != GLYPH_PIXEL_MISSING)
+					*dst = *src * 0x11;
 			}
+			break;
 
-			int pixelX = x + xx;
-			int pixelY = y + yy;
-
-			if (pixelX >= clipX && pixelX < clipX + clipWidth && pixelY >= clipY && pixelY < clipY + clipHeight) {
-				// 4-bit color value
-				int pixelColor = value;
-				switch ((FontPixelFormat)(u32)image->pixelFormat) {
-				case PSP_FONT_PIXELFORMAT_8:
-					// 8-bit color value
-					pixelColor |= pixelColor << 4;
-					break;
-				case PSP_FONT_PIXELFORMAT_24:
-					// 24-bit color value
-					pixelColor |= pixelColor << 4;
-					pixelColor |= pixelColor << 8;
-					pixelColor |= pixelColor << 8;
-					break;
-				case PSP_FONT_PIXELFORMAT_32:
-					// 32-bit color value
-					pixelColor |= pixelColor << 4;
-					pixelColor |= pixelColor << 8;
-					pixelColor |= pixelColor << 16;
-					break;
-				case PSP_FONT_PIXELFORMAT_4:
-				case PSP_FONT_PIXELFORMAT_4_REV:
-					break;
-				default:
-					ERROR_LOG_REPORT(SCEFONT, "Unhandled font pixel format: %d", (u32)image->pixelFormat);
-					break;
+		case PSP_FONT_PIXELFORMAT_24:
+			for (int pixelX = startX; pixelX < endX; ++pixelX, ++src, dst += 3) {
+				if (*src != GLYPH_PIXEL_MISSING) {
+					const u8 color = *src * 0x11;
+					dst[0] = color;
+					dst[1] = color;
+					dst[2] = color;
 				}
-
-				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, pixelX, pixelY, pixelColor, image->pixelFormat);
 			}
+			break;
 
-			pixelIndex++;
+		case PSP_FONT_PIXELFORMAT_32:
+			for (int pixelX = startX; pixelX < endX; ++pixelX, ++src, dst += 4) {
+				if (*src != GLYPH_PIXEL_MISSING) {
+					const u32 color = *src * 0x11111111;
+					memcpy(dst, &color, 4);
+				}
+			}
+			break;
 		}
 	}
 
-	gpu->InvalidateCache(image->bufferPtr, image->bytesPerLine * image->bufHeight, GPU_INVALIDATE_SAFE);
+	if (gpu) {
+		gpu->InvalidateCache(image->bufferPtr, image->bytesPerLine * image->bufHeight, GPU_INVALIDATE_SAFE);
+	}
 }
 
 void PGF::SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, int y, int pixelColor, int pixelformat) const {
@@ -660,7 +742,6 @@ void PGF::SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, in
 		return;
 	}
 
-	static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
 	int pixelBytes = fontPixelSizeInBytes[pixelformat];
 	int bufMaxWidth = (pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes);
 	if (x >= bufMaxWidth) {
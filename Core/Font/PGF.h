@@ -20,6 +20,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/Log.h"
@@ -282,6 +283,8 @@ class PGF {
 	int GetCharIndex(int charCode, const std::vector<int> &charmapCompressed);
 
 	void SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, int y, int pixelColor, int pixelformat) const;
+	const u8 *GetGlyphPixels(const Glyph &glyph) const;
+	void ClearGlyphCache();
 
 	PGFHeaderRev3Extra rev3extra;
 
@@ -306,4 +309,8 @@ class PGF {
 	std::vector<Glyph> glyphs;
 	std::vector<Glyph> shadowGlyphs;
 	int firstGlyph;
+
+	// Decoded bitmaps, one 4-bit pixel per byte in rows, by glyph.ptr.  Not saved, they're rebuilt as needed.
+	mutable std::unordered_map<u32, std::vector<u8>> glyphCache;
+	mutable size_t glyphCacheSize;
 };
@@ -15,7 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <cstring>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
@@ -32,6 +34,7 @@
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/HLE/HLETables.h"
+#include "Core/HLE/HLEProfiler.h"
 #include "Core/HLE/sceDisplay.h"
 #include "Core/HLE/sceIo.h"
 #include "Core/HLE/sceAudio.h"
@@ -58,9 +61,36 @@ enum
 	HLE_AFTER_SKIP_DEADBEEF     = 0x40,
 };
 
+// Module names are static strings in the HLE tables, so the index can key on them directly.
+struct ModuleNameHash
+{
+	size_t operator ()(const char *name) const
+	{
+		size_t hash = 0;
+		while (*name)
+			hash = hash * 31 + (u8)*name++;
+		return hash;
+	}
+};
+
+struct ModuleNameEquals
+{
+	bool operator ()(const char *a, const char *b) const
+	{
+		return strcmp(a, b) == 0;
+	}
+};
+
 static std::vector<HLEModule> moduleDB;
+// Built as modules register, so resolving imports doesn't scan every module and table.
+static std::unordered_map<const char *, int, ModuleNameHash, ModuleNameEquals> moduleIndexByName;
+static std::vector<std::unordered_map<u32, int>> funcIndexByNID;
+// Checked on every syscall, so don't look it up by name each time.
+static u32 idleSyscallOp = 0;
 static int delayedResultEvent = -1;
 static int hleAfterSyscall = HLE_AFTER_NOTHING;
+// What the last syscall asked for, kept for the profiler since hleFinishSyscall() clears it.
+static int hleProfiledAfterSyscall = HLE_AFTER_NOTHING;
 static const char *hleAfterSyscallReschedReason;
 
 void hleDelayResultFinish(u64 userdata, int cycleslate)
@@ -84,6 +114,7 @@ void hleDelayResultFinish(u64 userdata, int cycleslate)
 void HLEInit()
 {
 	RegisterAllModules();
+	idleSyscallOp = GetSyscallOp("FakeSysCalls", NID_IDLE);
 	delayedResultEvent = CoreTiming::RegisterEvent("HLEDelayedResult", hleDelayResultFinish);
 }
 
@@ -101,30 +132,39 @@ void HLEShutdown()
 {
 	hleAfterSyscall = HLE_AFTER_NOTHING;
 	moduleDB.clear();
+	moduleIndexByName.clear();
+	funcIndexByNID.clear();
+	idleSyscallOp = 0;
 }
 
 void RegisterModule(const char *name, int numFunctions, const HLEFunction *funcTable)
 {
 	HLEModule module = {name, numFunctions, funcTable};
 	moduleDB.push_back(module);
+
+	// Like the old linear search, the first registration of a name or NID wins.
+	moduleIndexByName.emplace(name, (int)moduleDB.size() - 1);
+	funcIndexByNID.push_back(std::unordered_map<u32, int>());
+	std::unordered_map<u32, int> &funcIndex = funcIndexByNID.back();
+	funcIndex.reserve(numFunctions);
+	for (int i = 0; i < numFunctions; i++)
+		funcIndex.emplace(funcTable[i].ID, i);
 }
 
 int GetModuleIndex(const char *moduleName)
 {
-	for (size_t i = 0; i < moduleDB.size(); i++)
-		if (strcmp(moduleName, moduleDB[i].name) == 0)
-			return (int)i;
+	auto it = moduleIndexByName.find(moduleName);
+	if (it != moduleIndexByName.end())
+		return it->second;
 	return -1;
 }
 
 int GetFuncIndex(int moduleIndex, u32 nib)
 {
-	const HLEModule &module = moduleDB[moduleIndex];
-	for (int i = 0; i < module.numFunctions; i++)
-	{
-		if (module.funcTable[i].ID == nib)
-			return i;
-	}
+	const std::unordered_map<u32, int> &funcIndex = funcIndexByNID[moduleIndex];
+	auto it = funcIndex.find(nib);
+	if (it != funcIndex.end())
+		return it->second;
 	return -1;
 }
 
@@ -165,6 +205,20 @@ const char *GetFuncName(const char *moduleName, u32 nib)
 	return temp;
 }
 
+static u32 GetSyscallOpForModule(int modindex, const char *moduleName, u32 nib)
+{
+	int funcindex = GetFuncIndex(modindex, nib);
+	if (funcindex != -1)
+	{
+		return (0x0000000c | (modindex<<18) | (funcindex<<6));
+	}
+	else
+	{
+		INFO_LOG(HLE, "Syscall (%s, %08x) unknown", moduleName, nib);
+		return (0x0003FFCC | (modindex<<18));  // invalid syscall
+	}
+}
+
 u32 GetSyscallOp(const char *moduleName, u32 nib)
 {
 	// Special case to hook up bad imports.
@@ -176,16 +230,7 @@ u32 GetSyscallOp(const char *moduleName, u32 nib)
 	int modindex = GetModuleIndex(moduleName);
 	if (modindex != -1)
 	{
-		int funcindex = GetFuncIndex(modindex, nib);
-		if (funcindex != -1)
-		{
-			return (0x0000000c | (modindex<<18) | (funcindex<<6));
-		}
-		else
-		{
-			INFO_LOG(HLE, "Syscall (%s, %08x) unknown", moduleName, nib);
-			return (0x0003FFCC | (modindex<<18));  // invalid syscall
-		}
+		return GetSyscallOpForModule(modindex, moduleName, nib);
 	}
 	else
 	{
@@ -228,7 +273,7 @@ bool WriteSyscall(const char *moduleName, u32 nib, u32 address)
 	if (modindex != -1)
 	{
 		Memory::Write_U32(MIPS_MAKE_JR_RA(), address); // jr ra
-		Memory::Write_U32(GetSyscallOp(moduleName, nib), address + 4);
+		Memory::Write_U32(GetSyscallOpForModule(modindex, moduleName, nib), address + 4);
 		return true;
 	}
 	else
@@ -365,6 +410,8 @@ inline static void SetDeadbeefRegs()
 
 inline void hleFinishSyscall(const HLEFunction &info)
 {
+	hleProfiledAfterSyscall |= hleAfterSyscall;
+
 	if ((hleAfterSyscall & HLE_AFTER_SKIP_DEADBEEF) == 0)
 		SetDeadbeefRegs();
 
@@ -409,6 +456,12 @@ inline void updateSyscallStats(int modulenum, int funcnum, double total)
 	kernelStats.msInSyscalls += total;
 
 	KernelStatsSyscall statCall(modulenum, funcnum);
+	int calls = ++kernelStats.summedSyscallCalls[statCall];
+	if (calls > kernelStats.mostCalledSyscallCount)
+	{
+		kernelStats.mostCalledSyscallCount = calls;
+		kernelStats.mostCalledSyscallName = name;
+	}
 	auto summedStat = kernelStats.summedMsInSyscalls.find(statCall);
 	if (summedStat == kernelStats.summedMsInSyscalls.end())
 	{
@@ -484,8 +537,8 @@ const HLEFunction *GetSyscallInfo(MIPSOpcode op)
 
 void *GetQuickSyscallFunc(MIPSOpcode op)
 {
-	// TODO: Clear jit cache on g_Config.bShowDebugStats change?
-	if (g_Config.bShowDebugStats)
+	// Checked when compiling, so anything toggling these needs to clear the jit cache.
+	if (g_Config.bShowDebugStats || HLEProfiler::IsEnabled())
 		return NULL;
 
 	const HLEFunction *info = GetSyscallInfo(op);
@@ -493,13 +546,39 @@ void *GetQuickSyscallFunc(MIPSOpcode op)
 		return NULL;
 
 	// TODO: Do this with a flag?
-	if (op == GetSyscallOp("FakeSysCalls", NID_IDLE))
+	if (op == idleSyscallOp)
 		return (void *)info->func;
-	if (info->flags != 0)
+	if ((info->flags & ~HLE_JIT_MASK) != 0)
 		return (void *)&CallSyscallWithFlags;
 	return (void *)&CallSyscallWithoutFlags;
 }
 
+void *GetDirectSyscallFunc(MIPSOpcode op)
+{
+	// Debug stats and the profiler need to time every call, so those go through CallSyscall.
+	// Like above, this is checked when compiling and toggling them clears the jit cache.
+	if (g_Config.bShowDebugStats || HLEProfiler::IsEnabled())
+		return NULL;
+
+	const HLEFunction *info = GetSyscallInfo(op);
+	if (!info || !info->func)
+		return NULL;
+	// Anything with dispatch or interrupt checks needs the full path.
+	if (info->flags != HLE_DIRECT_CALL)
+		return NULL;
+	return (void *)info->func;
+}
+
+const int *GetDirectSyscallAfterFlags()
+{
+	return &hleAfterSyscall;
+}
+
+void FinishDirectSyscall(const HLEFunction *info)
+{
+	hleFinishSyscall(*info);
+}
+
 static double hleSteppingTime = 0.0;
 void hleSetSteppingTime(double t)
 {
@@ -520,11 +599,21 @@ void CallSyscall(MIPSOpcode op)
 		return;
 	}
 
+	const bool profiling = HLEProfiler::IsEnabled();
+	double profileStart = 0.0;
+	SceUID profileThread = 0;
+	if (profiling)
+	{
+		hleProfiledAfterSyscall = HLE_AFTER_NOTHING;
+		profileThread = __KernelGetCurThread();
+		profileStart = real_time_now();
+	}
+
 	if (info->func)
 	{
-		if (op == GetSyscallOp("FakeSysCalls", NID_IDLE))
+		if (op == idleSyscallOp)
 			info->func();
-		else if (info->flags != 0)
+		else if ((info->flags & ~HLE_JIT_MASK) != 0)
 			CallSyscallWithFlags(info);
 		else
 			CallSyscallWithoutFlags(info);
@@ -534,14 +623,22 @@ void CallSyscall(MIPSOpcode op)
 		ERROR_LOG_REPORT(HLE, "Unimplemented HLE function %s", info->name ? info->name : "(\?\?\?)");
 	}
 
+	u32 callno = (op >> 6) & 0xFFFFF; //20 bits
+	int funcnum = callno & 0xFFF;
+	int modulenum = (callno & 0xFF000) >> 12;
+	// Like the debug stats, leave out idle, it would swamp everything else.
+	if (profiling && op != idleSyscallOp)
+	{
+		const bool rescheduled = (hleProfiledAfterSyscall & (HLE_AFTER_RESCHED | HLE_AFTER_RESCHED_CALLBACKS)) != 0;
+		double total = real_time_now() - profileStart - hleSteppingTime;
+		HLEProfiler::Record(moduleDB[modulenum].name, info, total, rescheduled, __KernelGetCurThread() != profileThread);
+	}
+
 	if (g_Config.bShowDebugStats)
 	{
 		time_update();
-		u32 callno = (op >> 6) & 0xFFFFF; //20 bits
-		int funcnum = callno & 0xFFF;
-		int modulenum = (callno & 0xFF000) >> 12;
 		double total = time_now_d() - start - hleSteppingTime;
-		hleSteppingTime = 0.0;
 		updateSyscallStats(modulenum, funcnum, total);
 	}
+	hleSteppingTime = 0.0;
 }
@@ -25,7 +25,9 @@ typedef void (* HLEFunc)();
 
 enum {
 	// The low 8 bits are a value, indicating special jit handling.
-	// Currently there are none.
+	// Rarely reschedules or runs callbacks, so the jit can call it directly and check afterward.
+	HLE_DIRECT_CALL = 0x01,
+	HLE_JIT_MASK = 0xFF,
 
 	// The remaining 24 bits are flags.
 	// Don't allow the call within an interrupt.  Not yet implemented.
@@ -122,4 +124,10 @@ void WriteFuncMissingStub(u32 stubAddr, u32 nid);
 const HLEFunction *GetSyscallInfo(MIPSOpcode op);
 // For jit, takes arg: const HLEFunction *
 void *GetQuickSyscallFunc(MIPSOpcode op);
+// For jit, the HLE function itself when it's flagged HLE_DIRECT_CALL, otherwise NULL.
+void *GetDirectSyscallFunc(MIPSOpcode op);
+// For jit, nonzero after a direct call if FinishDirectSyscall() must be called.
+const int *GetDirectSyscallAfterFlags();
+// For jit, takes arg: const HLEFunction *
+void FinishDirectSyscall(const HLEFunction *info);
 
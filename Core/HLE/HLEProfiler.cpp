@@ -0,0 +1,202 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Core/HLE/HLE.h"
+#include "Core/HLE/HLEProfiler.h"
+
+namespace HLEProfiler {
+
+// Four buckets per power of two of nanoseconds, so within about 20%, up to about 18 minutes.
+static const int HISTOGRAM_BUCKETS = 40 * 4;
+
+struct FunctionProfile {
+	const char *module;
+	const char *name;
+	u64 calls;
+	u64 reschedules;
+	u64 threadSwitches;
+	double totalTime;
+	double maxTime;
+	u64 histogram[HISTOGRAM_BUCKETS];
+};
+
+static volatile bool enabled = false;
+static std::mutex profilesLock;
+static std::unordered_map<const HLEFunction *, FunctionProfile> profiles;
+
+static int BucketForTime(double seconds) {
+	u64 ns = (u64)(seconds * 1000000000.0);
+	if (ns < 4)
+		return (int)ns;
+
+	int exp = 63;
+	while ((ns & (1ULL << exp)) == 0)
+		--exp;
+	int index = (exp - 1) * 4 + (int)((ns >> (exp - 2)) & 3);
+	return std::min(index, HISTOGRAM_BUCKETS - 1);
+}
+
+// The middle of the bucket, in seconds.
+static double BucketTime(int index) {
+	if (index < 4)
+		return index * 0.000000001;
+
+	int exp = index / 4 + 1;
+	int mantissa = 4 + index % 4;
+	double lower = (double)((u64)mantissa << (exp - 2));
+	double upper = (double)((u64)(mantissa + 1) << (exp - 2));
+	return (lower + upper) * 0.5 * 0.000000001;
+}
+
+static double Percentile(const FunctionProfile &profile, double fraction) {
+	u64 target = (u64)(fraction * profile.calls + 0.5);
+	if (target == 0)
+		target = 1;
+
+	u64 seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		seen += profile.histogram[i];
+		if (seen >= target)
+			return std::min(BucketTime(i), profile.maxTime);
+	}
+	return profile.maxTime;
+}
+
+void SetEnabled(bool enable) {
+	enabled = enable;
+}
+
+bool IsEnabled() {
+	return enabled;
+}
+
+void Reset() {
+	std::lock_guard<std::mutex> guard(profilesLock);
+	profiles.clear();
+}
+
+void Record(const char *module, const HLEFunction *func, double seconds, bool rescheduled, bool threadSwitched) {
+	if (seconds < 0.0)
+		seconds = 0.0;
+
+	std::lock_guard<std::mutex> guard(profilesLock);
+	auto it = profiles.find(func);
+	if (it == profiles.end()) {
+		FunctionProfile blank = {};
+		blank.module = module;
+		blank.name = func->name;
+		it = profiles.insert(std::make_pair(func, blank)).first;
+	}
+
+	FunctionProfile &profile = it->second;
+	profile.calls++;
+	if (rescheduled)
+		profile.reschedules++;
+	if (threadSwitched)
+		profile.threadSwitches++;
+	profile.totalTime += seconds;
+	profile.maxTime = std::max(profile.maxTime, seconds);
+	profile.histogram[BucketForTime(seconds)]++;
+}
+
+std::vector<FunctionStats> GetStats() {
+	std::vector<FunctionStats> stats;
+	{
+		std::lock_guard<std::mutex> guard(profilesLock);
+		stats.reserve(profiles.size());
+		for (auto it = profiles.begin(), end = profiles.end(); it != end; ++it) {
+			const FunctionProfile &profile = it->second;
+			FunctionStats s;
+			s.module = profile.module;
+			s.name = profile.name;
+			s.calls = profile.calls;
+			s.reschedules = profile.reschedules;
+			s.threadSwitches = profile.threadSwitches;
+			s.totalTime = profile.totalTime;
+			s.maxTime = profile.maxTime;
+			s.p50 = Percentile(profile, 0.50);
+			s.p99 = Percentile(profile, 0.99);
+			stats.push_back(s);
+		}
+	}
+
+	std::sort(stats.begin(), stats.end(), [](const FunctionStats &a, const FunctionStats &b) {
+		return a.totalTime > b.totalTime;
+	});
+	return stats;
+}
+
+static void AppendJSONString(std::string &out, const char *str) {
+	out += '"';
+	for (const char *p = str ? str : ""; *p; ++p) {
+		if (*p == '"' || *p == '\\') {
+			out += '\\';
+			out += *p;
+		} else if ((u8)*p < 0x20) {
+			char temp[8];
+			snprintf(temp, sizeof(temp), "\\u%04x", (u8)*p);
+			out += temp;
+		} else {
+			out += *p;
+		}
+	}
+	out += '"';
+}
+
+std::string GetStatsJSON() {
+	std::vector<FunctionStats> stats = GetStats();
+
+	std::string out = "{\n\t\"functions\": [";
+	char temp[512];
+	for (size_t i = 0; i < stats.size(); ++i) {
+		const FunctionStats &s = stats[i];
+		out += i == 0 ? "\n\t\t{\"module\": " : ",\n\t\t{\"module\": ";
+		AppendJSONString(out, s.module);
+		out += ", \"name\": ";
+		AppendJSONString(out, s.name);
+		snprintf(temp, sizeof(temp),
+			", \"calls\": %llu, \"reschedules\": %llu, \"threadSwitches\": %llu, \"totalMs\": %0.3f, \"meanUs\": %0.3f, \"p50Us\": %0.3f, \"p99Us\": %0.3f, \"maxUs\": %0.3f}",
+			(unsigned long long)s.calls, (unsigned long long)s.reschedules, (unsigned long long)s.threadSwitches,
+			s.totalTime * 1000.0, s.calls ? s.totalTime * 1000000.0 / s.calls : 0.0,
+			s.p50 * 1000000.0, s.p99 * 1000000.0, s.maxTime * 1000000.0);
+		out += temp;
+	}
+	out += "\n\t]\n}\n";
+	return out;
+}
+
+bool WriteStatsJSON(const std::string &filename) {
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		ERROR_LOG(HLE, "Unable to write HLE profile to %s", filename.c_str());
+		return false;
+	}
+
+	std::string json = GetStatsJSON();
+	bool success = fwrite(json.data(), 1, json.size(), f) == json.size();
+	fclose(f);
+	return success;
+}
+
+}  // namespace HLEProfiler
@@ -0,0 +1,57 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+struct HLEFunction;
+
+// Per function statistics for HLE calls, to find which ones are worth speeding up.
+// While enabled, every syscall goes through CallSyscall (the jit skips its shortcuts.)
+namespace HLEProfiler {
+
+struct FunctionStats {
+	const char *module;
+	const char *name;
+	u64 calls;
+	// Asked for a reschedule (hleReSchedule() and friends.)
+	u64 reschedules;
+	// Actually returned on a different thread.
+	u64 threadSwitches;
+	// Host time, in seconds.  The percentiles are estimated from a histogram.
+	double totalTime;
+	double maxTime;
+	double p50;
+	double p99;
+};
+
+void SetEnabled(bool enabled);
+bool IsEnabled();
+void Reset();
+
+void Record(const char *module, const HLEFunction *func, double seconds, bool rescheduled, bool threadSwitched);
+
+// Sorted by total time, most expensive first.
+std::vector<FunctionStats> GetStats();
+std::string GetStatsJSON();
+bool WriteStatsJSON(const std::string &filename);
+
+}  // namespace HLEProfiler
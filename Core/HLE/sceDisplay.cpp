@@ -41,6 +41,7 @@
 #include "Core/CoreParameter.h"
 #include "Core/Reporting.h"
 #include "Core/Config.h"
+#include "Core/Loaders.h"
 #include "Core/System.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -414,12 +415,25 @@ void __DisplayGetDebugStats(char stats[], size_t bufsize) {
 
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
 
+	// Just the texture formats in use: memory they take, and time spent decoding them this frame.
+	static const char *const textureFormatNames[] = { "5650", "5551", "4444", "8888", "CLUT4", "CLUT8", "CLUT16", "CLUT32", "DXT1", "DXT3", "DXT5" };
+	char textureFormats[512] = "";
+	size_t textureFormatsLength = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(textureFormatNames) && textureFormatsLength < sizeof(textureFormats); ++i) {
+		if (gpuStats.textureBytesByFormat[i] == 0 && gpuStats.msTextureDecodeByFormat[i] == 0.0) {
+			continue;
+		}
+		textureFormatsLength += snprintf(textureFormats + textureFormatsLength, sizeof(textureFormats) - textureFormatsLength, " %s %i KB %0.2f ms",
+			textureFormatNames[i], (int)(gpuStats.textureBytesByFormat[i] / 1024), gpuStats.msTextureDecodeByFormat[i]);
+	}
+
 	snprintf(stats, bufsize - 1,
 		"Frames: %i\n"
 		"DL processing time: %0.2f ms\n"
 		"Kernel processing time: %0.2f ms\n"
 		"Slowest syscall: %s : %0.2f ms\n"
 		"Most active syscall: %s : %0.2f ms\n"
+		"Most called syscall: %s : %i calls\n"
 		"Draw calls: %i, flushes %i\n"
 		"Cached Draw calls: %i\n"
 		"Alpha Tested draws: %i\n"
@@ -433,9 +447,14 @@ void __DisplayGetDebugStats(char stats[], size_t bufsize) {
 		"FBOs active: %i\n"
 		"Textures active: %i, decoded: %i\n"
 		"Texture invalidations: %i\n"
+		"Texture lookups: %i (%i probes), invalidation checks: %i\n"
+		"Background texture decodes: %i queued, %i done, latency %0.2f ms avg, %0.2f ms max\n"
+		"Texture memory: %i KB, secondary %i KB, evictions: %i, decoded again: %i\n"
+		"Texture formats:%s\n"
 		"Vertex shaders loaded: %i\n"
 		"Fragment shaders loaded: %i\n"
-		"Combined shaders loaded: %i\n",
+		"Combined shaders loaded: %i\n"
+		"Disc cache hit rate: %0.1f%%, prefetched: %i KB\n",
 		gpuStats.numVBlanks,
 		gpuStats.msProcessingDisplayLists * 1000.0f,
 		kernelStats.msInSyscalls * 1000.0f,
@@ -443,6 +462,8 @@ void __DisplayGetDebugStats(char stats[], size_t bufsize) {
 		kernelStats.slowestSyscallTime * 1000.0f,
 		kernelStats.summedSlowestSyscallName ? kernelStats.summedSlowestSyscallName : "(none)",
 		kernelStats.summedSlowestSyscallTime * 1000.0f,
+		kernelStats.mostCalledSyscallName ? kernelStats.mostCalledSyscallName : "(none)",
+		kernelStats.mostCalledSyscallCount,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numCachedDrawCalls,
@@ -459,9 +480,23 @@ void __DisplayGetDebugStats(char stats[], size_t bufsize) {
 		gpuStats.numTextures,
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTextureLookups,
+		gpuStats.numTextureLookupProbes,
+		gpuStats.numTextureInvalidationChecks,
+		gpuStats.numTextureDecodesQueued,
+		gpuStats.numTextureDecodesFinished,
+		gpuStats.numTextureDecodesFinished ? gpuStats.msTextureDecodeLatency / gpuStats.numTextureDecodesFinished : 0.0,
+		gpuStats.msMaxTextureDecodeLatency,
+		(int)(gpuStats.textureCacheBytes / 1024),
+		(int)(gpuStats.secondTextureCacheBytes / 1024),
+		gpuStats.numTextureEvictions,
+		gpuStats.numTexturesRedecodedAfterEviction,
+		textureFormats,
 		gpuStats.numVertexShaders,
 		gpuStats.numFragmentShaders,
-		gpuStats.numShaders
+		gpuStats.numShaders,
+		fileLoaderCacheStats.HitRate() * 100.0f,
+		(int)(fileLoaderCacheStats.bytesPrefetched / 1024)
 		);
 	stats[bufsize - 1] = '\0';
 	gpuStats.ResetFrame();
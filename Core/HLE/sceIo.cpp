@@ -516,6 +516,7 @@ void __IoInit() {
 		ResumeThread(ioManagerThread->native_handle());
 #endif
 		ioManagerThread->detach();
+		ioManager.StartWorkers(g_Config.iIOWorkerThreads);
 	}
 
 	__KernelRegisterWaitTypeFuncs(WAITTYPE_ASYNCIO, __IoAsyncBeginCallback, __IoAsyncEndCallback);
@@ -539,6 +540,7 @@ void __IoDoState(PointerWrap &p) {
 void __IoShutdown() {
 	ioManagerThreadEnabled = false;
 	ioManager.SyncThread();
+	ioManager.StopWorkers();
 	ioManager.FinishEventLoop();
 	if (ioManagerThread != NULL) {
 		delete ioManagerThread;
@@ -737,6 +739,7 @@ static u32 npdrmRead(FileNode *f, u8 *data, int size) {
 			blockPos = block*pgd->block_size;
 			pspFileSystem.SeekFile(f->handle, (s32)pgd->data_offset+blockPos, FILEMOVE_BEGIN);
 			pspFileSystem.ReadFile(f->handle, pgd->block_buf, pgd->block_size);
+			lock_guard guard(amctrlLock);
 			pgd_decrypt_block(pgd, block);
 			pgd->current_block = block;
 		}
@@ -2097,7 +2100,10 @@ static int __IoIoctl(u32 id, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr,
 		DEBUG_LOG(SCEIO, "Decrypting PGD DRM files");
 		pspFileSystem.SeekFile(f->handle, (s32)f->pgd_offset, FILEMOVE_BEGIN);
 		pspFileSystem.ReadFile(f->handle, pgd_header, 0x90);
-		f->pgdInfo = pgd_open(pgd_header, 2, key_ptr);
+		{
+			lock_guard guard(amctrlLock);
+			f->pgdInfo = pgd_open(pgd_header, 2, key_ptr);
+		}
 		if(f->pgdInfo==NULL){
 			ERROR_LOG(SCEIO, "Not a valid PGD file. Open as normal file.");
 			f->npdrm = false;
@@ -561,6 +561,9 @@ struct KernelStats {
 		summedMsInSyscalls.clear();
 		summedSlowestSyscallTime = 0;
 		summedSlowestSyscallName = 0;
+		summedSyscallCalls.clear();
+		mostCalledSyscallCount = 0;
+		mostCalledSyscallName = 0;
 	}
 
 	double msInSyscalls;
@@ -569,6 +572,9 @@ struct KernelStats {
 	std::map<KernelStatsSyscall, double> summedMsInSyscalls;
 	double summedSlowestSyscallTime;
 	const char *summedSlowestSyscallName;
+	std::map<KernelStatsSyscall, int> summedSyscallCalls;
+	int mostCalledSyscallCount;
+	const char *mostCalledSyscallName;
 };
 
 extern KernelStats kernelStats;
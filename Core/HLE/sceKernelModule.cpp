@@ -18,8 +18,13 @@
 #include <fstream>
 #include <algorithm>
 #include <set>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
 
 #include "native/base/stringutil.h"
+#include "native/base/timeutil.h"
+#include "native/file/file_util.h"
 #include "Common/ChunkFile.h"
 #include "Common/FileUtil.h"
 #include "Core/Config.h"
@@ -55,6 +60,7 @@
 #include "Core/ELF/ParamSFO.h"
 
 #include "GPU/GPUState.h"
+#include "ext/xxhash.h"
 
 #ifdef BLACKBERRY
 using std::strnlen;
@@ -146,6 +152,53 @@ void ImportFuncSymbol(const FuncSymbolImport &func);
 void ExportFuncSymbol(const FuncSymbolExport &func);
 void UnexportFuncSymbol(const FuncSymbolExport &func);
 
+// Imports or exports of all loaded modules by nid, so linking doesn't walk every symbol of every module.
+// Entries keep the order they were added in, var relocations depend on that (HI16 before LO16.)
+template <typename T>
+class SymbolIndex {
+public:
+	typedef std::vector<std::pair<SceUID, T>> Entries;
+
+	void Add(SceUID module, const T &sym) {
+		symbols_[sym.nid].push_back(std::make_pair(module, sym));
+	}
+	void Remove(SceUID module, const T &sym) {
+		auto found = symbols_.find(sym.nid);
+		if (found == symbols_.end()) {
+			return;
+		}
+		Entries &entries = found->second;
+		for (size_t i = 0; i < entries.size(); ) {
+			if (entries[i].first == module) {
+				entries.erase(entries.begin() + i);
+			} else {
+				++i;
+			}
+		}
+		if (entries.empty()) {
+			symbols_.erase(found);
+		}
+	}
+	const Entries *Find(u32 nid) const {
+		auto found = symbols_.find(nid);
+		return found == symbols_.end() ? 0 : &found->second;
+	}
+	void Clear() {
+		symbols_.clear();
+	}
+
+private:
+	std::unordered_map<u32, Entries> symbols_;
+};
+
+// Not saved in states, rebuilt from the loaded modules when marked dirty.
+static SymbolIndex<FuncSymbolExport> exportedFuncIndex;
+static SymbolIndex<FuncSymbolImport> importedFuncIndex;
+static SymbolIndex<VarSymbolExport> exportedVarIndex;
+static SymbolIndex<VarSymbolImport> importedVarIndex;
+static bool symbolIndexDirty = true;
+static void EnsureSymbolIndex();
+
 struct NativeModule {
 	u32_le next;
 	u16_le attribute;
@@ -280,7 +333,9 @@ class Module : public KernelObject {
 		p.Do(exportedVars, vsx);
 		VarSymbolImport vsi = {{0}};
 		p.Do(importedVars, vsi);
-		RebuildImpExpModuleNames();
+		if (p.mode == p.MODE_READ) {
+			symbolIndexDirty = true;
+		}
 
 		if (p.mode == p.MODE_READ) {
 			char moduleName[29] = {0};
@@ -308,15 +363,17 @@ class Module : public KernelObject {
 		symbolMap.AddFunction(temp,func.stubAddr,8);
 
 		// Keep track and actually hook it up if possible.
+		EnsureSymbolIndex();
 		importedFuncs.push_back(func);
-		impExpModuleNames.insert(func.moduleName);
+		importedFuncIndex.Add(GetUID(), func);
 		ImportFuncSymbol(func);
 	}
 
 	void ImportVar(const VarSymbolImport &var) {
 		// Keep track and actually hook it up if possible.
+		EnsureSymbolIndex();
 		importedVars.push_back(var);
-		impExpModuleNames.insert(var.moduleName);
+		importedVarIndex.Add(GetUID(), var);
 		ImportVarSymbol(var);
 	}
 
@@ -324,8 +381,9 @@ class Module : public KernelObject {
 		if (isFake) {
 			return;
 		}
+		EnsureSymbolIndex();
 		exportedFuncs.push_back(func);
-		impExpModuleNames.insert(func.moduleName);
+		exportedFuncIndex.Add(GetUID(), func);
 		ExportFuncSymbol(func);
 	}
 
@@ -333,28 +391,28 @@ class Module : public KernelObject {
 		if (isFake) {
 			return;
 		}
+		EnsureSymbolIndex();
 		exportedVars.push_back(var);
-		impExpModuleNames.insert(var.moduleName);
+		exportedVarIndex.Add(GetUID(), var);
 		ExportVarSymbol(var);
 	}
 
 	template <typename T>
-	void RebuildImpExpList(const std::vector<T> &list) {
+	void IndexSymbols(SymbolIndex<T> &index, const std::vector<T> &list, bool add) {
 		for (size_t i = 0; i < list.size(); ++i) {
-			impExpModuleNames.insert(list[i].moduleName);
+			if (add) {
+				index.Add(GetUID(), list[i]);
+			} else {
+				index.Remove(GetUID(), list[i]);
+			}
 		}
 	}
 
-	void RebuildImpExpModuleNames() {
-		impExpModuleNames.clear();
-		RebuildImpExpList(exportedFuncs);
-		RebuildImpExpList(importedFuncs);
-		RebuildImpExpList(exportedVars);
-		RebuildImpExpList(importedVars);
-	}
-
-	bool ImportsOrExportsModuleName(const std::string &moduleName) {
-		return impExpModuleNames.find(moduleName) != impExpModuleNames.end();
+	void IndexAllSymbols(bool add) {
+		IndexSymbols(exportedFuncIndex, exportedFuncs, add);
+		IndexSymbols(importedFuncIndex, importedFuncs, add);
+		IndexSymbols(exportedVarIndex, exportedVars, add);
+		IndexSymbols(importedVarIndex, importedVars, add);
 	}
 
 	NativeModule nm;
@@ -364,7 +422,6 @@ class Module : public KernelObject {
 	std::vector<FuncSymbolImport> importedFuncs;
 	std::vector<VarSymbolExport> exportedVars;
 	std::vector<VarSymbolImport> importedVars;
-	std::set<std::string> impExpModuleNames;
 
 	// Keep track of the code region so we can throw out analysis results
 	// when unloaded.
@@ -459,6 +516,9 @@ void __KernelModuleDoState(PointerWrap &p)
 	if (s >= 2) {
 		p.Do(loadedModules);
 	}
+	if (p.mode == p.MODE_READ) {
+		symbolIndexDirty = true;
+	}
 
 	if (g_Config.bFuncReplacements) {
 		MIPSAnalyst::ReplaceFunctions();
@@ -468,6 +528,7 @@ void __KernelModuleDoState(PointerWrap &p)
 void __KernelModuleShutdown()
 {
 	loadedModules.clear();
+	symbolIndexDirty = true;
 	MIPSAnalyst::Reset();
 }
 
@@ -585,6 +646,49 @@ static void WriteVarSymbol(u32 exportAddress, u32 relocAddress, u8 type, bool re
 	currentMIPS->InvalidateICache(relocAddress, 4);
 }
 
+static void EnsureSymbolIndex() {
+	if (!symbolIndexDirty) {
+		return;
+	}
+
+	exportedFuncIndex.Clear();
+	importedFuncIndex.Clear();
+	exportedVarIndex.Clear();
+	importedVarIndex.Clear();
+
+	u32 error;
+	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
+		Module *module = kernelObjects.Get<Module>(*mod, error);
+		if (module) {
+			module->IndexAllSymbols(true);
+		}
+	}
+	symbolIndexDirty = false;
+}
+
+// Like the modules were searched in order, the lowest loaded module id exporting it wins.
+template <typename E, typename I>
+static const E *FindSymbolExport(const SymbolIndex<E> &index, const I &imported) {
+	EnsureSymbolIndex();
+	const typename SymbolIndex<E>::Entries *exports = index.Find(imported.nid);
+	if (!exports) {
+		return 0;
+	}
+
+	const E *best = 0;
+	SceUID bestModule = 0;
+	for (auto it = exports->begin(), end = exports->end(); it != end; ++it) {
+		if (!it->second.Matches(imported) || (best && it->first >= bestModule)) {
+			continue;
+		}
+		if (loadedModules.find(it->first) != loadedModules.end()) {
+			best = &it->second;
+			bestModule = it->first;
+		}
+	}
+	return best;
+}
+
 void ImportVarSymbol(const VarSymbolImport &var) {
 	if (var.nid == 0) {
 		// TODO: What's the right thing for this?
@@ -597,20 +701,11 @@ void ImportVarSymbol(const VarSymbolImport &var) {
 		return;
 	}
 
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
-
-		// Look for exports currently loaded modules already have.  Maybe it's available?
-		for (auto it = module->exportedVars.begin(), end = module->exportedVars.end(); it != end; ++it) {
-			if (it->Matches(var)) {
-				WriteVarSymbol(it->symAddr, var.stubAddr, var.type);
-				return;
-			}
-		}
+	// Look for exports currently loaded modules already have.  Maybe it's available?
+	const VarSymbolExport *exported = FindSymbolExport(exportedVarIndex, var);
+	if (exported) {
+		WriteVarSymbol(exported->symAddr, var.stubAddr, var.type);
+		return;
 	}
 
 	// It hasn't been exported yet, but hopefully it will later.
@@ -618,37 +713,33 @@ void ImportVarSymbol(const VarSymbolImport &var) {
 }
 
 void ExportVarSymbol(const VarSymbolExport &var) {
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
+	EnsureSymbolIndex();
+	const SymbolIndex<VarSymbolImport>::Entries *imports = importedVarIndex.Find(var.nid);
+	if (!imports) {
+		return;
+	}
 
-		// Look for imports currently loaded modules already have, hook it up right away.
-		for (auto it = module->importedVars.begin(), end = module->importedVars.end(); it != end; ++it) {
-			if (var.Matches(*it)) {
-				INFO_LOG(LOADER, "Resolving var %s/%08x", var.moduleName, var.nid);
-				WriteVarSymbol(var.symAddr, it->stubAddr, it->type);
-			}
+	// Look for imports currently loaded modules already have, hook it up right away.
+	for (auto it = imports->begin(), end = imports->end(); it != end; ++it) {
+		if (var.Matches(it->second) && loadedModules.find(it->first) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Resolving var %s/%08x", var.moduleName, var.nid);
+			WriteVarSymbol(var.symAddr, it->second.stubAddr, it->second.type);
 		}
 	}
 }
 
 void UnexportVarSymbol(const VarSymbolExport &var) {
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
+	EnsureSymbolIndex();
+	const SymbolIndex<VarSymbolImport>::Entries *imports = importedVarIndex.Find(var.nid);
+	if (!imports) {
+		return;
+	}
 
-		// Look for imports modules that are *still* loaded have, and reverse them.
-		for (auto it = module->importedVars.begin(), end = module->importedVars.end(); it != end; ++it) {
-			if (var.Matches(*it)) {
-				INFO_LOG(LOADER, "Unresolving var %s/%08x", var.moduleName, var.nid);
-				WriteVarSymbol(var.symAddr, it->stubAddr, it->type, true);
-			}
+	// Look for imports modules that are *still* loaded have, and reverse them.
+	for (auto it = imports->begin(), end = imports->end(); it != end; ++it) {
+		if (var.Matches(it->second) && loadedModules.find(it->first) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Unresolving var %s/%08x", var.moduleName, var.nid);
+			WriteVarSymbol(var.symAddr, it->second.stubAddr, it->second.type, true);
 		}
 	}
 }
@@ -662,21 +753,12 @@ void ImportFuncSymbol(const FuncSymbolImport &func) {
 		return;
 	}
 
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
-
-		// Look for exports currently loaded modules already have.  Maybe it's available?
-		for (auto it = module->exportedFuncs.begin(), end = module->exportedFuncs.end(); it != end; ++it) {
-			if (it->Matches(func)) {
-				WriteFuncStub(func.stubAddr, it->symAddr);
-				currentMIPS->InvalidateICache(func.stubAddr, 8);
-				return;
-			}
-		}
+	// Look for exports currently loaded modules already have.  Maybe it's available?
+	const FuncSymbolExport *exported = FindSymbolExport(exportedFuncIndex, func);
+	if (exported) {
+		WriteFuncStub(func.stubAddr, exported->symAddr);
+		currentMIPS->InvalidateICache(func.stubAddr, 8);
+		return;
 	}
 
 	// It hasn't been exported yet, but hopefully it will later.
@@ -696,20 +778,18 @@ void ExportFuncSymbol(const FuncSymbolExport &func) {
 		return;
 	}
 
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
+	EnsureSymbolIndex();
+	const SymbolIndex<FuncSymbolImport>::Entries *imports = importedFuncIndex.Find(func.nid);
+	if (!imports) {
+		return;
+	}
 
-		// Look for imports currently loaded modules already have, hook it up right away.
-		for (auto it = module->importedFuncs.begin(), end = module->importedFuncs.end(); it != end; ++it) {
-			if (func.Matches(*it)) {
-				INFO_LOG(LOADER, "Resolving function %s/%08x", func.moduleName, func.nid);
-				WriteFuncStub(it->stubAddr, func.symAddr);
-				currentMIPS->InvalidateICache(it->stubAddr, 8);
-			}
+	// Look for imports currently loaded modules already have, hook it up right away.
+	for (auto it = imports->begin(), end = imports->end(); it != end; ++it) {
+		if (func.Matches(it->second) && loadedModules.find(it->first) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Resolving function %s/%08x", func.moduleName, func.nid);
+			WriteFuncStub(it->second.stubAddr, func.symAddr);
+			currentMIPS->InvalidateICache(it->second.stubAddr, 8);
 		}
 	}
 }
@@ -720,20 +800,18 @@ void UnexportFuncSymbol(const FuncSymbolExport &func) {
 		return;
 	}
 
-	u32 error;
-	for (auto mod = loadedModules.begin(), modend = loadedModules.end(); mod != modend; ++mod) {
-		Module *module = kernelObjects.Get<Module>(*mod, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
+	EnsureSymbolIndex();
+	const SymbolIndex<FuncSymbolImport>::Entries *imports = importedFuncIndex.Find(func.nid);
+	if (!imports) {
+		return;
+	}
 
-		// Look for imports modules that are *still* loaded have, and write back stubs.
-		for (auto it = module->importedFuncs.begin(), end = module->importedFuncs.end(); it != end; ++it) {
-			if (func.Matches(*it)) {
-				INFO_LOG(LOADER, "Unresolving function %s/%08x", func.moduleName, func.nid);
-				WriteFuncMissingStub(it->stubAddr, it->nid);
-				currentMIPS->InvalidateICache(it->stubAddr, 8);
-			}
+	// Look for imports modules that are *still* loaded have, and write back stubs.
+	for (auto it = imports->begin(), end = imports->end(); it != end; ++it) {
+		if (func.Matches(it->second) && loadedModules.find(it->first) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Unresolving function %s/%08x", func.moduleName, func.nid);
+			WriteFuncMissingStub(it->second.stubAddr, it->second.nid);
+			currentMIPS->InvalidateICache(it->second.stubAddr, 8);
 		}
 	}
 }
@@ -742,6 +820,8 @@ void Module::Cleanup() {
 	MIPSAnalyst::ForgetFunctions(textStart, textEnd);
 
 	loadedModules.erase(GetUID());
+	EnsureSymbolIndex();
+	IndexAllSymbols(false);
 
 	for (auto it = exportedVars.begin(), end = exportedVars.end(); it != end; ++it) {
 		UnexportVarSymbol(*it);
@@ -801,6 +881,135 @@ static void __SaveDecryptedEbootToStorageMedia(const u8 *decryptedEbootDataPtr,
 	INFO_LOG(SCEMODULE, "Successfully wrote decrypted EBOOT to %s", fullPath.c_str());
 }
 
+enum {
+	MODULE_CACHE_MAGIC = 0x43525058, // "XPRC"
+	MODULE_CACHE_VERSION = 1,
+};
+
+struct ModuleCacheHeader {
+	u32_le magic;
+	u32_le version;
+	u32_le encryptedSize;
+	u32_le decryptedSize;
+	u32_le decryptedHash;
+};
+
+static std::string __ModuleCacheDirectory() {
+	return GetSysDirectory(DIRECTORY_CACHE) + "modules/";
+}
+
+// Keyed by the encrypted image, so updated or patched modules just miss.
+static std::string __ModuleCachePath(const u8 *encrypted, u32 size) {
+	u64 hash = XXH64(encrypted, size, 0x50525843);
+	return __ModuleCacheDirectory() + StringFromFormat("%016llx.prx", (unsigned long long)hash);
+}
+
+// Returns the decrypted size, or 0 if the module isn't cached.
+static int __LoadDecryptedModuleFromCache(const u8 *encrypted, u32 size, u8 *out, u32 outSize) {
+	if (g_Config.iModuleCacheSizeMB <= 0) {
+		return 0;
+	}
+
+	FILE *f = File::OpenCFile(__ModuleCachePath(encrypted, size), "rb");
+	if (!f) {
+		return 0;
+	}
+
+	ModuleCacheHeader header;
+	bool valid = fread(&header, sizeof(header), 1, f) == 1;
+	valid = valid && header.magic == MODULE_CACHE_MAGIC && header.version == MODULE_CACHE_VERSION;
+	valid = valid && header.encryptedSize == size && header.decryptedSize != 0 && header.decryptedSize <= outSize;
+	valid = valid && fread(out, 1, header.decryptedSize, f) == header.decryptedSize;
+	fclose(f);
+
+	if (valid && XXH32(out, header.decryptedSize, 0) != header.decryptedHash) {
+		valid = false;
+	}
+	if (!valid) {
+		WARN_LOG(SCEMODULE, "Ignoring corrupt decrypted module cache entry");
+		return 0;
+	}
+	return (int)header.decryptedSize;
+}
+
+// Drops the oldest entries until the cache fits in the configured size.
+static void __TrimModuleCache(u64 maxBytes) {
+	std::vector<FileInfo> files;
+	getFilesInDir(__ModuleCacheDirectory().c_str(), &files, "prx");
+
+	u64 totalBytes = 0;
+	std::vector<std::pair<time_t, size_t>> byAge;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (files[i].isDirectory) {
+			continue;
+		}
+		totalBytes += files[i].size;
+		tm modified = File::GetModifTime(files[i].fullName);
+		byAge.push_back(std::make_pair(mktime(&modified), i));
+	}
+
+	std::sort(byAge.begin(), byAge.end());
+	for (size_t i = 0; i < byAge.size() && totalBytes > maxBytes; ++i) {
+		const FileInfo &info = files[byAge[i].second];
+		if (File::Delete(info.fullName)) {
+			totalBytes -= info.size;
+		}
+	}
+}
+
+static void __SaveDecryptedModuleToCache(const u8 *encrypted, u32 size, const u8 *decrypted, u32 decryptedSize) {
+	const u64 maxBytes = (u64)g_Config.iModuleCacheSizeMB * 1024 * 1024;
+	if (maxBytes == 0 || decryptedSize + sizeof(ModuleCacheHeader) > maxBytes) {
+		return;
+	}
+
+	const std::string cacheDir = __ModuleCacheDirectory();
+	if (!File::Exists(cacheDir)) {
+		File::CreateFullPath(cacheDir);
+	}
+
+	ModuleCacheHeader header;
+	header.magic = MODULE_CACHE_MAGIC;
+	header.version = MODULE_CACHE_VERSION;
+	header.encryptedSize = size;
+	header.decryptedSize = decryptedSize;
+	header.decryptedHash = XXH32(decrypted, decryptedSize, 0);
+
+	// Write to a temporary name first, so a crash can't leave a truncated entry behind.
+	const std::string path = __ModuleCachePath(encrypted, size);
+	const std::string tempPath = path + ".tmp";
+	FILE *f = File::OpenCFile(tempPath, "wb");
+	if (!f) {
+		ERROR_LOG(SCEMODULE, "Unable to write decrypted module cache entry %s", tempPath.c_str());
+		return;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+	written = written && fwrite(decrypted, 1, decryptedSize, f) == decryptedSize;
+	fclose(f);
+
+	if (!written || !File::Rename(tempPath, path)) {
+		File::Delete(tempPath);
+		return;
+	}
+
+	__TrimModuleCache(maxBytes);
+}
+
+// Decrypting large EBOOTs takes a good fraction of boot time, and the output never changes.
+static int __DecryptPRXCached(const u8 *in, u8 *out, u32 psp_size, u32 outSize, bool &fromCache) {
+	int ret = __LoadDecryptedModuleFromCache(in, psp_size, out, outSize);
+	fromCache = ret > 0;
+	if (fromCache) {
+		return ret;
+	}
+
+	ret = pspDecryptPRX(in, out, psp_size);
+	if (ret > 0 && (u32)ret <= outSize) {
+		__SaveDecryptedModuleToCache(in, psp_size, out, ret);
+	}
+	return ret;
+}
+
 static bool IsHLEVersionedModule(const char *name) {
 	// TODO: Only some of these are currently known to be versioned.
 	// Potentially only sceMpeg_library matters.
@@ -847,6 +1056,13 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 	bool reportedModule = false;
 	u32 devkitVersion = 0;
 	u8 *newptr = 0;
+
+	// Boot phases, logged at the end to see where load time goes.
+	const double loadStart = real_time_now();
+	double decryptTime = 0.0;
+	double relocateTime = 0.0;
+	double scanTime = 0.0;
+	bool decryptCached = false;
 	u32_le *magicPtr = (u32_le *) ptr;
 	if (*magicPtr == 0x4543537e) { // "~SCE"
 		INFO_LOG(SCEMODULE, "~SCE module, skipping header");
@@ -880,7 +1096,9 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 		newptr = new u8[head->elf_size + head->psp_size];
 		ptr = newptr;
 		magicPtr = (u32_le *)ptr;
-		int ret = pspDecryptPRX(in, (u8*)ptr, head->psp_size);
+		double decryptStart = real_time_now();
+		int ret = __DecryptPRXCached(in, (u8*)ptr, head->psp_size, head->elf_size + head->psp_size, decryptCached);
+		decryptTime = real_time_now() - decryptStart;
 		if (ret == MISSING_KEY) {
 			// This should happen for all "kernel" modules.
 			*error_string = "Missing key";
@@ -945,7 +1163,9 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 	// Open ELF reader
 	ElfReader reader((void*)ptr);
 
+	double relocateStart = real_time_now();
 	int result = reader.LoadInto(loadAddress, fromTop);
+	relocateTime = real_time_now() - relocateStart;
 	if (result != SCE_KERNEL_ERROR_OK) 	{
 		ERROR_LOG(SCEMODULE, "LoadInto failed with error %08x",result);
 		if (newptr)
@@ -1013,6 +1233,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 		module->nm.text_size = reader.GetTotalTextSize();
 
 		if (!module->isFake) {
+			double scanStart = real_time_now();
 #if !defined(MOBILE_DEVICE)
 			bool gotSymbols = reader.LoadSymbols();
 			MIPSAnalyst::ScanForFunctions(module->textStart, module->textEnd, !gotSymbols);
@@ -1022,6 +1243,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 				MIPSAnalyst::ScanForFunctions(module->textStart, module->textEnd, !gotSymbols);
 			}
 #endif
+			scanTime += real_time_now() - scanStart;
 		}
 	} else {
 		module->nm.text_addr = 0;
@@ -1183,6 +1405,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 		module->textEnd = firstImportStubAddr - 4;
 
 		if (!module->isFake) {
+			double scanStart = real_time_now();
 #if !defined(MOBILE_DEVICE)
 			bool gotSymbols = reader.LoadSymbols();
 			MIPSAnalyst::ScanForFunctions(module->textStart, module->textEnd, !gotSymbols);
@@ -1192,6 +1415,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 				MIPSAnalyst::ScanForFunctions(module->textStart, module->textEnd, !gotSymbols);
 			}
 #endif
+			scanTime += real_time_now() - scanStart;
 		}
 	}
 
@@ -1364,6 +1588,9 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, bool fromT
 		}
 	}
 
+	INFO_LOG(LOADER, "Module %s loaded in %0.1f ms: decrypt %0.1f ms%s, relocate %0.1f ms, scan %0.1f ms", modinfo->name,
+		(real_time_now() - loadStart) * 1000.0, decryptTime * 1000.0, decryptCached ? " (cached)" : "", relocateTime * 1000.0, scanTime * 1000.0);
+
 	error = 0;
 	return module;
 }
@@ -1503,6 +1730,7 @@ bool __KernelLoadExec(const char *filename, u32 paramPtr, std::string *error_str
 				// An invalid module.  We need to remove it or we'll loop forever.
 				WARN_LOG(LOADER, "Invalid module still marked as loaded on loadexec");
 				loadedModules.erase(moduleID);
+				symbolIndexDirty = true;
 			}
 		}
 
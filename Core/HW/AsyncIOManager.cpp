@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
+#include "native/thread/threadutil.h"
 #include "Common/ChunkFile.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
@@ -38,9 +41,55 @@ void AsyncIOManager::ScheduleOperation(AsyncIOEvent ev) {
 			ERROR_LOG_REPORT(SCEIO, "Scheduling operation for file %d while one is pending (type %d)", ev.handle, ev.type);
 		}
 	}
+	ev.startTicks = CoreTiming::GetTicks();
 	ScheduleEvent(ev);
 }
 
+void AsyncIOManager::StartWorkers(int count) {
+	lock_guard guard(workLock_);
+	// A single worker would just be the IO thread, so run inline in that case.
+	if (workersRunning_ || count <= 1 || !ThreadEnabled()) {
+		return;
+	}
+
+	workersRunning_ = true;
+	for (int i = 0; i < count; ++i) {
+		workers_.push_back(new std::thread([this] { WorkerLoop(); }));
+	}
+}
+
+void AsyncIOManager::StopWorkers() {
+	{
+		lock_guard guard(workLock_);
+		if (!workersRunning_) {
+			return;
+		}
+		workersRunning_ = false;
+		workWait_.notify_all();
+	}
+
+	// Workers finish anything still queued before exiting.
+	for (std::thread *worker : workers_) {
+		worker->join();
+		delete worker;
+	}
+	workers_.clear();
+}
+
+void AsyncIOManager::SyncThread(bool force) {
+	IOThreadEventQueue::SyncThread(force);
+
+	lock_guard guard(workLock_);
+	while (HasWorkerOperations()) {
+		workDrain_.wait(workLock_);
+	}
+}
+
+bool AsyncIOManager::HasWorkerOperations() {
+	lock_guard guard(workLock_);
+	return !work_.empty() || !workBusy_.empty();
+}
+
 void AsyncIOManager::Shutdown() {
 	lock_guard guard(resultsLock_);
 	resultsPending_.clear();
@@ -77,7 +126,7 @@ bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
 	lock_guard guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || HasWorkerOperations()) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (PopResult(handle, result)) {
 			return true;
 		}
@@ -95,7 +144,7 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 
 	lock_guard guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || HasWorkerOperations()) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (ReadResult(handle, result)) {
 			return result.finishTicks;
 		}
@@ -109,13 +158,42 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 }
 
 void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
+	if (CanRunConcurrently(ev)) {
+		// Events arrive in order, so queueing them in order keeps each handle's operations in order.
+		lock_guard guard(workLock_);
+		work_.push_back(ev);
+		workWait_.notify_all();
+		return;
+	}
+
+	RunOperation(ev);
+}
+
+bool AsyncIOManager::CanRunConcurrently(const AsyncIOEvent &ev) {
+	if (ev.type != IO_EVENT_READ && ev.type != IO_EVENT_WRITE) {
+		return false;
+	}
+
+	{
+		lock_guard guard(workLock_);
+		if (!workersRunning_) {
+			return false;
+		}
+	}
+
+	// Others (like the ISO) share a single device and position, keep those on the IO thread.
+	IFileSystem *sys = pspFileSystem.GetHandleOwner(ev.handle);
+	return sys != nullptr && (sys->Flags() & FILESYSTEM_CONCURRENT_IO) != 0;
+}
+
+void AsyncIOManager::RunOperation(const AsyncIOEvent &ev) {
 	switch (ev.type) {
 	case IO_EVENT_READ:
-		Read(ev.handle, ev.buf, ev.bytes);
+		Read(ev.handle, ev.buf, ev.bytes, ev.startTicks);
 		break;
 
 	case IO_EVENT_WRITE:
-		Write(ev.handle, ev.buf, ev.bytes);
+		Write(ev.handle, ev.buf, ev.bytes, ev.startTicks);
 		break;
 
 	default:
@@ -123,16 +201,51 @@ void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
 	}
 }
 
-void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes) {
+void AsyncIOManager::WorkerLoop() {
+	setCurrentThreadName("IOWorker");
+
+	lock_guard guard(workLock_);
+	while (true) {
+		// Take the oldest operation whose handle isn't already busy.
+		auto next = std::find_if(work_.begin(), work_.end(), [this](const AsyncIOEvent &ev) {
+			return workBusy_.find(ev.handle) == workBusy_.end();
+		});
+
+		if (next == work_.end()) {
+			if (!workersRunning_ && work_.empty()) {
+				break;
+			}
+			workWait_.wait(workLock_);
+			continue;
+		}
+
+		AsyncIOEvent ev = *next;
+		work_.erase(next);
+		workBusy_.insert(ev.handle);
+
+		workLock_.unlock();
+		RunOperation(ev);
+		workLock_.lock();
+
+		workBusy_.erase(ev.handle);
+		// Something may have been waiting on this handle.
+		workWait_.notify_all();
+		if (work_.empty() && workBusy_.empty()) {
+			workDrain_.notify_all();
+		}
+	}
+}
+
+void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes, u64 startTicks) {
 	int usec = 0;
 	s64 result = pspFileSystem.ReadFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec));
+	EventResult(handle, AsyncIOResult(result, usec, startTicks));
 }
 
-void AsyncIOManager::Write(u32 handle, u8 *buf, size_t bytes) {
+void AsyncIOManager::Write(u32 handle, u8 *buf, size_t bytes, u64 startTicks) {
 	int usec = 0;
 	s64 result = pspFileSystem.WriteFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec));
+	EventResult(handle, AsyncIOResult(result, usec, startTicks));
 }
 
 void AsyncIOManager::EventResult(u32 handle, AsyncIOResult result) {
@@ -141,7 +254,7 @@ void AsyncIOManager::EventResult(u32 handle, AsyncIOResult result) {
 		ERROR_LOG_REPORT(SCEIO, "Overwriting previous result for file action on handle %d", handle);
 	}
 	results_[handle] = result;
-	resultsWait_.notify_one();
+	resultsWait_.notify_all();
 }
 
 void AsyncIOManager::DoState(PointerWrap &p) {
@@ -15,9 +15,12 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <deque>
 #include <map>
 #include <set>
+#include <vector>
 #include "native/base/mutex.h"
+#include "native/thread/thread.h"
 #include "Core/ThreadEventQueue.h"
 
 class NoBase {
@@ -32,11 +35,13 @@ enum AsyncIOEventType {
 };
 
 struct AsyncIOEvent {
-	AsyncIOEvent(AsyncIOEventType t) : type(t) {}
+	AsyncIOEvent(AsyncIOEventType t) : type(t), startTicks(0) {}
 	AsyncIOEventType type;
 	u32 handle;
 	u8 *buf;
 	size_t bytes;
+	// Emulated time the operation was issued, so finish ticks don't depend on host timing.
+	u64 startTicks;
 
 	operator AsyncIOEventType() const {
 		return type;
@@ -50,8 +55,8 @@ struct AsyncIOResult {
 	explicit AsyncIOResult(s64 r) : result(r), finishTicks(0) {
 	}
 
-	AsyncIOResult(s64 r, int usec) : result(r) {
-		finishTicks = CoreTiming::GetTicks() + usToCycles(usec);
+	AsyncIOResult(s64 r, int usec, u64 startTicks) : result(r) {
+		finishTicks = startTicks + usToCycles(usec);
 	}
 
 	void DoState(PointerWrap &p) {
@@ -70,8 +75,17 @@ struct AsyncIOResult {
 typedef ThreadEventQueue<NoBase, AsyncIOEvent, AsyncIOEventType, IO_EVENT_INVALID, IO_EVENT_SYNC, IO_EVENT_FINISH> IOThreadEventQueue;
 class AsyncIOManager : public IOThreadEventQueue {
 public:
+	AsyncIOManager() : workersRunning_(false) {
+	}
+
 	void DoState(PointerWrap &p);
 
+	// With more than one worker, reads and writes on different handles may run at the same time.
+	void StartWorkers(int count);
+	void StopWorkers();
+	// Also waits for operations handed off to workers.
+	void SyncThread(bool force = false);
+
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(AsyncIOEvent ev);
 	void Shutdown();
@@ -89,8 +103,13 @@ class AsyncIOManager : public IOThreadEventQueue {
 	}
 
 private:
-	void Read(u32 handle, u8 *buf, size_t bytes);
-	void Write(u32 handle, u8 *buf, size_t bytes);
+	void Read(u32 handle, u8 *buf, size_t bytes, u64 startTicks);
+	void Write(u32 handle, u8 *buf, size_t bytes, u64 startTicks);
+	void RunOperation(const AsyncIOEvent &ev);
+
+	bool CanRunConcurrently(const AsyncIOEvent &ev);
+	bool HasWorkerOperations();
+	void WorkerLoop();
 
 	void EventResult(u32 handle, AsyncIOResult result);
 
@@ -98,4 +117,13 @@ class AsyncIOManager : public IOThreadEventQueue {
 	condition_variable resultsWait_;
 	std::set<u32> resultsPending_;
 	std::map<u32, AsyncIOResult> results_;
+
+	std::vector<std::thread *> workers_;
+	bool workersRunning_;
+	recursive_mutex workLock_;
+	condition_variable workWait_;
+	condition_variable workDrain_;
+	std::deque<AsyncIOEvent> work_;
+	// Handles currently being read or written by a worker.  Only one operation per handle runs at once.
+	std::set<u32> workBusy_;
 };
\ No newline at end of file
@@ -17,6 +17,9 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "thread/thread.h"
 #include "base/mutex.h"
@@ -28,6 +31,7 @@
 #include "net/url.h"
 
 #include "Common/FileUtil.h"
+#include "Common/StringUtils.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/FileSystems/MetaFileSystem.h"
@@ -39,6 +43,9 @@
 #include "Core/System.h"
 #include "Core/ELF/PBPReader.h"
 #include "Core/ELF/ParamSFO.h"
+#include "ext/xxhash.h"
+
+FileLoaderCacheStats fileLoaderCacheStats;
 
 class LocalFileLoader : public FileLoader {
 public:
@@ -160,6 +167,8 @@ class CachingFileLoader : public FileLoader {
 	}
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, void *data) override;
 
+	virtual void StartBootTrace() override;
+
 private:
 	void InitCache();
 	void ShutdownCache();
@@ -169,12 +178,26 @@ class CachingFileLoader : public FileLoader {
 	bool MakeCacheSpaceFor(size_t blocks, bool readingAhead);
 	void StartReadAhead(s64 pos);
 
+	u8 *AllocateBlock();
+	void FreeBlock(u8 *ptr);
+	void InsertBlock(s64 index, u8 *ptr);
+	void EvictOldestBlock();
+
+	std::string TracePath();
+	bool LoadTrace(std::vector<u32> &trace);
+	void RecordTrace(s64 blockIndex);
+	void FinishTrace();
+	void StartTracePrefetch();
+
 	enum {
 		BLOCK_SIZE = 65536,
 		BLOCK_SHIFT = 16,
 		MAX_BLOCKS_PER_READ = 16,
-		MAX_BLOCKS_CACHED = 4096, // 256 MB
+		BLOCKS_PER_SLAB = 64, // 4 MB
+		CACHE_BUDGET_BYTES = 256 * 1024 * 1024,
 		BLOCK_READAHEAD = 4,
+		MAX_TRACE_BLOCKS = 8192,
+		TRACE_SECONDS = 60,
 	};
 
 	s64 filesize_;
@@ -182,24 +205,31 @@ class CachingFileLoader : public FileLoader {
 	FileLoader *backend_;
 	int exists_;
 	int isDirectory_;
-	u64 generation_;
-	u64 oldestGeneration_;
 	size_t cacheSize_;
+	size_t maxBlocks_;
 
 	struct BlockInfo {
 		u8 *ptr;
-		u64 generation;
-
-		BlockInfo() : ptr(nullptr), generation(0) {
-		}
-		BlockInfo(u8 *p) : ptr(p), generation(0) {
-		}
+		std::list<s64>::iterator lruPos;
 	};
 
-	std::map<s64, BlockInfo> blocks_;
+	std::unordered_map<s64, BlockInfo> blocks_;
+	// Most recently used at the front.
+	std::list<s64> lru_;
+	std::vector<u8 *> slabs_;
+	std::vector<u8 *> freeBlocks_;
 	recursive_mutex blocksMutex_;
 	mutable recursive_mutex backendMutex_;
 	bool aheadThread_;
+	bool prefetchThread_;
+	bool shuttingDown_;
+
+	// Blocks in the order they were first touched since StartBootTrace().
+	bool tracing_;
+	double traceStart_;
+	std::vector<u32> trace_;
+	std::unordered_set<u32> traceSeen_;
+	size_t previousTraceSize_;
 };
 
 FileLoader *ConstructFileLoader(const std::string &filename) {
@@ -440,7 +470,8 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data) {
 
 // Takes ownership of backend.
 CachingFileLoader::CachingFileLoader(FileLoader *backend)
-	: filesize_(0), filepos_(0), backend_(backend), exists_(-1), isDirectory_(-1), aheadThread_(false) {
+	: filesize_(0), filepos_(0), backend_(backend), exists_(-1), isDirectory_(-1),
+	  aheadThread_(false), prefetchThread_(false), shuttingDown_(false), tracing_(false), traceStart_(0.0), previousTraceSize_(0) {
 	filesize_ = backend->FileSize();
 	if (filesize_ > 0) {
 		InitCache();
@@ -485,11 +516,33 @@ void CachingFileLoader::Seek(s64 absolutePos) {
 }
 
 size_t CachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data) {
+	if (bytes == 0 || absolutePos >= filesize_) {
+		return 0;
+	}
+	// Blocks past the end are never cached, so don't wait for them.
+	if ((s64)bytes > filesize_ - absolutePos) {
+		bytes = (size_t)(filesize_ - absolutePos);
+	}
+	if (tracing_) {
+		lock_guard guard(blocksMutex_);
+		s64 cacheEndPos = (absolutePos + bytes - 1) >> BLOCK_SHIFT;
+		for (s64 i = absolutePos >> BLOCK_SHIFT; i <= cacheEndPos; ++i) {
+			RecordTrace(i);
+		}
+	}
+
 	size_t readSize = ReadFromCache(absolutePos, bytes, data);
 	// While in case the cache size is too small for the entire read.
 	while (readSize < bytes) {
 		SaveIntoCache(absolutePos + readSize, bytes - readSize);
-		readSize += ReadFromCache(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize);
+		size_t bytesFromCache = ReadFromCache(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize);
+		readSize += bytesFromCache;
+		if (bytesFromCache == 0) {
+			// There wasn't room to cache it, so read the rest directly rather than spin.
+			lock_guard guard(backendMutex_);
+			readSize += backend_->ReadAt(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize);
+			break;
+		}
 	}
 
 	StartReadAhead(absolutePos + readSize);
@@ -500,30 +553,34 @@ size_t CachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data) {
 
 void CachingFileLoader::InitCache() {
 	cacheSize_ = 0;
-	oldestGeneration_ = 0;
-	generation_ = 0;
+	maxBlocks_ = CACHE_BUDGET_BYTES >> BLOCK_SHIFT;
 }
 
 void CachingFileLoader::ShutdownCache() {
 	// TODO: Maybe add some hint that deletion is coming soon?
 	// We can't delete while the thread is running, so have to wait.
 	// This should only happen from the menu.
-	while (aheadThread_) {
+	shuttingDown_ = true;
+	while (aheadThread_ || prefetchThread_) {
 		sleep_ms(1);
 	}
 
 	lock_guard guard(blocksMutex_);
-	for (auto block : blocks_) {
-		delete [] block.second.ptr;
-	}
+	FinishTrace();
+
 	blocks_.clear();
+	lru_.clear();
+	freeBlocks_.clear();
+	for (u8 *slab : slabs_) {
+		delete [] slab;
+	}
+	slabs_.clear();
 	cacheSize_ = 0;
 }
 
 size_t CachingFileLoader::ReadFromCache(s64 pos, size_t bytes, void *data) {
 	s64 cacheStartPos = pos >> BLOCK_SHIFT;
 	s64 cacheEndPos = (pos + bytes - 1) >> BLOCK_SHIFT;
-	// TODO: Smarter.
 	size_t readSize = 0;
 	size_t offset = (size_t)(pos - (cacheStartPos << BLOCK_SHIFT));
 	u8 *p = (u8 *)data;
@@ -532,9 +589,12 @@ size_t CachingFileLoader::ReadFromCache(s64 pos, size_t bytes, void *data) {
 	for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
 		auto block = blocks_.find(i);
 		if (block == blocks_.end()) {
+			fileLoaderCacheStats.blockMisses++;
 			return readSize;
 		}
-		block->second.generation = generation_;
+		fileLoaderCacheStats.blockHits++;
+		// Move to the front, it's now the most recently used.
+		lru_.splice(lru_.begin(), lru_, block->second.lruPos);
 
 		size_t toRead = std::min(bytes - readSize, (size_t)BLOCK_SIZE - offset);
 		memcpy(p + readSize, block->second.ptr + offset, toRead);
@@ -547,6 +607,9 @@ size_t CachingFileLoader::ReadFromCache(s64 pos, size_t bytes, void *data) {
 }
 
 void CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, bool readingAhead) {
+	if (pos >= filesize_) {
+		return;
+	}
 	s64 cacheStartPos = pos >> BLOCK_SHIFT;
 	s64 cacheEndPos = (pos + bytes - 1) >> BLOCK_SHIFT;
 
@@ -563,26 +626,24 @@ void CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, bool readingAhead)
 		}
 	}
 
-	if (!MakeCacheSpaceFor(blocksToRead, readingAhead) || blocksToRead == 0) {
+	if (blocksToRead == 0 || !MakeCacheSpaceFor(blocksToRead, readingAhead)) {
 		return;
 	}
 
+	// Claim the slots now, so nothing else can take them while we read.
+	u8 *bufs[MAX_BLOCKS_PER_READ];
+	for (size_t i = 0; i < blocksToRead; ++i) {
+		bufs[i] = AllocateBlock();
+	}
+
 	if (blocksToRead == 1) {
 		blocksMutex_.unlock();
 
-		u8 *buf = new u8[BLOCK_SIZE];
 		backendMutex_.lock();
-		backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, BLOCK_SIZE, buf);
+		backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, BLOCK_SIZE, bufs[0]);
 		backendMutex_.unlock();
 
 		blocksMutex_.lock();
-		// While blocksMutex_ was unlocked, another thread may have read.
-		// If so, free the one we just read.
-		if (blocks_.find(cacheStartPos) == blocks_.end()) {
-			blocks_[cacheStartPos] = BlockInfo(buf);
-		} else {
-			delete [] buf;
-		}
 	} else {
 		blocksMutex_.unlock();
 
@@ -591,89 +652,108 @@ void CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, bool readingAhead)
 		backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, blocksToRead << BLOCK_SHIFT, wholeRead);
 		backendMutex_.unlock();
 
-		blocksMutex_.lock();
 		for (size_t i = 0; i < blocksToRead; ++i) {
-			if (blocks_.find(cacheStartPos + i) != blocks_.end()) {
-				// Written while we were busy, just skip it.  Keep the existing block.
-				continue;
-			}
-			u8 *buf = new u8[BLOCK_SIZE];
-			memcpy(buf, wholeRead + (i << BLOCK_SHIFT), BLOCK_SIZE);
-			blocks_[cacheStartPos + i] = BlockInfo(buf);
+			memcpy(bufs[i], wholeRead + (i << BLOCK_SHIFT), BLOCK_SIZE);
 		}
-		delete[] wholeRead;
+		delete [] wholeRead;
+
+		blocksMutex_.lock();
 	}
 
-	cacheSize_ += blocksToRead;
-	++generation_;
+	for (size_t i = 0; i < blocksToRead; ++i) {
+		// While blocksMutex_ was unlocked, another thread may have read.
+		// If so, keep the existing block and release ours.
+		if (blocks_.find(cacheStartPos + i) != blocks_.end()) {
+			FreeBlock(bufs[i]);
+			continue;
+		}
+		InsertBlock(cacheStartPos + i, bufs[i]);
+		if (readingAhead) {
+			fileLoaderCacheStats.bytesPrefetched += BLOCK_SIZE;
+		}
+	}
 }
 
 bool CachingFileLoader::MakeCacheSpaceFor(size_t blocks, bool readingAhead) {
-	size_t goal = MAX_BLOCKS_CACHED - blocks;
-
-	if (readingAhead && cacheSize_ > goal) {
+	lock_guard guard(blocksMutex_);
+	if (blocks > maxBlocks_) {
+		return false;
+	}
+	if (readingAhead && cacheSize_ + blocks > maxBlocks_) {
+		// Never evict for speculative reads.
 		return false;
 	}
 
-	lock_guard guard(blocksMutex_);
-	while (cacheSize_ > goal) {
-		u64 minGeneration = generation_;
-
-		// We increment the iterator inside because we delete things inside.
-		for (auto it = blocks_.begin(); it != blocks_.end(); ) {
-			// Check for the minimum seen generation.
-			// TODO: Do this smarter?
-			if (it->second.generation != 0 && it->second.generation < minGeneration) {
-				minGeneration = it->second.generation;
-			}
+	// Blocks being read by another thread aren't in lru_ yet, and can't be evicted.
+	while (cacheSize_ + blocks > maxBlocks_ && !lru_.empty()) {
+		EvictOldestBlock();
+	}
+	return true;
+}
 
-			// 0 means it was never used yet or was the first read (e.g. block descriptor.)
-			if (it->second.generation == oldestGeneration_ || it->second.generation == 0) {
-				s64 pos = it->first;
-				delete it->second.ptr;
-				blocks_.erase(it);
-				--cacheSize_;
-
-				// Our iterator is invalid now.  Keep going?
-				if (cacheSize_ > goal) {
-					// This finds the one at that position.
-					it = blocks_.lower_bound(pos);
-				} else {
-					break;
-				}
-			} else {
-				++it;
-			}
+u8 *CachingFileLoader::AllocateBlock() {
+	if (freeBlocks_.empty() && !lru_.empty() && slabs_.size() * BLOCKS_PER_SLAB >= maxBlocks_) {
+		EvictOldestBlock();
+	}
+	if (freeBlocks_.empty()) {
+		// Normally under budget, but may briefly overshoot if other threads have reads in flight.
+		u8 *slab = new u8[BLOCKS_PER_SLAB << BLOCK_SHIFT];
+		slabs_.push_back(slab);
+		// Push in reverse so blocks are handed out in address order.
+		for (int i = BLOCKS_PER_SLAB - 1; i >= 0; --i) {
+			freeBlocks_.push_back(slab + (i << BLOCK_SHIFT));
 		}
-
-		// If we didn't find any, update to the lowest we did find.
-		oldestGeneration_ = minGeneration;
 	}
 
-	return true;
+	u8 *ptr = freeBlocks_.back();
+	freeBlocks_.pop_back();
+	++cacheSize_;
+	return ptr;
+}
+
+void CachingFileLoader::FreeBlock(u8 *ptr) {
+	freeBlocks_.push_back(ptr);
+	--cacheSize_;
+}
+
+void CachingFileLoader::InsertBlock(s64 index, u8 *ptr) {
+	lru_.push_front(index);
+	BlockInfo &info = blocks_[index];
+	info.ptr = ptr;
+	info.lruPos = lru_.begin();
+}
+
+void CachingFileLoader::EvictOldestBlock() {
+	s64 index = lru_.back();
+	lru_.pop_back();
+
+	auto it = blocks_.find(index);
+	FreeBlock(it->second.ptr);
+	blocks_.erase(it);
 }
 
 void CachingFileLoader::StartReadAhead(s64 pos) {
 	lock_guard guard(blocksMutex_);
-	if (aheadThread_) {
+	if (aheadThread_ || shuttingDown_) {
 		// Already going.
 		return;
 	}
-	if (cacheSize_ + BLOCK_READAHEAD > MAX_BLOCKS_CACHED) {
+	if (cacheSize_ + BLOCK_READAHEAD > maxBlocks_) {
 		// Not enough space to readahead.
 		return;
 	}
 
 	aheadThread_ = true;
 	std::thread th([this, pos] {
-		lock_guard guard(blocksMutex_);
 		s64 cacheStartPos = pos >> BLOCK_SHIFT;
 		s64 cacheEndPos = cacheStartPos + BLOCK_READAHEAD - 1;
 
 		for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
-			auto block = blocks_.find(i);
-			if (block == blocks_.end()) {
-				blocksMutex_.unlock();
+			blocksMutex_.lock();
+			bool cached = blocks_.find(i) != blocks_.end();
+			blocksMutex_.unlock();
+			if (!cached) {
+				// Must not hold the lock here, SaveIntoCache drops it while reading.
 				SaveIntoCache(i << BLOCK_SHIFT, BLOCK_SIZE * BLOCK_READAHEAD, true);
 				break;
 			}
@@ -684,6 +764,123 @@ void CachingFileLoader::StartReadAhead(s64 pos) {
 	th.detach();
 }
 
+void CachingFileLoader::StartBootTrace() {
+	if (filesize_ <= 0) {
+		return;
+	}
+
+	lock_guard guard(blocksMutex_);
+	trace_.clear();
+	traceSeen_.clear();
+	tracing_ = true;
+	traceStart_ = real_time_now();
+
+	StartTracePrefetch();
+}
+
+std::string CachingFileLoader::TracePath() {
+	// Keyed by both the path and size, so a replaced file gets a fresh trace.
+	const std::string path = Path();
+	u32 hash = XXH32(path.c_str(), (int)path.size(), (u32)filesize_);
+	return GetSysDirectory(DIRECTORY_CACHE) + StringFromFormat("%08x.blocktrace", hash);
+}
+
+bool CachingFileLoader::LoadTrace(std::vector<u32> &trace) {
+	FILE *f = File::OpenCFile(TracePath(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	u32 header[2];
+	bool valid = fread(header, sizeof(u32), 2, f) == 2 && header[0] == BLOCK_SIZE && header[1] > 0 && header[1] <= MAX_TRACE_BLOCKS;
+	if (valid) {
+		trace.resize(header[1]);
+		valid = fread(&trace[0], sizeof(u32), trace.size(), f) == trace.size();
+	}
+	fclose(f);
+
+	if (!valid) {
+		WARN_LOG(LOADER, "Ignoring corrupt block trace for %s", Path().c_str());
+		trace.clear();
+	}
+	return valid;
+}
+
+void CachingFileLoader::RecordTrace(s64 blockIndex) {
+	if (traceSeen_.insert((u32)blockIndex).second) {
+		trace_.push_back((u32)blockIndex);
+	}
+	if (trace_.size() >= MAX_TRACE_BLOCKS || real_time_now() - traceStart_ >= TRACE_SECONDS) {
+		FinishTrace();
+	}
+}
+
+void CachingFileLoader::FinishTrace() {
+	if (!tracing_) {
+		return;
+	}
+	tracing_ = false;
+
+	// Only replace a previous trace with a more complete one (e.g. not a quick exit to menu.)
+	if (trace_.size() > previousTraceSize_) {
+		const std::string cacheDir = GetSysDirectory(DIRECTORY_CACHE);
+		if (!File::Exists(cacheDir)) {
+			File::CreateFullPath(cacheDir);
+		}
+
+		FILE *f = File::OpenCFile(TracePath(), "wb");
+		if (f) {
+			u32 header[2] = { BLOCK_SIZE, (u32)trace_.size() };
+			fwrite(header, sizeof(u32), 2, f);
+			fwrite(&trace_[0], sizeof(u32), trace_.size(), f);
+			fclose(f);
+			INFO_LOG(LOADER, "Recorded block trace of %d blocks", (int)trace_.size());
+		} else {
+			ERROR_LOG(LOADER, "Unable to write block trace for %s", Path().c_str());
+		}
+	}
+
+	trace_.clear();
+	traceSeen_.clear();
+}
+
+void CachingFileLoader::StartTracePrefetch() {
+	std::vector<u32> trace;
+	if (prefetchThread_ || !LoadTrace(trace)) {
+		return;
+	}
+	previousTraceSize_ = trace.size();
+	INFO_LOG(LOADER, "Replaying block trace of %d blocks", (int)trace.size());
+
+	prefetchThread_ = true;
+	std::thread th([this, trace] {
+		size_t i = 0;
+		while (i < trace.size() && !shuttingDown_) {
+			// Coalesce runs of sequential blocks into one backend read.
+			size_t run = 1;
+			while (i + run < trace.size() && run < MAX_BLOCKS_PER_READ && trace[i + run] == trace[i] + run) {
+				++run;
+			}
+
+			s64 pos = (s64)trace[i] << BLOCK_SHIFT;
+			if (pos < filesize_) {
+				blocksMutex_.lock();
+				bool full = cacheSize_ + run > maxBlocks_;
+				blocksMutex_.unlock();
+				if (full) {
+					// The rest would only push out what we just prefetched.
+					break;
+				}
+				SaveIntoCache(pos, run << BLOCK_SHIFT, true);
+			}
+			i += run;
+		}
+
+		prefetchThread_ = false;
+	});
+	th.detach();
+}
+
 // Takes ownership of backend.
 RetryingFileLoader::RetryingFileLoader(FileLoader *backend)
 	: filepos_(0), backend_(backend) {
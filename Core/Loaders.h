@@ -73,8 +73,25 @@ class FileLoader {
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, void *data) {
 		return ReadAt(absolutePos, 1, bytes, data);
 	}
+
+	// Hint that this loader is booting a game, so its access pattern is worth recording.
+	virtual void StartBootTrace() {
+	}
 };
 
+struct FileLoaderCacheStats {
+	u64 blockHits;
+	u64 blockMisses;
+	u64 bytesPrefetched;
+
+	float HitRate() const {
+		u64 total = blockHits + blockMisses;
+		return total == 0 ? 0.0f : (float)blockHits / (float)total;
+	}
+};
+
+extern FileLoaderCacheStats fileLoaderCacheStats;
+
 FileLoader *ConstructFileLoader(const std::string &filename);
 
 // This can modify the string, for example for stripping off the "/EBOOT.PBP"
@@ -750,6 +750,29 @@ void Jit::Comp_JumpReg(MIPSOpcode op)
 	js.compiling = false;
 }
 
+void Jit::CompDirectSyscall(const void *func, const HLEFunction *info)
+{
+	ABI_CallFunction(func);
+
+	// Usually there's nothing left to do, so only call out when it asked for a reschedule or similar.
+	CMP(32, M(GetDirectSyscallAfterFlags()), Imm32(0));
+	FixupBranch finish = J_CC(CC_NZ, true);
+	// Unlike in CallSyscall, this is decided when compiling, so changing it only affects new blocks.
+	if (!g_Config.bSkipDeadbeefFilling)
+	{
+		// Same as CallSyscall: the compiler scratch, arguments, and temps.
+		static const int deadbeefRegs[] = {1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 24, 25};
+		for (size_t i = 0; i < ARRAY_SIZE(deadbeefRegs); ++i)
+			MOV(32, M(&mips_->r[deadbeefRegs[i]]), Imm32(0xDEADBEEF));
+		MOV(32, M(&mips_->lo), Imm32(0xDEADBEEF));
+		MOV(32, M(&mips_->hi), Imm32(0xDEADBEEF));
+	}
+	FixupBranch done = J(true);
+	SetJumpTarget(finish);
+	ABI_CallFunctionP((const void *)&FinishDirectSyscall, (void *)info);
+	SetJumpTarget(done);
+}
+
 void Jit::Comp_Syscall(MIPSOpcode op)
 {
 	// TODO: Maybe discard v0, v1, and some temps?  Definitely at?
@@ -762,8 +785,11 @@ void Jit::Comp_Syscall(MIPSOpcode op)
 	js.downcountAmount = -offset;
 
 	// Skip the CallSyscall where possible.
+	void *directFunc = GetDirectSyscallFunc(op);
 	void *quickFunc = GetQuickSyscallFunc(op);
-	if (quickFunc)
+	if (directFunc)
+		CompDirectSyscall(directFunc, GetSyscallInfo(op));
+	else if (quickFunc)
 		ABI_CallFunctionP(quickFunc, (void *)GetSyscallInfo(op));
 	else
 		ABI_CallFunctionC(&CallSyscall, op.encoding);
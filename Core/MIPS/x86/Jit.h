@@ -34,6 +34,7 @@
 #include "Core/MIPS/x86/RegCacheFPU.h"
 
 class PointerWrap;
+struct HLEFunction;
 
 namespace MIPSComp
 {
@@ -233,6 +234,7 @@ class Jit : public Gen::XCodeBlock
 	}
 	void CompITypeMemUnpairedLR(MIPSOpcode op, bool isStore);
 	void CompITypeMemUnpairedLRInner(MIPSOpcode op, Gen::X64Reg shiftReg);
+	void CompDirectSyscall(const void *func, const HLEFunction *info);
 	void CompBranchExits(Gen::CCFlags cc, u32 targetAddr, u32 notTakenAddr, bool delaySlotIsNice, bool likely, bool andLink);
 	void CompBranchExit(bool taken, u32 targetAddr, u32 notTakenAddr, bool delaySlotIsNice, bool likely, bool andLink);
 	static Gen::CCFlags FlipCCFlag(Gen::CCFlags flag);
@@ -75,7 +75,7 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 
 #ifdef _M_X64
 		if (g_Config.bCacheFullIsoInRam) {
-			// The constructor destroys the original block device object after reading it.
+			// Takes ownership of the original block device, which is read in the background.
 			bd = new RAMBlockDevice(bd);
 		}
 #endif
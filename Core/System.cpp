@@ -52,11 +52,16 @@
 #include "Core/ELF/ParamSFO.h"
 #include "Core/SaveState.h"
 #include "Common/LogManager.h"
+#include "Common/CPUDetect.h"
 #include "Core/HLE/sceAudiocodec.h"
 
 #include "GPU/GPUState.h"
 #include "GPU/GPUInterface.h"
 
+extern "C" {
+#include "ext/libkirk/AES.h"
+}
+
 enum CPUThreadState {
 	CPU_THREAD_NOT_RUNNING,
 	CPU_THREAD_PENDING,
@@ -171,6 +176,9 @@ void CPU_Init() {
 	coreState = CORE_POWERUP;
 	currentMIPS = &mipsr4k;
 
+	// PRX, NPDRM and savedata crypto all go through libkirk's AES.
+	AES_use_aesni(cpu_info.bAES);
+
 	// Default memory settings
 	// Seems to be the safest place currently..
 	if (g_Config.iPSPModel == PSP_MODEL_FAT)
@@ -184,6 +192,7 @@ void CPU_Init() {
 
 	std::string filename = coreParameter.fileToStart;
 	loadedFile = ConstructFileLoader(filename);
+	loadedFile->StartBootTrace();
 	IdentifiedFileType type = Identify_File(loadedFile);
 
 	// TODO: Put this somewhere better?
@@ -530,6 +539,8 @@ std::string GetSysDirectory(PSPDirectories directoryType) {
 		return g_Config.memStickDirectory + "PAUTH/";
 	case DIRECTORY_DUMP:
 		return g_Config.memStickDirectory + "PSP/SYSTEM/DUMP/";
+	case DIRECTORY_CACHE:
+		return g_Config.memStickDirectory + "PSP/SYSTEM/CACHE/";
 	// Just return the memory stick root if we run into some sort of problem.
 	default:
 		ERROR_LOG(FILESYS, "Unknown directory type.");
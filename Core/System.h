@@ -43,6 +43,7 @@ enum PSPDirectories {
 	DIRECTORY_SAVEDATA,
 	DIRECTORY_PAUTH,
 	DIRECTORY_DUMP,
+	DIRECTORY_CACHE,
 };
 
 
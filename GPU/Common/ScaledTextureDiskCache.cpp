@@ -0,0 +1,413 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "file/file_util.h"
+#include "thread/threadutil.h"
+#include "Common/Common.h"
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Common/StringUtils.h"
+#include "ext/snappy/snappy-c.h"
+#include "ext/xxhash.h"
+#include "GPU/Common/ScaledTextureDiskCache.h"
+
+enum {
+	SCALED_TEXTURE_MAGIC = 0x58545353, // "SSTX"
+	SCALED_TEXTURE_VERSION = 2,
+};
+
+// More than this isn't read ahead, the rest is read when needed.
+static const u64 PRELOAD_MAX_BYTES = 64 * 1024 * 1024;
+
+struct ScaledTextureFileHeader {
+	u32_le magic;
+	u32_le version;
+	ScaledTextureKey key;
+	u32_le compressedSize;
+	u32_le pixels;
+	u32_le hash;
+	// The key's u64 aligns the whole header.
+	u32_le pad;
+};
+
+ScaledTextureDiskCache::ScaledTextureDiskCache()
+	: maxBytes_(0), hits_(0), misses_(0), worker_(nullptr), running_(false), writing_(false), indexed_(false), totalBytes_(0) {
+}
+
+ScaledTextureDiskCache::~ScaledTextureDiskCache() {
+	Close();
+}
+
+void ScaledTextureDiskCache::Open(const std::string &dir, u64 maxBytes) {
+	if (dir == dir_ && maxBytes == maxBytes_) {
+		return;
+	}
+	Close();
+
+	dir_ = dir;
+	maxBytes_ = maxBytes;
+	running_ = true;
+	worker_ = new std::thread([this] { WorkerLoop(); });
+}
+
+void ScaledTextureDiskCache::Close() {
+	if (!worker_) {
+		return;
+	}
+
+	{
+		lock_guard guard(lock_);
+		running_ = false;
+		wait_.notify_all();
+	}
+	// Pending writes are finished first.
+	worker_->join();
+	delete worker_;
+	worker_ = nullptr;
+
+	indexed_ = false;
+	index_.clear();
+	preloaded_.clear();
+	totalBytes_ = 0;
+	dir_.clear();
+}
+
+u64 ScaledTextureDiskCache::HashKey(const ScaledTextureKey &key) {
+	return XXH64(&key, sizeof(key), 0x53545843);
+}
+
+std::string ScaledTextureDiskCache::PathFor(u64 hash) const {
+	return dir_ + StringFromFormat("%016llx.stx", (unsigned long long)hash);
+}
+
+bool ScaledTextureDiskCache::Contains(const ScaledTextureKey &key) {
+	if (!IsOpen()) {
+		return false;
+	}
+	lock_guard guard(lock_);
+	return indexed_ && index_.find(HashKey(key)) != index_.end();
+}
+
+bool ScaledTextureDiskCache::Lookup(const ScaledTextureKey &key, std::vector<u32> &out) {
+	if (!IsOpen()) {
+		return false;
+	}
+
+	const u64 hash = HashKey(key);
+	std::vector<u8> blob;
+	bool preloaded = false;
+	{
+		lock_guard guard(lock_);
+		// Once indexed, a miss doesn't need to touch the disk.
+		if (indexed_ && index_.find(hash) == index_.end()) {
+			misses_++;
+			return false;
+		}
+		auto it = preloaded_.find(hash);
+		if (it != preloaded_.end()) {
+			blob.swap(it->second);
+			preloaded_.erase(it);
+			preloaded = true;
+		}
+	}
+
+	if (ReadEntry(hash, key, preloaded ? &blob : nullptr, out)) {
+		hits_++;
+		lock_guard guard(lock_);
+		touches_.push_back(hash);
+		wait_.notify_all();
+		return true;
+	}
+	misses_++;
+	return false;
+}
+
+bool ScaledTextureDiskCache::ReadEntry(u64 hash, const ScaledTextureKey &key, const std::vector<u8> *blob, std::vector<u32> &out) {
+	std::vector<u8> fileData;
+	if (!blob) {
+		FILE *f = File::OpenCFile(PathFor(hash), "rb");
+		if (!f) {
+			return false;
+		}
+		fileData.resize((size_t)File::GetSize(f));
+		bool read = !fileData.empty() && fread(&fileData[0], 1, fileData.size(), f) == fileData.size();
+		fclose(f);
+		if (!read) {
+			return false;
+		}
+		blob = &fileData;
+	}
+
+	const u32 pixels = key.width * key.height * key.factor * key.factor;
+	ScaledTextureFileHeader header;
+	bool valid = blob->size() >= sizeof(header);
+	if (valid) {
+		memcpy(&header, &(*blob)[0], sizeof(header));
+		valid = header.magic == SCALED_TEXTURE_MAGIC && header.version == SCALED_TEXTURE_VERSION;
+		valid = valid && memcmp(&header.key, &key, sizeof(key)) == 0 && header.pixels == pixels;
+		valid = valid && header.compressedSize == blob->size() - sizeof(header);
+	}
+	if (valid) {
+		out.resize(pixels);
+		size_t uncompressedSize = pixels * sizeof(u32);
+		const char *compressed = (const char *)&(*blob)[sizeof(header)];
+		valid = snappy_uncompress(compressed, header.compressedSize, (char *)&out[0], &uncompressedSize) == SNAPPY_OK;
+		valid = valid && uncompressedSize == pixels * sizeof(u32) && XXH32(&out[0], uncompressedSize, 0) == header.hash;
+	}
+
+	if (!valid) {
+		WARN_LOG(G3D, "Ignoring corrupt scaled texture cache entry %016llx", (unsigned long long)hash);
+	}
+	return valid;
+}
+
+void ScaledTextureDiskCache::Store(const ScaledTextureKey &key, const u32 *scaled) {
+	if (!IsOpen()) {
+		return;
+	}
+
+	PendingWrite *write = new PendingWrite();
+	write->key = key;
+	write->data.assign(scaled, scaled + key.width * key.height * key.factor * key.factor);
+
+	lock_guard guard(lock_);
+	writes_.push_back(write);
+	wait_.notify_all();
+}
+
+void ScaledTextureDiskCache::Flush() {
+	if (!IsOpen()) {
+		return;
+	}
+
+	lock_guard guard(lock_);
+	while (!indexed_ || !writes_.empty() || !touches_.empty() || writing_) {
+		wait_.wait(lock_);
+	}
+}
+
+void ScaledTextureDiskCache::WorkerLoop() {
+	setCurrentThreadName("TexDiskCache");
+	IndexAndPreload();
+
+	lock_guard guard(lock_);
+	while (true) {
+		if (!touches_.empty()) {
+			std::vector<u64> touches;
+			touches.swap(touches_);
+			writing_ = true;
+
+			lock_.unlock();
+			for (u64 hash : touches) {
+				File::Touch(PathFor(hash));
+			}
+			lock_.lock();
+
+			writing_ = false;
+			wait_.notify_all();
+			continue;
+		}
+		if (writes_.empty()) {
+			if (!running_) {
+				break;
+			}
+			wait_.wait(lock_);
+			continue;
+		}
+
+		PendingWrite *write = writes_.front();
+		writes_.pop_front();
+		writing_ = true;
+
+		lock_.unlock();
+		WriteEntry(*write);
+		delete write;
+		lock_.lock();
+
+		writing_ = false;
+		wait_.notify_all();
+	}
+}
+
+static u64 HashFromFilename(const std::string &name) {
+	return strtoull(name.c_str(), nullptr, 16);
+}
+
+void ScaledTextureDiskCache::IndexAndPreload() {
+	// A crash mid-write leaves these behind.  Only this thread writes, and it hasn't started yet.
+	std::vector<FileInfo> tempFiles;
+	getFilesInDir(dir_.c_str(), &tempFiles, "tmp");
+	for (const FileInfo &info : tempFiles) {
+		if (!info.isDirectory) {
+			File::Delete(info.fullName);
+		}
+	}
+
+	std::vector<FileInfo> files;
+	getFilesInDir(dir_.c_str(), &files, "stx");
+
+	u64 totalBytes = 0;
+	std::vector<std::pair<time_t, size_t>> byAge;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (files[i].isDirectory) {
+			continue;
+		}
+		totalBytes += files[i].size;
+		tm modified = File::GetModifTime(files[i].fullName);
+		byAge.push_back(std::make_pair(mktime(&modified), i));
+	}
+
+	{
+		lock_guard guard(lock_);
+		for (auto age : byAge) {
+			index_.insert(HashFromFilename(files[age.second].name));
+		}
+		totalBytes_ += totalBytes;
+		indexed_ = true;
+		wait_.notify_all();
+	}
+	INFO_LOG(G3D, "Scaled texture cache: %d textures, %d KB", (int)byAge.size(), (int)(totalBytes / 1024));
+
+	if (totalBytes > maxBytes_) {
+		Trim();
+	}
+
+	// The newest are most likely to be needed soon, e.g. by the area the game was left in.
+	std::sort(byAge.rbegin(), byAge.rend());
+	u64 preloadedBytes = 0;
+	for (auto age : byAge) {
+		const FileInfo &info = files[age.second];
+		if (preloadedBytes + info.size > std::min(maxBytes_, PRELOAD_MAX_BYTES)) {
+			break;
+		}
+
+		std::vector<u8> blob;
+		FILE *f = File::OpenCFile(info.fullName, "rb");
+		if (!f) {
+			continue;
+		}
+		blob.resize((size_t)info.size);
+		bool read = !blob.empty() && fread(&blob[0], 1, blob.size(), f) == blob.size();
+		fclose(f);
+
+		lock_guard guard(lock_);
+		if (!running_) {
+			break;
+		}
+		const u64 hash = HashFromFilename(info.name);
+		if (read && index_.find(hash) != index_.end()) {
+			preloaded_[hash].swap(blob);
+			preloadedBytes += info.size;
+		}
+	}
+}
+
+void ScaledTextureDiskCache::WriteEntry(const PendingWrite &write) {
+	const size_t size = write.data.size() * sizeof(u32);
+	if (size == 0 || size + sizeof(ScaledTextureFileHeader) > maxBytes_) {
+		return;
+	}
+	if (!File::Exists(dir_)) {
+		File::CreateFullPath(dir_);
+	}
+
+	size_t compressedSize = snappy_max_compressed_length(size);
+	std::vector<char> compressed(compressedSize);
+	if (snappy_compress((const char *)&write.data[0], size, &compressed[0], &compressedSize) != SNAPPY_OK) {
+		return;
+	}
+
+	ScaledTextureFileHeader header;
+	header.magic = SCALED_TEXTURE_MAGIC;
+	header.version = SCALED_TEXTURE_VERSION;
+	header.key = write.key;
+	header.compressedSize = (u32)compressedSize;
+	header.pixels = (u32)write.data.size();
+	header.hash = XXH32(&write.data[0], size, 0);
+	header.pad = 0;
+
+	// Write to a temporary name first, so a crash can't leave a truncated entry behind.
+	const u64 hash = HashKey(write.key);
+	const std::string path = PathFor(hash);
+	const std::string tempPath = path + ".tmp";
+	FILE *f = File::OpenCFile(tempPath, "wb");
+	if (!f) {
+		ERROR_LOG(G3D, "Unable to write scaled texture cache entry %s", tempPath.c_str());
+		return;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+	written = written && fwrite(&compressed[0], 1, compressedSize, f) == compressedSize;
+	fclose(f);
+
+	if (!written || !File::Rename(tempPath, path)) {
+		ERROR_LOG(G3D, "Unable to write scaled texture cache entry %s", path.c_str());
+		File::Delete(tempPath);
+		return;
+	}
+
+	bool full;
+	{
+		lock_guard guard(lock_);
+		if (index_.insert(hash).second) {
+			totalBytes_ += sizeof(header) + compressedSize;
+		}
+		full = totalBytes_ > maxBytes_;
+	}
+	if (full) {
+		Trim();
+	}
+}
+
+// Drops the oldest entries until the cache fits, with some room to spare so this isn't every write.
+void ScaledTextureDiskCache::Trim() {
+	std::vector<FileInfo> files;
+	getFilesInDir(dir_.c_str(), &files, "stx");
+
+	u64 totalBytes = 0;
+	std::vector<std::pair<time_t, size_t>> byAge;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (files[i].isDirectory) {
+			continue;
+		}
+		totalBytes += files[i].size;
+		tm modified = File::GetModifTime(files[i].fullName);
+		byAge.push_back(std::make_pair(mktime(&modified), i));
+	}
+
+	const u64 targetBytes = maxBytes_ - maxBytes_ / 4;
+	std::sort(byAge.begin(), byAge.end());
+	std::vector<u64> deleted;
+	for (size_t i = 0; i < byAge.size() && totalBytes > targetBytes; ++i) {
+		const FileInfo &info = files[byAge[i].second];
+		if (File::Delete(info.fullName)) {
+			totalBytes -= info.size;
+			deleted.push_back(HashFromFilename(info.name));
+		}
+	}
+
+	lock_guard guard(lock_);
+	for (u64 hash : deleted) {
+		index_.erase(hash);
+		preloaded_.erase(hash);
+	}
+	totalBytes_ = totalBytes;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "native/base/mutex.h"
+#include "native/thread/thread.h"
+#include "Common/CommonTypes.h"
+
+// Everything the scaled result depends on.  No padding to hash, with the u64 first and the rest u32.
+struct ScaledTextureKey {
+	// XXH64 of level 0 and the CLUT, so it's the same on any CPU.  The cache trusts it,
+	// so a collision here would be a wrong texture.
+	u64 contenthash;
+	u32 format;
+	u32 clutformat;
+	u32 srcFmt;  // The backend's format for the unscaled texture.
+	u32 width;
+	u32 height;
+	u32 scaler;
+	u32 factor;
+	u32 deposterize;
+};
+
+// Scaled textures, compressed on disk in a directory per game, so each only needs scaling once.
+// The directory is indexed and the newest entries read into memory on a thread when opened,
+// and writes happen on that thread too.
+class ScaledTextureDiskCache {
+public:
+	ScaledTextureDiskCache();
+	~ScaledTextureDiskCache();
+
+	void Open(const std::string &dir, u64 maxBytes);
+	void Close();
+	bool IsOpen() const {
+		return !dir_.empty();
+	}
+
+	// Whether it's known to be on disk.  False until the directory has been indexed.
+	bool Contains(const ScaledTextureKey &key);
+	// Fills out with the scaled pixels (width * height * factor * factor of them.)
+	bool Lookup(const ScaledTextureKey &key, std::vector<u32> &out);
+	void Store(const ScaledTextureKey &key, const u32 *scaled);
+
+	// Waits for pending writes and touches, mostly for tests.
+	void Flush();
+
+	int Hits() const {
+		return hits_;
+	}
+	int Misses() const {
+		return misses_;
+	}
+
+private:
+	struct PendingWrite {
+		ScaledTextureKey key;
+		std::vector<u32> data;
+	};
+
+	static u64 HashKey(const ScaledTextureKey &key);
+	std::string PathFor(u64 hash) const;
+	bool ReadEntry(u64 hash, const ScaledTextureKey &key, const std::vector<u8> *blob, std::vector<u32> &out);
+
+	void WorkerLoop();
+	void IndexAndPreload();
+	void WriteEntry(const PendingWrite &write);
+	void Trim();
+
+	std::string dir_;
+	u64 maxBytes_;
+	int hits_;
+	int misses_;
+
+	std::thread *worker_;
+	recursive_mutex lock_;
+	condition_variable wait_;
+	bool running_;
+	bool writing_;
+	// Everything below is under lock_.
+	bool indexed_;
+	std::unordered_set<u64> index_;
+	// Compressed files read ahead, dropped once used.
+	std::unordered_map<u64, std::vector<u8>> preloaded_;
+	std::deque<PendingWrite *> writes_;
+	// Entries that were used, so Trim() sees them as new.
+	std::vector<u64> touches_;
+	u64 totalBytes_;
+};
@@ -15,11 +15,1819 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <cstring>
 
+#include "base/timeutil.h"
+#include "thread/threadutil.h"
+#include "Common/ChunkFile.h"
+#include "Core/Config.h"
+#include "Core/Host.h"
+#include "Core/ELF/ParamSFO.h"
+#include "Core/MemMap.h"
+#include "Core/Reporting.h"
+#include "Core/System.h"
+#include "GPU/ge_constants.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/FramebufferCommon.h"
 #include "GPU/Common/TextureCacheCommon.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "ext/xxhash.h"
 
-TextureCacheCommon::~TextureCacheCommon() {}
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+
+// If a texture hasn't been seen for this many frames, get rid of it.
+#define TEXTURE_KILL_AGE 200
+#define TEXTURE_KILL_AGE_LOWMEM 60
+// Not used in lowmem mode.
+#define TEXTURE_SECOND_KILL_AGE 100
+
+// Try to be prime to other decimation intervals.
+#define TEXCACHE_DECIMATION_INTERVAL 13
+
+// Changes more frequent than this will be considered "frequent" and prevent texture scaling.
+#define TEXCACHE_FRAME_CHANGE_FREQUENT 6
+
+#define TEXCACHE_MIN_PRESSURE 16 * 1024 * 1024  // Total in VRAM
+#define TEXCACHE_SECOND_MIN_PRESSURE 4 * 1024 * 1024
+
+// Eviction for a budget goes this far below it, so it doesn't happen again for every new texture.
+#define TEXCACHE_BUDGET_SLACK_DIVISOR 8
+// Past this many, the keys of evicted textures are forgotten.
+#define TEXCACHE_MAX_EVICTED_KEYS 8192
+
+TexCacheMap::TexCacheMap() : count_(0) {
+	slots_.resize(MIN_SLOTS);
+}
+
+TexCacheMap::~TexCacheMap() {
+	Clear();
+}
+
+size_t TexCacheMap::SlotFor(u64 key) const {
+	// Fibonacci hashing, so both the address and the clut hash end up in the index.
+	return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (slots_.size() - 1);
+}
+
+TexCacheMap::Node *TexCacheMap::FindNode(u64 key, int *probes) const {
+	const size_t mask = slots_.size() - 1;
+	for (size_t i = SlotFor(key); ; i = (i + 1) & mask) {
+		++*probes;
+		// There's always a free slot, so this ends.
+		const Slot &slot = slots_[i];
+		if (!slot.node || slot.key == key) {
+			return slot.node;
+		}
+	}
+}
+
+TexCacheEntry *TexCacheMap::Find(u64 key) {
+	int probes = 0;
+	Node *node = FindNode(key, &probes);
+	gpuStats.numTextureLookups++;
+	gpuStats.numTextureLookupProbes += probes;
+	return node ? &node->entry : nullptr;
+}
+
+TexCacheEntry *TexCacheMap::Insert(u64 key, const TexCacheEntry &entry) {
+	// Keep it at most half full, so probe runs stay short.
+	if ((count_ + 1) * 2 > slots_.size()) {
+		Rehash(slots_.size() * 2);
+	}
+
+	const size_t mask = slots_.size() - 1;
+	size_t i = SlotFor(key);
+	while (slots_[i].node) {
+		if (slots_[i].key == key) {
+			return &slots_[i].node->entry;
+		}
+		i = (i + 1) & mask;
+	}
+
+	Node *node = new Node();
+	node->key = key;
+	node->listed = false;
+	node->entry = entry;
+	slots_[i].key = key;
+	slots_[i].node = node;
+	++count_;
+	return &node->entry;
+}
+
+void TexCacheMap::Clear() {
+	for (size_t i = 0; i < slots_.size(); ++i) {
+		delete slots_[i].node;
+	}
+	slots_.clear();
+	slots_.resize(MIN_SLOTS);
+	pages_.clear();
+	count_ = 0;
+}
+
+void TexCacheMap::Rehash(size_t numSlots) {
+	std::vector<Slot> old(numSlots);
+	old.swap(slots_);
+
+	const size_t mask = numSlots - 1;
+	for (size_t j = 0; j < old.size(); ++j) {
+		if (!old[j].node) {
+			continue;
+		}
+		size_t i = SlotFor(old[j].key);
+		while (slots_[i].node) {
+			i = (i + 1) & mask;
+		}
+		slots_[i] = old[j];
+	}
+}
+
+void TexCacheMap::SetRange(u64 key, u32 addr, u32 size) {
+	int probes = 0;
+	Node *node = FindNode(key, &probes);
+	if (!node) {
+		return;
+	}
+
+	const u32 firstPage = addr >> PAGE_SHIFT;
+	const u32 lastPage = (addr + std::max(size, 1U) - 1) >> PAGE_SHIFT;
+	if (node->listed && node->addr == addr && node->firstPage == firstPage && node->lastPage == lastPage) {
+		return;
+	}
+	Unlist(node);
+	node->addr = addr;
+	node->firstPage = firstPage;
+	node->lastPage = lastPage;
+	List(node);
+}
+
+void TexCacheMap::List(Node *node) {
+	for (u32 page = node->firstPage; page <= node->lastPage; ++page) {
+		pages_[page].push_back(node);
+	}
+	node->listed = true;
+}
+
+void TexCacheMap::Unlist(Node *node) {
+	if (!node->listed) {
+		return;
+	}
+	for (u32 page = node->firstPage; page <= node->lastPage; ++page) {
+		auto list = pages_.find(page);
+		if (list == pages_.end()) {
+			continue;
+		}
+		std::vector<Node *> &nodes = list->second;
+		auto it = std::find(nodes.begin(), nodes.end(), node);
+		if (it != nodes.end()) {
+			*it = nodes.back();
+			nodes.pop_back();
+		}
+		if (nodes.empty()) {
+			pages_.erase(list);
+		}
+	}
+	node->listed = false;
+}
+
+TextureDecodeContext::TextureDecodeContext()
+	: state(nullptr), clut(nullptr), clutAlphaLinear(false), clutAlphaLinearHigh(false), clutAlphaLinearColor(0) {
+	// This is 5MB of temporary storage. Might be possible to shrink it.
+	tmpTexBuf32.resize(1024 * 512);  // 2MB
+	tmpTexBuf16.resize(1024 * 512);  // 1MB
+	tmpTexBufRearrange.resize(1024 * 512);   // 2MB
+}
+
+TextureCacheCommon::TextureCacheCommon()
+	: cacheBytes_(0), secondCacheBytes_(0), lowMemoryBudget_(0), clearCacheNextFrame_(false), lowMemoryMode_(false),
+	stagedJob_(nullptr), decodeWorkersRunning_(false),
+	clutLastFormat_(0xFFFFFFFF), clutBuf_(NULL), clutHash_(0), clutContentHash_(0), clutTotalBytes_(0), clutMaxBytes_(0),
+	clutAlphaLinear_(false), clutAlphaLinearHigh_(false), clutAlphaLinearColor_(0), texelsScaledThisFrame_(0),
+	texelsDecodedThisFrame_(0) {
+	timesInvalidatedAllThisFrame_ = 0;
+	decimationCounter_ = TEXCACHE_DECIMATION_INTERVAL;
+
+	// Aren't these way too big?
+	clutBufConverted_ = (u32 *)AllocateAlignedMemory(4096 * sizeof(u32), 16);  // 16KB
+	clutBufRaw_ = (u32 *)AllocateAlignedMemory(4096 * sizeof(u32), 16);  // 16KB
+
+	// Zap these so that reads from uninitialized parts of the CLUT look the same in
+	// release and debug
+	memset(clutBufConverted_, 0, 4096 * sizeof(u32));
+	memset(clutBufRaw_, 0, 4096 * sizeof(u32));
+
+	SetupTextureDecoder();
+
+	// Start reading the game's scaled textures early, if they'll be needed.
+	if (g_Config.iTexScalingLevel != 1) {
+		OpenScaledTextureCache();
+	}
+}
+
+TextureCacheCommon::~TextureCacheCommon() {
+	// Should already be done by the subclass, as the workers need its virtuals.
+	ShutdownDecodeWorkers();
+	FreeAlignedMemory(clutBufConverted_);
+	FreeAlignedMemory(clutBufRaw_);
+}
+
+void TextureCacheCommon::Clear(bool delete_them) {
+	Unbind();
+	CancelAllDecodes();
+	if (delete_them) {
+		auto release = [this](TexCacheEntry *entry) {
+			FreeTexture(entry);
+		};
+		cache.ForEach(release);
+		secondCache.ForEach(release);
+	}
+	if (cache.size() + secondCache.size()) {
+		INFO_LOG(G3D, "Texture cached cleared from %i textures", (int)(cache.size() + secondCache.size()));
+		cache.Clear();
+		secondCache.Clear();
+		cacheBytes_ = 0;
+		secondCacheBytes_ = 0;
+		gpuStats.textureCacheBytes = 0;
+		gpuStats.secondTextureCacheBytes = 0;
+		memset(gpuStats.textureBytesByFormat, 0, sizeof(gpuStats.textureBytesByFormat));
+	}
+	evictedKeys_.clear();
+	fbTexInfo_.clear();
+}
+
+// Frees the entry's texture, the caller removes it from the cache.
+void TextureCacheCommon::DeleteTexture(TexCacheEntry *entry) {
+	CancelDecode(entry);
+	FreeTexture(entry);
+	auto fbInfo = fbTexInfo_.find(entry->addr);
+	if (fbInfo != fbTexInfo_.end()) {
+		fbTexInfo_.erase(fbInfo);
+	}
+}
+
+void TextureCacheCommon::SetTextureBytes(TexCacheEntry &entry, u32 bytes) {
+	// Unsigned, so this works for shrinking too.
+	const u32 delta = bytes - entry.texBytes;
+	if (entry.status & TexCacheEntry::STATUS_SECOND_CACHE) {
+		secondCacheBytes_ += delta;
+	} else {
+		cacheBytes_ += delta;
+	}
+	gpuStats.textureBytesByFormat[entry.format & 0xF] += delta;
+	gpuStats.textureCacheBytes = cacheBytes_;
+	gpuStats.secondTextureCacheBytes = secondCacheBytes_;
+	entry.texBytes = bytes;
+}
+
+void TextureCacheCommon::FreeTexture(TexCacheEntry *entry) {
+	SetTextureBytes(*entry, 0);
+	ReleaseTexture(entry);
+}
+
+// Recounts both caches in debug builds, to catch totals that have drifted.
+void TextureCacheCommon::CheckTextureBytes() {
+#ifdef _DEBUG
+	u32 bytes = 0;
+	cache.ForEach([&](TexCacheEntry *entry) {
+		bytes += entry->texBytes;
+	});
+	_dbg_assert_msg_(G3D, bytes == cacheBytes_, "Texture cache counted %d bytes, has %d", cacheBytes_, bytes);
+	bytes = 0;
+	secondCache.ForEach([&](TexCacheEntry *entry) {
+		bytes += entry->texBytes;
+	});
+	_dbg_assert_msg_(G3D, bytes == secondCacheBytes_, "Second texture cache counted %d bytes, has %d", secondCacheBytes_, bytes);
+#endif
+}
+
+// The totals are u32, so budgets stop just short of 4 GB.
+static u32 BudgetBytes(int megabytes) {
+	return (u32)std::min(std::max(megabytes, 0), 4095) * 1024 * 1024;
+}
+
+void TextureCacheCommon::NoteEvicted(const TexCacheEntry *entry) {
+	gpuStats.numTextureEvictions++;
+	if (evictedKeys_.size() >= TEXCACHE_MAX_EVICTED_KEYS) {
+		evictedKeys_.clear();
+	}
+	evictedKeys_.insert(((u64)(entry->addr & 0x3FFFFFFF) << 32) | entry->cluthash);
+}
+
+void TextureCacheCommon::EvictToBudget(TexCacheMap &map, u32 &bytes, u32 budget, bool primary) {
+	if (budget == 0 || bytes <= budget) {
+		return;
+	}
+
+	// Oldest first.  Anything used this or the last frame is likely still needed, so it stays even over budget.
+	std::vector<std::pair<int, TexCacheEntry *>> lastUses;
+	map.ForEach([&](TexCacheEntry *entry) {
+		if (entry->texturePtr && entry->lastFrame + 1 < gpuStats.numFlips) {
+			lastUses.push_back(std::make_pair(entry->lastFrame, entry));
+		}
+	});
+	std::sort(lastUses.begin(), lastUses.end());
+
+	const u32 target = budget - budget / TEXCACHE_BUDGET_SLACK_DIVISOR;
+	u32 remaining = bytes;
+	std::unordered_set<TexCacheEntry *> evict;
+	for (size_t i = 0; i < lastUses.size() && remaining > target; ++i) {
+		remaining -= lastUses[i].second->texBytes;
+		evict.insert(lastUses[i].second);
+	}
+	if (evict.empty()) {
+		return;
+	}
+
+	Unbind();
+	map.EraseIf([&](TexCacheEntry *entry) {
+		if (evict.find(entry) == evict.end()) {
+			return false;
+		}
+		if (primary) {
+			NoteEvicted(entry);
+			DeleteTexture(entry);
+		} else {
+			gpuStats.numTextureEvictions++;
+			FreeTexture(entry);
+		}
+		return true;
+	});
+
+	VERBOSE_LOG(G3D, "Evicted %d textures, now %d bytes with a budget of %d", (int)evict.size(), bytes, budget);
+}
+
+// Removes old textures, and any that don't fit the budgets.
+void TextureCacheCommon::Decimate() {
+	CheckTextureBytes();
+
+	u32 budget = BudgetBytes(g_Config.iTextureCacheBudgetMB);
+	if (lowMemoryMode_) {
+		if (lowMemoryBudget_ == 0) {
+			lowMemoryBudget_ = std::max(cacheBytes_ - cacheBytes_ / 4, (u32)TEXCACHE_MIN_PRESSURE);
+			WARN_LOG(G3D, "Out of texture memory, keeping textures under %d KB", lowMemoryBudget_ / 1024);
+		}
+		if (budget == 0 || lowMemoryBudget_ < budget) {
+			budget = lowMemoryBudget_;
+		}
+	}
+	EvictToBudget(cache, cacheBytes_, budget, true);
+	EvictToBudget(secondCache, secondCacheBytes_, BudgetBytes(g_Config.iTextureSecondCacheBudgetMB), false);
+
+	if (--decimationCounter_ <= 0) {
+		decimationCounter_ = TEXCACHE_DECIMATION_INTERVAL;
+	} else {
+		return;
+	}
+
+	if (cacheBytes_ >= TEXCACHE_MIN_PRESSURE) {
+		const u32 had = cacheBytes_;
+
+		Unbind();
+		int killAge = lowMemoryMode_ ? TEXTURE_KILL_AGE_LOWMEM : TEXTURE_KILL_AGE;
+		cache.EraseIf([&](TexCacheEntry *entry) {
+			if (entry->lastFrame + killAge < gpuStats.numFlips) {
+				NoteEvicted(entry);
+				DeleteTexture(entry);
+				return true;
+			}
+			return false;
+		});
+
+		VERBOSE_LOG(G3D, "Decimated texture cache, saved %d bytes - now %d bytes", had - cacheBytes_, cacheBytes_);
+	}
+
+	if (g_Config.bTextureSecondaryCache && secondCacheBytes_ >= TEXCACHE_SECOND_MIN_PRESSURE) {
+		const u32 had = secondCacheBytes_;
+
+		secondCache.EraseIf([&](TexCacheEntry *entry) {
+			// In low memory mode, we kill them all.
+			if (lowMemoryMode_ || entry->lastFrame + TEXTURE_SECOND_KILL_AGE < gpuStats.numFlips) {
+				gpuStats.numTextureEvictions++;
+				FreeTexture(entry);
+				return true;
+			}
+			return false;
+		});
+
+		VERBOSE_LOG(G3D, "Decimated second texture cache, saved %d bytes - now %d bytes", had - secondCacheBytes_, secondCacheBytes_);
+	}
+}
+
+void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type) {
+	// If we're hashing every use, without backoff, then this isn't needed.
+	if (!g_Config.bTextureBackoffCache) {
+		return;
+	}
+
+	addr &= 0x3FFFFFFF;
+	const u32 addr_end = addr + size;
+
+	// Only entries listed under the pages of the range can overlap it.
+	cache.ForEachOverlapping(addr, addr_end, [&](TexCacheEntry *entry) {
+		gpuStats.numTextureInvalidationChecks++;
+		u32 texAddr = entry->addr;
+		u32 texEnd = entry->addr + entry->sizeInRAM;
+
+		if (texAddr < addr_end && addr < texEnd) {
+			if (entry->GetHashStatus() == TexCacheEntry::STATUS_RELIABLE) {
+				entry->SetHashStatus(TexCacheEntry::STATUS_HASHING);
+			}
+			if (type != GPU_INVALIDATE_ALL) {
+				gpuStats.numTextureInvalidations++;
+				// Start it over from 0 (unless it's safe.)
+				entry->numFrames = type == GPU_INVALIDATE_SAFE ? 256 : 0;
+				entry->framesUntilNextFullHash = 0;
+			} else if (!entry->framebuffer) {
+				entry->invalidHint++;
+			}
+		}
+	});
+}
+
+void TextureCacheCommon::InvalidateAll(GPUInvalidationType /*unused*/) {
+	// If we're hashing every use, without backoff, then this isn't needed.
+	if (!g_Config.bTextureBackoffCache) {
+		return;
+	}
+
+	if (timesInvalidatedAllThisFrame_ > 5) {
+		return;
+	}
+	timesInvalidatedAllThisFrame_++;
+
+	cache.ForEach([](TexCacheEntry *entry) {
+		if (entry->GetHashStatus() == TexCacheEntry::STATUS_RELIABLE) {
+			entry->SetHashStatus(TexCacheEntry::STATUS_HASHING);
+		}
+		if (!entry->framebuffer) {
+			entry->invalidHint++;
+		}
+	});
+}
+
+void TextureCacheCommon::ClearNextFrame() {
+	clearCacheNextFrame_ = true;
+}
+
+void TextureCacheCommon::StartFrame() {
+	InvalidateLastTexture();
+	timesInvalidatedAllThisFrame_ = 0;
+
+	texelsScaledThisFrame_ = 0;
+	texelsDecodedThisFrame_ = 0;
+	if (clearCacheNextFrame_) {
+		Clear(true);
+		clearCacheNextFrame_ = false;
+	} else {
+		Decimate();
+	}
+}
+
+void TextureCacheCommon::AttachFramebufferValid(TexCacheEntry *entry, VirtualFramebuffer *framebuffer, const AttachedFramebufferInfo &fbInfo) {
+	const bool hasInvalidFramebuffer = entry->framebuffer == nullptr || entry->invalidHint == -1;
+	const bool hasOlderFramebuffer = entry->framebuffer != nullptr && entry->framebuffer->last_frame_render < framebuffer->last_frame_render;
+	bool hasFartherFramebuffer = false;
+	if (!hasInvalidFramebuffer && !hasOlderFramebuffer) {
+		// If it's valid, but the offset is greater, then we still win.
+		if (fbTexInfo_[entry->addr].yOffset == fbInfo.yOffset)
+			hasFartherFramebuffer = fbTexInfo_[entry->addr].xOffset > fbInfo.xOffset;
+		else
+			hasFartherFramebuffer = fbTexInfo_[entry->addr].yOffset > fbInfo.yOffset;
+	}
+	if (hasInvalidFramebuffer || hasOlderFramebuffer || hasFartherFramebuffer) {
+		entry->framebuffer = framebuffer;
+		entry->invalidHint = 0;
+		entry->status &= ~TexCacheEntry::STATUS_DEPALETTIZE;
+		entry->maxLevel = 0;
+		fbTexInfo_[entry->addr] = fbInfo;
+		framebuffer->last_frame_attached = gpuStats.numFlips;
+		host->GPUNotifyTextureAttachment(entry->addr);
+	} else if (entry->framebuffer == framebuffer) {
+		framebuffer->last_frame_attached = gpuStats.numFlips;
+	}
+}
+
+void TextureCacheCommon::AttachFramebufferInvalid(TexCacheEntry *entry, VirtualFramebuffer *framebuffer, const AttachedFramebufferInfo &fbInfo) {
+	if (entry->framebuffer == nullptr || entry->framebuffer == framebuffer) {
+		entry->framebuffer = framebuffer;
+		entry->invalidHint = -1;
+		entry->status &= ~TexCacheEntry::STATUS_DEPALETTIZE;
+		entry->maxLevel = 0;
+		fbTexInfo_[entry->addr] = fbInfo;
+		host->GPUNotifyTextureAttachment(entry->addr);
+	}
+}
+
+bool TextureCacheCommon::AttachFramebuffer(TexCacheEntry *entry, u32 address, VirtualFramebuffer *framebuffer, u32 texaddrOffset) {
+	static const u32 MAX_SUBAREA_Y_OFFSET_SAFE = 32;
+
+	AttachedFramebufferInfo fbInfo = {0};
+
+	const u64 mirrorMask = 0x00600000;
+	// Must be in VRAM so | 0x04000000 it is.  Also, ignore memory mirrors.
+	const u32 addr = (address | 0x04000000) & 0x3FFFFFFF & ~mirrorMask;
+	const u32 texaddr = ((entry->addr + texaddrOffset) & ~mirrorMask);
+	const bool noOffset = texaddr == addr;
+	const bool exactMatch = noOffset && entry->format < 4;
+	const u32 h = 1 << ((entry->dim >> 8) & 0xf);
+	// 512 on a 272 framebuffer is sane, so let's be lenient.
+	const u32 minSubareaHeight = h / 4;
+
+	// If they match exactly, it's non-CLUT and from the top left.
+	if (exactMatch) {
+		// Apply to non-buffered and buffered mode only.
+		if (!(g_Config.iRenderingMode == FB_NON_BUFFERED_MODE || g_Config.iRenderingMode == FB_BUFFERED_MODE))
+			return false;
+
+		DEBUG_LOG(G3D, "Render to texture detected at %08x!", address);
+		if (framebuffer->fb_stride != entry->bufw) {
+			WARN_LOG_REPORT_ONCE(diffStrides1, G3D, "Render to texture with different strides %d != %d", entry->bufw, framebuffer->fb_stride);
+		}
+		if (entry->format != framebuffer->format) {
+			WARN_LOG_REPORT_ONCE(diffFormat1, G3D, "Render to texture with different formats %d != %d", entry->format, framebuffer->format);
+			// Let's avoid using it when we know the format is wrong.  May be a video/etc. updating memory.
+			// However, some games use a different format to clear the buffer.
+			if (framebuffer->last_frame_attached + 1 < gpuStats.numFlips) {
+				DetachFramebuffer(entry, address, framebuffer);
+			}
+		} else {
+			AttachFramebufferValid(entry, framebuffer, fbInfo);
+			return true;
+		}
+	} else {
+		// Apply to buffered mode only.
+		if (!(g_Config.iRenderingMode == FB_BUFFERED_MODE))
+			return false;
+
+		const bool clutFormat =
+			(framebuffer->format == GE_FORMAT_8888 && entry->format == GE_TFMT_CLUT32) ||
+			(framebuffer->format != GE_FORMAT_8888 && entry->format == GE_TFMT_CLUT16);
+
+		const u32 bitOffset = (texaddr - addr) * 8;
+		const u32 pixelOffset = bitOffset / std::max(1U, (u32)textureBitsPerPixel[entry->format]);
+		fbInfo.yOffset = pixelOffset / entry->bufw;
+		fbInfo.xOffset = pixelOffset % entry->bufw;
+
+		if (framebuffer->fb_stride != entry->bufw) {
+			if (noOffset) {
+				WARN_LOG_REPORT_ONCE(diffStrides2, G3D, "Render to texture using CLUT with different strides %d != %d", entry->bufw, framebuffer->fb_stride);
+			} else {
+				// Assume any render-to-tex with different bufw + offset is a render from ram.
+				DetachFramebuffer(entry, address, framebuffer);
+				return false;
+			}
+		}
+
+		if (fbInfo.yOffset + minSubareaHeight >= framebuffer->height) {
+			// Can't be inside the framebuffer then, ram.  Detach to be safe.
+			DetachFramebuffer(entry, address, framebuffer);
+			return false;
+		}
+		// Trying to play it safe.  Below 0x04110000 is almost always framebuffers.
+		// TODO: Maybe we can reduce this check and find a better way above 0x04110000?
+		if (fbInfo.yOffset > MAX_SUBAREA_Y_OFFSET_SAFE && addr > 0x04110000) {
+			WARN_LOG_REPORT_ONCE(subareaIgnored, G3D, "Ignoring possible render to texture at %08x +%dx%d / %dx%d", address, fbInfo.xOffset, fbInfo.yOffset, framebuffer->width, framebuffer->height);
+			DetachFramebuffer(entry, address, framebuffer);
+			return false;
+		}
+
+		// Check for CLUT. The framebuffer is always RGB, but it can be interpreted as a CLUT texture.
+		// 3rd Birthday (and a bunch of other games) render to a 16 bit clut texture.
+		if (clutFormat) {
+			if (!noOffset) {
+				WARN_LOG_REPORT_ONCE(subareaClut, G3D, "Render to texture using CLUT with offset at %08x +%dx%d", address, fbInfo.xOffset, fbInfo.yOffset);
+			}
+			AttachFramebufferValid(entry, framebuffer, fbInfo);
+			entry->status |= TexCacheEntry::STATUS_DEPALETTIZE;
+			// We'll validate it compiles later.
+			return true;
+		} else if (entry->format == GE_TFMT_CLUT8 || entry->format == GE_TFMT_CLUT4) {
+			ERROR_LOG_REPORT_ONCE(fourEightBit, G3D, "4 and 8-bit CLUT format not supported for framebuffers");
+		}
+
+		// This is either normal or we failed to generate a shader to depalettize
+		if (framebuffer->format == entry->format || clutFormat) {
+			if (framebuffer->format != entry->format) {
+				WARN_LOG_REPORT_ONCE(diffFormat2, G3D, "Render to texture with different formats %d != %d at %08x", entry->format, framebuffer->format, address);
+				AttachFramebufferValid(entry, framebuffer, fbInfo);
+				return true;
+			} else {
+				WARN_LOG_REPORT_ONCE(subarea, G3D, "Render to area containing texture at %08x +%dx%d", address, fbInfo.xOffset, fbInfo.yOffset);
+				// If "AttachFramebufferValid" ,  God of War Ghost of Sparta/Chains of Olympus will be missing special effect.
+				AttachFramebufferInvalid(entry, framebuffer, fbInfo);
+				return true;
+			}
+		} else {
+			WARN_LOG_REPORT_ONCE(diffFormat2, G3D, "Render to texture with incompatible formats %d != %d at %08x", entry->format, framebuffer->format, address);
+		}
+	}
+
+	return false;
+}
+
+void TextureCacheCommon::DetachFramebuffer(TexCacheEntry *entry, u32 address, VirtualFramebuffer *framebuffer) {
+	if (entry->framebuffer == framebuffer) {
+		entry->framebuffer = 0;
+		host->GPUNotifyTextureAttachment(entry->addr);
+	}
+}
+
+void TextureCacheCommon::NotifyFramebuffer(u32 address, VirtualFramebuffer *framebuffer, FramebufferNotification msg) {
+	// Must be in VRAM so | 0x04000000 it is.  Also, ignore memory mirrors.
+	// These checks are mainly to reduce scanning all textures.
+	const u32 addr = (address | 0x04000000) & 0x3F9FFFFF;
+	const u32 bpp = framebuffer->format == GE_FORMAT_8888 ? 4 : 2;
+	// If it's a subsample of the buffer, it'll start within the FBO.
+	const u32 addrEnd = addr + framebuffer->fb_stride * framebuffer->height * bpp;
+
+	// The first mirror starts at 0x04200000 and there are 3.  We search all for framebuffers.
+	const u32 mirrorAddr = 0x04200000;
+	const u32 mirrorAddrEnd = 0x04800000;
+
+	switch (msg) {
+	case NOTIFY_FB_CREATED:
+	case NOTIFY_FB_UPDATED:
+		{
+			// Ensure it's in the framebuffer cache.
+			if (std::find(fbCache_.begin(), fbCache_.end(), framebuffer) == fbCache_.end()) {
+				fbCache_.push_back(framebuffer);
+			}
+			auto attach = [&](TexCacheEntry *entry) {
+				gpuStats.numTextureInvalidationChecks++;
+				AttachFramebuffer(entry, addr, framebuffer);
+			};
+			cache.ForEachStartingIn(addr, addrEnd, attach);
+			// Let's assume anything in mirrors is fair game to check.
+			cache.ForEachStartingIn(mirrorAddr, mirrorAddrEnd, attach);
+		}
+		break;
+
+	case NOTIFY_FB_DESTROYED:
+		{
+			fbCache_.erase(std::remove(fbCache_.begin(), fbCache_.end(),  framebuffer), fbCache_.end());
+			auto detach = [&](TexCacheEntry *entry) {
+				gpuStats.numTextureInvalidationChecks++;
+				DetachFramebuffer(entry, addr, framebuffer);
+			};
+			cache.ForEachStartingIn(addr, addrEnd, detach);
+			cache.ForEachStartingIn(mirrorAddr, mirrorAddrEnd, detach);
+		}
+		break;
+	}
+}
+
+void TextureCacheCommon::LoadClut() {
+	u32 clutAddr = gstate.getClutAddress();
+	if (Memory::IsValidAddress(clutAddr)) {
+#ifdef _M_SSE
+		int numBlocks = gstate.getClutLoadBlocks();
+		clutTotalBytes_ = numBlocks * 32;
+		const __m128i *source = (const __m128i *)Memory::GetPointerUnchecked(clutAddr);
+		__m128i *dest = (__m128i *)clutBufRaw_;
+		for (int i = 0; i < numBlocks; i++, source += 2, dest += 2) {
+			__m128i data1 = _mm_loadu_si128(source);
+			__m128i data2 = _mm_loadu_si128(source + 1);
+			_mm_store_si128(dest, data1);
+			_mm_store_si128(dest + 1, data2);
+		}
+#else
+		clutTotalBytes_ = gstate.getClutLoadBytes();
+		Memory::MemcpyUnchecked(clutBufRaw_, clutAddr, clutTotalBytes_);
+#endif
+	} else {
+		clutTotalBytes_ = gstate.getClutLoadBytes();
+		memset(clutBufRaw_, 0xFF, clutTotalBytes_);
+	}
+	// Reload the clut next time.
+	clutLastFormat_ = 0xFFFFFFFF;
+	clutMaxBytes_ = std::max(clutMaxBytes_, clutTotalBytes_);
+}
+
+void TextureCacheCommon::UpdateCurrentClut() {
+	const GEPaletteFormat clutFormat = gstate.getClutPaletteFormat();
+	const u32 clutBase = gstate.getClutIndexStartPos();
+	const u32 clutBaseBytes = clutBase * (clutFormat == GE_CMODE_32BIT_ABGR8888 ? sizeof(u32) : sizeof(u16));
+	// Technically, these extra bytes weren't loaded, but hopefully it was loaded earlier.
+	// If not, we're going to hash random data, which hopefully doesn't cause a performance issue.
+	const u32 clutExtendedBytes = clutTotalBytes_ + clutBaseBytes;
+
+	clutHash_ = DoReliableHash32((const char *)clutBufRaw_, clutExtendedBytes, 0xC0108888);
+	clutContentHash_ = XXH64(clutBufRaw_, clutExtendedBytes, 0xC0108888);
+
+	// Avoid a copy when we don't need to convert colors.
+	const u32 clutDstFmt = GetDestFormat(GE_TFMT_CLUT32, clutFormat);
+	if (ConvertsColors(clutDstFmt)) {
+		const int numColors = (clutMaxBytes_ + clutBaseBytes) / (clutFormat == GE_CMODE_32BIT_ABGR8888 ? sizeof(u32) : sizeof(u16));
+		ConvertColors(clutBufConverted_, clutBufRaw_, clutDstFmt, numColors);
+		clutBuf_ = clutBufConverted_;
+	} else {
+		clutBuf_ = clutBufRaw_;
+	}
+
+	// Special optimization: fonts typically draw clut4 with just alpha values in a single color.
+	clutAlphaLinear_ = false;
+	clutAlphaLinearColor_ = 0;
+	if (clutFormat == GE_CMODE_16BIT_ABGR4444 && gstate.isClutIndexSimple()) {
+		// Check the PSP's colors, where alpha is always the top 4 bits.
+		const u16_le *clut = (const u16_le *)clutBufRaw_;
+		const u16 color = clut[15] & 0x0FFF;
+		clutAlphaLinear_ = true;
+		for (int i = 0; i < 16; ++i) {
+			if ((clut[i] >> 12) != i) {
+				clutAlphaLinear_ = false;
+				break;
+			}
+			// Alpha 0 doesn't matter.
+			// TODO: Well, depending on blend mode etc, it can actually matter, although unlikely.
+			if (i != 0 && (clut[i] & 0x0FFF) != color) {
+				clutAlphaLinear_ = false;
+				break;
+			}
+		}
+
+		if (clutAlphaLinear_) {
+			// Then see where the backend's format wants the color and the alpha.
+			const u32 colorAndAlpha = 0xF0000000 | color;
+			u32 converted = colorAndAlpha;
+			ConvertColors(&converted, &colorAndAlpha, clutDstFmt, 2);
+			clutAlphaLinearColor_ = (u16)(converted & 0xFFFF);
+			clutAlphaLinearHigh_ = (converted >> 16) == 0xF000;
+		}
+	}
+
+	clutLastFormat_ = gstate.clutformat;
+}
+
+static inline u32 MiniHash(const u32 *ptr) {
+	return ptr[0];
+}
+
+static inline u32 QuickTexHash(u32 addr, int bufw, int w, int h, GETextureFormat format) {
+	const u32 sizeInRAM = (textureBitsPerPixel[format] * bufw * h) / 8;
+	const u32 *checkp = (const u32 *) Memory::GetPointer(addr);
+
+	return DoQuickTexHash(checkp, sizeInRAM);
+}
+
+// Scaled textures on disk outlive the session and may be read on another CPU, so fullhash won't do:
+// it's only 32 bits, and DoQuickTexHash differs between SSE2 and AVX2.
+static inline u64 ContentTexHash(u32 addr, int bufw, int h, GETextureFormat format, u64 clutHash) {
+	const u32 sizeInRAM = (textureBitsPerPixel[format] * bufw * h) / 8;
+	return XXH64(Memory::GetPointer(addr), sizeInRAM, clutHash);
+}
 
 bool TextureCacheCommon::SetOffsetTexture(u32 offset) {
+	if (g_Config.iRenderingMode != FB_BUFFERED_MODE) {
+		return false;
+	}
+	u32 texaddr = gstate.getTextureAddress(0);
+	if (!Memory::IsValidAddress(texaddr) || !Memory::IsValidAddress(texaddr + offset)) {
+		return false;
+	}
+
+	u64 cachekey = (u64)(texaddr & 0x3FFFFFFF) << 32;
+	TexCacheEntry *entry = cache.Find(cachekey);
+	if (!entry) {
+		return false;
+	}
+
+	bool success = false;
+	for (size_t i = 0, n = fbCache_.size(); i < n; ++i) {
+		auto framebuffer = fbCache_[i];
+		if (AttachFramebuffer(entry, framebuffer->fb_address, framebuffer, offset)) {
+			success = true;
+		}
+	}
+
+	if (success && entry->framebuffer) {
+		SetTextureFramebuffer(entry, entry->framebuffer);
+		InvalidateLastTexture();
+		entry->lastFrame = gpuStats.numFlips;
+		return true;
+	}
+
 	return false;
 }
+
+// #define DEBUG_TEXTURES
+
+// Highlights one texture at a time, each for highlightFrames frames.
+bool TextureCacheCommon::SetDebugTexture() {
+	static const int highlightFrames = 30;
+
+	static int numTextures = 0;
+	static int lastFrames = 0;
+	static int mostTextures = 1;
+
+	if (lastFrames != gpuStats.numFlips) {
+		mostTextures = std::max(mostTextures, numTextures);
+		numTextures = 0;
+		lastFrames = gpuStats.numFlips;
+	}
+
+	bool changed = false;
+	if (((gpuStats.numFlips / highlightFrames) % mostTextures) == numTextures) {
+		if (gpuStats.numFlips % highlightFrames == 0) {
+			NOTICE_LOG(G3D, "Highlighting texture # %d / %d", numTextures, mostTextures);
+		}
+		BindDebugTexture();
+		changed = true;
+	}
+
+	++numTextures;
+	return changed;
+}
+
+void TextureCacheCommon::SetTexture(bool force) {
+#ifdef DEBUG_TEXTURES
+	if (SetDebugTexture()) {
+		// A different texture was bound, let's rebind next time.
+		InvalidateLastTexture();
+		return;
+	}
+#endif
+
+	if (force) {
+		InvalidateLastTexture();
+	}
+
+	u32 texaddr = gstate.getTextureAddress(0);
+	if (!Memory::IsValidAddress(texaddr)) {
+		// Bind a null texture and return.
+		Unbind();
+		return;
+	}
+
+	int w = gstate.getTextureWidth(0);
+	int h = gstate.getTextureHeight(0);
+
+	GETextureFormat format = gstate.getTextureFormat();
+	if (format >= 11) {
+		ERROR_LOG_REPORT(G3D, "Unknown texture format %i", format);
+		// TODO: Better assumption?
+		format = GE_TFMT_5650;
+	}
+	bool hasClut = gstate.isTextureFormatIndexed();
+
+	// Ignore uncached/kernel when caching.
+	u64 cachekey = (u64)(texaddr & 0x3FFFFFFF) << 32;
+	u32 cluthash;
+	if (hasClut) {
+		if (clutLastFormat_ != gstate.clutformat) {
+			// We update here because the clut format can be specified after the load.
+			UpdateCurrentClut();
+		}
+		cluthash = GetCurrentClutHash() ^ gstate.clutformat;
+		cachekey |= cluthash;
+	} else {
+		cluthash = 0;
+	}
+
+	int bufw = GetTextureBufw(0, texaddr, format);
+	int maxLevel = gstate.getTextureMaxLevel();
+
+	u32 texhash = MiniHash((const u32 *)Memory::GetPointerUnchecked(texaddr));
+	u32 fullhash = 0;
+
+	TexCacheEntry *entry = cache.Find(cachekey);
+	gstate_c.flipTexture = false;
+	gstate_c.needShaderTexClamp = false;
+	gstate_c.skipDrawReason &= ~SKIPDRAW_BAD_FB_TEXTURE;
+	bool replaceImages = false;
+	bool releaseOld = false;
+
+	if (entry) {
+		// Validate the texture still matches the cache entry.
+		u16 dim = gstate.getTextureDimension(0);
+		bool match = entry->Matches(dim, format, maxLevel);
+
+		// Check for FBO - slow!
+		if (entry->framebuffer) {
+			if (match) {
+				SetTextureFramebuffer(entry, entry->framebuffer);
+				InvalidateLastTexture();
+				entry->lastFrame = gpuStats.numFlips;
+				return;
+			} else {
+				// Make sure we re-evaluate framebuffers.
+				DetachFramebuffer(entry, texaddr, entry->framebuffer);
+				match = false;
+			}
+		}
+
+		bool rehash = entry->GetHashStatus() == TexCacheEntry::STATUS_UNRELIABLE;
+		bool doDelete = true;
+
+		// First let's see if another texture with the same address had a hashfail.
+		if (entry->status & TexCacheEntry::STATUS_CLUT_RECHECK) {
+			// Always rehash in this case, if one changed the rest all probably did.
+			rehash = true;
+			entry->status &= ~TexCacheEntry::STATUS_CLUT_RECHECK;
+		} else if ((gstate_c.textureChanged & TEXCHANGE_UPDATED) == 0) {
+			// Okay, just some parameter change - the data didn't change, no need to rehash.
+			rehash = false;
+		}
+
+		if (match) {
+			if (entry->lastFrame != gpuStats.numFlips) {
+				u32 diff = gpuStats.numFlips - entry->lastFrame;
+				entry->numFrames++;
+
+				if (entry->framesUntilNextFullHash < diff) {
+					// Exponential backoff up to 512 frames.  Textures are often reused.
+					if (entry->numFrames > 32) {
+						// Also, try to add some "randomness" to avoid rehashing several textures the same frame.
+						entry->framesUntilNextFullHash = std::min(512, entry->numFrames) + (entry->fullhash & 15);
+					} else {
+						entry->framesUntilNextFullHash = entry->numFrames;
+					}
+					rehash = true;
+				} else {
+					entry->framesUntilNextFullHash -= diff;
+				}
+			}
+
+			// If it's not huge or has been invalidated many times, recheck the whole texture.
+			if (entry->invalidHint > 180 || (entry->invalidHint > 15 && (dim >> 8) < 9 && (dim & 0xF) < 9)) {
+				entry->invalidHint = 0;
+				rehash = true;
+			}
+
+			bool hashFail = false;
+			if (texhash != entry->hash) {
+				fullhash = QuickTexHash(texaddr, bufw, w, h, format);
+				hashFail = true;
+				rehash = false;
+			}
+
+			if (rehash && entry->GetHashStatus() != TexCacheEntry::STATUS_RELIABLE) {
+				fullhash = QuickTexHash(texaddr, bufw, w, h, format);
+				if (fullhash != entry->fullhash) {
+					hashFail = true;
+				} else if (entry->GetHashStatus() != TexCacheEntry::STATUS_HASHING && entry->numFrames > TexCacheEntry::FRAMES_REGAIN_TRUST) {
+					// Reset to STATUS_HASHING.
+					if (g_Config.bTextureBackoffCache) {
+						entry->SetHashStatus(TexCacheEntry::STATUS_HASHING);
+					}
+					entry->status &= ~TexCacheEntry::STATUS_CHANGE_FREQUENT;
+				}
+			}
+
+			if (hashFail) {
+				match = false;
+				entry->status |= TexCacheEntry::STATUS_UNRELIABLE;
+				if (entry->numFrames < TEXCACHE_FRAME_CHANGE_FREQUENT) {
+					entry->status |= TexCacheEntry::STATUS_CHANGE_FREQUENT;
+				}
+				entry->numFrames = 0;
+
+				// Don't give up just yet.  Let's try the secondary cache if it's been invalidated before.
+				// If it's failed a bunch of times, then the second cache is just wasting time and VRAM.
+				// If it's still decoding, its texture doesn't match its hash, so leave the second cache alone.
+				if (g_Config.bTextureSecondaryCache && (entry->status & TexCacheEntry::STATUS_DECODING) == 0) {
+					if (entry->numInvalidated > 2 && entry->numInvalidated < 128 && !lowMemoryMode_) {
+						u64 secondKey = fullhash | (u64)cluthash << 32;
+						TexCacheEntry *secondEntry = secondCache.Find(secondKey);
+						if (secondEntry) {
+							if (secondEntry->Matches(dim, format, maxLevel)) {
+								// Reset the numInvalidated value lower, we got a match.
+								if (entry->numInvalidated > 8) {
+									--entry->numInvalidated;
+								}
+								entry = secondEntry;
+								match = true;
+							}
+						} else {
+							secondKey = entry->fullhash | ((u64)entry->cluthash << 32);
+							const u32 bytes = entry->texBytes;
+							SetTextureBytes(*entry, 0);
+							TexCacheEntry *moved = secondCache.Insert(secondKey, *entry);
+							moved->status |= TexCacheEntry::STATUS_SECOND_CACHE;
+							SetTextureBytes(*moved, bytes);
+							// The second cache owns the texture now, this entry will get a new one.
+							entry->texturePtr = nullptr;
+							doDelete = false;
+						}
+					}
+				}
+			}
+		}
+
+		if (match && (entry->status & TexCacheEntry::STATUS_TO_SCALE) && g_Config.iTexScalingLevel != 1 && texelsScaledThisFrame_ < TEXCACHE_MAX_TEXELS_SCALED) {
+			// INFO_LOG(G3D, "Reloading texture to do the scaling we skipped..");
+			match = false;
+		}
+
+		if (match) {
+			// TODO: Mark the entry reliable if it's been safe for long enough?
+			//got one!
+			entry->lastFrame = gpuStats.numFlips;
+			if (entry->status & TexCacheEntry::STATUS_DECODING) {
+				FinishDecode(entry);
+				return;
+			}
+			BindTexture(entry);
+			VERBOSE_LOG(G3D, "Texture at %08x Found in Cache, applying", texaddr);
+			return; //Done!
+		} else {
+			entry->numInvalidated++;
+			gpuStats.numTextureInvalidations++;
+			DEBUG_LOG(G3D, "Texture different or overwritten, reloading at %08x", texaddr);
+			// A cancelled decode may leave a texture of some other size behind.
+			const bool oldSizeDiffers = (entry->status & TexCacheEntry::STATUS_DECODING) != 0 && CancelDecode(entry);
+			if (doDelete) {
+				if (!oldSizeDiffers && entry->maxLevel == maxLevel && entry->dim == gstate.getTextureDimension(0) && entry->format == format && g_Config.iTexScalingLevel == 1) {
+					// Actually, if size and number of levels match, let's try to avoid deleting and recreating.
+					// Instead, let's use glTexSubImage to replace the images.
+					replaceImages = true;
+				} else {
+					// Kept until the new one is built, in case that happens in the background.
+					releaseOld = true;
+				}
+			}
+			// Clear the reliable bit if set.
+			if (entry->GetHashStatus() == TexCacheEntry::STATUS_RELIABLE) {
+				entry->SetHashStatus(TexCacheEntry::STATUS_HASHING);
+			}
+
+			// Also, mark any textures with the same address but different clut.  They need rechecking.
+			if (cluthash != 0) {
+				const u32 keyAddr = texaddr & 0x3FFFFFFF;
+				cache.ForEachStartingIn(keyAddr, keyAddr + 1, [&](TexCacheEntry *other) {
+					if (other->cluthash != cluthash) {
+						other->status |= TexCacheEntry::STATUS_CLUT_RECHECK;
+					}
+				});
+			}
+		}
+	} else {
+		VERBOSE_LOG(G3D, "No texture in cache, decoding...");
+		TexCacheEntry entryNew = {0};
+		entry = cache.Insert(cachekey, entryNew);
+		if (evictedKeys_.erase(cachekey)) {
+			gpuStats.numTexturesRedecodedAfterEviction++;
+		}
+		if (g_Config.bTextureBackoffCache) {
+			entry->status = TexCacheEntry::STATUS_HASHING;
+		} else {
+			entry->status = TexCacheEntry::STATUS_UNRELIABLE;
+		}
+	}
+
+	if ((bufw == 0 || (gstate.texbufwidth[0] & 0xf800) != 0) && texaddr >= PSP_GetKernelMemoryEnd()) {
+		ERROR_LOG_REPORT(G3D, "Texture with unexpected bufw (full=%d)", gstate.texbufwidth[0] & 0xffff);
+	}
+
+	// We have to decode it, let's setup the cache entry first.
+	entry->addr = texaddr;
+	entry->hash = texhash;
+	// An old texture kept until the new one is built counts under the new format from now on.
+	gpuStats.textureBytesByFormat[entry->format & 0xF] -= entry->texBytes;
+	gpuStats.textureBytesByFormat[format & 0xF] += entry->texBytes;
+	entry->format = format;
+	entry->lastFrame = gpuStats.numFlips;
+	entry->framebuffer = 0;
+	entry->maxLevel = maxLevel;
+	entry->lodBias = 0.0f;
+
+	entry->dim = gstate.getTextureDimension(0);
+	entry->bufw = bufw;
+
+	// This would overestimate the size in many case so we underestimate instead
+	// to avoid excessive clearing caused by cache invalidations.
+	entry->sizeInRAM = (textureBitsPerPixel[format] * bufw * h / 2) / 8;
+	cache.SetRange(cachekey, texaddr & 0x3FFFFFFF, entry->sizeInRAM);
+
+	entry->fullhash = fullhash == 0 ? QuickTexHash(texaddr, bufw, w, h, format) : fullhash;
+	entry->cluthash = cluthash;
+	if (g_Config.iTexScalingLevel != 1) {
+		entry->contenthash = ContentTexHash(texaddr, bufw, h, format, hasClut ? clutContentHash_ : 0);
+	} else {
+		entry->contenthash = 0;
+	}
+
+	entry->status &= ~TexCacheEntry::STATUS_ALPHA_MASK;
+
+	gstate_c.curTextureWidth = w;
+	gstate_c.curTextureHeight = h;
+
+	// Before we go reading the texture from memory, let's check for render-to-texture.
+	for (size_t i = 0, n = fbCache_.size(); i < n; ++i) {
+		auto framebuffer = fbCache_[i];
+		AttachFramebuffer(entry, framebuffer->fb_address, framebuffer);
+	}
+
+	// If we ended up with a framebuffer, attach it - no texture decoding needed.
+	if (entry->framebuffer) {
+		if (releaseOld) {
+			FreeTexture(entry);
+		}
+		SetTextureFramebuffer(entry, entry->framebuffer);
+		InvalidateLastTexture();
+		entry->lastFrame = gpuStats.numFlips;
+		return;
+	}
+
+	if (DecodeInBackground(entry, replaceImages, releaseOld)) {
+		return;
+	}
+	if (releaseOld) {
+		FreeTexture(entry);
+	}
+	BuildTexture(entry, replaceImages);
+}
+
+bool TextureCacheCommon::DecodeInBackground(TexCacheEntry *entry, bool replaceImages, bool releaseOld) {
+	if (!g_Config.bBackgroundTextureDecode) {
+		return false;
+	}
+	// Animations want this frame's contents.
+	if (entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) {
+		return false;
+	}
+	// Only spikes go in the background, usually a frame decodes everything itself.
+	const int texels = gstate.getTextureWidth(0) * gstate.getTextureHeight(0);
+	if (texelsDecodedThisFrame_ + texels <= TEXCACHE_MAX_TEXELS_DECODED_SYNC) {
+		texelsDecodedThisFrame_ += texels;
+		return false;
+	}
+
+	StartDecodeWorkers();
+	if (decodeWorkers_.empty()) {
+		return false;
+	}
+
+	DecodeJob *job = new DecodeJob();
+	job->entry = entry;
+	job->replaceImages = replaceImages;
+	job->releaseOld = releaseOld;
+	job->done = false;
+	job->cancelled = false;
+	job->queuedTime = real_time_now();
+	job->doneTime = 0.0;
+	job->msDecoding = 0.0;
+	job->state = gstate;
+	// Only set once a CLUT has been loaded.
+	if (clutBuf_) {
+		memcpy(job->clut, clutBuf_, sizeof(job->clut));
+	}
+	job->clutAlphaLinear = clutAlphaLinear_;
+	job->clutAlphaLinearHigh = clutAlphaLinearHigh_;
+	job->clutAlphaLinearColor = clutAlphaLinearColor_;
+	job->format = GETextureFormat(entry->format);
+	job->clutFormat = gstate.getClutPaletteFormat();
+	job->dstFmt = GetDestFormat(job->format, job->clutFormat);
+
+	// Like the backends, stop at the first level pointing to nothing.
+	const int maxLevel = g_Config.bMipMap ? entry->maxLevel : 0;
+	job->numLevels = 0;
+	while (job->numLevels <= maxLevel && Memory::IsValidAddress(gstate.getTextureAddress(job->numLevels))) {
+		job->numLevels++;
+	}
+
+	// The alpha of whatever gets drawn meanwhile isn't known.
+	entry->status |= TexCacheEntry::STATUS_DECODING;
+	entry->SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
+	decodeJobs_[entry] = job;
+	{
+		lock_guard guard(decodeLock_);
+		decodeQueue_.push_back(job);
+		decodeWait_.notify_one();
+	}
+	gpuStats.numTextureDecodesQueued++;
+
+	FinishDecode(entry);
+	return true;
+}
+
+void TextureCacheCommon::FinishDecode(TexCacheEntry *entry) {
+	auto it = decodeJobs_.find(entry);
+	DecodeJob *job = it == decodeJobs_.end() ? nullptr : it->second;
+	bool done;
+	{
+		lock_guard guard(decodeLock_);
+		done = job && job->done;
+	}
+
+	if (!done) {
+		// Draw with the old texture until it's done, if it has one.
+		if (entry->texturePtr) {
+			BindTexture(entry);
+		} else {
+			Unbind();
+		}
+		return;
+	}
+
+	decodeJobs_.erase(it);
+	entry->status &= ~TexCacheEntry::STATUS_DECODING;
+
+	const double latency = (job->doneTime - job->queuedTime) * 1000.0;
+	gpuStats.numTextureDecodesFinished++;
+	gpuStats.msTextureDecodeLatency += latency;
+	gpuStats.msMaxTextureDecodeLatency = std::max(gpuStats.msMaxTextureDecodeLatency, latency);
+	gpuStats.msTextureDecodeByFormat[job->format & 0xF] += job->msDecoding;
+
+	if (job->releaseOld) {
+		FreeTexture(entry);
+	}
+	// DecodeTextureLevel() hands out the job's levels while this is set.
+	stagedJob_ = job;
+	BuildTexture(entry, job->replaceImages);
+	stagedJob_ = nullptr;
+	delete job;
+}
+
+bool TextureCacheCommon::CancelDecode(TexCacheEntry *entry) {
+	entry->status &= ~TexCacheEntry::STATUS_DECODING;
+	auto it = decodeJobs_.find(entry);
+	if (it == decodeJobs_.end()) {
+		return false;
+	}
+
+	DecodeJob *job = it->second;
+	const bool releaseOld = job->releaseOld;
+	decodeJobs_.erase(it);
+
+	lock_guard guard(decodeLock_);
+	auto queued = std::find(decodeQueue_.begin(), decodeQueue_.end(), job);
+	if (queued != decodeQueue_.end()) {
+		decodeQueue_.erase(queued);
+		delete job;
+	} else if (job->done) {
+		delete job;
+	} else {
+		// A worker has it, and deletes it when done.
+		job->cancelled = true;
+	}
+	return releaseOld;
+}
+
+void TextureCacheCommon::CancelAllDecodes() {
+	while (!decodeJobs_.empty()) {
+		CancelDecode(decodeJobs_.begin()->first);
+	}
+}
+
+void TextureCacheCommon::StartDecodeWorkers() {
+	lock_guard guard(decodeLock_);
+	if (decodeWorkersRunning_) {
+		return;
+	}
+
+	// Leave some cores to the emulator and the scaler.
+	const int count = std::min(4, g_Config.iNumWorkerThreads / 2);
+	if (count <= 0) {
+		return;
+	}
+	decodeWorkersRunning_ = true;
+	for (int i = 0; i < count; ++i) {
+		decodeWorkers_.push_back(new std::thread([this] { DecodeWorkerLoop(); }));
+	}
+}
+
+void TextureCacheCommon::StopDecodeWorkers() {
+	{
+		lock_guard guard(decodeLock_);
+		if (!decodeWorkersRunning_) {
+			return;
+		}
+		decodeWorkersRunning_ = false;
+		decodeWait_.notify_all();
+	}
+
+	for (std::thread *worker : decodeWorkers_) {
+		worker->join();
+		delete worker;
+	}
+	decodeWorkers_.clear();
+}
+
+void TextureCacheCommon::ShutdownDecodeWorkers() {
+	// Stopping waits for jobs the workers already hold, cancelled or not.
+	CancelAllDecodes();
+	StopDecodeWorkers();
+}
+
+void TextureCacheCommon::DecodeWorkerLoop() {
+	setCurrentThreadName("TexDecode");
+	TextureDecodeContext ctx;
+
+	lock_guard guard(decodeLock_);
+	while (true) {
+		if (decodeQueue_.empty()) {
+			if (!decodeWorkersRunning_) {
+				break;
+			}
+			decodeWait_.wait(decodeLock_);
+			continue;
+		}
+
+		DecodeJob *job = decodeQueue_.front();
+		decodeQueue_.pop_front();
+
+		decodeLock_.unlock();
+		RunDecodeJob(ctx, job);
+		decodeLock_.lock();
+
+		if (job->cancelled) {
+			delete job;
+		} else {
+			job->done = true;
+			job->doneTime = real_time_now();
+		}
+	}
+}
+
+void TextureCacheCommon::RunDecodeJob(TextureDecodeContext &ctx, DecodeJob *job) {
+	ctx.state = &job->state;
+	ctx.clut = job->clut;
+	ctx.clutAlphaLinear = job->clutAlphaLinear;
+	ctx.clutAlphaLinearHigh = job->clutAlphaLinearHigh;
+	ctx.clutAlphaLinearColor = job->clutAlphaLinearColor;
+
+	const double start = real_time_now();
+	for (int level = 0; level < job->numLevels; ++level) {
+		DecodeJob::Level &out = job->levels[level];
+		out.texByteAlign = 1;
+		u32 bytes = 0;
+		const u8 *data = (const u8 *)DecodeTextureLevel(ctx, job->format, job->clutFormat, level, out.texByteAlign, job->dstFmt, out.bufw, bytes);
+		if (!data) {
+			break;
+		}
+		// The result may point into PSP memory or ctx, so it needs a copy either way.
+		out.data.assign(data, data + bytes);
+	}
+	job->msDecoding = (real_time_now() - start) * 1000.0;
+}
+
+void *TextureCacheCommon::DecodeTextureLevel(GETextureFormat format, GEPaletteFormat clutformat, int level, u32 &texByteAlign, u32 dstFmt, int *bufwout) {
+	if (stagedJob_) {
+		if (level >= stagedJob_->numLevels || stagedJob_->levels[level].data.empty()) {
+			return NULL;
+		}
+		const DecodeJob::Level &staged = stagedJob_->levels[level];
+		texByteAlign = staged.texByteAlign;
+		if (bufwout)
+			*bufwout = staged.bufw;
+		return (void *)&staged.data[0];
+	}
+
+	decodeContext_.state = &gstate;
+	decodeContext_.clut = clutBuf_;
+	decodeContext_.clutAlphaLinear = clutAlphaLinear_;
+	decodeContext_.clutAlphaLinearHigh = clutAlphaLinearHigh_;
+	decodeContext_.clutAlphaLinearColor = clutAlphaLinearColor_;
+
+	int bufw = 0;
+	u32 bytes = 0;
+	const double start = real_time_now();
+	void *finalBuf = DecodeTextureLevel(decodeContext_, format, clutformat, level, texByteAlign, dstFmt, bufw, bytes);
+	gpuStats.msTextureDecodeByFormat[format & 0xF] += (real_time_now() - start) * 1000.0;
+	if (bufwout)
+		*bufwout = bufw;
+	return finalBuf;
+}
+
+bool TextureCacheCommon::OpenScaledTextureCache() {
+	if (g_Config.iScaledTextureCacheSizeMB <= 0) {
+		scaledDiskCache_.Close();
+		return false;
+	}
+
+	const std::string gameID = g_paramSFO.GetValueString("DISC_ID");
+	if (gameID.empty()) {
+		return false;
+	}
+	const std::string dir = GetSysDirectory(DIRECTORY_CACHE) + "textures/" + gameID + "/";
+	scaledDiskCache_.Open(dir, (u64)g_Config.iScaledTextureCacheSizeMB * 1024 * 1024);
+	return true;
+}
+
+ScaledTextureKey TextureCacheCommon::MakeScaledTextureKey(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor) const {
+	ScaledTextureKey key;
+	key.contenthash = entry.contenthash;
+	key.format = entry.format;
+	// Index shift, mask and offset matter too, not just the colors.
+	const bool clut = entry.format >= GE_TFMT_CLUT4 && entry.format <= GE_TFMT_CLUT32;
+	key.clutformat = clut ? (gstate.clutformat & 0xFFFFFF) : 0;
+	key.srcFmt = srcFmt;
+	key.width = w;
+	key.height = h;
+	key.scaler = g_Config.iTexScalingType;
+	key.factor = factor;
+	key.deposterize = g_Config.bTexDeposterize ? 1 : 0;
+	return key;
+}
+
+bool TextureCacheCommon::HasScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor) {
+	if (!OpenScaledTextureCache()) {
+		return false;
+	}
+	return scaledDiskCache_.Contains(MakeScaledTextureKey(entry, srcFmt, w, h, factor));
+}
+
+const u32 *TextureCacheCommon::LoadScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor) {
+	if (!OpenScaledTextureCache()) {
+		return nullptr;
+	}
+	if (!scaledDiskCache_.Lookup(MakeScaledTextureKey(entry, srcFmt, w, h, factor), scaledFromDisk_)) {
+		return nullptr;
+	}
+	return &scaledFromDisk_[0];
+}
+
+void TextureCacheCommon::SaveScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor, const u32 *scaled) {
+	if (OpenScaledTextureCache()) {
+		scaledDiskCache_.Store(MakeScaledTextureKey(entry, srcFmt, w, h, factor), scaled);
+	}
+}
+
+void *TextureCacheCommon::UnswizzleFromMem(TextureDecodeContext &ctx, const u8 *texptr, u32 bufw, u32 bytesPerPixel, u32 level) {
+	SimpleBuf<u32> &tmpTexBuf32 = ctx.tmpTexBuf32;
+	const u32 rowWidth = (bytesPerPixel > 0) ? (bufw * bytesPerPixel) : (bufw / 2);
+	const u32 pitch = rowWidth / 4;
+	const int bxc = rowWidth / 16;
+	int byc = (ctx.state->getTextureHeight(level) + 7) / 8;
+	if (byc == 0)
+		byc = 1;
+
+	u32 ydest = 0;
+	if (rowWidth >= 16) {
+		u32 *ydestp = tmpTexBuf32.data();
+		// The most common one, so it gets an optimized implementation.
+		DoUnswizzleTex16(texptr, ydestp, bxc, byc, pitch, rowWidth);
+	} else if (rowWidth == 8) {
+		const u32 *src = (const u32 *) texptr;
+		for (int by = 0; by < byc; by++) {
+			for (int n = 0; n < 8; n++, ydest += 2) {
+				tmpTexBuf32[ydest + 0] = *src++;
+				tmpTexBuf32[ydest + 1] = *src++;
+				src += 2; // skip two u32
+			}
+		}
+	} else if (rowWidth == 4) {
+		const u32 *src = (const u32 *) texptr;
+		for (int by = 0; by < byc; by++) {
+			for (int n = 0; n < 8; n++, ydest++) {
+				tmpTexBuf32[ydest] = *src++;
+				src += 3;
+			}
+		}
+	} else if (rowWidth == 2) {
+		const u16 *src = (const u16 *) texptr;
+		for (int by = 0; by < byc; by++) {
+			for (int n = 0; n < 4; n++, ydest++) {
+				u16 n1 = src[0];
+				u16 n2 = src[8];
+				tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 16);
+				src += 16;
+			}
+		}
+	} else if (rowWidth == 1) {
+		const u8 *src = (const u8 *) texptr;
+		for (int by = 0; by < byc; by++) {
+			for (int n = 0; n < 2; n++, ydest++) {
+				u8 n1 = src[ 0];
+				u8 n2 = src[16];
+				u8 n3 = src[32];
+				u8 n4 = src[48];
+				tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 8) | ((u32)n3 << 16) | ((u32)n4 << 24);
+				src += 64;
+			}
+		}
+	}
+	return tmpTexBuf32.data();
+}
+
+void *TextureCacheCommon::ReadIndexedTex(TextureDecodeContext &ctx, int level, const u8 *texptr, int bytesPerIndex, int bufw) {
+	const GPUgstate &state = *ctx.state;
+	SimpleBuf<u32> &tmpTexBuf32 = ctx.tmpTexBuf32;
+	SimpleBuf<u16> &tmpTexBuf16 = ctx.tmpTexBuf16;
+	SimpleBuf<u32> &tmpTexBufRearrange = ctx.tmpTexBufRearrange;
+	int w = state.getTextureWidth(level);
+	int h = state.getTextureHeight(level);
+	int length = bufw * h;
+	void *buf = NULL;
+	switch (state.getClutPaletteFormat()) {
+	case GE_CMODE_16BIT_BGR5650:
+	case GE_CMODE_16BIT_ABGR5551:
+	case GE_CMODE_16BIT_ABGR4444:
+		{
+		tmpTexBuf16.resize(std::max(bufw, w) * h);
+		tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+		const u16 *clut = (const u16 *)ctx.clut;
+		if (!state.isTextureSwizzled()) {
+			switch (bytesPerIndex) {
+			case 1:
+				DeIndexTexture(tmpTexBuf16.data(), (const u8 *)texptr, length, clut, state);
+				break;
+
+			case 2:
+				DeIndexTexture(tmpTexBuf16.data(), (const u16_le *)texptr, length, clut, state);
+				break;
+
+			case 4:
+				DeIndexTexture(tmpTexBuf16.data(), (const u32_le *)texptr, length, clut, state);
+				break;
+			}
+		} else {
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			UnswizzleFromMem(ctx, texptr, bufw, bytesPerIndex, level);
+			switch (bytesPerIndex) {
+			case 1:
+				DeIndexTexture(tmpTexBuf16.data(), (u8 *) tmpTexBuf32.data(), length, clut, state);
+				break;
+
+			case 2:
+				DeIndexTexture(tmpTexBuf16.data(), (u16 *) tmpTexBuf32.data(), length, clut, state);
+				break;
+
+			case 4:
+				DeIndexTexture(tmpTexBuf16.data(), (u32 *) tmpTexBuf32.data(), length, clut, state);
+				break;
+			}
+		}
+		buf = tmpTexBuf16.data();
+		}
+		break;
+
+	case GE_CMODE_32BIT_ABGR8888:
+		{
+		tmpTexBuf32.resize(std::max(bufw, w) * h);
+		tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+		const u32 *clut = (const u32 *)ctx.clut;
+		if (!state.isTextureSwizzled()) {
+			switch (bytesPerIndex) {
+			case 1:
+				DeIndexTexture(tmpTexBuf32.data(), (const u8 *)texptr, length, clut, state);
+				break;
+
+			case 2:
+				DeIndexTexture(tmpTexBuf32.data(), (const u16_le *)texptr, length, clut, state);
+				break;
+
+			case 4:
+				DeIndexTexture(tmpTexBuf32.data(), (const u32_le *)texptr, length, clut, state);
+				break;
+			}
+			buf = tmpTexBuf32.data();
+		} else {
+			UnswizzleFromMem(ctx, texptr, bufw, bytesPerIndex, level);
+			// Since we had to unswizzle to tmpTexBuf32, let's output to tmpTexBuf16.
+			tmpTexBuf16.resize(std::max(bufw, w) * h * 2);
+			u32 *dest32 = (u32 *) tmpTexBuf16.data();
+			switch (bytesPerIndex) {
+			case 1:
+				DeIndexTexture(dest32, (u8 *) tmpTexBuf32.data(), length, clut, state);
+				buf = dest32;
+				break;
+
+			case 2:
+				DeIndexTexture(dest32, (u16 *) tmpTexBuf32.data(), length, clut, state);
+				buf = dest32;
+				break;
+
+			case 4:
+				// TODO: If a game actually uses this mode, check if using dest32 or tmpTexBuf32 is faster.
+				DeIndexTexture(tmpTexBuf32.data(), tmpTexBuf32.data(), length, clut, state);
+				buf = tmpTexBuf32.data();
+				break;
+			}
+		}
+		}
+		break;
+
+	default:
+		ERROR_LOG_REPORT(G3D, "Unhandled clut texture mode %d!!!", (state.clutformat & 3));
+		break;
+	}
+
+	return buf;
+}
+
+static const u8 texByteAlignMap[] = {2, 2, 2, 4};
+
+void *TextureCacheCommon::DecodeTextureLevel(TextureDecodeContext &ctx, GETextureFormat format, GEPaletteFormat clutformat, int level, u32 &texByteAlign, u32 dstFmt, int &bufw, u32 &bytes) {
+	const GPUgstate &state = *ctx.state;
+	SimpleBuf<u32> &tmpTexBuf32 = ctx.tmpTexBuf32;
+	SimpleBuf<u16> &tmpTexBuf16 = ctx.tmpTexBuf16;
+	SimpleBuf<u32> &tmpTexBufRearrange = ctx.tmpTexBufRearrange;
+	void *finalBuf = NULL;
+
+	u32 texaddr = state.getTextureAddress(level);
+	if (texaddr & 0x00600000 && Memory::IsVRAMAddress(texaddr)) {
+		// This means it's in a mirror, possibly a swizzled mirror.  Let's report.
+		WARN_LOG_REPORT_ONCE(texmirror, G3D, "Decoding texture from VRAM mirror at %08x swizzle=%d", texaddr, state.isTextureSwizzled() ? 1 : 0);
+	}
+
+	bufw = GetTextureBufw(level, texaddr, format, state);
+	int w = state.getTextureWidth(level);
+	int h = state.getTextureHeight(level);
+	const u8 *texptr = Memory::GetPointer(texaddr);
+	// The decoded pixel size, for packing the rows at the end.
+	int pixelSize = 4;
+
+	switch (format) {
+	case GE_TFMT_CLUT4:
+		{
+		const bool mipmapShareClut = state.isClutSharedForMipmaps();
+		const int clutSharingOffset = mipmapShareClut ? 0 : level * 16;
+
+		switch (clutformat) {
+		case GE_CMODE_16BIT_BGR5650:
+		case GE_CMODE_16BIT_ABGR5551:
+		case GE_CMODE_16BIT_ABGR4444:
+			{
+			tmpTexBuf16.resize(std::max(bufw, w) * h);
+			tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+			const u16 *clut = (const u16 *)ctx.clut + clutSharingOffset;
+			texByteAlign = 2;
+			pixelSize = 2;
+			const u8 *indexed = texptr;
+			if (state.isTextureSwizzled()) {
+				tmpTexBuf32.resize(std::max(bufw, w) * h);
+				UnswizzleFromMem(ctx, texptr, bufw, 0, level);
+				indexed = (const u8 *)tmpTexBuf32.data();
+			}
+			if (ctx.clutAlphaLinear && mipmapShareClut) {
+				if (ctx.clutAlphaLinearHigh) {
+					DeIndexTexture4OptimalRev(tmpTexBuf16.data(), indexed, bufw * h, ctx.clutAlphaLinearColor);
+				} else {
+					DeIndexTexture4Optimal(tmpTexBuf16.data(), indexed, bufw * h, ctx.clutAlphaLinearColor);
+				}
+			} else {
+				DeIndexTexture4(tmpTexBuf16.data(), indexed, bufw * h, clut, state);
+			}
+			finalBuf = tmpTexBuf16.data();
+			}
+			break;
+
+		case GE_CMODE_32BIT_ABGR8888:
+			{
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+			const u32 *clut = (const u32 *)ctx.clut + clutSharingOffset;
+			if (!state.isTextureSwizzled()) {
+				DeIndexTexture4(tmpTexBuf32.data(), texptr, bufw * h, clut, state);
+				finalBuf = tmpTexBuf32.data();
+			} else {
+				UnswizzleFromMem(ctx, texptr, bufw, 0, level);
+				// Let's reuse tmpTexBuf16, just need double the space.
+				tmpTexBuf16.resize(std::max(bufw, w) * h * 2);
+				DeIndexTexture4((u32 *)tmpTexBuf16.data(), (u8 *)tmpTexBuf32.data(), bufw * h, clut, state);
+				finalBuf = tmpTexBuf16.data();
+			}
+			}
+			break;
+
+		default:
+			ERROR_LOG_REPORT(G3D, "Unknown CLUT4 texture mode %d", state.getClutPaletteFormat());
+			return NULL;
+		}
+		}
+		break;
+
+	case GE_TFMT_CLUT8:
+	case GE_TFMT_CLUT16:
+	case GE_TFMT_CLUT32:
+		texByteAlign = texByteAlignMap[state.getClutPaletteFormat()];
+		pixelSize = state.getClutPaletteFormat() == GE_CMODE_32BIT_ABGR8888 ? 4 : 2;
+		finalBuf = ReadIndexedTex(ctx, level, texptr, format == GE_TFMT_CLUT8 ? 1 : (format == GE_TFMT_CLUT16 ? 2 : 4), bufw);
+		break;
+
+	case GE_TFMT_4444:
+	case GE_TFMT_5551:
+	case GE_TFMT_5650:
+		texByteAlign = 2;
+		pixelSize = 2;
+
+		if (!state.isTextureSwizzled()) {
+			// Like 8888, uploaded straight from PSP memory if the backend takes these colors as they are.
+			if (!ConvertsColors(dstFmt) && ((g_Config.iTexScalingLevel == 1 && CanUploadWithStride()) || w == bufw)) {
+				finalBuf = (void *)texptr;
+				break;
+			}
+			int len = std::max(bufw, w) * h;
+			tmpTexBuf16.resize(len);
+			tmpTexBufRearrange.resize(len);
+			finalBuf = tmpTexBuf16.data();
+			ConvertColors(finalBuf, texptr, dstFmt, bufw * h);
+		} else {
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			finalBuf = UnswizzleFromMem(ctx, texptr, bufw, 2, level);
+			ConvertColors(finalBuf, finalBuf, dstFmt, bufw * h);
+		}
+		break;
+
+	case GE_TFMT_8888:
+		if (!state.isTextureSwizzled()) {
+			// Special case: if we don't need to deal with packing, we don't need to copy.
+			if ((g_Config.iTexScalingLevel == 1 && CanUploadWithStride()) || w == bufw) {
+				if (ConvertsColors(dstFmt)) {
+					tmpTexBuf32.resize(std::max(bufw, w) * h);
+					finalBuf = tmpTexBuf32.data();
+					ConvertColors(finalBuf, texptr, dstFmt, bufw * h);
+				} else {
+					finalBuf = (void *)texptr;
+				}
+			} else {
+				tmpTexBuf32.resize(std::max(bufw, w) * h);
+				tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+				finalBuf = tmpTexBuf32.data();
+				ConvertColors(finalBuf, texptr, dstFmt, bufw * h);
+			}
+		} else {
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			finalBuf = UnswizzleFromMem(ctx, texptr, bufw, 4, level);
+			ConvertColors(finalBuf, finalBuf, dstFmt, bufw * h);
+		}
+		break;
+
+	case GE_TFMT_DXT1:
+		{
+			int minw = std::min(bufw, w);
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+			u32 *dst = tmpTexBuf32.data();
+			DXT1Block *src = (DXT1Block*)texptr;
+
+			for (int y = 0; y < h; y += 4) {
+				u32 blockIndex = (y / 4) * (bufw / 4);
+				DoDecodeDXT1Blocks(dst + bufw * y, src + blockIndex, (minw + 3) / 4, bufw);
+			}
+			finalBuf = tmpTexBuf32.data();
+			ConvertColors(finalBuf, finalBuf, dstFmt, bufw * h);
+			w = (w + 3) & ~3;
+		}
+		break;
+
+	case GE_TFMT_DXT3:
+		{
+			int minw = std::min(bufw, w);
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+			u32 *dst = tmpTexBuf32.data();
+			DXT3Block *src = (DXT3Block*)texptr;
+
+			for (int y = 0; y < h; y += 4) {
+				u32 blockIndex = (y / 4) * (bufw / 4);
+				DoDecodeDXT3Blocks(dst + bufw * y, src + blockIndex, (minw + 3) / 4, bufw);
+			}
+			w = (w + 3) & ~3;
+			finalBuf = tmpTexBuf32.data();
+			ConvertColors(finalBuf, finalBuf, dstFmt, bufw * h);
+		}
+		break;
+
+	case GE_TFMT_DXT5:
+		{
+			int minw = std::min(bufw, w);
+			tmpTexBuf32.resize(std::max(bufw, w) * h);
+			tmpTexBufRearrange.resize(std::max(bufw, w) * h);
+			u32 *dst = tmpTexBuf32.data();
+			DXT5Block *src = (DXT5Block*)texptr;
+
+			for (int y = 0; y < h; y += 4) {
+				u32 blockIndex = (y / 4) * (bufw / 4);
+				DoDecodeDXT5Blocks(dst + bufw * y, src + blockIndex, (minw + 3) / 4, bufw);
+			}
+			w = (w + 3) & ~3;
+			finalBuf = tmpTexBuf32.data();
+			ConvertColors(finalBuf, finalBuf, dstFmt, bufw * h);
+		}
+		break;
+
+	default:
+		ERROR_LOG_REPORT(G3D, "Unknown Texture Format %d!!!", format);
+		return NULL;
+	}
+
+	if (!finalBuf) {
+		ERROR_LOG_REPORT(G3D, "NO finalbuf! Will crash!");
+	}
+
+	bytes = bufw * h * pixelSize;
+	if (!(g_Config.iTexScalingLevel == 1 && CanUploadWithStride()) && w != bufw) {
+		// Need to rearrange the buffer to simulate GL_UNPACK_ROW_LENGTH etc.
+		bytes = w * h * pixelSize;
+		int inRowBytes = bufw * pixelSize;
+		int outRowBytes = w * pixelSize;
+		const u8 *read = (const u8 *)finalBuf;
+		u8 *write = 0;
+		if (w > bufw) {
+			write = (u8 *)tmpTexBufRearrange.data();
+			finalBuf = tmpTexBufRearrange.data();
+		} else {
+			write = (u8 *)finalBuf;
+		}
+		for (int y = 0; y < h; y++) {
+			memmove(write, read, outRowBytes);
+			read += inRowBytes;
+			write += outRowBytes;
+		}
+	}
+
+	return finalBuf;
+}
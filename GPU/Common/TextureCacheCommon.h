@@ -17,11 +17,461 @@
 
 #pragma once
 
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "native/base/mutex.h"
+#include "native/thread/thread.h"
 #include "Common/CommonTypes.h"
+#include "Common/MemoryUtil.h"
+#include "GPU/GPUInterface.h"
+#include "GPU/Common/ScaledTextureDiskCache.h"
+#include "GPU/ge_constants.h"
+
+struct VirtualFramebuffer;
+
+#define TEXCACHE_MAX_TEXELS_SCALED (256*256)  // Per frame
+// With background decoding on, textures past this many texels per frame are decoded in the background.
+#define TEXCACHE_MAX_TEXELS_DECODED_SYNC (512*512)
+
+enum TextureFiltering {
+	AUTO = 1,
+	NEAREST = 2,
+	LINEAR = 3,
+	LINEARFMV = 4,
+};
+
+enum FramebufferNotification {
+	NOTIFY_FB_CREATED,
+	NOTIFY_FB_UPDATED,
+	NOTIFY_FB_DESTROYED,
+};
+
+// Wow this is starting to grow big. Soon need to start looking at resizing it.
+// Must stay a POD.
+struct TexCacheEntry {
+	// After marking STATUS_UNRELIABLE, if it stays the same this many frames we'll trust it again.
+	const static int FRAMES_REGAIN_TRUST = 1000;
+
+	enum Status {
+		STATUS_HASHING = 0x00,
+		STATUS_RELIABLE = 0x01,        // Don't bother rehashing.
+		STATUS_UNRELIABLE = 0x02,      // Always recheck hash.
+		STATUS_MASK = 0x03,
+
+		STATUS_ALPHA_UNKNOWN = 0x04,
+		STATUS_ALPHA_FULL = 0x00,      // Has no alpha channel, or always full alpha.
+		STATUS_ALPHA_SIMPLE = 0x08,    // Like above, but also has 0 alpha (e.g. 5551.)
+		STATUS_ALPHA_MASK = 0x0c,
+
+		STATUS_CHANGE_FREQUENT = 0x10, // Changes often (less than 15 frames in between.)
+		STATUS_CLUT_RECHECK = 0x20,    // Another texture with same addr had a hashfail.
+		STATUS_DEPALETTIZE = 0x40,     // Needs to go through a depalettize pass.
+		STATUS_TO_SCALE = 0x80,        // Pending texture scaling in a later frame.
+		STATUS_DECODING = 0x100,       // Being decoded in the background, the texture is still the old one.
+		STATUS_SECOND_CACHE = 0x200,   // Lives in secondCache, and its bytes count there.
+	};
+
+	// Status, but int so we can zero initialize.
+	int status;
+	u32 addr;
+	u32 hash;
+	VirtualFramebuffer *framebuffer;  // if null, not sourced from an FBO.
+	u32 sizeInRAM;
+	int lastFrame;
+	int numFrames;
+	int numInvalidated;
+	u32 framesUntilNextFullHash;
+	u8 format;
+	u16 dim;
+	u16 bufw;
+	// The backend's texture, zero if it doesn't have one yet.
+	union {
+		u32 textureName;
+		void *texturePtr;
+	};
+	// What the backend's texture takes, all levels, as counted in the cache's totals.  Zero without one.
+	u32 texBytes;
+	int invalidHint;
+	u32 fullhash;
+	u32 cluthash;
+	// Of level 0 and the CLUT, for the scaled texture disk cache.  Zero unless scaling.
+	u64 contenthash;
+	int maxLevel;
+	float lodBias;
+
+	// Cache the current filter settings so we can avoid setting it again.
+	// (OpenGL madness where filter settings are attached to each texture).
+	u8 magFilt;
+	u8 minFilt;
+	bool sClamp;
+	bool tClamp;
+
+	Status GetHashStatus() {
+		return Status(status & STATUS_MASK);
+	}
+	void SetHashStatus(Status newStatus) {
+		status = (status & ~STATUS_MASK) | newStatus;
+	}
+	Status GetAlphaStatus() {
+		return Status(status & STATUS_ALPHA_MASK);
+	}
+	void SetAlphaStatus(Status newStatus) {
+		status = (status & ~STATUS_ALPHA_MASK) | newStatus;
+	}
+	void SetAlphaStatus(Status newStatus, int level) {
+		// For non-level zero, only set more restrictive.
+		if (newStatus == STATUS_ALPHA_UNKNOWN || level == 0) {
+			SetAlphaStatus(newStatus);
+		} else if (newStatus == STATUS_ALPHA_SIMPLE && GetAlphaStatus() == STATUS_ALPHA_FULL) {
+			SetAlphaStatus(STATUS_ALPHA_SIMPLE);
+		}
+	}
+	bool Matches(u16 dim2, u8 format2, int maxLevel2) const {
+		return dim == dim2 && format == format2 && maxLevel == maxLevel2;
+	}
+};
+
+// Scratch buffers and state for decoding textures.  Decoding on the GPU thread uses the live
+// registers and clut, a background decode uses copies taken when it was queued.
+struct TextureDecodeContext {
+	TextureDecodeContext();
+
+	const GPUgstate *state;
+	const u32 *clut;
+	// Like TextureCacheCommon's clutAlphaLinear* fields.
+	bool clutAlphaLinear;
+	bool clutAlphaLinearHigh;
+	u16 clutAlphaLinearColor;
+
+	SimpleBuf<u32> tmpTexBuf32;
+	SimpleBuf<u16> tmpTexBuf16;
+	SimpleBuf<u32> tmpTexBufRearrange;
+};
+
+// Texture cache entries by 64-bit key, in an open addressed table with linear probing, so
+// a lookup is usually a single cache line.  Entries are allocated separately, so pointers to
+// them stay valid while other entries come and go.
+// Entries given a memory range with SetRange() are also listed under each page it covers,
+// so range invalidation only looks at entries that can overlap.
+class TexCacheMap {
+public:
+	TexCacheMap();
+	~TexCacheMap();
+
+	TexCacheEntry *Find(u64 key);
+	// Returns the existing entry if the key is already there.
+	TexCacheEntry *Insert(u64 key, const TexCacheEntry &entry);
+	void Clear();
+	// Lists the entry under the pages of [addr, addr + size).  Call again when they change.
+	void SetRange(u64 key, u32 addr, u32 size);
+
+	size_t size() const {
+		return count_;
+	}
+
+	// func(TexCacheEntry *entry) for every entry.
+	template <typename F>
+	void ForEach(F func) {
+		for (size_t i = 0; i < slots_.size(); ++i) {
+			if (slots_[i].node) {
+				func(&slots_[i].node->entry);
+			}
+		}
+	}
+
+	// Removes (and frees) every entry for which pred(TexCacheEntry *entry) returns true.
+	template <typename F>
+	void EraseIf(F pred) {
+		bool erased = false;
+		for (size_t i = 0; i < slots_.size(); ++i) {
+			Node *node = slots_[i].node;
+			if (node && pred(&node->entry)) {
+				Unlist(node);
+				delete node;
+				slots_[i].node = nullptr;
+				--count_;
+				erased = true;
+			}
+		}
+		// Removing from the middle of probe sequences breaks them, so just rebuild.
+		if (erased) {
+			Rehash(slots_.size());
+		}
+	}
+
+	// func(TexCacheEntry *entry) once for each entry whose range overlaps [start, end).
+	template <typename F>
+	void ForEachOverlapping(u32 start, u32 end, F func) {
+		if (end <= start) {
+			return;
+		}
+		const u32 firstPage = start >> PAGE_SHIFT;
+		const u32 lastPage = (end - 1) >> PAGE_SHIFT;
+		for (u32 page = firstPage; page <= lastPage; ++page) {
+			auto list = pages_.find(page);
+			if (list == pages_.end()) {
+				continue;
+			}
+			for (Node *node : list->second) {
+				// Visit an entry only at its first page within the range.
+				if (page == std::max(node->firstPage, firstPage)) {
+					func(&node->entry);
+				}
+			}
+		}
+	}
+
+	// func(TexCacheEntry *entry) for each entry whose range starts within [start, end).
+	template <typename F>
+	void ForEachStartingIn(u32 start, u32 end, F func) {
+		if (end <= start) {
+			return;
+		}
+		for (u32 page = start >> PAGE_SHIFT, lastPage = (end - 1) >> PAGE_SHIFT; page <= lastPage; ++page) {
+			auto list = pages_.find(page);
+			if (list == pages_.end()) {
+				continue;
+			}
+			for (Node *node : list->second) {
+				if (node->firstPage == page && node->addr >= start && node->addr < end) {
+					func(&node->entry);
+				}
+			}
+		}
+	}
 
+private:
+	enum {
+		PAGE_SHIFT = 16,
+		MIN_SLOTS = 256,
+	};
+
+	struct Node {
+		u64 key;
+		u32 addr;
+		u32 firstPage;
+		u32 lastPage;
+		bool listed;
+		TexCacheEntry entry;
+	};
+	struct Slot {
+		u64 key;
+		Node *node;
+	};
+
+	size_t SlotFor(u64 key) const;
+	Node *FindNode(u64 key, int *probes) const;
+	void Rehash(size_t numSlots);
+	void List(Node *node);
+	void Unlist(Node *node);
+
+	std::vector<Slot> slots_;
+	size_t count_;
+	std::unordered_map<u32, std::vector<Node *>> pages_;
+};
+
+// Looks up, hashes, invalidates and decodes PSP textures.  The backends only
+// create, upload and bind the host textures, through the virtuals below.
 class TextureCacheCommon {
 public:
+	TextureCacheCommon();
 	virtual ~TextureCacheCommon();
 
+	void SetTexture(bool force = false);
 	virtual bool SetOffsetTexture(u32 offset);
-};
\ No newline at end of file
+
+	virtual void Clear(bool delete_them);
+	virtual void StartFrame();
+	void Invalidate(u32 addr, int size, GPUInvalidationType type);
+	void InvalidateAll(GPUInvalidationType type);
+	void ClearNextFrame();
+	void LoadClut();
+
+	// FramebufferManager keeps TextureCache updated about what regions of memory
+	// are being rendered to. This is barebones so far.
+	void NotifyFramebuffer(u32 address, VirtualFramebuffer *framebuffer, FramebufferNotification msg);
+
+	size_t NumLoadedTextures() const {
+		return cache.size();
+	}
+
+protected:
+	// Binds no texture at all.
+	virtual void Unbind() = 0;
+	// Makes the next BindTexture() bind, even if it's the same texture.
+	virtual void InvalidateLastTexture() = 0;
+	// Binds a texture that was found in the cache, and sets its sampling state.
+	virtual void BindTexture(TexCacheEntry *entry) = 0;
+	// Frees the entry's texture and zeroes it.
+	virtual void ReleaseTexture(TexCacheEntry *entry) = 0;
+	// Decodes and uploads all levels of the current texture into the entry, and binds it.
+	// If replaceImages is set, the entry's texture already has the right size and levels.
+	virtual void BuildTexture(TexCacheEntry *entry, bool replaceImages) = 0;
+	virtual void SetTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) = 0;
+	// Binds a solid color in place of a texture, for DEBUG_TEXTURES.
+	virtual void BindDebugTexture() {
+		Unbind();
+	}
+
+	// The backend's pixel format for a texture or clut format, as passed to the decoder.
+	virtual u32 GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const = 0;
+	// Converts PSP colors to dstFmt.  dstBuf may be srcBuf.
+	virtual void ConvertColors(void *dstBuf, const void *srcBuf, u32 dstFmt, int numPixels) = 0;
+	// False if ConvertColors() would just copy.
+	virtual bool ConvertsColors(u32 dstFmt) const {
+		return false;
+	}
+	// True if the backend can upload rows that are bufw apart, so decoding doesn't need to pack them.
+	virtual bool CanUploadWithStride() const {
+		return false;
+	}
+
+	bool SetDebugTexture();
+	void Decimate();  // Run this once per frame to get rid of old textures.
+	void DeleteTexture(TexCacheEntry *entry);
+	// Backends call this for each level they upload, with its final size, so the budgets see real bytes.
+	void SetLevelBytes(TexCacheEntry &entry, int level, int w, int h, int bytesPerPixel) {
+		const u32 bytes = (u32)(w * h * bytesPerPixel);
+		SetTextureBytes(entry, level == 0 ? bytes : entry.texBytes + bytes);
+	}
+	void SetTextureBytes(TexCacheEntry &entry, u32 bytes);
+	// Releases the entry's texture and stops counting it.  Use this rather than ReleaseTexture().
+	void FreeTexture(TexCacheEntry *entry);
+	void CheckTextureBytes();
+	// Drops the least recently used textures until the cache is under budget (or only ones used this frame are left.)
+	void EvictToBudget(TexCacheMap &map, u32 &bytes, u32 budget, bool primary);
+	void NoteEvicted(const TexCacheEntry *entry);
+	void *UnswizzleFromMem(TextureDecodeContext &ctx, const u8 *texptr, u32 bufw, u32 bytesPerPixel, u32 level);
+	void *ReadIndexedTex(TextureDecodeContext &ctx, int level, const u8 *texptr, int bytesPerIndex, int bufw);
+	// Decodes a level of the current texture, or hands out a finished background decode's level.
+	void *DecodeTextureLevel(GETextureFormat format, GEPaletteFormat clutformat, int level, u32 &texByteAlign, u32 dstFmt, int *bufw = 0);
+	// Can run on any thread, if ConvertColors() can.  bytes is the size of the result.
+	void *DecodeTextureLevel(TextureDecodeContext &ctx, GETextureFormat format, GEPaletteFormat clutformat, int level, u32 &texByteAlign, u32 dstFmt, int &bufw, u32 &bytes);
+	template <typename T>
+	const T *GetCurrentClut() {
+		return (const T *)clutBuf_;
+	}
+	u32 GetCurrentClutHash() {
+		return clutHash_;
+	}
+	void UpdateCurrentClut();
+	bool AttachFramebuffer(TexCacheEntry *entry, u32 address, VirtualFramebuffer *framebuffer, u32 texaddrOffset = 0);
+	void DetachFramebuffer(TexCacheEntry *entry, u32 address, VirtualFramebuffer *framebuffer);
+
+	TexCacheMap cache;
+	TexCacheMap secondCache;
+	std::vector<VirtualFramebuffer *> fbCache_;
+	// What the textures in each cache take, kept up to date by SetTextureBytes().
+	u32 cacheBytes_;
+	u32 secondCacheBytes_;
+	// Set when the backend first runs out of memory, what fit then, less a bit.
+	u32 lowMemoryBudget_;
+	// Keys of textures dropped by Decimate(), so it's known when one has to be decoded again.
+	std::unordered_set<u64> evictedKeys_;
+
+	// Separate to keep main texture cache size down.
+	struct AttachedFramebufferInfo {
+		u32 xOffset;
+		u32 yOffset;
+	};
+	std::map<u32, AttachedFramebufferInfo> fbTexInfo_;
+	void AttachFramebufferValid(TexCacheEntry *entry, VirtualFramebuffer *framebuffer, const AttachedFramebufferInfo &fbInfo);
+	void AttachFramebufferInvalid(TexCacheEntry *entry, VirtualFramebuffer *framebuffer, const AttachedFramebufferInfo &fbInfo);
+
+	// A texture being decoded by the workers, into its own buffers.
+	struct DecodeJob {
+		struct Level {
+			std::vector<u8> data;
+			int bufw;
+			u32 texByteAlign;
+		};
+
+		TexCacheEntry *entry;
+		bool replaceImages;
+		bool releaseOld;
+		// Both under decodeLock_.
+		bool done;
+		bool cancelled;
+		double queuedTime;
+		double doneTime;
+		double msDecoding;
+
+		GPUgstate state;
+		// Indices can reach 0x1FF, plus the offset of unshared mip cluts.
+		u32 clut[1024];
+		bool clutAlphaLinear;
+		bool clutAlphaLinearHigh;
+		u16 clutAlphaLinearColor;
+		GETextureFormat format;
+		GEPaletteFormat clutFormat;
+		u32 dstFmt;
+		int numLevels;
+		Level levels[8];
+	};
+
+	// Queues the decode if it's on and this frame has decoded enough already, and binds the
+	// old texture (or nothing) meanwhile.  False if it should be built right away.
+	bool DecodeInBackground(TexCacheEntry *entry, bool replaceImages, bool releaseOld);
+	// Builds the texture if its decode is done, otherwise binds the old one.
+	void FinishDecode(TexCacheEntry *entry);
+	// Returns true if the entry's texture was going to be released, as it's not the size the entry says.
+	bool CancelDecode(TexCacheEntry *entry);
+	void CancelAllDecodes();
+	void StartDecodeWorkers();
+	void StopDecodeWorkers();
+	// The workers call virtuals, so subclasses must call this from their destructors.
+	void ShutdownDecodeWorkers();
+	void DecodeWorkerLoop();
+	void RunDecodeJob(TextureDecodeContext &ctx, DecodeJob *job);
+
+	// Upscaled textures are saved to disk per game, so each only needs scaling once.
+	// These take level 0 of the current texture, srcFmt is its format before scaling.
+	bool HasScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor);
+	const u32 *LoadScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor);
+	void SaveScaledTexture(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor, const u32 *scaled);
+	ScaledTextureKey MakeScaledTextureKey(const TexCacheEntry &entry, u32 srcFmt, int w, int h, int factor) const;
+	bool OpenScaledTextureCache();
+
+	bool clearCacheNextFrame_;
+	bool lowMemoryMode_;
+
+	// For decoding on the GPU thread.
+	TextureDecodeContext decodeContext_;
+	// Jobs by entry, only touched by the GPU thread.
+	std::unordered_map<TexCacheEntry *, DecodeJob *> decodeJobs_;
+	// While building a texture from a finished job.
+	DecodeJob *stagedJob_;
+	std::vector<std::thread *> decodeWorkers_;
+	bool decodeWorkersRunning_;
+	recursive_mutex decodeLock_;
+	condition_variable decodeWait_;
+	std::deque<DecodeJob *> decodeQueue_;
+
+	ScaledTextureDiskCache scaledDiskCache_;
+	std::vector<u32> scaledFromDisk_;
+
+	u32 clutLastFormat_;
+	u32 *clutBufRaw_;
+	u32 *clutBufConverted_;
+	u32 *clutBuf_;
+	u32 clutHash_;
+	// Unlike clutHash_, the same on every CPU.
+	u64 clutContentHash_;
+	u32 clutTotalBytes_;
+	u32 clutMaxBytes_;
+	// True if the clut is just alpha values in the same order (RGBA4444-bit only.)
+	bool clutAlphaLinear_;
+	// Whether the backend's 4444 format keeps alpha in the top bits rather than the bottom.
+	bool clutAlphaLinearHigh_;
+	u16 clutAlphaLinearColor_;
+
+	int decimationCounter_;
+	int texelsScaledThisFrame_;
+	int texelsDecodedThisFrame_;
+	int timesInvalidatedAllThisFrame_;
+};
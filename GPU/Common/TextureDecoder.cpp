@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "ext/xxhash.h"
 #include "Common/CPUDetect.h"
 #include "GPU/Common/TextureDecoder.h"
@@ -28,6 +30,9 @@
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
 #endif
+#ifdef HAVE_AVX2_INTRINSICS
+#include <immintrin.h>
+#endif
 
 u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 	u32 check = 0;
@@ -61,6 +66,77 @@ u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 
 	return check;
 }
+
+#ifdef HAVE_AVX2_INTRINSICS
+// Same idea as the SSE2 one, but two of its 16-byte lanes at a time, so the result differs.
+AVX2_TARGET u32 QuickTexHashAVX2(const void *checkp, u32 size) {
+	if (((intptr_t)checkp & 0xf) != 0 || (size & 0x7f) != 0) {
+		return QuickTexHashSSE2(checkp, size);
+	}
+
+	__m256i cursor = _mm256_setzero_si256();
+	__m256i cursor2 = _mm256_set_epi16(0x0003U, 0x0107U, 0x2c29U, 0x5e41U, 0xa98bU, 0x3d61U, 0x8a4dU, 0xe6f3U,
+		0x0001U, 0x0083U, 0x4309U, 0x4d9bU, 0xb651U, 0x4b73U, 0x9bd9U, 0xc00bU);
+	const __m256i update = _mm256_set1_epi16(0x2455U);
+	// Textures are only 16-byte aligned, but unaligned loads are about as fast on anything with AVX2.
+	const __m256i *p = (const __m256i *)checkp;
+	for (u32 i = 0; i < size / 32; i += 4) {
+		__m256i chunk = _mm256_mullo_epi16(_mm256_loadu_si256(&p[i]), cursor2);
+		cursor = _mm256_add_epi16(cursor, chunk);
+		cursor = _mm256_xor_si256(cursor, _mm256_loadu_si256(&p[i + 1]));
+		cursor = _mm256_add_epi32(cursor, _mm256_loadu_si256(&p[i + 2]));
+		chunk = _mm256_mullo_epi16(_mm256_loadu_si256(&p[i + 3]), cursor2);
+		cursor = _mm256_xor_si256(cursor, chunk);
+		cursor2 = _mm256_add_epi16(cursor2, update);
+	}
+	cursor = _mm256_add_epi32(cursor, cursor2);
+	// Add the eight parts into the low i32.
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(cursor), _mm256_extracti128_si256(cursor, 1));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+	return _mm_cvtsi128_si32(sum);
+}
+
+// Four sets of eight XXH32 style lanes, each set taking every fourth 32 bytes.  The lanes and
+// the tail then go through XXH64.  Like XXH32's, the multiplies are what limit this.
+AVX2_TARGET u64 ReliableHash64AVX2(const void *input, size_t len, u64 seed) {
+	// Too short to keep the lanes busy.
+	if (len < 256) {
+		return XXH64(input, len, seed);
+	}
+
+	const __m256i prime1 = _mm256_set1_epi32(2654435761U);
+	const __m256i prime2 = _mm256_set1_epi32(2246822519U);
+	const __m256i lanes = _mm256_setr_epi32(0x00000000, 0x165667B1, 0x2CACCF62, 0x43033713, 0x59599EC4, 0x6FB00675, 0x86066E26, 0x9C5CD5D7);
+	const __m256i seedLo = _mm256_add_epi32(_mm256_set1_epi32((u32)seed), lanes);
+	const __m256i seedHi = _mm256_add_epi32(_mm256_set1_epi32((u32)(seed >> 32)), lanes);
+	__m256i acc0 = _mm256_add_epi32(seedLo, prime1);
+	__m256i acc1 = _mm256_add_epi32(seedHi, prime2);
+	__m256i acc2 = _mm256_sub_epi32(seedLo, prime1);
+	__m256i acc3 = _mm256_sub_epi32(seedHi, prime2);
+
+	const u8 *p = (const u8 *)input;
+	const u8 *const end = p + (len & ~(size_t)127);
+	for (; p < end; p += 128) {
+#define ROUND(acc, offset) \
+		acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(p + offset)), prime2)); \
+		acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13), _mm256_srli_epi32(acc, 32 - 13)); \
+		acc = _mm256_mullo_epi32(acc, prime1);
+		ROUND(acc0, 0);
+		ROUND(acc1, 32);
+		ROUND(acc2, 64);
+		ROUND(acc3, 96);
+#undef ROUND
+	}
+
+	u32 state[32];
+	_mm256_storeu_si256((__m256i *)&state[0], acc0);
+	_mm256_storeu_si256((__m256i *)&state[8], acc1);
+	_mm256_storeu_si256((__m256i *)&state[16], acc2);
+	_mm256_storeu_si256((__m256i *)&state[24], acc3);
+	return XXH64(state, sizeof(state), XXH64(p, len & 127, seed + len));
+}
+#endif
 #endif
 
 u32 QuickTexHashNonSSE(const void *checkp, u32 size) {
@@ -205,15 +281,195 @@ void DoUnswizzleTex16Basic(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32
 #endif
 }
 
-#ifndef _M_SSE
-QuickTexHashFunc DoQuickTexHash = &QuickTexHashBasic;
+void DeIndexTexture4To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture4To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture8To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	for (int i = 0; i < length; ++i) {
+		dest[i] = clut[indexed[i]];
+	}
+}
+
+void DeIndexTexture8To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	for (int i = 0; i < length; ++i) {
+		dest[i] = clut[indexed[i]];
+	}
+}
+
+#ifdef HAVE_AVX2_INTRINSICS
+// Two blocks side by side make a 32 byte row.
+AVX2_TARGET void DoUnswizzleTex16AVX2(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch, u32 rowWidth) {
+	if (bxc & 1) {
+		DoUnswizzleTex16Basic(texptr, ydestp, bxc, byc, pitch, rowWidth);
+		return;
+	}
+
+	const __m128i *src = (const __m128i *)texptr;
+	for (int by = 0; by < byc; by++) {
+		u32 *xdest = ydestp;
+		for (int bx = 0; bx < bxc; bx += 2) {
+			u32 *dest = xdest;
+			for (int n = 0; n < 8; n++) {
+				__m256i row = _mm256_castsi128_si256(_mm_load_si128(src + n));
+				row = _mm256_inserti128_si256(row, _mm_load_si128(src + 8 + n), 1);
+				_mm256_storeu_si256((__m256i *)dest, row);
+				dest += pitch;
+			}
+			src += 16;
+			xdest += 8;
+		}
+		ydestp += (rowWidth * 8) / 4;
+	}
+}
+
+// Nibbles in pixel order, low nibble first, from 16 bytes of CLUT4 indices.
+SSSE3_TARGET static inline void SplitClut4Indices(const u8 *indexed, __m128i &first, __m128i &second) {
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i src = _mm_loadu_si128((const __m128i *)indexed);
+	const __m128i lowNibbles = _mm_and_si128(src, mask);
+	const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(src, 4), mask);
+	first = _mm_unpacklo_epi8(lowNibbles, highNibbles);
+	second = _mm_unpackhi_epi8(lowNibbles, highNibbles);
+}
+
+// A CLUT4 palette fits in pshufb tables, one per byte of the color.
+SSSE3_TARGET void DeIndexTexture4To16SSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	const __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)clut), split);
+	const __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 8)), split);
+	const __m128i lowBytes = _mm_unpacklo_epi64(c0, c1);
+	const __m128i highBytes = _mm_unpackhi_epi64(c0, c1);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitClut4Indices(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i lo = _mm_shuffle_epi8(lowBytes, idx[j]);
+			const __m128i hi = _mm_shuffle_epi8(highBytes, idx[j]);
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16), _mm_unpacklo_epi8(lo, hi));
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16 + 8), _mm_unpackhi_epi8(lo, hi));
+		}
+	}
+	DeIndexTexture4To16Basic(dest + i, indexed + i / 2, length - i, clut);
+}
+
+SSSE3_TARGET void DeIndexTexture4To32SSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	const __m128i split = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)clut), split);
+	const __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 4)), split);
+	const __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 8)), split);
+	const __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 12)), split);
+	const __m128i c01lo = _mm_unpacklo_epi32(c0, c1);
+	const __m128i c23lo = _mm_unpacklo_epi32(c2, c3);
+	const __m128i c01hi = _mm_unpackhi_epi32(c0, c1);
+	const __m128i c23hi = _mm_unpackhi_epi32(c2, c3);
+	const __m128i bytes0 = _mm_unpacklo_epi64(c01lo, c23lo);
+	const __m128i bytes1 = _mm_unpackhi_epi64(c01lo, c23lo);
+	const __m128i bytes2 = _mm_unpacklo_epi64(c01hi, c23hi);
+	const __m128i bytes3 = _mm_unpackhi_epi64(c01hi, c23hi);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitClut4Indices(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i b0 = _mm_shuffle_epi8(bytes0, idx[j]);
+			const __m128i b1 = _mm_shuffle_epi8(bytes1, idx[j]);
+			const __m128i b2 = _mm_shuffle_epi8(bytes2, idx[j]);
+			const __m128i b3 = _mm_shuffle_epi8(bytes3, idx[j]);
+			const __m128i b01lo = _mm_unpacklo_epi8(b0, b1);
+			const __m128i b23lo = _mm_unpacklo_epi8(b2, b3);
+			const __m128i b01hi = _mm_unpackhi_epi8(b0, b1);
+			const __m128i b23hi = _mm_unpackhi_epi8(b2, b3);
+			__m128i *d = (__m128i *)(dest + i + j * 16);
+			_mm_storeu_si128(d + 0, _mm_unpacklo_epi16(b01lo, b23lo));
+			_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(b01lo, b23lo));
+			_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(b01hi, b23hi));
+			_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(b01hi, b23hi));
+		}
+	}
+	DeIndexTexture4To32Basic(dest + i, indexed + i / 2, length - i, clut);
+}
+
+// 256 entries are too many for pshufb, so these gather.  The 16-bit one gathers 32 bits
+// at each entry and drops the top half.
+AVX2_TARGET void DeIndexTexture8To16AVX2(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i idx = _mm_loadu_si128((const __m128i *)(indexed + i));
+		const __m256i idx0 = _mm256_cvtepu8_epi32(idx);
+		const __m256i idx1 = _mm256_cvtepu8_epi32(_mm_srli_si128(idx, 8));
+		const __m256i c0 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)clut, idx0, 2), mask);
+		const __m256i c1 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)clut, idx1, 2), mask);
+		// The pack works within 128-bit lanes, so put them back in order.
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(c0, c1), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dest + i), packed);
+	}
+	DeIndexTexture8To16Basic(dest + i, indexed + i, length - i, clut);
+}
+
+AVX2_TARGET void DeIndexTexture8To32AVX2(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	int i = 0;
+	for (; i + 8 <= length; i += 8) {
+		const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indexed + i)));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_i32gather_epi32((const int *)clut, idx, 4));
+	}
+	DeIndexTexture8To32Basic(dest + i, indexed + i, length - i, clut);
+}
+#endif
+
+ReliableHash64Func DoReliableHash64 = &XXH64;
 UnswizzleTex16Func DoUnswizzleTex16 = &DoUnswizzleTex16Basic;
+DeIndexTexture16Func DoDeIndexTexture4To16 = &DeIndexTexture4To16Basic;
+DeIndexTexture32Func DoDeIndexTexture4To32 = &DeIndexTexture4To32Basic;
+DeIndexTexture16Func DoDeIndexTexture8To16 = &DeIndexTexture8To16Basic;
+DeIndexTexture32Func DoDeIndexTexture8To32 = &DeIndexTexture8To32Basic;
+#ifdef _M_SSE
+QuickTexHashFunc DoQuickTexHash = &QuickTexHashSSE2;
+DecodeDXT1BlocksFunc DoDecodeDXT1Blocks = &DecodeDXT1BlocksSSE2;
+DecodeDXT3BlocksFunc DoDecodeDXT3Blocks = &DecodeDXT3BlocksSSE2;
+DecodeDXT5BlocksFunc DoDecodeDXT5Blocks = &DecodeDXT5BlocksSSE2;
+#else
+DecodeDXT1BlocksFunc DoDecodeDXT1Blocks = &DecodeDXT1BlocksBasic;
+DecodeDXT3BlocksFunc DoDecodeDXT3Blocks = &DecodeDXT3BlocksBasic;
+DecodeDXT5BlocksFunc DoDecodeDXT5Blocks = &DecodeDXT5BlocksBasic;
+QuickTexHashFunc DoQuickTexHash = &QuickTexHashBasic;
 ReliableHash32Func DoReliableHash32 = &XXH32;
-ReliableHash64Func DoReliableHash64 = &XXH64;
 #endif
 
 // This has to be done after CPUDetect has done its magic.
 void SetupTextureDecoder() {
+#ifdef HAVE_AVX2_INTRINSICS
+	if (cpu_info.bSSSE3) {
+		DoDeIndexTexture4To16 = &DeIndexTexture4To16SSSE3;
+		DoDeIndexTexture4To32 = &DeIndexTexture4To32SSSE3;
+	}
+	if (cpu_info.bAVX2) {
+		DoQuickTexHash = &QuickTexHashAVX2;
+		DoReliableHash64 = &ReliableHash64AVX2;
+		DoUnswizzleTex16 = &DoUnswizzleTex16AVX2;
+		DoDeIndexTexture8To16 = &DeIndexTexture8To16AVX2;
+		DoDeIndexTexture8To32 = &DeIndexTexture8To32AVX2;
+		DoDecodeDXT1Blocks = &DecodeDXT1BlocksAVX2;
+		DoDecodeDXT3Blocks = &DecodeDXT3BlocksAVX2;
+		DoDecodeDXT5Blocks = &DecodeDXT5BlocksAVX2;
+	}
+#endif
 #ifdef HAVE_ARMV7
 	if (cpu_info.bNEON) {
 		DoQuickTexHash = &QuickTexHashNEON;
@@ -328,6 +584,333 @@ void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch) {
 	}
 }
 
+void DecodeDXT1BlocksBasic(u32 *dst, const DXT1Block *src, int count, int pitch) {
+	for (int i = 0; i < count; ++i) {
+		DecodeDXT1Block(dst + i * 4, src + i, pitch);
+	}
+}
+
+void DecodeDXT3BlocksBasic(u32 *dst, const DXT3Block *src, int count, int pitch) {
+	for (int i = 0; i < count; ++i) {
+		DecodeDXT3Block(dst + i * 4, src + i, pitch);
+	}
+}
+
+void DecodeDXT5BlocksBasic(u32 *dst, const DXT5Block *src, int count, int pitch) {
+	for (int i = 0; i < count; ++i) {
+		DecodeDXT5Block(dst + i * 4, src + i, pitch);
+	}
+}
+
+#ifdef _M_SSE
+// The SIMD versions work out the colors of 8 blocks at once, with the same math as DecodeDXT1Block.
+static const int DXT_BATCH = 8;
+
+static inline u32 DXTColorWord(const DXT1Block &block) {
+	return (u32)block.color1 | ((u32)block.color2 << 16);
+}
+
+// All 16 color indices, 2 bits each.
+static inline u32 DXTLines(const DXT1Block &block) {
+	return block.lines[0] | (block.lines[1] << 8) | (block.lines[2] << 16) | ((u32)block.lines[3] << 24);
+}
+
+static inline __m128i SelectSSE2(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i MakeColorsSSE2(__m128i r, __m128i g, __m128i b, __m128i a, bool high) {
+	const __m128i lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	const __m128i hi = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+	return high ? _mm_unpackhi_epi16(lo, hi) : _mm_unpacklo_epi16(lo, hi);
+}
+
+// Fills colors with the 4 colors of each block, from color1 | (color2 << 16) of each.
+static inline void DecodeDXTColorsSSE2(u32 colors[DXT_BATCH][4], const u32 colorWords[DXT_BATCH], bool ignore1bitAlpha) {
+	const __m128i w0 = _mm_loadu_si128((const __m128i *)colorWords);
+	const __m128i w1 = _mm_loadu_si128((const __m128i *)(colorWords + 4));
+	// Sign extended, so the pack doesn't saturate.
+	const __m128i c1 = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(w0, 16), 16), _mm_srai_epi32(_mm_slli_epi32(w1, 16), 16));
+	const __m128i c2 = _mm_packs_epi32(_mm_srai_epi32(w0, 16), _mm_srai_epi32(w1, 16));
+
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask6 = _mm_set1_epi16(0x3F);
+	__m128i r1 = _mm_and_si128(c1, mask5);
+	__m128i g1 = _mm_and_si128(_mm_srli_epi16(c1, 5), mask6);
+	__m128i b1 = _mm_srli_epi16(c1, 11);
+	__m128i r2 = _mm_and_si128(c2, mask5);
+	__m128i g2 = _mm_and_si128(_mm_srli_epi16(c2, 5), mask6);
+	__m128i b2 = _mm_srli_epi16(c2, 11);
+	r1 = _mm_or_si128(_mm_slli_epi16(r1, 3), _mm_srli_epi16(r1, 2));
+	g1 = _mm_or_si128(_mm_slli_epi16(g1, 2), _mm_srli_epi16(g1, 4));
+	b1 = _mm_or_si128(_mm_slli_epi16(b1, 3), _mm_srli_epi16(b1, 2));
+	r2 = _mm_or_si128(_mm_slli_epi16(r2, 3), _mm_srli_epi16(r2, 2));
+	g2 = _mm_or_si128(_mm_slli_epi16(g2, 2), _mm_srli_epi16(g2, 4));
+	b2 = _mm_or_si128(_mm_slli_epi16(b2, 3), _mm_srli_epi16(b2, 2));
+
+	// Where color1 > color2, the other two are interpolated, otherwise an average and transparent.
+	__m128i interp = _mm_set1_epi32(-1);
+	if (!ignore1bitAlpha) {
+		const __m128i flip = _mm_set1_epi16((short)0x8000);
+		interp = _mm_cmpgt_epi16(_mm_xor_si128(c1, flip), _mm_xor_si128(c2, flip));
+	}
+	__m128i r3, r4, g3, g4, b3, b4;
+#define INTERPOLATE(x) { \
+		const __m128i d = _mm_sub_epi16(x##2, x##1); \
+		const __m128i t = _mm_sub_epi16(_mm_srai_epi16(d, 1), _mm_srai_epi16(d, 3)); \
+		x##3 = SelectSSE2(interp, _mm_add_epi16(x##1, t), _mm_avg_epu16(x##1, x##2)); \
+		x##4 = SelectSSE2(interp, _mm_sub_epi16(x##2, t), x##2); \
+	}
+	INTERPOLATE(r);
+	INTERPOLATE(g);
+	INTERPOLATE(b);
+#undef INTERPOLATE
+	const __m128i opaque = _mm_set1_epi16(0xFF);
+	const __m128i a4 = _mm_and_si128(interp, opaque);
+
+	for (int half = 0; half < 2; ++half) {
+		const __m128i e0 = MakeColorsSSE2(r1, g1, b1, opaque, half != 0);
+		const __m128i e1 = MakeColorsSSE2(r2, g2, b2, opaque, half != 0);
+		const __m128i e2 = MakeColorsSSE2(r3, g3, b3, opaque, half != 0);
+		const __m128i e3 = MakeColorsSSE2(r4, g4, b4, a4, half != 0);
+		// Transpose from color by color to block by block.
+		const __m128i t0 = _mm_unpacklo_epi32(e0, e1);
+		const __m128i t1 = _mm_unpacklo_epi32(e2, e3);
+		const __m128i t2 = _mm_unpackhi_epi32(e0, e1);
+		const __m128i t3 = _mm_unpackhi_epi32(e2, e3);
+		__m128i *dest = (__m128i *)colors[half * 4];
+		_mm_storeu_si128(dest + 0, _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128(dest + 1, _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128(dest + 2, _mm_unpacklo_epi64(t2, t3));
+		_mm_storeu_si128(dest + 3, _mm_unpackhi_epi64(t2, t3));
+	}
+}
+
+// The colors of each line of a block.  Each pixel's is color 0, xored with the difference to
+// the color its index matches, if any.
+static inline void LookupDXTColorsSSE2(const DXT1Block &block, const u32 colors[4], __m128i lines[4]) {
+	const __m128i palette = _mm_loadu_si128((const __m128i *)colors);
+	const __m128i c0 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128i x1 = _mm_xor_si128(c0, _mm_shuffle_epi32(palette, _MM_SHUFFLE(1, 1, 1, 1)));
+	const __m128i x2 = _mm_xor_si128(c0, _mm_shuffle_epi32(palette, _MM_SHUFFLE(2, 2, 2, 2)));
+	const __m128i x3 = _mm_xor_si128(c0, _mm_shuffle_epi32(palette, _MM_SHUFFLE(3, 3, 3, 3)));
+	const __m128i mask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+	const __m128i index1 = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+	const __m128i index2 = _mm_setr_epi32(2, 2 << 2, 2 << 4, 2 << 6);
+	__m128i indices = _mm_set1_epi32(DXTLines(block));
+	for (int y = 0; y < 4; y++) {
+		const __m128i index = _mm_and_si128(indices, mask);
+		__m128i color = _mm_xor_si128(c0, _mm_and_si128(_mm_cmpeq_epi32(index, index1), x1));
+		color = _mm_xor_si128(color, _mm_and_si128(_mm_cmpeq_epi32(index, index2), x2));
+		lines[y] = _mm_xor_si128(color, _mm_and_si128(_mm_cmpeq_epi32(index, mask), x3));
+		indices = _mm_srli_epi32(indices, 8);
+	}
+}
+
+// The 8 alpha values of a DXT5 block, shifted into place.  Uses the same float math as lerp8/lerp6.
+static inline void DecodeDXT5AlphaSSE2(__m128i &lo, __m128i &hi, const DXT5Block &block) {
+	static const float lerp7[8] = { 0.0f, 1.0f, 1 / 7.0f, 2 / 7.0f, 3 / 7.0f, 4 / 7.0f, 5 / 7.0f, 6 / 7.0f };
+	static const float lerp5[8] = { 0.0f, 1.0f, 1 / 5.0f, 2 / 5.0f, 3 / 5.0f, 4 / 5.0f, 0.0f, 0.0f };
+	const bool eight = block.alpha1 > block.alpha2;
+	const float *lerp = eight ? lerp7 : lerp5;
+
+	const __m128 a1 = _mm_set1_ps((float)block.alpha1);
+	const __m128 d = _mm_set1_ps((float)(block.alpha2 - block.alpha1));
+	lo = _mm_cvttps_epi32(_mm_add_ps(a1, _mm_mul_ps(d, _mm_loadu_ps(lerp))));
+	hi = _mm_cvttps_epi32(_mm_add_ps(a1, _mm_mul_ps(d, _mm_loadu_ps(lerp + 4))));
+	// Otherwise the last two are 0 and 255.  Without a branch, since the mode is often random.
+	const __m128i fixed = _mm_and_si128(_mm_set1_epi32(eight ? 0 : -1), _mm_setr_epi32(0, 0, -1, -1));
+	hi = _mm_or_si128(_mm_andnot_si128(fixed, hi), _mm_and_si128(fixed, _mm_setr_epi32(0, 0, 0, 255)));
+	lo = _mm_slli_epi32(lo, 24);
+	hi = _mm_slli_epi32(hi, 24);
+}
+
+void DecodeDXT1BlocksSSE2(u32 *dst, const DXT1Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j]) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, false);
+
+		for (int j = 0; j < n; ++j) {
+			__m128i lines[4];
+			LookupDXTColorsSSE2(src[i + j], colors[j], lines);
+			u32 *d = dst + (i + j) * 4;
+			for (int y = 0; y < 4; y++) {
+				_mm_storeu_si128((__m128i *)d, lines[y]);
+				d += pitch;
+			}
+		}
+	}
+}
+
+void DecodeDXT3BlocksSSE2(u32 *dst, const DXT3Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	const __m128i alphaShifts = _mm_setr_epi32(1 << 12, 1 << 8, 1 << 4, 1);
+	const __m128i alphaMask = _mm_set1_epi32(0xF000);
+	const __m128i colorMask = _mm_set1_epi32(0xFFFFFF);
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j].color) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, true);
+
+		for (int j = 0; j < n; ++j) {
+			const DXT3Block &block = src[i + j];
+			__m128i lines[4];
+			LookupDXTColorsSSE2(block.color, colors[j], lines);
+			u32 *d = dst + (i + j) * 4;
+			for (int y = 0; y < 4; y++) {
+				// Each pixel's nibble is moved to the top of the low 16 bits by multiplying, then doubled.
+				const __m128i line = _mm_set1_epi32(block.alphaLines[y]);
+				__m128i alpha = _mm_and_si128(_mm_mullo_epi16(line, alphaShifts), alphaMask);
+				alpha = _mm_slli_epi32(_mm_or_si128(alpha, _mm_srli_epi16(alpha, 4)), 16);
+				_mm_storeu_si128((__m128i *)d, _mm_or_si128(_mm_and_si128(lines[y], colorMask), alpha));
+				d += pitch;
+			}
+		}
+	}
+}
+
+void DecodeDXT5BlocksSSE2(u32 *dst, const DXT5Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	u32 alphas[8];
+	const __m128i colorMask = _mm_set1_epi32(0xFFFFFF);
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j].color) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, true);
+
+		for (int j = 0; j < n; ++j) {
+			const DXT5Block &block = src[i + j];
+			__m128i alphaLo, alphaHi;
+			DecodeDXT5AlphaSSE2(alphaLo, alphaHi, block);
+			_mm_storeu_si128((__m128i *)alphas, alphaLo);
+			_mm_storeu_si128((__m128i *)(alphas + 4), alphaHi);
+			__m128i lines[4];
+			LookupDXTColorsSSE2(block.color, colors[j], lines);
+			u64 data = ((u64)(u16)block.alphadata1 << 32) | (u32)block.alphadata2;
+			u32 *d = dst + (i + j) * 4;
+			for (int y = 0; y < 4; y++) {
+				const __m128i alpha = _mm_setr_epi32(alphas[data & 7], alphas[(data >> 3) & 7], alphas[(data >> 6) & 7], alphas[(data >> 9) & 7]);
+				_mm_storeu_si128((__m128i *)d, _mm_or_si128(_mm_and_si128(lines[y], colorMask), alpha));
+				data >>= 12;
+				d += pitch;
+			}
+		}
+	}
+}
+
+#ifdef HAVE_AVX2_INTRINSICS
+// With AVX2, two lines of a block at a time look up their colors with vpermd.
+AVX2_TARGET static inline void StoreDXTLinesAVX2(u32 *dst, __m256i top, __m256i bottom, int pitch) {
+	_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(top));
+	_mm_storeu_si128((__m128i *)(dst + pitch), _mm256_extracti128_si256(top, 1));
+	_mm_storeu_si128((__m128i *)(dst + pitch * 2), _mm256_castsi256_si128(bottom));
+	_mm_storeu_si128((__m128i *)(dst + pitch * 3), _mm256_extracti128_si256(bottom, 1));
+}
+
+// The colors of a block's pixels, the first two lines in top and the last two in bottom.
+AVX2_TARGET static inline void LookupDXTColorsAVX2(const DXT1Block &block, const u32 colors[4], __m256i &top, __m256i &bottom) {
+	const __m256i palette = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)colors));
+	const __m256i lines = _mm256_set1_epi32(DXTLines(block));
+	const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i mask = _mm256_set1_epi32(3);
+	top = _mm256_permutevar8x32_epi32(palette, _mm256_and_si256(_mm256_srlv_epi32(lines, shifts), mask));
+	bottom = _mm256_permutevar8x32_epi32(palette, _mm256_and_si256(_mm256_srlv_epi32(lines, _mm256_add_epi32(shifts, _mm256_set1_epi32(16))), mask));
+}
+
+AVX2_TARGET void DecodeDXT1BlocksAVX2(u32 *dst, const DXT1Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j]) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, false);
+
+		for (int j = 0; j < n; ++j) {
+			__m256i top, bottom;
+			LookupDXTColorsAVX2(src[i + j], colors[j], top, bottom);
+			StoreDXTLinesAVX2(dst + (i + j) * 4, top, bottom, pitch);
+		}
+	}
+}
+
+AVX2_TARGET void DecodeDXT3BlocksAVX2(u32 *dst, const DXT3Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256i mask = _mm256_set1_epi32(0xF);
+	const __m256i colorMask = _mm256_set1_epi32(0xFFFFFF);
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j].color) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, true);
+
+		for (int j = 0; j < n; ++j) {
+			const DXT3Block &block = src[i + j];
+			__m256i top, bottom;
+			LookupDXTColorsAVX2(block.color, colors[j], top, bottom);
+
+			const __m256i topLines = _mm256_set1_epi32(block.alphaLines[0] | ((u32)block.alphaLines[1] << 16));
+			const __m256i bottomLines = _mm256_set1_epi32(block.alphaLines[2] | ((u32)block.alphaLines[3] << 16));
+			__m256i topAlpha = _mm256_and_si256(_mm256_srlv_epi32(topLines, shifts), mask);
+			__m256i bottomAlpha = _mm256_and_si256(_mm256_srlv_epi32(bottomLines, shifts), mask);
+			topAlpha = _mm256_or_si256(_mm256_slli_epi32(topAlpha, 24), _mm256_slli_epi32(topAlpha, 28));
+			bottomAlpha = _mm256_or_si256(_mm256_slli_epi32(bottomAlpha, 24), _mm256_slli_epi32(bottomAlpha, 28));
+			top = _mm256_or_si256(_mm256_and_si256(top, colorMask), topAlpha);
+			bottom = _mm256_or_si256(_mm256_and_si256(bottom, colorMask), bottomAlpha);
+			StoreDXTLinesAVX2(dst + (i + j) * 4, top, bottom, pitch);
+		}
+	}
+}
+
+AVX2_TARGET void DecodeDXT5BlocksAVX2(u32 *dst, const DXT5Block *src, int count, int pitch) {
+	u32 colorWords[DXT_BATCH];
+	u32 colors[DXT_BATCH][4];
+	const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i mask = _mm256_set1_epi32(7);
+	const __m256i colorMask = _mm256_set1_epi32(0xFFFFFF);
+	for (int i = 0; i < count; i += DXT_BATCH) {
+		const int n = std::min(count - i, DXT_BATCH);
+		for (int j = 0; j < DXT_BATCH; ++j) {
+			colorWords[j] = j < n ? DXTColorWord(src[i + j].color) : 0;
+		}
+		DecodeDXTColorsSSE2(colors, colorWords, true);
+
+		for (int j = 0; j < n; ++j) {
+			const DXT5Block &block = src[i + j];
+			__m256i top, bottom;
+			LookupDXTColorsAVX2(block.color, colors[j], top, bottom);
+
+			__m128i alphaLo, alphaHi;
+			DecodeDXT5AlphaSSE2(alphaLo, alphaHi, block);
+			const __m256i palette = _mm256_inserti128_si256(_mm256_castsi128_si256(alphaLo), alphaHi, 1);
+			// 3 bits per pixel, so 24 bits for each pair of lines.
+			const u64 data = ((u64)(u16)block.alphadata1 << 32) | (u32)block.alphadata2;
+			const __m256i topIndices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((u32)data), shifts), mask);
+			const __m256i bottomIndices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((u32)(data >> 24)), shifts), mask);
+			top = _mm256_or_si256(_mm256_and_si256(top, colorMask), _mm256_permutevar8x32_epi32(palette, topIndices));
+			bottom = _mm256_or_si256(_mm256_and_si256(bottom, colorMask), _mm256_permutevar8x32_epi32(palette, bottomIndices));
+			StoreDXTLinesAVX2(dst + (i + j) * 4, top, bottom, pitch);
+		}
+	}
+}
+#endif
+#endif
+
 void ConvertBGRA8888ToRGBA8888(u32 *dst, const u32 *src, const u32 numPixels) {
 #ifdef _M_SSE
 	const __m128i maskGA = _mm_set1_epi32(0xFF00FF00);
@@ -24,31 +24,68 @@
 
 void SetupTextureDecoder();
 
-#ifdef _M_SSE
-u32 QuickTexHashSSE2(const void *checkp, u32 size);
-#define DoQuickTexHash QuickTexHashSSE2
+typedef u32 (*QuickTexHashFunc)(const void *checkp, u32 size);
+extern QuickTexHashFunc DoQuickTexHash;
+
+typedef void (*UnswizzleTex16Func)(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch, u32 rowWidth);
+extern UnswizzleTex16Func DoUnswizzleTex16;
+
+// CLUT lookups for when isClutIndexSimple(), with length in pixels.
+typedef void (*DeIndexTexture16Func)(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+typedef void (*DeIndexTexture32Func)(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+extern DeIndexTexture16Func DoDeIndexTexture4To16;
+extern DeIndexTexture32Func DoDeIndexTexture4To32;
+// May read one entry past the last used one, which the CLUT buffers always have room for.
+extern DeIndexTexture16Func DoDeIndexTexture8To16;
+extern DeIndexTexture32Func DoDeIndexTexture8To32;
 
 void DoUnswizzleTex16Basic(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch, u32 rowWidth);
-#define DoUnswizzleTex16 DoUnswizzleTex16Basic
+void DeIndexTexture4To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+void DeIndexTexture8To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture8To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+
+#ifdef _M_SSE
+// SSSE3 and AVX2 functions are built regardless of the compiler's target, and only picked if the CPU has it.
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+#define HAVE_AVX2_INTRINSICS
+#define SSSE3_TARGET
+#define SSE41_TARGET
+#define AVX2_TARGET
+#elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define HAVE_AVX2_INTRINSICS
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+u32 QuickTexHashSSE2(const void *checkp, u32 size);
+#ifdef HAVE_AVX2_INTRINSICS
+u32 QuickTexHashAVX2(const void *checkp, u32 size);
+// Not XXH64, but about twice as fast on large inputs.
+u64 ReliableHash64AVX2(const void *input, size_t len, u64 seed);
+
+void DoUnswizzleTex16AVX2(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch, u32 rowWidth);
+void DeIndexTexture4To16SSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4To32SSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+void DeIndexTexture8To16AVX2(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture8To32AVX2(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+#endif
 
 #include "ext/xxhash.h"
 #define DoReliableHash32 XXH32
-#define DoReliableHash64 XXH64
+
+typedef u64 (*ReliableHash64Func)(const void *input, size_t len, u64 seed);
+extern ReliableHash64Func DoReliableHash64;
 
 #ifdef _M_X64
-#define DoReliableHash XXH64
+#define DoReliableHash DoReliableHash64
 typedef u64 ReliableHashType;
 #else
 #define DoReliableHash XXH32
 typedef u32 ReliableHashType;
 #endif
 #else
-typedef u32 (*QuickTexHashFunc)(const void *checkp, u32 size);
-extern QuickTexHashFunc DoQuickTexHash;
-
-typedef void (*UnswizzleTex16Func)(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch, u32 rowWidth);
-extern UnswizzleTex16Func DoUnswizzleTex16;
-
 typedef u32 (*ReliableHash32Func)(const void *input, size_t len, u32 seed);
 extern ReliableHash32Func DoReliableHash32;
 
@@ -84,6 +121,28 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, bool ignore1bitA
 void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch);
 void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch);
 
+// These decode count blocks side by side, so a row of 4 lines of pixels.
+typedef void (*DecodeDXT1BlocksFunc)(u32 *dst, const DXT1Block *src, int count, int pitch);
+typedef void (*DecodeDXT3BlocksFunc)(u32 *dst, const DXT3Block *src, int count, int pitch);
+typedef void (*DecodeDXT5BlocksFunc)(u32 *dst, const DXT5Block *src, int count, int pitch);
+extern DecodeDXT1BlocksFunc DoDecodeDXT1Blocks;
+extern DecodeDXT3BlocksFunc DoDecodeDXT3Blocks;
+extern DecodeDXT5BlocksFunc DoDecodeDXT5Blocks;
+
+void DecodeDXT1BlocksBasic(u32 *dst, const DXT1Block *src, int count, int pitch);
+void DecodeDXT3BlocksBasic(u32 *dst, const DXT3Block *src, int count, int pitch);
+void DecodeDXT5BlocksBasic(u32 *dst, const DXT5Block *src, int count, int pitch);
+#ifdef _M_SSE
+void DecodeDXT1BlocksSSE2(u32 *dst, const DXT1Block *src, int count, int pitch);
+void DecodeDXT3BlocksSSE2(u32 *dst, const DXT3Block *src, int count, int pitch);
+void DecodeDXT5BlocksSSE2(u32 *dst, const DXT5Block *src, int count, int pitch);
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+void DecodeDXT1BlocksAVX2(u32 *dst, const DXT1Block *src, int count, int pitch);
+void DecodeDXT3BlocksAVX2(u32 *dst, const DXT3Block *src, int count, int pitch);
+void DecodeDXT5BlocksAVX2(u32 *dst, const DXT5Block *src, int count, int pitch);
+#endif
+
 static const u8 textureBitsPerPixel[16] = {
 	16,  //GE_TFMT_5650,
 	16,  //GE_TFMT_5551,
@@ -123,12 +182,12 @@ static const u32 textureAlignMask16[16] = {
 	0,   // INVALID,
 };
 
-static inline u32 GetTextureBufw(int level, u32 texaddr, GETextureFormat format) {
+static inline u32 GetTextureBufw(int level, u32 texaddr, GETextureFormat format, const GPUgstate &state = gstate) {
 	// This is a hack to allow for us to draw the huge PPGe texture, which is always in kernel ram.
 	if (texaddr < PSP_GetKernelMemoryEnd())
-		return gstate.texbufwidth[level] & 0x1FFF;
+		return state.texbufwidth[level] & 0x1FFF;
 
-	u32 bufw = gstate.texbufwidth[level] & textureAlignMask16[format];
+	u32 bufw = state.texbufwidth[level] & textureAlignMask16[format];
 	if (bufw == 0) {
 		// If it's less than 16 bytes, use 16 bytes.
 		bufw = (8 * 16) / textureBitsPerPixel[format];
@@ -137,9 +196,9 @@ static inline u32 GetTextureBufw(int level, u32 texaddr, GETextureFormat format)
 }
 
 template <typename IndexT, typename ClutT>
-inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const ClutT *clut) {
+inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const ClutT *clut, const GPUgstate &state) {
 	// Usually, there is no special offset, mask, or shift.
-	const bool nakedIndex = gstate.isClutIndexSimple();
+	const bool nakedIndex = state.isClutIndexSimple();
 
 	if (nakedIndex) {
 		if (sizeof(IndexT) == 1) {
@@ -153,7 +212,7 @@ inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const
 		}
 	} else {
 		for (int i = 0; i < length; ++i) {
-			*dest++ = clut[gstate.transformClutIndex(*indexed++)];
+			*dest++ = clut[state.transformClutIndex(*indexed++)];
 		}
 	}
 }
@@ -161,13 +220,13 @@ inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const
 template <typename IndexT, typename ClutT>
 inline void DeIndexTexture(ClutT *dest, const u32 texaddr, int length, const ClutT *clut) {
 	const IndexT *indexed = (const IndexT *) Memory::GetPointer(texaddr);
-	DeIndexTexture(dest, indexed, length, clut);
+	DeIndexTexture(dest, indexed, length, clut, gstate);
 }
 
 template <typename ClutT>
-inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
+inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const ClutT *clut, const GPUgstate &state) {
 	// Usually, there is no special offset, mask, or shift.
-	const bool nakedIndex = gstate.isClutIndexSimple();
+	const bool nakedIndex = state.isClutIndexSimple();
 
 	if (nakedIndex) {
 		for (int i = 0; i < length; i += 2) {
@@ -178,8 +237,8 @@ inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const Cl
 	} else {
 		for (int i = 0; i < length; i += 2) {
 			u8 index = *indexed++;
-			dest[i + 0] = clut[gstate.transformClutIndex((index >> 0) & 0xf)];
-			dest[i + 1] = clut[gstate.transformClutIndex((index >> 4) & 0xf)];
+			dest[i + 0] = clut[state.transformClutIndex((index >> 0) & 0xf)];
+			dest[i + 1] = clut[state.transformClutIndex((index >> 4) & 0xf)];
 		}
 	}
 }
@@ -205,10 +264,55 @@ inline void DeIndexTexture4Optimal<u16>(u16 *dest, const u8 *indexed, int length
 	}
 }
 
+// Like the above, but for formats with alpha in the top 4 bits.
+inline void DeIndexTexture4OptimalRev(u16 *dest, const u8 *indexed, int length, u16 color) {
+	const u16_le *indexed16 = (const u16_le *)indexed;
+	const u32 color32 = (color << 16) | color;
+	u32 *dest32 = (u32 *)dest;
+	for (int i = 0; i < length / 2; i += 2) {
+		u16 index = *indexed16++;
+		dest32[i + 0] = color32 | ((index & 0x00f0) << 24) | ((index & 0x000f) << 12);
+		dest32[i + 1] = color32 | ((index & 0xf000) << 16) | ((index & 0x0f00) <<  4);
+	}
+}
+
+// These are picked over the templates, to use the fast versions in the usual case.
+inline void DeIndexTexture(u16 *dest, const u8 *indexed, int length, const u16 *clut, const GPUgstate &state) {
+	if (state.isClutIndexSimple()) {
+		DoDeIndexTexture8To16(dest, indexed, length, clut);
+	} else {
+		DeIndexTexture<u8, u16>(dest, indexed, length, clut, state);
+	}
+}
+
+inline void DeIndexTexture(u32 *dest, const u8 *indexed, int length, const u32 *clut, const GPUgstate &state) {
+	if (state.isClutIndexSimple()) {
+		DoDeIndexTexture8To32(dest, indexed, length, clut);
+	} else {
+		DeIndexTexture<u8, u32>(dest, indexed, length, clut, state);
+	}
+}
+
+inline void DeIndexTexture4(u16 *dest, const u8 *indexed, int length, const u16 *clut, const GPUgstate &state) {
+	if (state.isClutIndexSimple()) {
+		DoDeIndexTexture4To16(dest, indexed, length, clut);
+	} else {
+		DeIndexTexture4<u16>(dest, indexed, length, clut, state);
+	}
+}
+
+inline void DeIndexTexture4(u32 *dest, const u8 *indexed, int length, const u32 *clut, const GPUgstate &state) {
+	if (state.isClutIndexSimple()) {
+		DoDeIndexTexture4To32(dest, indexed, length, clut);
+	} else {
+		DeIndexTexture4<u32>(dest, indexed, length, clut, state);
+	}
+}
+
 template <typename ClutT>
 inline void DeIndexTexture4(ClutT *dest, const u32 texaddr, int length, const ClutT *clut) {
 	const u8 *indexed = (const u8 *) Memory::GetPointer(texaddr);
-	DeIndexTexture4(dest, indexed, length, clut);
+	DeIndexTexture4(dest, indexed, length, clut, gstate);
 }
 
 template <typename ClutT>
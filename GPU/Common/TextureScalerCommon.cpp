@@ -0,0 +1,1163 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#if _MSC_VER == 1700
+// Has to be included before TextureScalerCommon.h, else we get those std::bind errors in VS2012..
+#include "../native/base/basictypes.h"
+#endif
+
+#include <algorithm>
+#include "GPU/Common/TextureScalerCommon.h"
+
+#include "Core/Config.h"
+#include "Common/Common.h"
+#include "Common/Log.h"
+#include "Common/MsgHandler.h"
+#include "Common/CommonFuncs.h"
+#include "Common/ThreadPools.h"
+#include "Common/CPUDetect.h"
+// For the SSE4.1 and AVX2 target macros.
+#include "GPU/Common/TextureDecoder.h"
+#include "ext/xbrz/xbrz.h"
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef HAVE_AVX2_INTRINSICS
+#include <immintrin.h>
+#endif
+
+// Report the time and throughput for each larger scaling operation in the log
+//#define SCALING_MEASURE_TIME
+
+#ifdef SCALING_MEASURE_TIME
+#include "native/base/timeutil.h"
+#endif
+
+/////////////////////////////////////// Helper Functions (mostly math for parallelization)
+
+namespace {
+	//////////////////////////////////////////////////////////////////// Various image processing
+
+	#define R(_col) ((_col>> 0)&0xFF)
+	#define G(_col) ((_col>> 8)&0xFF)
+	#define B(_col) ((_col>>16)&0xFF)
+	#define A(_col) ((_col>>24)&0xFF)
+
+	#define DISTANCE(_p1,_p2) ( abs(static_cast<int>(static_cast<int>(R(_p1))-R(_p2))) + abs(static_cast<int>(static_cast<int>(G(_p1))-G(_p2))) \
+							  + abs(static_cast<int>(static_cast<int>(B(_p1))-B(_p2))) + abs(static_cast<int>(static_cast<int>(A(_p1))-A(_p2))) )
+
+	// this is sadly much faster than an inline function with a loop, at least in VC10
+	#define MIX_PIXELS(_p0, _p1, _factors) \
+		( (R(_p0)*(_factors)[0] + R(_p1)*(_factors)[1])/255 <<  0 ) | \
+		( (G(_p0)*(_factors)[0] + G(_p1)*(_factors)[1])/255 <<  8 ) | \
+		( (B(_p0)*(_factors)[0] + B(_p1)*(_factors)[1])/255 << 16 ) | \
+		( (A(_p0)*(_factors)[0] + A(_p1)*(_factors)[1])/255 << 24 )
+
+	#define BLOCK_SIZE 32
+
+	// one pixel of convolve3x3, also used for the borders by the SIMD versions
+	inline u32 convolvePixel(u32* data, const int kernel[3][3], int width, int height, int x, int y) {
+		int val = 0;
+		for(int yoff = -1; yoff <= 1; ++yoff) {
+			int yy = std::max(std::min(y+yoff, height-1), 0);
+			for(int xoff = -1; xoff <= 1; ++xoff) {
+				int xx = std::max(std::min(x+xoff, width-1), 0);
+				val += data[yy*width + xx] * kernel[yoff+1][xoff+1];
+			}
+		}
+		return abs(val);
+	}
+
+	// 3x3 convolution with Neumann boundary conditions, parallelizable
+	// quite slow, could be sped up a lot
+	// especially handling of separable kernels
+	void convolve3x3(u32* data, u32* out, const int kernel[3][3], int width, int height, int l, int u) {
+		for(int yb = 0; yb < (u-l)/BLOCK_SIZE+1; ++yb) {
+			for(int xb = 0; xb < width/BLOCK_SIZE+1; ++xb) {
+				for(int y = l+yb*BLOCK_SIZE; y < l+(yb+1)*BLOCK_SIZE && y < u; ++y) {
+					for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < width; ++x) {
+						out[y*width + x] = convolvePixel(data, kernel, width, height, x, y);
+					}
+				}
+			}
+		}
+	}
+
+	// deposterization: smoothes posterized gradients from low-color-depth (e.g. 444, 565, compressed) sources
+	// a and b are the neighbours on either side of center, left and right or upper and lower
+	inline u32 deposterizePixel(u32 a, u32 center, u32 b) {
+		static const int T = 8;
+		u32 result = 0;
+		for(int c=0; c<4; ++c) {
+			u8 ac = ((     a>>c*8)&0xFF);
+			u8 cc = ((center>>c*8)&0xFF);
+			u8 bc = ((     b>>c*8)&0xFF);
+			if((ac != bc) && ((ac == cc && abs((int)((int)bc)-cc) <= T) || (bc == cc && abs((int)((int)ac)-cc) <= T))) {
+				// blend this component
+				result |= ((bc+ac)/2) << (c*8);
+			} else {
+				// no change for this component
+				result |= cc << (c*8);
+			}
+		}
+		return result;
+	}
+	void deposterizeH(u32* data, u32* out, int w, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			for(int x = 0; x < w; ++x) {
+				int inpos = y*w + x;
+				u32 center = data[inpos];
+				if(x==0 || x==w-1) {
+					out[y*w + x] = center;
+					continue;
+				}
+				out[y*w + x] = deposterizePixel(data[inpos - 1], center, data[inpos + 1]);
+			}
+		}
+	}
+	void deposterizeV(u32* data, u32* out, int w, int h, int l, int u) {
+		for(int xb = 0; xb < w/BLOCK_SIZE+1; ++xb) {
+			for(int y = l; y < u; ++y) {
+				for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < w; ++x) {
+					u32 center = data[ y    * w + x];
+					if(y==0 || y==h-1) {
+						out[y*w + x] = center;
+						continue;
+					}
+					out[y*w + x] = deposterizePixel(data[(y-1) * w + x], center, data[(y+1) * w + x]);
+				}
+			}
+		}
+	}
+
+	// one pixel of generateDistanceMask, also used for the borders by the SIMD versions
+	inline u32 distanceMaskPixel(u32* data, int width, int height, int x, int y) {
+		u32 result = 0;
+		u32 center = data[y*width + x];
+		for(int yoff = -1; yoff <= 1; ++yoff) {
+			int yy = y+yoff;
+			if(yy == height || yy == -1) {
+				result += 1200; // assume distance at borders, usually makes for better result
+				continue;
+			}
+			for(int xoff = -1; xoff <= 1; ++xoff) {
+				if(yoff == 0 && xoff == 0) continue;
+				int xx = x+xoff;
+				if(xx == width || xx == -1) {
+					result += 400; // assume distance at borders, usually makes for better result
+					continue;
+				}
+				result += DISTANCE(data[yy*width + xx], center);
+			}
+		}
+		return result;
+	}
+
+	// generates a distance mask value for each pixel in data
+	// higher values -> larger distance to the surrounding pixels
+	void generateDistanceMask(u32* data, u32* out, int width, int height, int l, int u) {
+		for(int yb = 0; yb < (u-l)/BLOCK_SIZE+1; ++yb) {
+			for(int xb = 0; xb < width/BLOCK_SIZE+1; ++xb) {
+				for(int y = l+yb*BLOCK_SIZE; y < l+(yb+1)*BLOCK_SIZE && y < u; ++y) {
+					for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < width; ++x) {
+						out[y*width + x] = distanceMaskPixel(data, width, height, x, y);
+					}
+				}
+			}
+		}
+	}
+
+	// one pixel of mix, also used for the tails by the SIMD versions
+	inline u32 mixPixel(u32 data, u32 source, u32 mask, u32 maskmax) {
+		u8 mixFactors[2] = { 0, static_cast<u8>((std::min(mask, maskmax)*255)/maskmax) };
+		mixFactors[0] = 255-mixFactors[1];
+		u32 result = MIX_PIXELS(data, source, mixFactors);
+		if(A(source) == 0) result = result & 0x00FFFFFF; // xBRZ always does a better job with hard alpha
+		return result;
+	}
+
+	// mix two images based on a mask
+	void mix(u32* data, u32* source, u32* mask, u32 maskmax, int width, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			for(int x = 0; x < width; ++x) {
+				int pos = y*width + x;
+				data[pos] = mixPixel(data[pos], source[pos], mask[pos], maskmax);
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////// Bicubic scaling
+
+	// generate the value of a Mitchell-Netravali scaling spline at distance d, with parameters A and B
+	// B=1 C=0   : cubic B spline (very smooth)
+	// B=C=1/3   : recommended for general upscaling
+	// B=0 C=1/2 : Catmull-Rom spline (sharp, ringing)
+	// see Mitchell & Netravali, "Reconstruction Filters in Computer Graphics"
+	inline float mitchell(float x, float B, float C) {
+		float ax = fabs(x);
+		if(ax>=2.0f) return 0.0f;
+		if(ax>=1.0f) return ((-B-6*C)*(x*x*x) + (6*B+30*C)*(x*x) + (-12*B-48*C)*x + (8*B+24*C))/6.0f;
+		return ((12-9*B-6*C)*(x*x*x) + (-18+12*B+6*C)*(x*x) + (6-2*B))/6.0f;
+	}
+
+	// arrays for pre-calculating weights and sums (~20KB)
+	// Dimensions:
+	//   0: 0 = BSpline, 1 = mitchell
+	//   2: 2-5x scaling
+	// 2,3: 5x5 generated pixels
+	// 4,5: 5x5 pixels sampled from
+	float bicubicWeights[2][4][5][5][5][5];
+	float bicubicInvSums[2][4][5][5];
+
+	// initialize pre-computed weights array
+	void initBicubicWeights() {
+		float B[2] = { 1.0f, 0.334f };
+		float C[2] = { 0.0f, 0.334f };
+		for(int type=0; type<2; ++type) {
+			for(int factor=2; factor<=5; ++factor) {
+				for(int x=0; x<factor; ++x) {
+					for(int y=0; y<factor; ++y) {
+						float sum = 0.0f;
+						for(int sx = -2; sx <= 2; ++sx) {
+							for(int sy = -2; sy <= 2; ++sy) {
+								float dx = (x+0.5f)/factor - (sx+0.5f);
+								float dy = (y+0.5f)/factor - (sy+0.5f);
+								float dist = sqrt(dx*dx + dy*dy);
+								float weight = mitchell(dist, B[type], C[type]);
+								bicubicWeights[type][factor-2][x][y][sx+2][sy+2] = weight;
+								sum += weight;
+							}
+						}
+						bicubicInvSums[type][factor-2][x][y] = 1.0f/sum;
+					}
+				}
+			}
+		}
+	}
+
+	// perform bicubic scaling by factor f, with precomputed spline type T
+	template<int f, int T>
+	void scaleBicubicT(u32* data, u32* out, int w, int h, int l, int u) {
+		int outw = w*f;
+		for(int yb = 0; yb < (u-l)*f/BLOCK_SIZE+1; ++yb) {
+			for(int xb = 0; xb < w*f/BLOCK_SIZE+1; ++xb) {
+				for(int y = l*f+yb*BLOCK_SIZE; y < l*f+(yb+1)*BLOCK_SIZE && y < u*f; ++y) {
+					for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < w*f; ++x) {
+						float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+						int cx = x/f, cy = y/f;
+						// sample supporting pixels in original image
+						for(int sx = -2; sx <= 2; ++sx) {
+							for(int sy = -2; sy <= 2; ++sy) {
+								float weight = bicubicWeights[T][f-2][x%f][y%f][sx+2][sy+2];
+								if(weight != 0.0f) {
+									// clamp pixel locations
+									int csy = std::max(std::min(sy+cy,h-1),0);
+									int csx = std::max(std::min(sx+cx,w-1),0);
+									// sample & add weighted components
+									u32 sample = data[csy*w+csx];
+									r += weight*R(sample);
+									g += weight*G(sample);
+									b += weight*B(sample);
+									a += weight*A(sample);
+								}
+							}
+						}
+						// generate and write result
+						float invSum = bicubicInvSums[T][f-2][x%f][y%f];
+						int ri = std::min(std::max(static_cast<int>(ceilf(r*invSum)),0),255);
+						int gi = std::min(std::max(static_cast<int>(ceilf(g*invSum)),0),255);
+						int bi = std::min(std::max(static_cast<int>(ceilf(b*invSum)),0),255);
+						int ai = std::min(std::max(static_cast<int>(ceilf(a*invSum)),0),255);
+						out[y*outw + x] = (ai << 24) | (bi << 16) | (gi << 8) | ri;
+					}
+				}
+			}
+		}
+	}
+
+	template<int T>
+	void scaleBicubic(int factor, u32* data, u32* out, int w, int h, int l, int u) {
+		switch(factor) {
+		case 2: scaleBicubicT<2, T>(data, out, w, h, l, u); break; // when I first tested this,
+		case 3: scaleBicubicT<3, T>(data, out, w, h, l, u); break; // it was even slower than I had expected
+		case 4: scaleBicubicT<4, T>(data, out, w, h, l, u); break; // turns out I had not included
+		case 5: scaleBicubicT<5, T>(data, out, w, h, l, u); break; // any of these break statements
+		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////// Bilinear scaling
+
+	const static u8 BILINEAR_FACTORS[4][3][2] = {
+		{ { 44,211}, {  0,  0}, {  0,  0} }, // x2
+		{ { 64,191}, {  0,255}, {  0,  0} }, // x3
+		{ { 77,178}, { 26,229}, {  0,  0} }, // x4
+		{ {102,153}, { 51,204}, {  0,255} }, // x5
+	};
+	// the f output pixels of input pixel x, also used for the borders by the SIMD versions
+	template<int f>
+	inline void bilinearHPixel(u32* row, u32* outRow, int w, int x) {
+		u32 left   = row[x - (x==0  ?0:1)];
+		u32 center = row[x];
+		u32 right  = row[x + (x==w-1?0:1)];
+		int i=0;
+		for(; i<f/2+f%2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
+			outRow[x*f + i] = MIX_PIXELS(left, center, BILINEAR_FACTORS[f-2][i]);
+		}
+		for(; i<f      ; ++i) { // second half of the new pixels, hope the compiler unrolls this
+			outRow[x*f + i] = MIX_PIXELS(right, center, BILINEAR_FACTORS[f-2][f-1-i]);
+		}
+	}
+	// integral bilinear upscaling by factor f, horizontal part
+	template<int f>
+	void bilinearHt(u32* data, u32* out, int w, int l, int u) {
+		static_assert(f>1 && f<=5, "Bilinear scaling only implemented for factors 2 to 5");
+		int outw = w*f;
+		for(int y = l; y < u; ++y) {
+			for(int x = 0; x < w; ++x) {
+				bilinearHPixel<f>(data + y*w, out + y*outw, w, x);
+			}
+		}
+	}
+	void bilinearH(int factor, u32* data, u32* out, int w, int l, int u) {
+		switch(factor) {
+		case 2: bilinearHt<2>(data, out, w, l, u); break;
+		case 3: bilinearHt<3>(data, out, w, l, u); break;
+		case 4: bilinearHt<4>(data, out, w, l, u); break;
+		case 5: bilinearHt<5>(data, out, w, l, u); break;
+		default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
+		}
+	}
+	// integral bilinear upscaling by factor f, vertical part
+	// gl/gu == global lower and upper bound
+	template<int f>
+	void bilinearVt(u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		static_assert(f>1 && f<=5, "Bilinear scaling only implemented for 2x, 3x, 4x, and 5x");
+		int outw = w*f;
+		for(int xb = 0; xb < outw/BLOCK_SIZE+1; ++xb) {
+			for(int y = l; y < u; ++y) {
+				u32 uy = y - (y==gl  ?0:1);
+				u32 ly = y + (y==gu-1?0:1);
+				for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < outw; ++x) {
+					u32 upper  = data[uy * outw + x];
+					u32 center = data[y * outw + x];
+					u32 lower  = data[ly * outw + x];
+					int i=0;
+					for(; i<f/2+f%2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
+						out[(y*f + i)*outw + x] = MIX_PIXELS(upper, center, BILINEAR_FACTORS[f-2][i]);
+					}
+					for(; i<f      ; ++i) { // second half of the new pixels, hope the compiler unrolls this
+						out[(y*f + i)*outw + x] = MIX_PIXELS(lower, center, BILINEAR_FACTORS[f-2][f-1-i]);
+					}
+				}
+			}
+		}
+	}
+	void bilinearV(int factor, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		switch(factor) {
+		case 2: bilinearVt<2>(data, out, w, gl, gu, l, u); break;
+		case 3: bilinearVt<3>(data, out, w, gl, gu, l, u); break;
+		case 4: bilinearVt<4>(data, out, w, gl, gu, l, u); break;
+		case 5: bilinearVt<5>(data, out, w, gl, gu, l, u); break;
+		default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	const ScalerKernels basicKernels = {
+		&bilinearH, &bilinearV, &scaleBicubic<0>, &scaleBicubic<1>,
+		&deposterizeH, &deposterizeV, &generateDistanceMask, &convolve3x3, &mix,
+	};
+
+#ifdef HAVE_AVX2_INTRINSICS
+	//////////////////////////////////////////////////////////////////// SSE4.1
+	// These give the same results as the functions above, except bicubic, which rounds instead of ceil.
+
+	// x/255 for 16-bit x up to 255*255, as in MIX_PIXELS
+	SSE41_TARGET inline __m128i div255SSE41(__m128i x) {
+		return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+	}
+
+	// MIX_PIXELS for 4 pixels, with 16-bit factors for each channel of pixels 0-1 (lo) and 2-3 (hi)
+	SSE41_TARGET inline __m128i mixPixelsSSE41(__m128i p0, __m128i p1, __m128i f0lo, __m128i f1lo, __m128i f0hi, __m128i f1hi) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero), f0lo), _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), f1lo));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero), f0hi), _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), f1hi));
+		return _mm_packus_epi16(div255SSE41(lo), div255SSE41(hi));
+	}
+
+	template<int f>
+	SSE41_TARGET void bilinearHtSSE41(u32* data, u32* out, int w, int l, int u) {
+		int outw = w*f;
+		// 4 input pixels make f vectors of output, each picking its centers and neighbours with a shuffle
+		__m128i shuffles[f], useLeft[f], f0lo[f], f1lo[f], f0hi[f], f1hi[f];
+		for(int v = 0; v < f; ++v) {
+			u8 shuffle[16];
+			u32 left[4];
+			u16 f0[8], f1[8];
+			for(int p = 0; p < 4; ++p) {
+				int k = (4*v + p)/f, i = (4*v + p)%f;
+				const u8 *factors = i<f/2+f%2 ? BILINEAR_FACTORS[f-2][i] : BILINEAR_FACTORS[f-2][f-1-i];
+				left[p] = i<f/2+f%2 ? 0xFFFFFFFF : 0;
+				for(int c = 0; c < 4; ++c) {
+					shuffle[p*4 + c] = k*4 + c;
+					f0[(p&1)*4 + c] = factors[0];
+					f1[(p&1)*4 + c] = factors[1];
+				}
+				if(p == 1) {
+					f0lo[v] = _mm_loadu_si128((const __m128i *)f0);
+					f1lo[v] = _mm_loadu_si128((const __m128i *)f1);
+				}
+			}
+			f0hi[v] = _mm_loadu_si128((const __m128i *)f0);
+			f1hi[v] = _mm_loadu_si128((const __m128i *)f1);
+			shuffles[v] = _mm_loadu_si128((const __m128i *)shuffle);
+			useLeft[v] = _mm_loadu_si128((const __m128i *)left);
+		}
+
+		for(int y = l; y < u; ++y) {
+			u32 *row = data + y*w;
+			u32 *outRow = out + y*outw;
+			bilinearHPixel<f>(row, outRow, w, 0);
+			int x = 1;
+			for(; x + 5 <= w; x += 4) {
+				__m128i left = _mm_loadu_si128((const __m128i *)(row + x - 1));
+				__m128i center = _mm_loadu_si128((const __m128i *)(row + x));
+				__m128i right = _mm_loadu_si128((const __m128i *)(row + x + 1));
+				for(int v = 0; v < f; ++v) {
+					__m128i other = _mm_blendv_epi8(_mm_shuffle_epi8(right, shuffles[v]), _mm_shuffle_epi8(left, shuffles[v]), useLeft[v]);
+					__m128i result = mixPixelsSSE41(other, _mm_shuffle_epi8(center, shuffles[v]), f0lo[v], f1lo[v], f0hi[v], f1hi[v]);
+					_mm_storeu_si128((__m128i *)(outRow + x*f + v*4), result);
+				}
+			}
+			for(; x < w; ++x) {
+				bilinearHPixel<f>(row, outRow, w, x);
+			}
+		}
+	}
+	void bilinearHSSE41(int factor, u32* data, u32* out, int w, int l, int u) {
+		switch(factor) {
+		case 2: bilinearHtSSE41<2>(data, out, w, l, u); break;
+		case 3: bilinearHtSSE41<3>(data, out, w, l, u); break;
+		case 4: bilinearHtSSE41<4>(data, out, w, l, u); break;
+		case 5: bilinearHtSSE41<5>(data, out, w, l, u); break;
+		default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	// each output row mixes two input rows with the same factors, so this goes along whole rows
+	template<int f>
+	SSE41_TARGET void bilinearVtSSE41(u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		int outw = w*f;
+		for(int y = l; y < u; ++y) {
+			const u32 *upper  = data + (y - (y==gl  ?0:1)) * outw;
+			const u32 *center = data + y * outw;
+			const u32 *lower  = data + (y + (y==gu-1?0:1)) * outw;
+			for(int i = 0; i < f; ++i) {
+				const u32 *other = i<f/2+f%2 ? upper : lower;
+				const u8 *factors = i<f/2+f%2 ? BILINEAR_FACTORS[f-2][i] : BILINEAR_FACTORS[f-2][f-1-i];
+				const __m128i f0 = _mm_set1_epi16(factors[0]);
+				const __m128i f1 = _mm_set1_epi16(factors[1]);
+				u32 *outRow = out + (y*f + i)*outw;
+				int x = 0;
+				for(; x + 4 <= outw; x += 4) {
+					__m128i o = _mm_loadu_si128((const __m128i *)(other + x));
+					__m128i c = _mm_loadu_si128((const __m128i *)(center + x));
+					_mm_storeu_si128((__m128i *)(outRow + x), mixPixelsSSE41(o, c, f0, f1, f0, f1));
+				}
+				for(; x < outw; ++x) {
+					outRow[x] = MIX_PIXELS(other[x], center[x], factors);
+				}
+			}
+		}
+	}
+	void bilinearVSSE41(int factor, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		switch(factor) {
+		case 2: bilinearVtSSE41<2>(data, out, w, gl, gu, l, u); break;
+		case 3: bilinearVtSSE41<3>(data, out, w, gl, gu, l, u); break;
+		case 4: bilinearVtSSE41<4>(data, out, w, gl, gu, l, u); break;
+		case 5: bilinearVtSSE41<5>(data, out, w, gl, gu, l, u); break;
+		default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	template<int f, int T>
+	SSE41_TARGET void scaleBicubicTSSE41(u32* data, u32* out, int w, int h, int l, int u) {
+		int outw = w*f;
+		for(int yb = 0; yb < (u-l)*f/BLOCK_SIZE+1; ++yb) {
+			for(int xb = 0; xb < w*f/BLOCK_SIZE+1; ++xb) {
+				for(int y = l*f+yb*BLOCK_SIZE; y < l*f+(yb+1)*BLOCK_SIZE && y < u*f; ++y) {
+					for(int x = xb*BLOCK_SIZE; x < (xb+1)*BLOCK_SIZE && x < w*f; ++x) {
+						__m128 result = _mm_set1_ps(0.0f);
+						int cx = x/f, cy = y/f;
+						// sample supporting pixels in original image
+						for(int sx = -2; sx <= 2; ++sx) {
+							for(int sy = -2; sy <= 2; ++sy) {
+								float weight = bicubicWeights[T][f-2][x%f][y%f][sx+2][sy+2];
+								if(weight != 0.0f) {
+									// clamp pixel locations
+									int csy = std::max(std::min(sy+cy,h-1),0);
+									int csx = std::max(std::min(sx+cx,w-1),0);
+									// sample & add weighted components
+									__m128i sample = _mm_cvtsi32_si128(data[csy*w+csx]);
+									sample = _mm_cvtepu8_epi32(sample);
+									__m128 col = _mm_cvtepi32_ps(sample);
+									col = _mm_mul_ps(col, _mm_set1_ps(weight));
+									result = _mm_add_ps(result, col);
+								}
+							}
+						}
+						// generate and write result
+						__m128i pixel = _mm_cvtps_epi32(_mm_mul_ps(result, _mm_set1_ps(bicubicInvSums[T][f-2][x%f][y%f])));
+						pixel = _mm_packs_epi32(pixel, pixel);
+						pixel = _mm_packus_epi16(pixel, pixel);
+						out[y*outw + x] = _mm_cvtsi128_si32(pixel);
+					}
+				}
+			}
+		}
+	}
+	template<int T>
+	void scaleBicubicSSE41(int factor, u32* data, u32* out, int w, int h, int l, int u) {
+		switch(factor) {
+		case 2: scaleBicubicTSSE41<2, T>(data, out, w, h, l, u); break;
+		case 3: scaleBicubicTSSE41<3, T>(data, out, w, h, l, u); break;
+		case 4: scaleBicubicTSSE41<4, T>(data, out, w, h, l, u); break;
+		case 5: scaleBicubicTSSE41<5, T>(data, out, w, h, l, u); break;
+		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	// deposterizePixel for each byte
+	SSE41_TARGET inline __m128i deposterizeSSE41(__m128i a, __m128i center, __m128i b) {
+		const __m128i T = _mm_set1_epi8(8);
+		const __m128i zero = _mm_setzero_si128();
+		__m128i aNear = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_or_si128(_mm_subs_epu8(a, center), _mm_subs_epu8(center, a)), T), zero);
+		__m128i bNear = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_or_si128(_mm_subs_epu8(b, center), _mm_subs_epu8(center, b)), T), zero);
+		__m128i blend = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(a, center), bNear), _mm_and_si128(_mm_cmpeq_epi8(b, center), aNear));
+		blend = _mm_andnot_si128(_mm_cmpeq_epi8(a, b), blend);
+		// avg rounds up, (a+b)/2 rounds down
+		__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+		return _mm_blendv_epi8(center, average, blend);
+	}
+	SSE41_TARGET void deposterizeHSSE41(u32* data, u32* out, int w, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *row = data + y*w;
+			u32 *outRow = out + y*w;
+			outRow[0] = row[0];
+			int x = 1;
+			for(; x + 5 <= w; x += 4) {
+				__m128i left = _mm_loadu_si128((const __m128i *)(row + x - 1));
+				__m128i center = _mm_loadu_si128((const __m128i *)(row + x));
+				__m128i right = _mm_loadu_si128((const __m128i *)(row + x + 1));
+				_mm_storeu_si128((__m128i *)(outRow + x), deposterizeSSE41(left, center, right));
+			}
+			for(; x < w; ++x) {
+				outRow[x] = x==w-1 ? row[x] : deposterizePixel(row[x - 1], row[x], row[x + 1]);
+			}
+		}
+	}
+	SSE41_TARGET void deposterizeVSSE41(u32* data, u32* out, int w, int h, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *center = data + y*w;
+			u32 *outRow = out + y*w;
+			if(y==0 || y==h-1) {
+				memcpy(outRow, center, w*sizeof(u32));
+				continue;
+			}
+			u32 *upper = center - w;
+			u32 *lower = center + w;
+			int x = 0;
+			for(; x + 4 <= w; x += 4) {
+				__m128i uc = _mm_loadu_si128((const __m128i *)(upper + x));
+				__m128i cc = _mm_loadu_si128((const __m128i *)(center + x));
+				__m128i lc = _mm_loadu_si128((const __m128i *)(lower + x));
+				_mm_storeu_si128((__m128i *)(outRow + x), deposterizeSSE41(uc, cc, lc));
+			}
+			for(; x < w; ++x) {
+				outRow[x] = deposterizePixel(upper[x], center[x], lower[x]);
+			}
+		}
+	}
+
+	// DISTANCE for 4 pixels, summed per pixel into 16-bit pairs
+	SSE41_TARGET inline __m128i distanceSSE41(const u32 *p, __m128i center) {
+		__m128i other = _mm_loadu_si128((const __m128i *)p);
+		__m128i diff = _mm_or_si128(_mm_subs_epu8(other, center), _mm_subs_epu8(center, other));
+		return _mm_maddubs_epi16(diff, _mm_set1_epi8(1));
+	}
+	SSE41_TARGET void generateDistanceMaskSSE41(u32* data, u32* out, int width, int height, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *outRow = out + y*width;
+			if(y==0 || y==height-1) {
+				for(int x = 0; x < width; ++x) {
+					outRow[x] = distanceMaskPixel(data, width, height, x, y);
+				}
+				continue;
+			}
+			u32 *row = data + y*width;
+			outRow[0] = distanceMaskPixel(data, width, height, 0, y);
+			int x = 1;
+			for(; x + 5 <= width; x += 4) {
+				__m128i center = _mm_loadu_si128((const __m128i *)(row + x));
+				__m128i sum = distanceSSE41(row - width + x - 1, center);
+				sum = _mm_add_epi16(sum, distanceSSE41(row - width + x, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row - width + x + 1, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row + x - 1, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row + x + 1, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row + width + x - 1, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row + width + x, center));
+				sum = _mm_add_epi16(sum, distanceSSE41(row + width + x + 1, center));
+				_mm_storeu_si128((__m128i *)(outRow + x), _mm_madd_epi16(sum, _mm_set1_epi16(1)));
+			}
+			for(; x < width; ++x) {
+				outRow[x] = distanceMaskPixel(data, width, height, x, y);
+			}
+		}
+	}
+
+	SSE41_TARGET void convolve3x3SSE41(u32* data, u32* out, const int kernel[3][3], int width, int height, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *rows[3];
+			for(int yoff = -1; yoff <= 1; ++yoff) {
+				rows[yoff+1] = data + std::max(std::min(y+yoff, height-1), 0)*width;
+			}
+			u32 *outRow = out + y*width;
+			outRow[0] = convolvePixel(data, kernel, width, height, 0, y);
+			int x = 1;
+			for(; x + 5 <= width; x += 4) {
+				__m128i val = _mm_setzero_si128();
+				for(int yoff = 0; yoff < 3; ++yoff) {
+					for(int xoff = 0; xoff < 3; ++xoff) {
+						__m128i pixels = _mm_loadu_si128((const __m128i *)(rows[yoff] + x + xoff - 1));
+						val = _mm_add_epi32(val, _mm_mullo_epi32(pixels, _mm_set1_epi32(kernel[yoff][xoff])));
+					}
+				}
+				_mm_storeu_si128((__m128i *)(outRow + x), _mm_abs_epi32(val));
+			}
+			for(; x < width; ++x) {
+				outRow[x] = convolvePixel(data, kernel, width, height, x, y);
+			}
+		}
+	}
+
+	// the mask becomes a factor with a shift, so only power of two maxima go here
+	inline int maskShift(u32 maskmax) {
+		int shift = 0;
+		while(shift < 31 && (1U << shift) < maskmax) ++shift;
+		return (1U << shift) == maskmax ? shift : -1;
+	}
+
+	SSE41_TARGET void mixSSE41(u32* data, u32* source, u32* mask, u32 maskmax, int width, int l, int u) {
+		int shift = maskShift(maskmax);
+		if(shift < 0) {
+			mix(data, source, mask, maskmax, width, l, u);
+			return;
+		}
+		const __m128i max = _mm_set1_epi32(maskmax);
+		const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+		for(int y = l; y < u; ++y) {
+			int x = 0;
+			for(; x + 4 <= width; x += 4) {
+				int pos = y*width + x;
+				__m128i m = _mm_min_epu32(_mm_loadu_si128((const __m128i *)(mask + pos)), max);
+				__m128i factors = _mm_srli_epi32(_mm_sub_epi32(_mm_slli_epi32(m, 8), m), shift);
+				// spread each pixel's factor over its four channels
+				factors = _mm_packs_epi32(factors, factors);
+				factors = _mm_unpacklo_epi16(factors, factors);
+				__m128i f1lo = _mm_unpacklo_epi32(factors, factors);
+				__m128i f1hi = _mm_unpackhi_epi32(factors, factors);
+				__m128i f0lo = _mm_sub_epi16(_mm_set1_epi16(255), f1lo);
+				__m128i f0hi = _mm_sub_epi16(_mm_set1_epi16(255), f1hi);
+				__m128i src = _mm_loadu_si128((const __m128i *)(source + pos));
+				__m128i result = mixPixelsSSE41(_mm_loadu_si128((const __m128i *)(data + pos)), src, f0lo, f1lo, f0hi, f1hi);
+				// xBRZ always does a better job with hard alpha
+				__m128i noAlpha = _mm_cmpeq_epi32(_mm_and_si128(src, alphaMask), _mm_setzero_si128());
+				result = _mm_andnot_si128(_mm_and_si128(noAlpha, alphaMask), result);
+				_mm_storeu_si128((__m128i *)(data + pos), result);
+			}
+			for(; x < width; ++x) {
+				int pos = y*width + x;
+				data[pos] = mixPixel(data[pos], source[pos], mask[pos], maskmax);
+			}
+		}
+	}
+
+	const ScalerKernels sse41Kernels = {
+		&bilinearHSSE41, &bilinearVSSE41, &scaleBicubicSSE41<0>, &scaleBicubicSSE41<1>,
+		&deposterizeHSSE41, &deposterizeVSSE41, &generateDistanceMaskSSE41, &convolve3x3SSE41, &mixSSE41,
+	};
+
+	//////////////////////////////////////////////////////////////////// AVX2
+	// Twice the width of the SSE4.1 ones where the rows are long enough, bit exact with them.
+
+	AVX2_TARGET inline __m256i div255AVX2(__m256i x) {
+		return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+	}
+
+	// as mixPixelsSSE41, for pixels 0-1 and 4-5 (lo) and 2-3 and 6-7 (hi)
+	AVX2_TARGET inline __m256i mixPixelsAVX2(__m256i p0, __m256i p1, __m256i f0lo, __m256i f1lo, __m256i f0hi, __m256i f1hi) {
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(p0, zero), f0lo), _mm256_mullo_epi16(_mm256_unpacklo_epi8(p1, zero), f1lo));
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(p0, zero), f0hi), _mm256_mullo_epi16(_mm256_unpackhi_epi8(p1, zero), f1hi));
+		return _mm256_packus_epi16(div255AVX2(lo), div255AVX2(hi));
+	}
+
+	template<int f>
+	AVX2_TARGET void bilinearVtAVX2(u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		int outw = w*f;
+		for(int y = l; y < u; ++y) {
+			const u32 *upper  = data + (y - (y==gl  ?0:1)) * outw;
+			const u32 *center = data + y * outw;
+			const u32 *lower  = data + (y + (y==gu-1?0:1)) * outw;
+			for(int i = 0; i < f; ++i) {
+				const u32 *other = i<f/2+f%2 ? upper : lower;
+				const u8 *factors = i<f/2+f%2 ? BILINEAR_FACTORS[f-2][i] : BILINEAR_FACTORS[f-2][f-1-i];
+				const __m256i f0 = _mm256_set1_epi16(factors[0]);
+				const __m256i f1 = _mm256_set1_epi16(factors[1]);
+				u32 *outRow = out + (y*f + i)*outw;
+				int x = 0;
+				for(; x + 8 <= outw; x += 8) {
+					__m256i o = _mm256_loadu_si256((const __m256i *)(other + x));
+					__m256i c = _mm256_loadu_si256((const __m256i *)(center + x));
+					_mm256_storeu_si256((__m256i *)(outRow + x), mixPixelsAVX2(o, c, f0, f1, f0, f1));
+				}
+				for(; x < outw; ++x) {
+					outRow[x] = MIX_PIXELS(other[x], center[x], factors);
+				}
+			}
+		}
+	}
+	void bilinearVAVX2(int factor, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+		switch(factor) {
+		case 2: bilinearVtAVX2<2>(data, out, w, gl, gu, l, u); break;
+		case 3: bilinearVtAVX2<3>(data, out, w, gl, gu, l, u); break;
+		case 4: bilinearVtAVX2<4>(data, out, w, gl, gu, l, u); break;
+		case 5: bilinearVtAVX2<5>(data, out, w, gl, gu, l, u); break;
+		default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	// two output pixels at a time, one per lane, with the taps in the same order as SSE4.1
+	template<int f, int T>
+	AVX2_TARGET void scaleBicubicTAVX2(u32* data, u32* out, int w, int h, int l, int u) {
+		int outw = w*f;
+		for(int y = l*f; y < u*f; ++y) {
+			int cy = y/f;
+			for(int x0 = 0; x0 < outw; x0 += 2) {
+				// an odd last pixel is computed twice
+				int x1 = std::min(x0+1, outw-1);
+				int cx0 = x0/f, cx1 = x1/f;
+				const float (*weights0)[5] = bicubicWeights[T][f-2][x0%f][y%f];
+				const float (*weights1)[5] = bicubicWeights[T][f-2][x1%f][y%f];
+				__m256 result = _mm256_setzero_ps();
+				for(int sx = -2; sx <= 2; ++sx) {
+					int csx0 = std::max(std::min(sx+cx0,w-1),0);
+					int csx1 = std::max(std::min(sx+cx1,w-1),0);
+					for(int sy = -2; sy <= 2; ++sy) {
+						float weight0 = weights0[sx+2][sy+2];
+						float weight1 = weights1[sx+2][sy+2];
+						if(weight0 != 0.0f || weight1 != 0.0f) {
+							// a zero weight adds +0, which leaves the sum as it is
+							int csy = std::max(std::min(sy+cy,h-1),0);
+							__m128i samples = _mm_unpacklo_epi32(_mm_cvtsi32_si128(data[csy*w+csx0]), _mm_cvtsi32_si128(data[csy*w+csx1]));
+							__m256 col = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(samples));
+							col = _mm256_mul_ps(col, _mm256_setr_ps(weight0, weight0, weight0, weight0, weight1, weight1, weight1, weight1));
+							result = _mm256_add_ps(result, col);
+						}
+					}
+				}
+				float invSum0 = bicubicInvSums[T][f-2][x0%f][y%f];
+				float invSum1 = bicubicInvSums[T][f-2][x1%f][y%f];
+				__m256 invSums = _mm256_setr_ps(invSum0, invSum0, invSum0, invSum0, invSum1, invSum1, invSum1, invSum1);
+				__m256i pixels = _mm256_cvtps_epi32(_mm256_mul_ps(result, invSums));
+				pixels = _mm256_packs_epi32(pixels, pixels);
+				pixels = _mm256_packus_epi16(pixels, pixels);
+				out[y*outw + x0] = _mm_cvtsi128_si32(_mm256_castsi256_si128(pixels));
+				out[y*outw + x1] = _mm_cvtsi128_si32(_mm256_extracti128_si256(pixels, 1));
+			}
+		}
+	}
+	template<int T>
+	void scaleBicubicAVX2(int factor, u32* data, u32* out, int w, int h, int l, int u) {
+		switch(factor) {
+		case 2: scaleBicubicTAVX2<2, T>(data, out, w, h, l, u); break;
+		case 3: scaleBicubicTAVX2<3, T>(data, out, w, h, l, u); break;
+		case 4: scaleBicubicTAVX2<4, T>(data, out, w, h, l, u); break;
+		case 5: scaleBicubicTAVX2<5, T>(data, out, w, h, l, u); break;
+		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
+		}
+	}
+
+	AVX2_TARGET inline __m256i deposterizeAVX2(__m256i a, __m256i center, __m256i b) {
+		const __m256i T = _mm256_set1_epi8(8);
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i aNear = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_or_si256(_mm256_subs_epu8(a, center), _mm256_subs_epu8(center, a)), T), zero);
+		__m256i bNear = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_or_si256(_mm256_subs_epu8(b, center), _mm256_subs_epu8(center, b)), T), zero);
+		__m256i blend = _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, center), bNear), _mm256_and_si256(_mm256_cmpeq_epi8(b, center), aNear));
+		blend = _mm256_andnot_si256(_mm256_cmpeq_epi8(a, b), blend);
+		__m256i average = _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1)));
+		return _mm256_blendv_epi8(center, average, blend);
+	}
+	AVX2_TARGET void deposterizeHAVX2(u32* data, u32* out, int w, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *row = data + y*w;
+			u32 *outRow = out + y*w;
+			outRow[0] = row[0];
+			int x = 1;
+			for(; x + 9 <= w; x += 8) {
+				__m256i left = _mm256_loadu_si256((const __m256i *)(row + x - 1));
+				__m256i center = _mm256_loadu_si256((const __m256i *)(row + x));
+				__m256i right = _mm256_loadu_si256((const __m256i *)(row + x + 1));
+				_mm256_storeu_si256((__m256i *)(outRow + x), deposterizeAVX2(left, center, right));
+			}
+			for(; x < w; ++x) {
+				outRow[x] = x==w-1 ? row[x] : deposterizePixel(row[x - 1], row[x], row[x + 1]);
+			}
+		}
+	}
+	AVX2_TARGET void deposterizeVAVX2(u32* data, u32* out, int w, int h, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *center = data + y*w;
+			u32 *outRow = out + y*w;
+			if(y==0 || y==h-1) {
+				memcpy(outRow, center, w*sizeof(u32));
+				continue;
+			}
+			u32 *upper = center - w;
+			u32 *lower = center + w;
+			int x = 0;
+			for(; x + 8 <= w; x += 8) {
+				__m256i uc = _mm256_loadu_si256((const __m256i *)(upper + x));
+				__m256i cc = _mm256_loadu_si256((const __m256i *)(center + x));
+				__m256i lc = _mm256_loadu_si256((const __m256i *)(lower + x));
+				_mm256_storeu_si256((__m256i *)(outRow + x), deposterizeAVX2(uc, cc, lc));
+			}
+			for(; x < w; ++x) {
+				outRow[x] = deposterizePixel(upper[x], center[x], lower[x]);
+			}
+		}
+	}
+
+	AVX2_TARGET inline __m256i distanceAVX2(const u32 *p, __m256i center) {
+		__m256i other = _mm256_loadu_si256((const __m256i *)p);
+		__m256i diff = _mm256_or_si256(_mm256_subs_epu8(other, center), _mm256_subs_epu8(center, other));
+		return _mm256_maddubs_epi16(diff, _mm256_set1_epi8(1));
+	}
+	AVX2_TARGET void generateDistanceMaskAVX2(u32* data, u32* out, int width, int height, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *outRow = out + y*width;
+			if(y==0 || y==height-1) {
+				for(int x = 0; x < width; ++x) {
+					outRow[x] = distanceMaskPixel(data, width, height, x, y);
+				}
+				continue;
+			}
+			u32 *row = data + y*width;
+			outRow[0] = distanceMaskPixel(data, width, height, 0, y);
+			int x = 1;
+			for(; x + 9 <= width; x += 8) {
+				__m256i center = _mm256_loadu_si256((const __m256i *)(row + x));
+				__m256i sum = distanceAVX2(row - width + x - 1, center);
+				sum = _mm256_add_epi16(sum, distanceAVX2(row - width + x, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row - width + x + 1, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row + x - 1, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row + x + 1, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row + width + x - 1, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row + width + x, center));
+				sum = _mm256_add_epi16(sum, distanceAVX2(row + width + x + 1, center));
+				_mm256_storeu_si256((__m256i *)(outRow + x), _mm256_madd_epi16(sum, _mm256_set1_epi16(1)));
+			}
+			for(; x < width; ++x) {
+				outRow[x] = distanceMaskPixel(data, width, height, x, y);
+			}
+		}
+	}
+
+	AVX2_TARGET void convolve3x3AVX2(u32* data, u32* out, const int kernel[3][3], int width, int height, int l, int u) {
+		for(int y = l; y < u; ++y) {
+			u32 *rows[3];
+			for(int yoff = -1; yoff <= 1; ++yoff) {
+				rows[yoff+1] = data + std::max(std::min(y+yoff, height-1), 0)*width;
+			}
+			u32 *outRow = out + y*width;
+			outRow[0] = convolvePixel(data, kernel, width, height, 0, y);
+			int x = 1;
+			for(; x + 9 <= width; x += 8) {
+				__m256i val = _mm256_setzero_si256();
+				for(int yoff = 0; yoff < 3; ++yoff) {
+					for(int xoff = 0; xoff < 3; ++xoff) {
+						__m256i pixels = _mm256_loadu_si256((const __m256i *)(rows[yoff] + x + xoff - 1));
+						val = _mm256_add_epi32(val, _mm256_mullo_epi32(pixels, _mm256_set1_epi32(kernel[yoff][xoff])));
+					}
+				}
+				_mm256_storeu_si256((__m256i *)(outRow + x), _mm256_abs_epi32(val));
+			}
+			for(; x < width; ++x) {
+				outRow[x] = convolvePixel(data, kernel, width, height, x, y);
+			}
+		}
+	}
+
+	AVX2_TARGET void mixAVX2(u32* data, u32* source, u32* mask, u32 maskmax, int width, int l, int u) {
+		int shift = maskShift(maskmax);
+		if(shift < 0) {
+			mix(data, source, mask, maskmax, width, l, u);
+			return;
+		}
+		const __m256i max = _mm256_set1_epi32(maskmax);
+		const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+		for(int y = l; y < u; ++y) {
+			int x = 0;
+			for(; x + 8 <= width; x += 8) {
+				int pos = y*width + x;
+				__m256i m = _mm256_min_epu32(_mm256_loadu_si256((const __m256i *)(mask + pos)), max);
+				__m256i factors = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_slli_epi32(m, 8), m), shift);
+				factors = _mm256_packs_epi32(factors, factors);
+				factors = _mm256_unpacklo_epi16(factors, factors);
+				__m256i f1lo = _mm256_unpacklo_epi32(factors, factors);
+				__m256i f1hi = _mm256_unpackhi_epi32(factors, factors);
+				__m256i f0lo = _mm256_sub_epi16(_mm256_set1_epi16(255), f1lo);
+				__m256i f0hi = _mm256_sub_epi16(_mm256_set1_epi16(255), f1hi);
+				__m256i src = _mm256_loadu_si256((const __m256i *)(source + pos));
+				__m256i result = mixPixelsAVX2(_mm256_loadu_si256((const __m256i *)(data + pos)), src, f0lo, f1lo, f0hi, f1hi);
+				__m256i noAlpha = _mm256_cmpeq_epi32(_mm256_and_si256(src, alphaMask), _mm256_setzero_si256());
+				result = _mm256_andnot_si256(_mm256_and_si256(noAlpha, alphaMask), result);
+				_mm256_storeu_si256((__m256i *)(data + pos), result);
+			}
+			for(; x < width; ++x) {
+				int pos = y*width + x;
+				data[pos] = mixPixel(data[pos], source[pos], mask[pos], maskmax);
+			}
+		}
+	}
+
+	// the horizontal bilinear pass shuffles within 128 bits, so it stays SSE4.1
+	const ScalerKernels avx2Kernels = {
+		&bilinearHSSE41, &bilinearVAVX2, &scaleBicubicAVX2<0>, &scaleBicubicAVX2<1>,
+		&deposterizeHAVX2, &deposterizeVAVX2, &generateDistanceMaskAVX2, &convolve3x3AVX2, &mixAVX2,
+	};
+#endif
+
+	const ScalerKernels *currentKernels = &basicKernels;
+
+	#undef BLOCK_SIZE
+	#undef MIX_PIXELS
+	#undef DISTANCE
+	#undef R
+	#undef G
+	#undef B
+	#undef A
+
+	// used for debugging texture scaling (writing textures to files)
+	static int g_imgCount = 0;
+	void dbgPPM(int w, int h, u8* pixels, const char* prefix = "dbg") { // 3 component RGB
+		char fn[32];
+		snprintf(fn, 32, "%s%04d.ppm", prefix, g_imgCount++);
+		FILE *fp = fopen(fn, "wb");
+		fprintf(fp, "P6\n%d %d\n255\n", w, h);
+		for(int j = 0; j < h; ++j) {
+			for(int i = 0; i < w; ++i) {
+				static unsigned char color[3];
+				color[0] = pixels[(j*w+i)*4+0];  /* red */
+				color[1] = pixels[(j*w+i)*4+1];  /* green */
+				color[2] = pixels[(j*w+i)*4+2];  /* blue */
+				fwrite(color, 1, 3, fp);
+			}
+		}
+		fclose(fp);
+	}
+	void dbgPGM(int w, int h, u32* pixels, const char* prefix = "dbg") { // 1 component
+		char fn[32];
+		snprintf(fn, 32, "%s%04d.pgm", prefix, g_imgCount++);
+		FILE *fp = fopen(fn, "wb");
+		fprintf(fp, "P5\n%d %d\n65536\n", w, h);
+		for(int j = 0; j < h; ++j) {
+			for(int i = 0; i < w; ++i) {
+				fwrite((pixels+(j*w+i)), 1, 2, fp);
+			}
+		}
+		fclose(fp);
+	}
+}
+
+// This has to be done after CPUDetect has done its magic.
+void SetupScalerKernels() {
+	initBicubicWeights();
+	currentKernels = &basicKernels;
+#ifdef HAVE_AVX2_INTRINSICS
+	if (cpu_info.bAVX2) {
+		currentKernels = &avx2Kernels;
+	} else if (cpu_info.bSSE4_1) {
+		currentKernels = &sse41Kernels;
+	}
+#endif
+}
+
+const ScalerKernels &GetScalerKernels() {
+	return *currentKernels;
+}
+
+const ScalerKernels *GetScalerKernels(ScalerKernelSet set) {
+	switch (set) {
+	case SCALER_KERNELS_BASIC:
+		return &basicKernels;
+#ifdef HAVE_AVX2_INTRINSICS
+	case SCALER_KERNELS_SSE41:
+		return cpu_info.bSSE4_1 ? &sse41Kernels : nullptr;
+	case SCALER_KERNELS_AVX2:
+		return cpu_info.bAVX2 ? &avx2Kernels : nullptr;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+/////////////////////////////////////// Texture Scaler
+
+TextureScalerCommon::TextureScalerCommon() {
+	SetupScalerKernels();
+}
+
+bool TextureScalerCommon::IsEmptyOrFlat(u32* data, int pixels, u32 fmt) {
+	int pixelsPerWord = (fmt == Get8888Format()) ? 1 : 2;
+	u32 ref = data[0];
+	for(int i=0; i<pixels/pixelsPerWord; ++i) {
+		if(data[i]!=ref) return false;
+	}
+	return true;
+}
+
+void TextureScalerCommon::Scale(u32* &data, u32 &dstFmt, int &width, int &height, int factor) {
+	// prevent processing empty or flat textures (this happens a lot in some games)
+	// doesn't hurt the standard case, will be very quick for textures with actual texture
+	if(IsEmptyOrFlat(data, width*height, dstFmt)) {
+		INFO_LOG(G3D, "TextureScaler: early exit -- empty/flat texture");
+		return;
+	}
+
+	#ifdef SCALING_MEASURE_TIME
+	double t_start = real_time_now();
+	#endif
+
+	bufInput.resize(width*height); // used to store the input image image if it needs to be reformatted
+	bufOutput.resize(width*height*factor*factor); // used to store the upscaled image
+	u32 *inputBuf = bufInput.data();
+	u32 *outputBuf = bufOutput.data();
+
+	// convert texture to correct format for scaling
+	ConvertTo8888(dstFmt, data, inputBuf, width, height);
+
+	// deposterize
+	if(g_Config.bTexDeposterize) {
+		bufDeposter.resize(width*height);
+		DePosterize(inputBuf, bufDeposter.data(), width, height);
+		inputBuf = bufDeposter.data();
+	}
+
+	// scale
+	switch(g_Config.iTexScalingType) {
+	case XBRZ:
+		ScaleXBRZ(factor, inputBuf, outputBuf, width, height);
+		break;
+	case HYBRID:
+		ScaleHybrid(factor, inputBuf, outputBuf, width, height);
+		break;
+	case BICUBIC:
+		ScaleBicubicMitchell(factor, inputBuf, outputBuf, width, height);
+		break;
+	case HYBRID_BICUBIC:
+		ScaleHybrid(factor, inputBuf, outputBuf, width, height, true);
+		break;
+	default:
+		ERROR_LOG(G3D, "Unknown scaling type: %d", g_Config.iTexScalingType);
+	}
+
+	// update values accordingly
+	data = outputBuf;
+	dstFmt = Get8888Format();
+	width *= factor;
+	height *= factor;
+
+	#ifdef SCALING_MEASURE_TIME
+	if(width*height > 64*64*factor*factor) {
+		double t = real_time_now() - t_start;
+		NOTICE_LOG(MASTER_LOG, "TextureScaler: processed %9d pixels in %6.5lf seconds. (%9.2lf Mpixels/second)",
+			width*height, t, (width*height)/(t*1000*1000));
+	}
+	#endif
+}
+
+void TextureScalerCommon::ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height) {
+	xbrz::ScalerCfg cfg;
+	GlobalThreadPool::Loop(std::bind(&xbrz::scale, factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, placeholder::_1, placeholder::_2), 0, height);
+}
+
+void TextureScalerCommon::ScaleBilinear(int factor, u32* source, u32* dest, int width, int height) {
+	const ScalerKernels &kernels = GetScalerKernels();
+	bufTmp1.resize(width*height*factor);
+	u32 *tmpBuf = bufTmp1.data();
+	GlobalThreadPool::Loop(std::bind(kernels.bilinearH, factor, source, tmpBuf, width, placeholder::_1, placeholder::_2), 0, height);
+	GlobalThreadPool::Loop(std::bind(kernels.bilinearV, factor, tmpBuf, dest, width, 0, height, placeholder::_1, placeholder::_2), 0, height);
+}
+
+void TextureScalerCommon::ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height) {
+	GlobalThreadPool::Loop(std::bind(GetScalerKernels().bicubicBSpline, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+}
+
+void TextureScalerCommon::ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height) {
+	GlobalThreadPool::Loop(std::bind(GetScalerKernels().bicubicMitchell, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+}
+
+void TextureScalerCommon::ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic) {
+	// Basic algorithm:
+	// 1) determine a feature mask C based on a sobel-ish filter + splatting, and upscale that mask bilinearly
+	// 2) generate 2 scaled images: A - using Bilinear filtering, B - using xBRZ
+	// 3) output = A*C + B*(1-C)
+
+	const static int KERNEL_SPLAT[3][3] = {
+		{ 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 }
+	};
+
+	const ScalerKernels &kernels = GetScalerKernels();
+	bufTmp1.resize(width*height);
+	bufTmp2.resize(width*height*factor*factor);
+	bufTmp3.resize(width*height*factor*factor);
+	GlobalThreadPool::Loop(std::bind(kernels.generateDistanceMask, source, bufTmp1.data(), width, height, placeholder::_1, placeholder::_2), 0, height);
+	GlobalThreadPool::Loop(std::bind(kernels.convolve3x3, bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, placeholder::_1, placeholder::_2), 0, height);
+	ScaleBilinear(factor, bufTmp2.data(), bufTmp3.data(), width, height);
+	// mask C is now in bufTmp3
+
+	ScaleXBRZ(factor, source, bufTmp2.data(), width, height);
+	// xBRZ upscaled source is in bufTmp2
+
+	if(bicubic) ScaleBicubicBSpline(factor, source, dest, width, height);
+	else ScaleBilinear(factor, source, dest, width, height);
+	// Upscaled source is in dest
+
+	// Now we can mix it all together
+	// The factor 8192 was found through practical testing on a variety of textures
+	GlobalThreadPool::Loop(std::bind(kernels.mix, dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, placeholder::_1, placeholder::_2), 0, height*factor);
+}
+
+void TextureScalerCommon::DePosterize(u32* source, u32* dest, int width, int height) {
+	const ScalerKernels &kernels = GetScalerKernels();
+	bufTmp3.resize(width*height);
+	GlobalThreadPool::Loop(std::bind(kernels.deposterizeH, source, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
+	GlobalThreadPool::Loop(std::bind(kernels.deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+	GlobalThreadPool::Loop(std::bind(kernels.deposterizeH, dest, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
+	GlobalThreadPool::Loop(std::bind(kernels.deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+#include "Common/MemoryUtil.h"
+
+// The passes of the texture scalers, on 8888 pixels.  Each does the rows [l, u) so GlobalThreadPool::Loop
+// can split it up: output rows for bilinearV, input rows for everything else.
+struct ScalerKernels {
+	void (*bilinearH)(int factor, u32 *data, u32 *out, int w, int l, int u);
+	// gl/gu are the rows of the whole image.
+	void (*bilinearV)(int factor, u32 *data, u32 *out, int w, int gl, int gu, int l, int u);
+	void (*bicubicBSpline)(int factor, u32 *data, u32 *out, int w, int h, int l, int u);
+	void (*bicubicMitchell)(int factor, u32 *data, u32 *out, int w, int h, int l, int u);
+	void (*deposterizeH)(u32 *data, u32 *out, int w, int l, int u);
+	void (*deposterizeV)(u32 *data, u32 *out, int w, int h, int l, int u);
+	void (*generateDistanceMask)(u32 *data, u32 *out, int width, int height, int l, int u);
+	void (*convolve3x3)(u32 *data, u32 *out, const int kernel[3][3], int width, int height, int l, int u);
+	void (*mix)(u32 *data, u32 *source, u32 *mask, u32 maskmax, int width, int l, int u);
+};
+
+enum ScalerKernelSet {
+	SCALER_KERNELS_BASIC,
+	SCALER_KERNELS_SSE41,
+	SCALER_KERNELS_AVX2,
+};
+
+// Precomputes the bicubic weights and picks the kernels for this CPU.
+void SetupScalerKernels();
+const ScalerKernels &GetScalerKernels();
+// For testing.  Null if the build or the CPU doesn't have the set.
+const ScalerKernels *GetScalerKernels(ScalerKernelSet set);
+
+class TextureScalerCommon {
+public:
+	TextureScalerCommon();
+	virtual ~TextureScalerCommon() {}
+
+	// dstFmt is the backend's texture format, and becomes its 8888 format when the texture is scaled.
+	void Scale(u32* &data, u32 &dstFmt, int &width, int &height, int factor);
+
+	enum { XBRZ= 0, HYBRID = 1, BICUBIC = 2, HYBRID_BICUBIC = 3 };
+
+	// These work on 8888 and are public for benchmarking.
+	void ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBilinear(int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height);
+	void ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic = false);
+	void DePosterize(u32* source, u32* dest, int width, int height);
+
+protected:
+	virtual void ConvertTo8888(u32 format, u32* source, u32* &dest, int width, int height) = 0;
+	virtual u32 Get8888Format() const = 0;
+
+	bool IsEmptyOrFlat(u32* data, int pixels, u32 fmt);
+
+	// depending on the factor and texture sizes, these can get pretty large
+	// maximum is (100 MB total for a 512 by 512 texture with scaling factor 5 and hybrid scaling)
+	// of course, scaling factor 5 is totally silly anyway
+	SimpleBuf<u32> bufInput, bufDeposter, bufOutput, bufTmp1, bufTmp2, bufTmp3;
+};
@@ -506,10 +506,18 @@ struct GPUStatistics {
 		numUncachedVertsDrawn = 0;
 		numTrackedVertexArrays = 0;
 		numTextureInvalidations = 0;
+		numTextureLookups = 0;
+		numTextureLookupProbes = 0;
+		numTextureInvalidationChecks = 0;
 		numTextureSwitches = 0;
 		numShaderSwitches = 0;
 		numFlushes = 0;
 		numTexturesDecoded = 0;
+		numTextureDecodesQueued = 0;
+		numTextureDecodesFinished = 0;
+		msTextureDecodeLatency = 0;
+		msMaxTextureDecodeLatency = 0;
+		memset(msTextureDecodeByFormat, 0, sizeof(msTextureDecodeByFormat));
 		numAlphaTestedDraws = 0;
 		numNonAlphaTestedDraws = 0;
 		msProcessingDisplayLists = 0;
@@ -527,9 +535,17 @@ struct GPUStatistics {
 	int numUncachedVertsDrawn;
 	int numTrackedVertexArrays;
 	int numTextureInvalidations;
+	int numTextureLookups;
+	int numTextureLookupProbes;
+	int numTextureInvalidationChecks;  // Cache entries looked at for range invalidations.
 	int numTextureSwitches;
 	int numShaderSwitches;
 	int numTexturesDecoded;
+	int numTextureDecodesQueued;
+	int numTextureDecodesFinished;  // Background decodes that got uploaded.
+	double msTextureDecodeLatency;
+	double msMaxTextureDecodeLatency;
+	double msTextureDecodeByFormat[16];  // By GETextureFormat, including background decodes finished this frame.
 	double msProcessingDisplayLists;
 	int vertexGPUCycles;
 	int otherGPUCycles;
@@ -546,6 +562,13 @@ struct GPUStatistics {
 	int numFragmentShaders;
 	int numShaders;
 	int numFBOs;
+
+	// Kept up to date by the texture cache.
+	u32 textureCacheBytes;
+	u32 secondTextureCacheBytes;
+	u32 textureBytesByFormat[16];  // Both caches, by the PSP's GETextureFormat.
+	int numTextureEvictions;
+	int numTexturesRedecodedAfterEviction;
 };
 
 bool GPU_Init();
@@ -45,9 +45,11 @@ SOURCES += $$P/GPU/GeDisasm.cpp \ # GPU
 	$$P/GPU/Common/TextureDecoder.cpp \
 	$$P/GPU/Common/VertexDecoderCommon.cpp \
 	$$P/GPU/Common/TextureCacheCommon.cpp \
+	$$P/GPU/Common/TextureScalerCommon.cpp \
 	$$P/GPU/Common/TransformCommon.cpp \
 	$$P/GPU/Common/SoftwareTransformCommon.cpp \
 	$$P/GPU/Common/PostShader.cpp \
+	$$P/GPU/Common/ScaledTextureDiskCache.cpp \
 	$$P/GPU/Common/FramebufferCommon.cpp \
 	$$P/GPU/Common/SplineCommon.cpp \
 	$$P/GPU/Common/DrawEngineCommon.cpp \
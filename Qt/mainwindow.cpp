@@ -339,6 +339,13 @@ void MainWindow::stretchAct()
 		gpu->Resized();
 }
 
+void MainWindow::statsAct()
+{
+	g_Config.bShowDebugStats = !g_Config.bShowDebugStats;
+	// The JIT only times syscalls with stats on, and decides that when compiling.
+	NativeMessageReceived("clear jit", "");
+}
+
 void MainWindow::raiseTopMost()
 {
 	
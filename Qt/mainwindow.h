@@ -110,7 +110,7 @@ private slots:
 
 	void fullscrAct();
 	void raiseTopMost();
-	void statsAct() { g_Config.bShowDebugStats = !g_Config.bShowDebugStats; }
+	void statsAct();
 	void showFPSAct() { g_Config.iShowFPSCounter = !g_Config.iShowFPSCounter; }
 
 	// Logs
@@ -18,6 +18,8 @@
 #include <algorithm>
 
 #include "base/compat.h"
+#include "base/NativeApp.h"
+#include "base/timeutil.h"
 #include "gfx_es2/gl_state.h"
 #include "i18n/i18n.h"
 #include "ui/ui_context.h"
@@ -32,6 +34,7 @@
 #include "Core/Config.h"
 #include "Core/System.h"
 #include "Core/CoreParameter.h"
+#include "Core/HLE/HLEProfiler.h"
 #include "Core/MIPS/MIPSTables.h"
 #include "Core/MIPS/JitCommon/NativeJit.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
@@ -61,6 +64,7 @@ void DevMenu::CreatePopupContents(UI::ViewGroup *parent) {
 	parent->Add(new Choice(de->T("Logging Channels")))->OnClick.Handle(this, &DevMenu::OnLogConfig);
 	parent->Add(new Choice(sy->T("Developer Tools")))->OnClick.Handle(this, &DevMenu::OnDeveloperTools);
 	parent->Add(new Choice(de->T("Jit Compare")))->OnClick.Handle(this, &DevMenu::OnJitCompare);
+	parent->Add(new Choice(de->T("HLE Profiler")))->OnClick.Handle(this, &DevMenu::OnHLEProfiler);
 	parent->Add(new Choice(de->T("Toggle Freeze")))->OnClick.Handle(this, &DevMenu::OnFreezeFrame);
 	parent->Add(new Choice(de->T("Dump Frame GPU Commands")))->OnClick.Handle(this, &DevMenu::OnDumpFrame);
 
@@ -94,6 +98,12 @@ UI::EventReturn DevMenu::OnJitCompare(UI::EventParams &e) {
 	return UI::EVENT_DONE;
 }
 
+UI::EventReturn DevMenu::OnHLEProfiler(UI::EventParams &e) {
+	UpdateUIState(UISTATE_PAUSEMENU);
+	screenManager()->push(new HLEProfilerScreen());
+	return UI::EVENT_DONE;
+}
+
 UI::EventReturn DevMenu::OnFreezeFrame(UI::EventParams &e) {
 	if (PSP_CoreParameter().frozen) {
 		PSP_CoreParameter().frozen = false;
@@ -176,6 +186,74 @@ UI::EventReturn LogScreen::OnSubmit(UI::EventParams &e) {
 	return UI::EVENT_DONE;
 }
 
+HLEProfilerScreen::HLEProfilerScreen() : profiling_(HLEProfiler::IsEnabled()), lastUpdate_(0.0), vert_(NULL) {
+}
+
+void HLEProfilerScreen::UpdateStats() {
+	using namespace UI;
+	vert_->Clear();
+
+	std::vector<HLEProfiler::FunctionStats> stats = HLEProfiler::GetStats();
+	if (stats.empty()) {
+		vert_->Add(new TextView(profiling_ ? "No calls yet" : "Profiling is off", FLAG_DYNAMIC_ASCII, false));
+		return;
+	}
+
+	// The list can get long, and this is refreshed live, so only show the expensive ones.
+	const size_t maxRows = 100;
+	for (size_t i = 0; i < stats.size() && i < maxRows; ++i) {
+		const HLEProfiler::FunctionStats &s = stats[i];
+		std::string line = StringFromFormat("%s::%s  %llu calls, %0.2f ms, p50 %0.1f us, p99 %0.1f us, max %0.1f us, %llu resched, %llu switches",
+			s.module, s.name, (unsigned long long)s.calls, s.totalTime * 1000.0, s.p50 * 1000000.0, s.p99 * 1000000.0,
+			s.maxTime * 1000000.0, (unsigned long long)s.reschedules, (unsigned long long)s.threadSwitches);
+		vert_->Add(new TextView(line, FLAG_DYNAMIC_ASCII, false));
+	}
+}
+
+void HLEProfilerScreen::update(InputState &input) {
+	UIDialogScreenWithBackground::update(input);
+
+	const double now = real_time_now();
+	if (now - lastUpdate_ >= 1.0) {
+		lastUpdate_ = now;
+		UpdateStats();
+	}
+}
+
+void HLEProfilerScreen::CreateViews() {
+	using namespace UI;
+	I18NCategory *di = GetI18NCategory("Dialog");
+	I18NCategory *de = GetI18NCategory("Developer");
+
+	LinearLayout *outer = new LinearLayout(ORIENT_VERTICAL, new LinearLayoutParams(FILL_PARENT, WRAP_CONTENT));
+	root_ = outer;
+
+	LinearLayout *topbar = outer->Add(new LinearLayout(ORIENT_HORIZONTAL, new LayoutParams(FILL_PARENT, WRAP_CONTENT)));
+	topbar->Add(new Choice(di->T("Back")))->OnClick.Handle<UIScreen>(this, &UIScreen::OnBack);
+	topbar->Add(new CheckBox(&profiling_, de->T("Profile HLE calls"), "", new LinearLayoutParams(1.0)))->OnClick.Handle(this, &HLEProfilerScreen::OnToggleProfiling);
+	topbar->Add(new Choice(de->T("Reset")))->OnClick.Handle(this, &HLEProfilerScreen::OnReset);
+
+	ScrollView *scroll = outer->Add(new ScrollView(ORIENT_VERTICAL, new LinearLayoutParams(1.0)));
+	vert_ = scroll->Add(new LinearLayout(ORIENT_VERTICAL, new LinearLayoutParams(FILL_PARENT, WRAP_CONTENT)));
+	vert_->SetSpacing(0);
+
+	UpdateStats();
+}
+
+UI::EventReturn HLEProfilerScreen::OnToggleProfiling(UI::EventParams &e) {
+	HLEProfiler::SetEnabled(profiling_);
+	// The jit skips CallSyscall where it can, so it has to recompile either way.
+	NativeMessageReceived("clear jit", "");
+	UpdateStats();
+	return UI::EVENT_DONE;
+}
+
+UI::EventReturn HLEProfilerScreen::OnReset(UI::EventParams &e) {
+	HLEProfiler::Reset();
+	UpdateStats();
+	return UI::EVENT_DONE;
+}
+
 void LogConfigScreen::CreateViews() {
 	using namespace UI;
 
@@ -39,6 +39,7 @@ class DevMenu : public PopupScreen {
 	UI::EventReturn OnLogView(UI::EventParams &e);
 	UI::EventReturn OnLogConfig(UI::EventParams &e);
 	UI::EventReturn OnJitCompare(UI::EventParams &e);
+	UI::EventReturn OnHLEProfiler(UI::EventParams &e);
 	UI::EventReturn OnFreezeFrame(UI::EventParams &e);
 	UI::EventReturn OnDumpFrame(UI::EventParams &e);
 	UI::EventReturn OnDeveloperTools(UI::EventParams &e);
@@ -70,6 +71,22 @@ class LogScreen : public UIDialogScreenWithBackground {
 	bool toBottom_;
 };
 
+class HLEProfilerScreen : public UIDialogScreenWithBackground {
+public:
+	HLEProfilerScreen();
+	void CreateViews() override;
+	void update(InputState &input) override;
+
+private:
+	void UpdateStats();
+	UI::EventReturn OnToggleProfiling(UI::EventParams &e);
+	UI::EventReturn OnReset(UI::EventParams &e);
+
+	bool profiling_;
+	double lastUpdate_;
+	UI::LinearLayout *vert_;
+};
+
 class LogLevelScreen : public ListPopupScreen {
 public:
 	LogLevelScreen(const std::string &title);
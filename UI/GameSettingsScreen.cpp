@@ -211,6 +211,8 @@ void GameSettingsScreen::CreateViews() {
 
 	CheckBox *texSecondary_ = graphicsSettings->Add(new CheckBox(&g_Config.bTextureSecondaryCache, gs->T("Retain changed textures", "Retain changed textures (speedup, mem hog)")));
 	texSecondary_->SetDisabledPtr(&g_Config.bSoftwareRendering);
+	CheckBox *texBackground = graphicsSettings->Add(new CheckBox(&g_Config.bBackgroundTextureDecode, gs->T("Decode textures in background", "Decode textures in background (fewer stutters, may briefly show old textures)")));
+	texBackground->SetDisabledPtr(&g_Config.bSoftwareRendering);
 
 	CheckBox *framebufferSlowEffects = graphicsSettings->Add(new CheckBox(&g_Config.bDisableSlowFramebufEffects, gs->T("Disable slower effects (speedup)")));
 	framebufferSlowEffects->SetDisabledPtr(&g_Config.bSoftwareRendering);
@@ -32,6 +32,16 @@
 
 #include "AES.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define AES_HAVE_NI
+#include <wmmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define AES_NI_TARGET __attribute__((target("aes,sse2")))
+#else
+#define AES_NI_TARGET
+#endif
+#endif
+
 #undef FULL_UNROLL
 
 
@@ -1245,6 +1255,7 @@ rijndael_set_key_enc_only(rijndael_ctx *ctx, const u8 *key, int bits)
 
 	ctx->Nr = rounds;
 	ctx->enc_only = 1;
+	ctx->use_ni = 0;
 
 	return 0;
 }
@@ -1263,6 +1274,7 @@ rijndael_set_key(rijndael_ctx *ctx, const u8 *key, int bits)
 
 	ctx->Nr = rounds;
 	ctx->enc_only = 0;
+	ctx->use_ni = 0;
 
 	return 0;
 }
@@ -1279,18 +1291,154 @@ rijndael_encrypt(rijndael_ctx *ctx, const u8 *src, u8 *dst)
 	rijndaelEncrypt(ctx->ek, ctx->Nr, src, dst);
 }
 
+static int aesni_enabled = 0;
+
+void AES_use_aesni(int enable)
+{
+#ifdef AES_HAVE_NI
+	aesni_enabled = enable;
+#endif
+}
+
+#ifdef AES_HAVE_NI
+/* The AES-NI round keys are just the big-endian bytes of the portable encrypt schedule. */
+static AES_NI_TARGET void aesni_setup(AES_ctx *ctx)
+{
+	int i;
+	__m128i k;
+
+	for (i = 0; i < 4 * (ctx->Nr + 1); i++)
+		PUTU32(ctx->ni_ek + i * 4, ctx->ek[i]);
+
+	_mm_storeu_si128((__m128i *)ctx->ni_dk, _mm_loadu_si128((const __m128i *)(ctx->ni_ek + ctx->Nr * 16)));
+	for (i = 1; i < ctx->Nr; i++) {
+		k = _mm_loadu_si128((const __m128i *)(ctx->ni_ek + (ctx->Nr - i) * 16));
+		_mm_storeu_si128((__m128i *)(ctx->ni_dk + i * 16), _mm_aesimc_si128(k));
+	}
+	_mm_storeu_si128((__m128i *)(ctx->ni_dk + ctx->Nr * 16), _mm_loadu_si128((const __m128i *)ctx->ni_ek));
+	ctx->use_ni = 1;
+}
+
+static AES_NI_TARGET __m128i aesni_encrypt_block(const AES_ctx *ctx, __m128i b)
+{
+	const __m128i *k = (const __m128i *)ctx->ni_ek;
+	int r;
+
+	b = _mm_xor_si128(b, _mm_loadu_si128(k));
+	for (r = 1; r < ctx->Nr; r++)
+		b = _mm_aesenc_si128(b, _mm_loadu_si128(k + r));
+	return _mm_aesenclast_si128(b, _mm_loadu_si128(k + ctx->Nr));
+}
+
+static AES_NI_TARGET __m128i aesni_decrypt_block(const AES_ctx *ctx, __m128i b)
+{
+	const __m128i *k = (const __m128i *)ctx->ni_dk;
+	int r;
+
+	b = _mm_xor_si128(b, _mm_loadu_si128(k));
+	for (r = 1; r < ctx->Nr; r++)
+		b = _mm_aesdec_si128(b, _mm_loadu_si128(k + r));
+	return _mm_aesdeclast_si128(b, _mm_loadu_si128(k + ctx->Nr));
+}
+
+static AES_NI_TARGET void aesni_encrypt(AES_ctx *ctx, const u8 *src, u8 *dst)
+{
+	__m128i b = _mm_loadu_si128((const __m128i *)src);
+	_mm_storeu_si128((__m128i *)dst, aesni_encrypt_block(ctx, b));
+}
+
+static AES_NI_TARGET void aesni_decrypt(AES_ctx *ctx, const u8 *src, u8 *dst)
+{
+	__m128i b = _mm_loadu_si128((const __m128i *)src);
+	_mm_storeu_si128((__m128i *)dst, aesni_decrypt_block(ctx, b));
+}
+
+static AES_NI_TARGET void aesni_cbc_encrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
+{
+	/* Same as the portable version, the first block has no IV. */
+	__m128i prev = _mm_setzero_si128();
+	int i;
+
+	for (i = 0; i < size; i += 16) {
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+		prev = aesni_encrypt_block(ctx, _mm_xor_si128(b, prev));
+		_mm_storeu_si128((__m128i *)(dst + i), prev);
+	}
+}
+
+static AES_NI_TARGET void aesni_cbc_decrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
+{
+	/* Unlike encryption, CBC decryption of separate blocks is independent, so do four at once. */
+	const __m128i *k = (const __m128i *)ctx->ni_dk;
+	__m128i prev = _mm_setzero_si128();
+	int i, r;
+
+	for (i = 0; i + 64 <= size; i += 64) {
+		__m128i c0 = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i *)(src + i + 16));
+		__m128i c2 = _mm_loadu_si128((const __m128i *)(src + i + 32));
+		__m128i c3 = _mm_loadu_si128((const __m128i *)(src + i + 48));
+		__m128i key = _mm_loadu_si128(k);
+		__m128i b0 = _mm_xor_si128(c0, key);
+		__m128i b1 = _mm_xor_si128(c1, key);
+		__m128i b2 = _mm_xor_si128(c2, key);
+		__m128i b3 = _mm_xor_si128(c3, key);
+		for (r = 1; r < ctx->Nr; r++) {
+			key = _mm_loadu_si128(k + r);
+			b0 = _mm_aesdec_si128(b0, key);
+			b1 = _mm_aesdec_si128(b1, key);
+			b2 = _mm_aesdec_si128(b2, key);
+			b3 = _mm_aesdec_si128(b3, key);
+		}
+		key = _mm_loadu_si128(k + ctx->Nr);
+		b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, key), prev);
+		b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, key), c0);
+		b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, key), c1);
+		b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, key), c2);
+		_mm_storeu_si128((__m128i *)(dst + i), b0);
+		_mm_storeu_si128((__m128i *)(dst + i + 16), b1);
+		_mm_storeu_si128((__m128i *)(dst + i + 32), b2);
+		_mm_storeu_si128((__m128i *)(dst + i + 48), b3);
+		prev = c3;
+	}
+
+	for (; i < size; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(aesni_decrypt_block(ctx, c), prev));
+		prev = c;
+	}
+}
+#endif
+
 int AES_set_key(AES_ctx *ctx, const u8 *key, int bits)
 {
-	return rijndael_set_key((rijndael_ctx *)ctx, key, bits);
+	int ret = rijndael_set_key((rijndael_ctx *)ctx, key, bits);
+#ifdef AES_HAVE_NI
+	if (ret == 0 && aesni_enabled)
+		aesni_setup(ctx);
+#endif
+	return ret;
 }
 
 void AES_decrypt(AES_ctx *ctx, const u8 *src, u8 *dst)
 {
+#ifdef AES_HAVE_NI
+	if (ctx->use_ni) {
+		aesni_decrypt(ctx, src, dst);
+		return;
+	}
+#endif
 	rijndaelDecrypt(ctx->dk, ctx->Nr, src, dst);
 }
 
 void AES_encrypt(AES_ctx *ctx, const u8 *src, u8 *dst)
 {
+#ifdef AES_HAVE_NI
+	if (ctx->use_ni) {
+		aesni_encrypt(ctx, src, dst);
+		return;
+	}
+#endif
 	rijndaelEncrypt(ctx->ek, ctx->Nr, src, dst);
 }
 
@@ -1309,6 +1457,12 @@ void AES_cbc_encrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
 	u8 block_buff[16];
 	
 	int i;
+#ifdef AES_HAVE_NI
+	if (ctx->use_ni) {
+		aesni_cbc_encrypt(ctx, src, dst, size);
+		return;
+	}
+#endif
 	for(i = 0; i < size; i+=16)
 	{
 		//step 1: copy block to dst
@@ -1331,6 +1485,12 @@ void AES_cbc_decrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
 	u8 block_buff_previous[16];
 	int i;
 	
+#ifdef AES_HAVE_NI
+	if (ctx->use_ni) {
+		aesni_cbc_decrypt(ctx, src, dst, size);
+		return;
+	}
+#endif
 	memcpy(block_buff, src, 16);
 	memcpy(block_buff_previous, src, 16);
 	AES_decrypt(ctx, src, dst);
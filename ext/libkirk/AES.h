@@ -22,6 +22,9 @@ typedef struct
 	int	Nr;			/* key-length-dependent number of rounds */
 	u32	ek[4*(AES_MAXROUNDS + 1)];	/* encrypt key schedule */
 	u32	dk[4*(AES_MAXROUNDS + 1)];	/* decrypt key schedule */
+	int	use_ni;			/* ni_ek/ni_dk are valid, use AES-NI */
+	u8	ni_ek[16*(AES_MAXROUNDS + 1)];	/* AES-NI encrypt round keys */
+	u8	ni_dk[16*(AES_MAXROUNDS + 1)];	/* AES-NI decrypt round keys */
 } rijndael_ctx;
 
 typedef struct 
@@ -30,6 +33,9 @@ typedef struct
 	int	Nr;			/* key-length-dependent number of rounds */
 	u32	ek[4*(AES_MAXROUNDS + 1)];	/* encrypt key schedule */
 	u32	dk[4*(AES_MAXROUNDS + 1)];	/* decrypt key schedule */
+	int	use_ni;			/* ni_ek/ni_dk are valid, use AES-NI */
+	u8	ni_ek[16*(AES_MAXROUNDS + 1)];	/* AES-NI encrypt round keys */
+	u8	ni_dk[16*(AES_MAXROUNDS + 1)];	/* AES-NI decrypt round keys */
 } AES_ctx;
 
 int rijndael_set_key(rijndael_ctx *, const u8 *, int);
@@ -37,6 +43,8 @@ int	rijndael_set_key_enc_only(rijndael_ctx *, const u8 *, int);
 void rijndael_decrypt(rijndael_ctx *, const u8 *, u8 *);
 void rijndael_encrypt(rijndael_ctx *, const u8 *, u8 *);
 
+/* Contexts set up after this use AES-NI if enable is nonzero and it was compiled in. */
+void AES_use_aesni(int enable);
 int AES_set_key(AES_ctx *ctx, const u8 *key, int bits);
 void AES_encrypt(AES_ctx *ctx, const u8 *src, u8 *dst);
 void AES_decrypt(AES_ctx *ctx, const u8 *src, u8 *dst);
@@ -12,6 +12,7 @@
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/System.h"
+#include "Core/HLE/HLEProfiler.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
 #include "Core/SaveState.h"
@@ -102,6 +103,7 @@ int printUsage(const char *progname, const char *reason)
 	}
 #endif
 	fprintf(stderr, "  --timeout=SECONDS     abort test it if takes longer than SECONDS\n");
+	fprintf(stderr, "  --hle-profile=FILE    write per function HLE call stats as JSON at exit\n");
 
 	fprintf(stderr, "  -v, --verbose         show the full passed/failed result\n");
 	fprintf(stderr, "  -i                    use the interpreter\n");
@@ -217,6 +219,7 @@ int main(int argc, const char* argv[])
 	const char *mountIso = 0;
 	const char *mountRoot = 0;
 	const char *screenshotFilename = 0;
+	const char *hleProfileFilename = 0;
 	float timeout = std::numeric_limits<float>::infinity();
 
 	for (int i = 1; i < argc; i++)
@@ -264,6 +267,8 @@ int main(int argc, const char* argv[])
 			screenshotFilename = argv[i] + strlen("--screenshot=");
 		else if (!strncmp(argv[i], "--timeout=", strlen("--timeout=")) && strlen(argv[i]) > strlen("--timeout="))
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
+		else if (!strncmp(argv[i], "--hle-profile=", strlen("--hle-profile=")) && strlen(argv[i]) > strlen("--hle-profile="))
+			hleProfileFilename = argv[i] + strlen("--hle-profile=");
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
@@ -390,6 +395,9 @@ int main(int argc, const char* argv[])
 	if (stateToLoad != NULL)
 		SaveState::Load(stateToLoad);
 
+	if (hleProfileFilename != 0)
+		HLEProfiler::SetEnabled(true);
+
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
 	for (size_t i = 0; i < testFilenames.size(); ++i)
@@ -423,6 +431,9 @@ int main(int argc, const char* argv[])
 		}
 	}
 
+	if (hleProfileFilename != 0 && !HLEProfiler::WriteStatsJSON(hleProfileFilename))
+		fprintf(stderr, "Unable to write HLE profile to %s\n", hleProfileFilename);
+
 	host->ShutdownGraphics();
 	delete host;
 	host = NULL;
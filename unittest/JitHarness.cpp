@@ -51,8 +51,14 @@ void UnitTestTerminator() {
 	hleSkipDeadbeef();
 }
 
+static int unitTestCounterCalls = 0;
+void UnitTestCounter() {
+	RETURN(++unitTestCounterCalls);
+}
+
 HLEFunction UnitTestFakeSyscalls[] = {
 	{0x1234BEEF, &UnitTestTerminator, "UnitTestTerminator"},
+	{0x1234C0DE, &UnitTestCounter, "UnitTestCounter"},
 };
 
 double ExecCPUTest() {
@@ -102,6 +108,27 @@ static void DestroyJitHarness() {
 	currentMIPS = nullptr;
 }
 
+// Runs a string of cheap syscalls, with or without HLE_DIRECT_CALL, and checks the results.
+static double ExecSyscallTest(bool direct, bool &valid) {
+	const int SYSCALLS = 100;
+
+	u32 *p = (u32 *)Memory::GetPointer(PSP_GetUserMemoryBase());
+	for (int i = 0; i < SYSCALLS; ++i) {
+		*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestCounter");
+	}
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	UnitTestFakeSyscalls[1].flags = direct ? HLE_DIRECT_CALL : 0;
+	MIPSComp::jit->ClearCache();
+	unitTestCounterCalls = 0;
+	double speed = ExecCPUTest() * SYSCALLS;
+
+	// Either way, the result comes back and the temps get clobbered.
+	valid = currentMIPS->r[MIPS_REG_V0] == (u32)unitTestCounterCalls && currentMIPS->r[MIPS_REG_A0] == 0xDEADBEEF;
+	return speed;
+}
+
 bool TestJit() {
 	SetupJitHarness();
 
@@ -189,11 +216,20 @@ bool TestJit() {
 		if (lines.size() > cutoff)
 			printf("...\n");
 		printf("Jit was %fx faster than interp.\n\n", jit_speed / interp_speed);
+
+		bool genericValid = false, directValid = false;
+		double generic_speed = ExecSyscallTest(false, genericValid);
+		double direct_speed = ExecSyscallTest(true, directValid);
+		printf("Syscalls: %0.0f per second generic, %0.0f per second direct.\n", generic_speed, direct_speed);
+		if (!genericValid || !directValid) {
+			printf("ERROR: Syscall results or register clobbering were wrong.\n");
+			compileSuccess = false;
+		}
 	}
 
 	printf("\n");
 
 	DestroyJitHarness();
 
-	return jit_speed >= interp_speed;
+	return compileSuccess && jit_speed >= interp_speed;
 }
\ No newline at end of file
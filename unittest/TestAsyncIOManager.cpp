@@ -0,0 +1,134 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <set>
+
+#include "base/timeutil.h"
+#include "thread/thread.h"
+#include "Common/ChunkFile.h"
+#include "Core/System.h"
+#include "Core/FileSystems/MetaFileSystem.h"
+#include "Core/HW/AsyncIOManager.h"
+
+#include "UnitTest.h"
+
+// Every read takes a while, like a slow memory stick or network share.
+class SlowFileSystem : public EmptyFileSystem {
+public:
+	u32 OpenFile(std::string filename, FileAccess access, const char *devicename = NULL) override {
+		u32 handle = pspFileSystem.GetNewHandle();
+		handles_.insert(handle);
+		return handle;
+	}
+	void CloseFile(u32 handle) override {
+		handles_.erase(handle);
+	}
+	bool OwnsHandle(u32 handle) override {
+		return handles_.find(handle) != handles_.end();
+	}
+	size_t ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) override {
+		sleep_ms(LATENCY_MS);
+		memset(pointer, (u8)handle, (size_t)size);
+		usec = (int)size;
+		return (size_t)size;
+	}
+	int Flags() override {
+		return FILESYSTEM_CONCURRENT_IO;
+	}
+
+	static const int LATENCY_MS = 20;
+
+private:
+	std::set<u32> handles_;
+};
+
+// Issues one async read per handle, like overlapping sceIoReadAsync calls, and waits for them all.
+static double TimeOverlappingReads(int workers, bool &valid) {
+	const int FILES = 8;
+	const int SIZE = 4096;
+
+	SlowFileSystem fs;
+	pspFileSystem.Mount("slow0:", &fs);
+
+	u32 handles[FILES];
+	for (int i = 0; i < FILES; ++i) {
+		handles[i] = pspFileSystem.OpenFile("slow0:/file.bin", FILEACCESS_READ);
+	}
+
+	AsyncIOManager manager;
+	manager.SetThreadEnabled(true);
+	volatile bool running = true;
+	std::thread ioThread([&] {
+		while (running) {
+			manager.RunEventsUntil(0);
+		}
+	});
+	manager.StartWorkers(workers);
+
+	static u8 buffers[FILES][SIZE];
+	double start = real_time_now();
+	for (int i = 0; i < FILES; ++i) {
+		AsyncIOEvent ev = IO_EVENT_READ;
+		ev.handle = handles[i];
+		ev.buf = buffers[i];
+		ev.bytes = SIZE;
+		manager.ScheduleOperation(ev);
+	}
+
+	valid = true;
+	u64 firstFinish = 0;
+	for (int i = 0; i < FILES; ++i) {
+		AsyncIOResult result;
+		if (!manager.WaitResult(handles[i], result) || result.result != SIZE || buffers[i][SIZE - 1] != (u8)handles[i]) {
+			valid = false;
+		}
+		// All were issued at the same emulated time, so host scheduling must not affect the finish time.
+		if (i == 0) {
+			firstFinish = result.finishTicks;
+		} else if (result.finishTicks != firstFinish) {
+			valid = false;
+		}
+	}
+	double elapsed = real_time_now() - start;
+
+	manager.SyncThread(true);
+	manager.StopWorkers();
+	running = false;
+	manager.ScheduleEvent(IO_EVENT_FINISH);
+	ioThread.join();
+
+	for (int i = 0; i < FILES; ++i) {
+		pspFileSystem.CloseFile(handles[i]);
+	}
+	pspFileSystem.Unmount("slow0:", &fs);
+	return elapsed;
+}
+
+bool TestAsyncIOManager() {
+	bool valid = false;
+	double serial = TimeOverlappingReads(1, valid);
+	EXPECT_TRUE(valid);
+	double concurrent = TimeOverlappingReads(4, valid);
+	EXPECT_TRUE(valid);
+
+	printf("Overlapping async reads: %0.1f ms with 1 worker, %0.1f ms with 4 workers\n", serial * 1000.0, concurrent * 1000.0);
+	EXPECT_TRUE(concurrent < serial);
+	return true;
+}
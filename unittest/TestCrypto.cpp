@@ -0,0 +1,181 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/CommonTypes.h"
+#include "Common/CPUDetect.h"
+#include "Common/Crypto/md5.h"
+#include "Common/Crypto/sha1.h"
+#include "Common/Crypto/sha256.h"
+
+extern "C" {
+#include "ext/libkirk/AES.h"
+}
+
+#include "UnitTest.h"
+
+static std::vector<u8> FromHex(const char *hex) {
+	std::vector<u8> bytes;
+	for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+		unsigned int b;
+		sscanf(hex + i, "%2x", &b);
+		bytes.push_back((u8)b);
+	}
+	return bytes;
+}
+
+static bool MatchesHex(const u8 *data, const char *hex) {
+	std::vector<u8> expected = FromHex(hex);
+	return memcmp(data, &expected[0], expected.size()) == 0;
+}
+
+// Known answers from FIPS-197 and RFC 4493.
+static bool TestAESKnownAnswers() {
+	std::vector<u8> key = FromHex("000102030405060708090a0b0c0d0e0f");
+	std::vector<u8> plain = FromHex("00112233445566778899aabbccddeeff");
+	u8 out[16];
+
+	AES_ctx ctx;
+	AES_set_key(&ctx, &key[0], 128);
+	AES_encrypt(&ctx, &plain[0], out);
+	EXPECT_TRUE(MatchesHex(out, "69c4e0d86a7b0430d8cdb78070b4c55a"));
+	AES_decrypt(&ctx, out, out);
+	EXPECT_TRUE(MatchesHex(out, "00112233445566778899aabbccddeeff"));
+
+	std::vector<u8> cmacKey = FromHex("2b7e151628aed2a6abf7158809cf4f3c");
+	std::vector<u8> message = FromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411");
+	AES_set_key(&ctx, &cmacKey[0], 128);
+	AES_CMAC(&ctx, &message[0], 0, out);
+	EXPECT_TRUE(MatchesHex(out, "bb1d6929e95937287fa37d129b756746"));
+	AES_CMAC(&ctx, &message[0], 16, out);
+	EXPECT_TRUE(MatchesHex(out, "070a16b46b4d4144f79bdd9dd04a287c"));
+	AES_CMAC(&ctx, &message[0], 40, out);
+	EXPECT_TRUE(MatchesHex(out, "dfa66747de9ae63030ca32611497c827"));
+	return true;
+}
+
+// Hardware and portable CBC must agree, including the odd block counts the 4-wide path leaves over.
+static bool TestAESCBCMatches() {
+	std::vector<u8> key = FromHex("2b7e151628aed2a6abf7158809cf4f3c");
+	const int SIZE = 16 * 23;
+	u8 plain[SIZE], portable[SIZE], accelerated[SIZE];
+	for (int i = 0; i < SIZE; ++i) {
+		plain[i] = (u8)(i * 7 + 3);
+	}
+
+	AES_ctx ctx;
+	AES_use_aesni(0);
+	AES_set_key(&ctx, &key[0], 128);
+	AES_cbc_encrypt(&ctx, plain, portable, SIZE);
+
+	AES_use_aesni(cpu_info.bAES);
+	AES_set_key(&ctx, &key[0], 128);
+	AES_cbc_encrypt(&ctx, plain, accelerated, SIZE);
+	EXPECT_EQ_INT(memcmp(portable, accelerated, SIZE), 0);
+
+	// In place, like kirk does.
+	AES_cbc_decrypt(&ctx, accelerated, accelerated, SIZE);
+	EXPECT_EQ_INT(memcmp(plain, accelerated, SIZE), 0);
+	return true;
+}
+
+static bool TestHashKnownAnswers() {
+	const char *abc = "abc";
+	const char *long448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	std::string million(1000000, 'a');
+	u8 digest[32];
+
+	sha256_context sha256;
+	sha256_starts(&sha256);
+	sha256_update(&sha256, (const uint8_t *)abc, 3);
+	sha256_finish(&sha256, digest);
+	EXPECT_TRUE(MatchesHex(digest, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+	sha256_starts(&sha256);
+	sha256_update(&sha256, (const uint8_t *)long448, (uint32_t)strlen(long448));
+	sha256_finish(&sha256, digest);
+	EXPECT_TRUE(MatchesHex(digest, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+	sha256_starts(&sha256);
+	sha256_update(&sha256, (const uint8_t *)million.data(), (uint32_t)million.size());
+	sha256_finish(&sha256, digest);
+	EXPECT_TRUE(MatchesHex(digest, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+
+	sha1_context sha1;
+	sha1_starts(&sha1);
+	sha1_update(&sha1, (unsigned char *)abc, 3);
+	sha1_finish(&sha1, digest);
+	EXPECT_TRUE(MatchesHex(digest, "a9993e364706816aba3e25717850c26c9cd0d89d"));
+	sha1_starts(&sha1);
+	sha1_update(&sha1, (unsigned char *)long448, (int)strlen(long448));
+	sha1_finish(&sha1, digest);
+	EXPECT_TRUE(MatchesHex(digest, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"));
+	sha1_starts(&sha1);
+	sha1_update(&sha1, (unsigned char *)&million[0], (int)million.size());
+	sha1_finish(&sha1, digest);
+	EXPECT_TRUE(MatchesHex(digest, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"));
+
+	md5_context md5;
+	md5_starts(&md5);
+	md5_update(&md5, (unsigned char *)abc, 3);
+	md5_finish(&md5, digest);
+	EXPECT_TRUE(MatchesHex(digest, "900150983cd24fb0d6963f7d28e17f72"));
+	return true;
+}
+
+static double TimeCrypto(std::vector<u8> &data) {
+	std::vector<u8> key = FromHex("2b7e151628aed2a6abf7158809cf4f3c");
+	u8 digest[32];
+	AES_ctx ctx;
+
+	double start = real_time_now();
+	AES_set_key(&ctx, &key[0], 128);
+	AES_cbc_decrypt(&ctx, &data[0], &data[0], (int)data.size());
+	sha1_context sha1;
+	sha1_starts(&sha1);
+	sha1_update(&sha1, &data[0], (int)data.size());
+	sha1_finish(&sha1, digest);
+	sha256_context sha256;
+	sha256_starts(&sha256);
+	sha256_update(&sha256, &data[0], (uint32_t)data.size());
+	sha256_finish(&sha256, digest);
+	return real_time_now() - start;
+}
+
+bool TestCrypto() {
+	// Always check the portable code, so machines with the extensions still cover it.
+	const CPUInfo saved = cpu_info;
+	cpu_info.bAES = false;
+	cpu_info.bSHA = false;
+	AES_use_aesni(0);
+	bool portableOk = TestAESKnownAnswers() && TestHashKnownAnswers();
+
+	std::vector<u8> data(8 * 1024 * 1024, 0x5A);
+	double portableTime = TimeCrypto(data);
+
+	cpu_info = saved;
+	AES_use_aesni(cpu_info.bAES);
+	bool acceleratedOk = TestAESKnownAnswers() && TestHashKnownAnswers() && TestAESCBCMatches();
+	double acceleratedTime = TimeCrypto(data);
+
+	printf("Crypto (AES-CBC + SHA-1 + SHA-256 over 8 MB): portable %0.1f ms, %s%s%0.1f ms\n", portableTime * 1000.0,
+		cpu_info.bAES ? "AES-NI " : "", cpu_info.bSHA ? "SHA-NI " : "", acceleratedTime * 1000.0);
+	return portableOk && acceleratedOk;
+}
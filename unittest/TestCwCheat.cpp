@@ -0,0 +1,123 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/StringUtils.h"
+#include "Core/CwCheat.h"
+#include "Core/MemMap.h"
+
+#include "UnitTest.h"
+
+// Cheat addresses are relative to the start of user memory.
+static const u32 CHEAT_BASE = 0x08800000;
+
+static bool TestCheatCodes() {
+	const char *lines[] = {
+		"_S ULUS-99999",
+		"_G Unit Test",
+		"_C1 Writes",
+		"_L 0x20001000 0x12345678",
+		"_L 0x00001004 0x000000AB",
+		"_L 0x10001006 0x0000BEEF",
+		"_L 0x30300010 0x00001008",
+		"_L 0x40001100 0x00040001",
+		"_L 0x00000005 0x00000001",
+		"_C0 Disabled",
+		"_L 0x20001020 0xDEADBEEF",
+		"_C1 Conditions",
+		// 16-bit equal, true, so the next line runs.
+		"_L 0xD0001000 0x00005678",
+		"_L 0x2000100C 0x11111111",
+		// 16-bit equal, false, so the next line is skipped.
+		"_L 0xD0001000 0x00001111",
+		"_L 0x20001010 0x22222222",
+		// 8-bit multi skip, 0xAB isn't 0x99, so skip two lines.
+		"_L 0xE1020099 0x00001004",
+		"_L 0x20001014 0x33333333",
+		"_L 0x20001018 0x44444444",
+		"_L 0x2000101C 0x55555555",
+		// Boolean OR.
+		"_L 0x70001004 0x00000010",
+		// Code stopper, nothing after this runs.
+		"_L 0xC0001000 0x00000000",
+		"_L 0x20001024 0x66666666",
+	};
+
+	Memory::Memset(CHEAT_BASE, 0, 0x2000);
+	Memory::Write_U16(0x0100, CHEAT_BASE + 0x1008);
+
+	CWCheatEngine engine;
+	engine.CreateCodeList(std::vector<std::string>(lines, lines + ARRAY_SIZE(lines)));
+	EXPECT_TRUE(engine.HasCheats());
+	engine.Run();
+
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1000), 0x12345678);
+	EXPECT_EQ_INT(Memory::Read_U8(CHEAT_BASE + 0x1004), 0xAB | 0x10);
+	EXPECT_EQ_INT(Memory::Read_U16(CHEAT_BASE + 0x1006), 0xBEEF);
+	EXPECT_EQ_INT(Memory::Read_U16(CHEAT_BASE + 0x1008), 0x0110);
+	for (int i = 0; i < 4; ++i) {
+		EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1100 + i * 4), 5 + i);
+	}
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x100C), 0x11111111);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1010), 0);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1014), 0);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1018), 0);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x101C), 0x55555555);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1020), 0);
+	EXPECT_EQ_INT(Memory::Read_U32(CHEAT_BASE + 0x1024), 0);
+
+	// Running again increments again, and the rest stays put.
+	engine.Run();
+	EXPECT_EQ_INT(Memory::Read_U16(CHEAT_BASE + 0x1008), 0x0120);
+	return true;
+}
+
+bool TestCwCheat() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	bool valid = TestCheatCodes();
+
+	// Like a big cheat database: lots of codes, many behind conditions.
+	const int CHEATS = 500;
+	const int LINES_PER_CHEAT = 10;
+	std::vector<std::string> database;
+	for (int c = 0; c < CHEATS; ++c) {
+		database.push_back(StringFromFormat("_C1 Cheat %d", c));
+		database.push_back(StringFromFormat("_L 0xD%07X 0x00000000", 0x10000 + c * 4));
+		for (int i = 1; i < LINES_PER_CHEAT; ++i) {
+			database.push_back(StringFromFormat("_L 0x2%07X 0x%08X", 0x20000 + (c * LINES_PER_CHEAT + i) * 4, c * i));
+		}
+	}
+
+	CWCheatEngine engine;
+	engine.CreateCodeList(database);
+	const int RUNS = 100;
+	double start = real_time_now();
+	for (int r = 0; r < RUNS; ++r) {
+		engine.Run();
+	}
+	double elapsed = real_time_now() - start;
+	printf("CwCheat: %d lines in %0.3f ms per run\n", CHEATS * LINES_PER_CHEAT, elapsed * 1000.0 / RUNS);
+
+	Memory::Shutdown();
+	return valid;
+}
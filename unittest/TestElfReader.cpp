@@ -0,0 +1,162 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/ELF/ElfReader.h"
+#include "Core/HLE/sceKernelMemory.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MemMap.h"
+#include "Core/System.h"
+
+#include "UnitTest.h"
+
+// The first words stand in for the module info, relocated code follows in groups of four.
+static const u32 FIRST_RELOCATED_WORD = 16;
+
+static u32 TestRelocationTarget(u32 word) {
+	// Every other target needs the HI16 carry.
+	return word * 4 + ((word & 4) ? 0x8000 : 0);
+}
+
+// Builds a relocatable PRX with a .text of textWords words and a PSP relocation section for it.
+static std::vector<u8> BuildTestPRX(u32 textWords, u32 &numRelocs) {
+	const u32 textOffset = 128;
+	const u32 textSize = textWords * 4;
+	const u32 relOffset = textOffset + textSize;
+	const u32 groups = (textWords - FIRST_RELOCATED_WORD) / 4;
+	numRelocs = groups * 4;
+	const u32 relSize = numRelocs * sizeof(Elf32_Rel);
+	const char strtab[] = "\0.text\0.rel.text\0.shstrtab";
+	const u32 strtabOffset = relOffset + relSize;
+	const u32 shOffset = (strtabOffset + sizeof(strtab) + 3) & ~3;
+	const int numSections = 4;
+
+	std::vector<u8> image(shOffset + numSections * sizeof(Elf32_Shdr));
+	Elf32_Ehdr *header = (Elf32_Ehdr *)&image[0];
+	memcpy(header->e_ident, "\x7f" "ELF", 4);
+	header->e_ident[EI_CLASS] = ELFCLASS32;
+	header->e_ident[EI_DATA] = ELFDATA2LSB;
+	header->e_type = ET_PSP_PRX;
+	header->e_machine = EM_MIPS;
+	header->e_version = EV_CURRENT;
+	header->e_phoff = 64;
+	header->e_shoff = shOffset;
+	header->e_ehsize = sizeof(Elf32_Ehdr);
+	header->e_phentsize = sizeof(Elf32_Phdr);
+	header->e_phnum = 1;
+	header->e_shentsize = sizeof(Elf32_Shdr);
+	header->e_shnum = numSections;
+	header->e_shstrndx = 3;
+
+	Elf32_Phdr *segment = (Elf32_Phdr *)&image[64];
+	segment->p_type = PT_LOAD;
+	segment->p_offset = textOffset;
+	segment->p_paddr = textOffset;
+	segment->p_filesz = textSize;
+	segment->p_memsz = textSize;
+
+	u32_le *text = (u32_le *)&image[textOffset];
+	Elf32_Rel *rels = (Elf32_Rel *)&image[relOffset];
+	for (u32 g = 0; g < groups; ++g) {
+		const u32 word = FIRST_RELOCATED_WORD + g * 4;
+		const u32 target = TestRelocationTarget(word);
+		text[word + 0] = 0x3C020000 | (((target >> 16) + ((target & 0x8000) ? 1 : 0)) & 0xFFFF);  // lui v0, %hi
+		text[word + 1] = 0x24420000 | (target & 0xFFFF);  // addiu v0, v0, %lo
+		text[word + 2] = target;
+		text[word + 3] = 0x0C000000 | (target >> 2);  // jal
+		static const u32 types[4] = { R_MIPS_HI16, R_MIPS_LO16, R_MIPS_32, R_MIPS_26 };
+		for (int i = 0; i < 4; ++i) {
+			rels[g * 4 + i].r_offset = (word + i) * 4;
+			rels[g * 4 + i].r_info = types[i];
+		}
+	}
+	memcpy(&image[strtabOffset], strtab, sizeof(strtab));
+
+	Elf32_Shdr *sections = (Elf32_Shdr *)&image[shOffset];
+	sections[1].sh_name = 1;
+	sections[1].sh_type = SHT_PROGBITS;
+	sections[1].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	sections[1].sh_offset = textOffset;
+	sections[1].sh_size = textSize;
+	sections[2].sh_name = 7;
+	sections[2].sh_type = SHT_PSPREL;
+	sections[2].sh_offset = relOffset;
+	sections[2].sh_size = relSize;
+	sections[2].sh_info = 1;
+	sections[3].sh_name = 17;
+	sections[3].sh_type = SHT_STRTAB;
+	sections[3].sh_offset = strtabOffset;
+	sections[3].sh_size = sizeof(strtab);
+	return image;
+}
+
+static bool CheckRelocated(u32 base, u32 textWords) {
+	for (u32 word = FIRST_RELOCATED_WORD; word + 4 <= textWords; word += 4) {
+		const u32 target = TestRelocationTarget(word) + base;
+		const u32 addr = base + word * 4;
+		const u32 hiLo = (Memory::Read_U32(addr) << 16) + (s32)(s16)(Memory::Read_U32(addr + 4) & 0xFFFF);
+		EXPECT_EQ_INT(hiLo, target);
+		EXPECT_EQ_INT(Memory::Read_U32(addr + 8), target);
+		EXPECT_EQ_INT(Memory::Read_U32(addr + 12) & 0x03FFFFFF, (target >> 2) & 0x03FFFFFF);
+	}
+	return true;
+}
+
+bool TestElfReader() {
+	const int MODULES = 8;
+	const u32 TEXT_WORDS = 64 * 1024;
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	userMemory.Init(PSP_GetUserMemoryBase(), PSP_GetUserMemoryEnd() - PSP_GetUserMemoryBase());
+	currentMIPS = &mipsr4k;
+	// Fault in the pages first, so we time the loader rather than the host.
+	Memory::Memset(PSP_GetUserMemoryBase(), 0, PSP_GetUserMemoryEnd() - PSP_GetUserMemoryBase());
+
+	u32 numRelocs = 0;
+	std::vector<u8> images[MODULES];
+	for (int i = 0; i < MODULES; ++i) {
+		images[i] = BuildTestPRX(TEXT_WORDS, numRelocs);
+	}
+
+	// Like a game with a pile of PRXs, load them all side by side.
+	bool valid = true;
+	u32 addrs[MODULES];
+	double start = real_time_now();
+	for (int i = 0; i < MODULES; ++i) {
+		ElfReader reader(&images[i][0]);
+		valid = reader.LoadInto(0, false) == 0 && valid;
+		addrs[i] = reader.GetVaddr();
+	}
+	double elapsed = real_time_now() - start;
+
+	for (int i = 0; i < MODULES && valid; ++i) {
+		valid = CheckRelocated(addrs[i], TEXT_WORDS);
+		userMemory.Free(addrs[i]);
+	}
+	printf("ELF load: %d modules with %d relocations each in %0.2f ms\n", MODULES, numRelocs, elapsed * 1000.0);
+
+	userMemory.Shutdown();
+	Memory::Shutdown();
+	currentMIPS = nullptr;
+	return valid;
+}
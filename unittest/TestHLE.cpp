@@ -0,0 +1,142 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/HLE/HLE.h"
+#include "Core/HLE/HLEProfiler.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+
+#include "UnitTest.h"
+
+// Roughly the shape of the real tables: lots of modules, some of them large.
+static const int TEST_MODULES = 64;
+static const int TEST_FUNCS_PER_MODULE = 48;
+
+static char testModuleNames[TEST_MODULES][32];
+static HLEFunction testModuleFuncs[TEST_MODULES][TEST_FUNCS_PER_MODULE];
+
+static u32 TestNID(int module, int func) {
+	// Something that looks like a hash, as NIDs do.
+	u32 x = (u32)(module * TEST_FUNCS_PER_MODULE + func + 1) * 0x9E3779B1;
+	return x ^ (x >> 15);
+}
+
+static void RegisterTestModules() {
+	for (int m = 0; m < TEST_MODULES; ++m) {
+		snprintf(testModuleNames[m], sizeof(testModuleNames[m]), "sceUnitTestLibrary%02d", m);
+		for (int f = 0; f < TEST_FUNCS_PER_MODULE; ++f) {
+			HLEFunction &func = testModuleFuncs[m][f];
+			func.ID = TestNID(m, f);
+			func.func = nullptr;
+			func.name = testModuleNames[m];
+			func.flags = 0;
+		}
+		RegisterModule(testModuleNames[m], TEST_FUNCS_PER_MODULE, testModuleFuncs[m]);
+	}
+}
+
+static bool TestHLEProfiler() {
+	HLEProfiler::Reset();
+	// Mostly fast, with the occasional slow call, like a function that sometimes waits.
+	for (int i = 0; i < 1000; ++i) {
+		bool slow = i % 50 == 0;
+		HLEProfiler::Record("sceUnitTestLibrary01", &testModuleFuncs[1][2], slow ? 0.001 : 0.000001, slow, false);
+	}
+	HLEProfiler::Record("sceUnitTestLibrary02", &testModuleFuncs[2][0], 0.5, true, true);
+
+	std::vector<HLEProfiler::FunctionStats> stats = HLEProfiler::GetStats();
+	EXPECT_EQ_INT((int)stats.size(), 2);
+	// Most expensive first.
+	EXPECT_EQ_STR(std::string(stats[0].module), std::string("sceUnitTestLibrary02"));
+	EXPECT_EQ_INT((int)stats[0].threadSwitches, 1);
+
+	const HLEProfiler::FunctionStats &s = stats[1];
+	EXPECT_EQ_INT((int)s.calls, 1000);
+	EXPECT_EQ_INT((int)s.reschedules, 20);
+	EXPECT_EQ_INT((int)s.threadSwitches, 0);
+	EXPECT_TRUE(s.maxTime == 0.001);
+	// The histogram is only accurate to a quarter of a power of two.
+	EXPECT_TRUE(s.p50 > 0.0000008 && s.p50 < 0.00000125);
+	EXPECT_TRUE(s.p99 > 0.0008 && s.p99 <= 0.001);
+
+	std::string json = HLEProfiler::GetStatsJSON();
+	EXPECT_TRUE(json.find("\"module\": \"sceUnitTestLibrary01\"") != json.npos);
+	EXPECT_TRUE(json.find("\"calls\": 1000, \"reschedules\": 20,") != json.npos);
+
+	HLEProfiler::Reset();
+	EXPECT_TRUE(HLEProfiler::GetStats().empty());
+	return true;
+}
+
+bool TestHLE() {
+	const int IMPORTS = 600;
+	const int ROUNDS = 100;
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	RegisterTestModules();
+
+	EXPECT_EQ_INT(GetModuleIndex("sceUnitTestLibrary00"), 0);
+	EXPECT_EQ_INT(GetModuleIndex("sceUnitTestLibrary63"), 63);
+	EXPECT_EQ_INT(GetModuleIndex("sceUnitTestLibrary64"), -1);
+	EXPECT_EQ_INT(GetFuncIndex(10, TestNID(10, 47)), 47);
+	EXPECT_EQ_INT(GetFuncIndex(10, TestNID(11, 0)), -1);
+	EXPECT_FALSE(FuncImportIsSyscall("sceUnitTestLibrary01", TestNID(2, 0)));
+	EXPECT_TRUE(GetFunc("sceUnitTestLibrary05", TestNID(5, 3)) == &testModuleFuncs[5][3]);
+
+	// Like a game importing a few hundred functions, spread over the libraries.
+	std::vector<int> importModules(IMPORTS), importFuncs(IMPORTS);
+	for (int i = 0; i < IMPORTS; ++i) {
+		importModules[i] = (i * 37) % TEST_MODULES;
+		importFuncs[i] = (i * 13) % TEST_FUNCS_PER_MODULE;
+	}
+
+	const u32 stubBase = PSP_GetUserMemoryBase();
+	bool valid = true;
+	double start = real_time_now();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (int i = 0; i < IMPORTS; ++i) {
+			const char *moduleName = testModuleNames[importModules[i]];
+			u32 nid = TestNID(importModules[i], importFuncs[i]);
+			if (FuncImportIsSyscall(moduleName, nid)) {
+				valid = WriteSyscall(moduleName, nid, stubBase + i * 8) && valid;
+			} else {
+				valid = false;
+			}
+		}
+	}
+	double elapsed = real_time_now() - start;
+	EXPECT_TRUE(valid);
+
+	// Every stub has to dispatch back to the function it imported.
+	for (int i = 0; i < IMPORTS; ++i) {
+		MIPSOpcode op(Memory::Read_U32(stubBase + i * 8 + 4));
+		EXPECT_TRUE(GetSyscallInfo(op) == &testModuleFuncs[importModules[i]][importFuncs[i]]);
+	}
+	printf("HLE imports: %d resolved in %0.3f ms\n", IMPORTS, elapsed * 1000.0 / ROUNDS);
+
+	bool profilerValid = TestHLEProfiler();
+
+	HLEShutdown();
+	Memory::Shutdown();
+	return profilerValid;
+}
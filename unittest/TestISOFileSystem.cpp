@@ -0,0 +1,213 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/ISOFileSystem.h"
+
+#include "UnitTest.h"
+
+class MemoryBlockDevice : public BlockDevice {
+public:
+	MemoryBlockDevice(const std::vector<u8> &data) : data_(data) {}
+
+	bool ReadBlock(int blockNumber, u8 *outPtr) override {
+		if ((u32)blockNumber >= GetNumBlocks()) {
+			return false;
+		}
+		memcpy(outPtr, &data_[blockNumber * 2048], 2048);
+		return true;
+	}
+	u32 GetNumBlocks() override {
+		return (u32)(data_.size() / 2048);
+	}
+
+private:
+	std::vector<u8> data_;
+};
+
+struct IsoRecord {
+	std::string name;
+	u32 sector;
+	u32 size;
+	bool dir;
+};
+
+static int IsoRecordSize(const IsoRecord &r) {
+	return (33 + (int)r.name.size() + 1) & ~1;
+}
+
+static u32 IsoSectorsFor(const std::vector<IsoRecord> &records) {
+	u32 sectors = 1;
+	int offset = 0;
+	for (auto r : records) {
+		if (offset + IsoRecordSize(r) > 2048) {
+			++sectors;
+			offset = 0;
+		}
+		offset += IsoRecordSize(r);
+	}
+	return sectors;
+}
+
+static void IsoWriteBoth32(u8 *p, u32 v) {
+	for (int i = 0; i < 4; ++i) {
+		p[i] = (u8)(v >> (i * 8));
+		p[7 - i] = (u8)(v >> (i * 8));
+	}
+}
+
+static void IsoWriteRecords(std::vector<u8> &iso, u32 sector, const std::vector<IsoRecord> &records) {
+	int offset = 0;
+	for (auto r : records) {
+		if (offset + IsoRecordSize(r) > 2048) {
+			++sector;
+			offset = 0;
+		}
+		u8 *p = &iso[sector * 2048 + offset];
+		p[0] = (u8)IsoRecordSize(r);
+		IsoWriteBoth32(p + 2, r.sector);
+		IsoWriteBoth32(p + 10, r.size);
+		p[25] = r.dir ? 2 : 0;
+		p[28] = 1;
+		p[31] = 1;
+		p[32] = (u8)r.name.size();
+		memcpy(p + 33, r.name.data(), r.name.size());
+		offset += IsoRecordSize(r);
+	}
+}
+
+// Builds a minimal ISO9660 image with dirs directories of filesPerDir files each.
+static std::vector<u8> BuildTestISO(int dirs, int filesPerDir) {
+	std::vector<std::vector<IsoRecord>> dirRecords(dirs + 1);
+	char name[32];
+
+	std::vector<IsoRecord> &root = dirRecords[0];
+	root.push_back(IsoRecord{ std::string(1, '\0'), 0, 0, true });
+	root.push_back(IsoRecord{ std::string(1, '\1'), 0, 0, true });
+	for (int d = 0; d < dirs; ++d) {
+		snprintf(name, sizeof(name), "DIR%03d", d);
+		root.push_back(IsoRecord{ name, 0, 0, true });
+
+		std::vector<IsoRecord> &records = dirRecords[d + 1];
+		records.push_back(IsoRecord{ std::string(1, '\0'), 0, 0, true });
+		records.push_back(IsoRecord{ std::string(1, '\1'), 0, 0, true });
+		for (int f = 0; f < filesPerDir; ++f) {
+			snprintf(name, sizeof(name), "FILE%04d.BIN", f);
+			records.push_back(IsoRecord{ name, 0, 2048, false });
+		}
+	}
+
+	// Sector 16 is the volume descriptor, directories follow, then one shared data sector.
+	std::vector<u32> dirSectors(dirs + 1);
+	u32 nextSector = 18;
+	for (size_t i = 0; i < dirRecords.size(); ++i) {
+		dirSectors[i] = nextSector;
+		nextSector += IsoSectorsFor(dirRecords[i]);
+	}
+	const u32 dataSector = nextSector++;
+
+	for (size_t i = 0; i < dirRecords.size(); ++i) {
+		std::vector<IsoRecord> &records = dirRecords[i];
+		u32 size = IsoSectorsFor(records) * 2048;
+		records[0].sector = dirSectors[i];
+		records[0].size = size;
+		records[1].sector = dirSectors[0];
+		records[1].size = IsoSectorsFor(dirRecords[0]) * 2048;
+		for (size_t j = 2; j < records.size(); ++j) {
+			if (i == 0) {
+				records[j].sector = dirSectors[j - 1];
+				records[j].size = IsoSectorsFor(dirRecords[j - 1]) * 2048;
+			} else {
+				records[j].sector = dataSector;
+			}
+		}
+	}
+
+	std::vector<u8> iso(nextSector * 2048);
+	u8 *desc = &iso[16 * 2048];
+	desc[0] = 1;
+	memcpy(desc + 1, "CD001", 5);
+	desc[6] = 1;
+	IsoWriteBoth32(desc + 80, nextSector);
+	// Root directory record.
+	IsoRecord rootRecord{ std::string(1, '\0'), dirSectors[0], IsoSectorsFor(root) * 2048, true };
+	std::vector<u8> temp(2048);
+	IsoWriteRecords(temp, 0, std::vector<IsoRecord>(1, rootRecord));
+	memcpy(desc + 156, &temp[0], 34);
+
+	for (size_t i = 0; i < dirRecords.size(); ++i) {
+		IsoWriteRecords(iso, dirSectors[i], dirRecords[i]);
+	}
+	return iso;
+}
+
+bool TestISOFileSystem() {
+	const int DIRS = 64;
+	const int FILES = 100;
+
+	SequentialHandleAllocator handles;
+	// Takes ownership of the block device.
+	ISOFileSystem fs(&handles, new MemoryBlockDevice(BuildTestISO(DIRS, FILES)));
+
+	// Lookups are case insensitive and tolerate a few path quirks.
+	EXPECT_TRUE(fs.GetFileInfo("/DIR000/FILE0000.BIN").exists);
+	EXPECT_TRUE(fs.GetFileInfo("dir063/file0099.bin").exists);
+	EXPECT_TRUE(fs.GetFileInfo("./Dir010//File0050.Bin").exists);
+	EXPECT_TRUE(fs.GetFileInfo("/DIR001/").type == FILETYPE_DIRECTORY);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR000/FILE0100.BIN").exists);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR999/FILE0000.BIN").exists);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR000/FILE0000.BIN/X").exists);
+	EXPECT_EQ_INT((int)fs.GetDirListing("/DIR002").size(), FILES);
+	EXPECT_EQ_INT((int)fs.GetDirListing("/").size(), DIRS);
+
+	// Some games open and stat the same files over and over, measure that.
+	const int ITERATIONS = 100000;
+	char path[64];
+	double start = real_time_now();
+	for (int i = 0; i < ITERATIONS; ++i) {
+		snprintf(path, sizeof(path), "/dir%03d/FILE%04d.bin", i % DIRS, (i * 7) % FILES);
+		u32 handle = fs.OpenFile(path, FILEACCESS_READ);
+		EXPECT_TRUE(handle != 0);
+		fs.CloseFile(handle);
+		EXPECT_TRUE(fs.GetFileInfo(path).exists);
+	}
+	double elapsed = real_time_now() - start;
+	printf("ISO open/stat: %d lookups in %0.2f ms (%0.0f per second)\n", ITERATIONS * 2, elapsed * 1000.0, (ITERATIONS * 2) / elapsed);
+
+	// The RAM cache fills lazily, reads before and after the background fill must match.
+	std::vector<u8> iso = BuildTestISO(DIRS, FILES);
+	start = real_time_now();
+	RAMBlockDevice ram(new MemoryBlockDevice(iso));
+	u8 block[2048];
+	EXPECT_TRUE(ram.ReadBlock(16, block));
+	printf("RAMBlockDevice: first block after %0.3f ms\n", (real_time_now() - start) * 1000.0);
+	EXPECT_EQ_INT(memcmp(block, &iso[16 * 2048], 2048), 0);
+	for (u32 i = 0; i < ram.GetNumBlocks(); ++i) {
+		EXPECT_TRUE(ram.ReadBlock(i, block));
+		EXPECT_EQ_INT(memcmp(block, &iso[i * 2048], 2048), 0);
+	}
+	EXPECT_FALSE(ram.ReadBlock(ram.GetNumBlocks(), block));
+
+	return true;
+}
@@ -0,0 +1,240 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/CommonTypes.h"
+#include "Common/Swap.h"
+#include "Core/Font/PGF.h"
+#include "Core/MemMap.h"
+
+#include "UnitTest.h"
+
+// About the size of the Japanese font.
+static const int TEST_GLYPHS = 4096;
+static const int TEST_GLYPH_SIZE = 24;
+static const int TEST_FIRST_CHAR = 0x20;
+
+class BitWriter {
+public:
+	void Write(u32 value, int bits) {
+		for (int i = 0; i < bits; ++i, ++pos_) {
+			if (data_.size() <= pos_ / 8)
+				data_.resize(pos_ / 8 + 1);
+			data_[pos_ / 8] |= ((value >> i) & 1) << (pos_ & 7);
+		}
+	}
+	void AlignTo(int bits) {
+		pos_ = (pos_ + bits - 1) / bits * bits;
+		data_.resize(pos_ / 8);
+	}
+	size_t Pos() const {
+		return pos_;
+	}
+	std::vector<u8> &Data() {
+		return data_;
+	}
+
+private:
+	std::vector<u8> data_;
+	size_t pos_ = 0;
+};
+
+// Has runs of the same value, so both kinds of RLE get used.
+static int TestPixel(int glyph, int xx, int yy) {
+	return ((xx / 4) * 3 + yy + glyph) & 15;
+}
+
+static void WriteGlyphBitmap(BitWriter &w, int glyph, bool vRows) {
+	std::vector<int> values;
+	for (int i = 0; i < TEST_GLYPH_SIZE * TEST_GLYPH_SIZE; ++i) {
+		int a = i / TEST_GLYPH_SIZE, b = i % TEST_GLYPH_SIZE;
+		values.push_back(vRows ? TestPixel(glyph, a, b) : TestPixel(glyph, b, a));
+	}
+
+	size_t i = 0;
+	while (i < values.size()) {
+		size_t run = 1;
+		while (i + run < values.size() && run < 8 && values[i + run] == values[i])
+			++run;
+		if (run > 1) {
+			w.Write((u32)run - 1, 4);
+			w.Write(values[i], 4);
+		} else {
+			size_t count = 1;
+			while (i + count < values.size() && count < 8 && values[i + count] != values[i + count - 1])
+				++count;
+			w.Write(16 - (u32)count, 4);
+			for (size_t j = 0; j < count; ++j)
+				w.Write(values[i + j], 4);
+			run = count;
+		}
+		i += run;
+	}
+}
+
+// A rev 2 font with no metric tables, every glyph spells its metrics out.
+static std::vector<u8> BuildTestPGF() {
+	PGFHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.PGFMagic, "PGF0", 4);
+	header.revision = 2;
+	header.version = 6;
+	header.charMapLength = TEST_GLYPHS;
+	header.charMapBpe = 16;
+	header.charPointerLength = TEST_GLYPHS;
+	header.charPointerBpe = 24;
+	header.bpp = 4;
+	strcpy(header.fontName, "Unit Test Gothic");
+	header.firstGlyph = TEST_FIRST_CHAR;
+	header.lastGlyph = TEST_FIRST_CHAR + TEST_GLYPHS - 1;
+	header.maxGlyphWidth = TEST_GLYPH_SIZE;
+	header.maxGlyphHeight = TEST_GLYPH_SIZE;
+
+	BitWriter charMap, charPointers, glyphData;
+	for (int i = 0; i < TEST_GLYPHS; ++i) {
+		charMap.Write(i, header.charMapBpe);
+
+		glyphData.AlignTo(32);
+		charPointers.Write((u32)(glyphData.Pos() / 32), header.charPointerBpe);
+		bool vRows = (i & 1) != 0;
+		glyphData.Write(0, 14);
+		glyphData.Write(TEST_GLYPH_SIZE, 7);
+		glyphData.Write(TEST_GLYPH_SIZE, 7);
+		glyphData.Write(0, 7);
+		glyphData.Write(TEST_GLYPH_SIZE, 7);
+		glyphData.Write(vRows ? FONT_PGF_BMP_V_ROWS : FONT_PGF_BMP_H_ROWS, 6);
+		glyphData.Write(0, 2 + 2 + 3 + 9);
+		for (int m = 0; m < 8; ++m)
+			glyphData.Write(TEST_GLYPH_SIZE << 6, 32);
+		WriteGlyphBitmap(glyphData, i, vRows);
+	}
+	charMap.AlignTo(32);
+	charPointers.AlignTo(32);
+	glyphData.AlignTo(32);
+	// The decoder reads whole words, leave it some room at the end.
+	glyphData.Write(0, 64);
+
+	std::vector<u8> font((const u8 *)&header, (const u8 *)&header + sizeof(header));
+	font.insert(font.end(), charMap.Data().begin(), charMap.Data().end());
+	font.insert(font.end(), charPointers.Data().begin(), charPointers.Data().end());
+	font.insert(font.end(), glyphData.Data().begin(), glyphData.Data().end());
+	return font;
+}
+
+// What the old pixel at a time drawing would leave in the buffer.
+static void DrawReference(std::vector<u8> &buf, const GlyphImage &image, int glyph, int clipX, int clipY, int clipW, int clipH) {
+	static const int bytesPerPixel[] = { 0, 0, 1, 3, 4 };
+	const int format = (FontPixelFormat)(u32)image.pixelFormat;
+	const int pixelBytes = bytesPerPixel[format];
+	const int maxWidth = pixelBytes == 0 ? image.bytesPerLine * 2 : image.bytesPerLine / pixelBytes;
+	for (int yy = 0; yy < TEST_GLYPH_SIZE; ++yy) {
+		for (int xx = 0; xx < TEST_GLYPH_SIZE; ++xx) {
+			int px = (image.xPos64 >> 6) + xx, py = (image.yPos64 >> 6) + yy;
+			if (px < clipX || px >= clipX + clipW || py < clipY || py >= clipY + clipH)
+				continue;
+			if (px < 0 || px >= image.bufWidth || px >= maxWidth || py < 0 || py >= image.bufHeight)
+				continue;
+			u8 value = (u8)TestPixel(glyph, xx, yy);
+			if (pixelBytes == 0) {
+				u8 &b = buf[py * image.bytesPerLine + px / 2];
+				b = (px & 1) != format ? (u8)((value << 4) | (b & 0xF)) : (u8)((b & 0xF0) | value);
+			} else {
+				memset(&buf[py * image.bytesPerLine + px * pixelBytes], value * 0x11, pixelBytes);
+			}
+		}
+	}
+}
+
+static bool TestGlyphFormats(const PGF &pgf, u32 bufAddr) {
+	const int BUF_W = 40, BUF_H = 32;
+	for (int format = PSP_FONT_PIXELFORMAT_4; format <= PSP_FONT_PIXELFORMAT_32; ++format) {
+		GlyphImage image;
+		image.pixelFormat = (FontPixelFormat)format;
+		image.xPos64 = 21 << 6;
+		image.yPos64 = -3 << 6;
+		image.bufWidth = BUF_W;
+		image.bufHeight = BUF_H;
+		image.bytesPerLine = format <= PSP_FONT_PIXELFORMAT_4_REV ? BUF_W / 2 : BUF_W * (format - 1);
+		image.pad = 0;
+		image.bufferPtr = bufAddr;
+
+		// An odd clip, and glyphs hanging off the top and right of the buffer.
+		const int glyph = 5 + format;
+		const int size = image.bytesPerLine * BUF_H;
+		std::vector<u8> expected(size, 0xA5);
+		DrawReference(expected, image, glyph, 3, 1, 30, 29);
+		Memory::Memset(bufAddr, 0xA5, size);
+		pgf.DrawCharacter(&image, 3, 1, 30, 29, TEST_FIRST_CHAR + glyph, 0, FONT_PGF_CHARGLYPH);
+		EXPECT_EQ_INT(memcmp(Memory::GetPointer(bufAddr), &expected[0], size), 0);
+
+		// And again from the cache, at an odd position for the 4-bit formats.
+		image.xPos64 = 1 << 6;
+		image.yPos64 = 4 << 6;
+		std::fill(expected.begin(), expected.end(), 0xA5);
+		DrawReference(expected, image, glyph, 0, 0, 8192, 8192);
+		Memory::Memset(bufAddr, 0xA5, size);
+		pgf.DrawCharacter(&image, -1, -1, -1, -1, TEST_FIRST_CHAR + glyph, 0, FONT_PGF_CHARGLYPH);
+		EXPECT_EQ_INT(memcmp(Memory::GetPointer(bufAddr), &expected[0], size), 0);
+	}
+	return true;
+}
+
+static double DrawAllGlyphs(const PGF &pgf, u32 bufAddr) {
+	GlyphImage image;
+	image.pixelFormat = PSP_FONT_PIXELFORMAT_8;
+	image.xPos64 = 0;
+	image.yPos64 = 0;
+	image.bufWidth = 32;
+	image.bufHeight = 32;
+	image.bytesPerLine = 32;
+	image.pad = 0;
+	image.bufferPtr = bufAddr;
+
+	double start = real_time_now();
+	for (int i = 0; i < TEST_GLYPHS; ++i) {
+		pgf.DrawCharacter(&image, -1, -1, -1, -1, TEST_FIRST_CHAR + i, 0, FONT_PGF_CHARGLYPH);
+	}
+	return real_time_now() - start;
+}
+
+bool TestPGF() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	const u32 bufAddr = PSP_GetUserMemoryBase();
+
+	std::vector<u8> font = BuildTestPGF();
+	PGF pgf;
+	EXPECT_TRUE(pgf.ReadPtr(&font[0], font.size()));
+
+	PGFCharInfo info;
+	EXPECT_TRUE(pgf.GetCharInfo(TEST_FIRST_CHAR + 100, &info, 0));
+	EXPECT_EQ_INT((int)info.bitmapWidth, TEST_GLYPH_SIZE);
+
+	bool valid = TestGlyphFormats(pgf, bufAddr);
+
+	// Like a text heavy game drawing the whole font, then drawing it again.
+	double firstTime = DrawAllGlyphs(pgf, bufAddr);
+	double cachedTime = DrawAllGlyphs(pgf, bufAddr);
+	printf("PGF: %d glyphs of %dx%d in %0.2f ms decoding, %0.2f ms cached\n", TEST_GLYPHS, TEST_GLYPH_SIZE, TEST_GLYPH_SIZE, firstTime * 1000.0, cachedTime * 1000.0);
+
+	Memory::Shutdown();
+	return valid;
+}
@@ -0,0 +1,612 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/FileUtil.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "GPU/ge_constants.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/FramebufferCommon.h"
+#include "GPU/Common/ScaledTextureDiskCache.h"
+#include "GPU/Common/TextureCacheCommon.h"
+
+#include "UnitTest.h"
+
+static const u32 TEX_BASE = 0x08900000;
+static const u32 CLUT_BASE = 0x08B00000;
+
+// Decodes like a backend would, but keeps the PSP's colors and only remembers the last upload.
+class HeadlessTextureCache : public TextureCacheCommon {
+public:
+	HeadlessTextureCache() : uploads(0), binds(0), nextName_(1) {}
+	~HeadlessTextureCache() {
+		ShutdownDecodeWorkers();
+	}
+
+	int uploads;
+	int binds;
+	std::vector<u8> lastDecoded;
+
+protected:
+	void Unbind() override {}
+	void InvalidateLastTexture() override {}
+	void BindTexture(TexCacheEntry *entry) override {
+		binds++;
+	}
+	void ReleaseTexture(TexCacheEntry *entry) override {
+		entry->textureName = 0;
+	}
+	void BuildTexture(TexCacheEntry *entry, bool replaceImages) override {
+		const GETextureFormat format = GETextureFormat(entry->format);
+		const u32 dstFmt = GetDestFormat(format, gstate.getClutPaletteFormat());
+		u32 texByteAlign = 1;
+		const u8 *data = (const u8 *)DecodeTextureLevel(format, gstate.getClutPaletteFormat(), 0, texByteAlign, dstFmt);
+		if (data) {
+			lastDecoded.assign(data, data + gstate.getTextureWidth(0) * gstate.getTextureHeight(0) * dstFmt);
+			SetLevelBytes(*entry, 0, gstate.getTextureWidth(0), gstate.getTextureHeight(0), dstFmt);
+		}
+		if (entry->textureName == 0) {
+			entry->textureName = nextName_++;
+		}
+		uploads++;
+	}
+	void SetTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) override {}
+
+	// The "format" is just the bytes per pixel, colors stay as they are.
+	u32 GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const override {
+		switch (format) {
+		case GE_TFMT_4444:
+		case GE_TFMT_5551:
+		case GE_TFMT_5650:
+			return 2;
+		case GE_TFMT_CLUT4:
+		case GE_TFMT_CLUT8:
+		case GE_TFMT_CLUT16:
+		case GE_TFMT_CLUT32:
+			return clutFormat == GE_CMODE_32BIT_ABGR8888 ? 4 : 2;
+		default:
+			return 4;
+		}
+	}
+	void ConvertColors(void *dstBuf, const void *srcBuf, u32 dstFmt, int numPixels) override {
+		if (dstBuf != srcBuf) {
+			memcpy(dstBuf, srcBuf, numPixels * dstFmt);
+		}
+	}
+
+private:
+	u32 nextName_;
+};
+
+struct TexDraw {
+	u32 addr;
+	GETextureFormat format;
+	int wLog2;
+	int hLog2;
+	int bufw;
+	bool swizzled;
+	u32 clutAddr;
+	GEPaletteFormat clutFormat;
+};
+
+// Sets the registers like a display list would, then looks the texture up.
+static void DrawWithTexture(HeadlessTextureCache &cache, const TexDraw &draw) {
+	gstate.texaddr[0] = (GE_CMD_TEXADDR0 << 24) | (draw.addr & 0xFFFFF0);
+	gstate.texbufwidth[0] = (GE_CMD_TEXBUFWIDTH0 << 24) | ((draw.addr >> 8) & 0x0F0000) | draw.bufw;
+	gstate.texsize[0] = (GE_CMD_TEXSIZE0 << 24) | (draw.hLog2 << 8) | draw.wLog2;
+	gstate.texformat = (GE_CMD_TEXFORMAT << 24) | draw.format;
+	gstate.texmode = (GE_CMD_TEXMODE << 24) | (draw.swizzled ? 1 : 0);
+	if (draw.format >= GE_TFMT_CLUT4 && draw.format <= GE_TFMT_CLUT32) {
+		const int colors = draw.format == GE_TFMT_CLUT4 ? 16 : 256;
+		const int bytes = colors * (draw.clutFormat == GE_CMODE_32BIT_ABGR8888 ? 4 : 2);
+		gstate.clutaddr = (GE_CMD_CLUTADDR << 24) | (draw.clutAddr & 0xFFFFF0);
+		gstate.clutaddrupper = (GE_CMD_CLUTADDRUPPER << 24) | ((draw.clutAddr >> 8) & 0x0F0000);
+		gstate.loadclut = (GE_CMD_LOADCLUT << 24) | (bytes / 32);
+		cache.LoadClut();
+		gstate.clutformat = (GE_CMD_CLUTFORMAT << 24) | 0x00FF00 | draw.clutFormat;
+	}
+	gstate_c.textureChanged |= TEXCHANGE_UPDATED;
+	cache.SetTexture();
+	gstate_c.textureChanged = TEXCHANGE_UNCHANGED;
+}
+
+static void NextFrame(HeadlessTextureCache &cache) {
+	gpuStats.numFlips++;
+	cache.StartFrame();
+}
+
+static bool TestDecoding(HeadlessTextureCache &cache) {
+	// A font: CLUT4 with a 4444 palette that only changes alpha.
+	u16_le *clut16 = (u16_le *)Memory::GetPointer(CLUT_BASE);
+	for (int i = 0; i < 16; ++i) {
+		clut16[i] = (i << 12) | 0x0ABC;
+	}
+	u8 *tex = Memory::GetPointer(TEX_BASE);
+	for (int i = 0; i < 32 * 32 / 2; ++i) {
+		tex[i] = (u8)(i * 7 + (i >> 5));
+	}
+	const TexDraw font = { TEX_BASE, GE_TFMT_CLUT4, 5, 5, 32, false, CLUT_BASE, GE_CMODE_16BIT_ABGR4444 };
+	DrawWithTexture(cache, font);
+	EXPECT_EQ_INT(cache.uploads, 1);
+	EXPECT_EQ_INT((int)cache.lastDecoded.size(), 32 * 32 * 2);
+	const u16 *decoded16 = (const u16 *)&cache.lastDecoded[0];
+	for (int i = 0; i < 32 * 32; ++i) {
+		const int index = (tex[i / 2] >> ((i & 1) * 4)) & 0xF;
+		EXPECT_EQ_INT((int)decoded16[i], (int)clut16[index]);
+	}
+
+	// The same texture again is a hit, even in a later frame.
+	DrawWithTexture(cache, font);
+	NextFrame(cache);
+	DrawWithTexture(cache, font);
+	EXPECT_EQ_INT(cache.uploads, 1);
+	EXPECT_EQ_INT(cache.binds, 2);
+
+	// But not once the game writes over it.
+	tex[0] ^= 0xFF;
+	DrawWithTexture(cache, font);
+	EXPECT_EQ_INT(cache.uploads, 2);
+
+	// CLUT8 with an 8888 palette.
+	u32_le *clut32 = (u32_le *)Memory::GetPointer(CLUT_BASE + 0x1000);
+	for (int i = 0; i < 256; ++i) {
+		clut32[i] = 0x01000000 * (255 - i) + i * 0x010203;
+	}
+	u8 *tex8 = Memory::GetPointer(TEX_BASE + 0x10000);
+	for (int i = 0; i < 64 * 16; ++i) {
+		tex8[i] = (u8)(i * 13);
+	}
+	const TexDraw indexed = { TEX_BASE + 0x10000, GE_TFMT_CLUT8, 6, 4, 64, false, CLUT_BASE + 0x1000, GE_CMODE_32BIT_ABGR8888 };
+	DrawWithTexture(cache, indexed);
+	EXPECT_EQ_INT(cache.uploads, 3);
+	const u32 *decoded32 = (const u32 *)&cache.lastDecoded[0];
+	for (int i = 0; i < 64 * 16; ++i) {
+		EXPECT_EQ_INT(decoded32[i], (u32)clut32[tex8[i]]);
+	}
+
+	// A different palette on the same texture is a different texture.
+	DrawWithTexture(cache, indexed);
+	EXPECT_EQ_INT(cache.uploads, 3);
+	clut32[0] = 0x12345678;
+	DrawWithTexture(cache, indexed);
+	EXPECT_EQ_INT(cache.uploads, 4);
+	decoded32 = (const u32 *)&cache.lastDecoded[0];
+	EXPECT_EQ_INT(decoded32[0], 0x12345678);
+
+	// 8888 narrower than its buffer gets its rows packed.
+	u32_le *tex32 = (u32_le *)Memory::GetPointer(TEX_BASE + 0x20000);
+	for (int i = 0; i < 64 * 32; ++i) {
+		tex32[i] = i * 0x01010101;
+	}
+	const TexDraw strided = { TEX_BASE + 0x20000, GE_TFMT_8888, 5, 5, 64, false, 0, GE_CMODE_16BIT_BGR5650 };
+	DrawWithTexture(cache, strided);
+	EXPECT_EQ_INT(cache.uploads, 5);
+	decoded32 = (const u32 *)&cache.lastDecoded[0];
+	for (int y = 0; y < 32; ++y) {
+		for (int x = 0; x < 32; ++x) {
+			EXPECT_EQ_INT(decoded32[y * 32 + x], (u32)tex32[y * 64 + x]);
+		}
+	}
+
+	// An invalidation marks it for rehashing, and the rehash finds nothing changed.
+	NextFrame(cache);
+	cache.Invalidate(TEX_BASE + 0x20000, 64 * 32 * 4, GPU_INVALIDATE_HINT);
+	DrawWithTexture(cache, strided);
+	EXPECT_EQ_INT(cache.uploads, 5);
+
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), 4);
+	cache.Clear(true);
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), 0);
+	return true;
+}
+
+// A tile map: one small CLUT4 texture drawn with lots of palettes, each its own entry.
+static bool TestManyCluts(HeadlessTextureCache &cache) {
+	const int PALETTES = 2000;
+	const TexDraw draw = { TEX_BASE, GE_TFMT_CLUT4, 4, 4, 32, false, CLUT_BASE, GE_CMODE_16BIT_ABGR4444 };
+	Memory::Memset(TEX_BASE, 0x21, 16 * 16 / 2);
+	u16_le *clut16 = (u16_le *)Memory::GetPointer(CLUT_BASE);
+	for (int i = 0; i < 16; ++i) {
+		clut16[i] = 0x1234;
+	}
+
+	for (int pass = 0; pass < 2; ++pass) {
+		gpuStats.ResetFrame();
+		for (int p = 0; p < PALETTES; ++p) {
+			clut16[0] = p;
+			DrawWithTexture(cache, draw);
+		}
+		// The second time around, they're all found.
+		EXPECT_EQ_INT(cache.uploads, PALETTES);
+		EXPECT_EQ_INT(gpuStats.numTextureLookups, PALETTES);
+		EXPECT_TRUE(gpuStats.numTextureLookupProbes < PALETTES * 2);
+	}
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), PALETTES);
+
+	// Invalidating somewhere else doesn't even look at them.
+	gpuStats.ResetFrame();
+	cache.Invalidate(TEX_BASE + 0x100000, 0x1000, GPU_INVALIDATE_HINT);
+	EXPECT_EQ_INT(gpuStats.numTextureInvalidationChecks, 0);
+	cache.Invalidate(TEX_BASE + 0x40, 0x10, GPU_INVALIDATE_HINT);
+	EXPECT_EQ_INT(gpuStats.numTextureInvalidationChecks, PALETTES);
+	EXPECT_EQ_INT(gpuStats.numTextureInvalidations, PALETTES);
+
+	// A change to the texture makes the others with the same address recheck.
+	Memory::Write_U8(0x43, TEX_BASE);
+	clut16[0] = 0;
+	DrawWithTexture(cache, draw);
+	EXPECT_EQ_INT(cache.uploads, PALETTES + 1);
+	clut16[0] = 1;
+	DrawWithTexture(cache, draw);
+	EXPECT_EQ_INT(cache.uploads, PALETTES + 2);
+
+	cache.Clear(true);
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), 0);
+	return true;
+}
+
+// A big texture past the frame's budget gets decoded by a worker, and drawn once it's done.
+static bool TestBackgroundDecode(HeadlessTextureCache &cache) {
+	u32_le *big = (u32_le *)Memory::GetPointer(TEX_BASE);
+	for (int i = 0; i < 512 * 512; ++i) {
+		big[i] = i * 0x00010203;
+	}
+	u32_le *late = (u32_le *)Memory::GetPointer(TEX_BASE + 0x100000);
+	for (int i = 0; i < 256 * 256; ++i) {
+		late[i] = 0xFF000000 | i;
+	}
+	const TexDraw first = { TEX_BASE, GE_TFMT_8888, 9, 9, 512, false, 0, GE_CMODE_16BIT_BGR5650 };
+	const TexDraw second = { TEX_BASE + 0x100000, GE_TFMT_8888, 8, 8, 256, false, 0, GE_CMODE_16BIT_BGR5650 };
+
+	// The first fits the budget, so it's decoded right away.
+	NextFrame(cache);
+	gpuStats.ResetFrame();
+	DrawWithTexture(cache, first);
+	EXPECT_EQ_INT(cache.uploads, 1);
+	DrawWithTexture(cache, second);
+	EXPECT_EQ_INT(gpuStats.numTextureDecodesQueued, 1);
+
+	// Draws keep going without it until the worker is done.
+	double start = real_time_now();
+	while (cache.uploads == 1 && real_time_now() - start < 5.0) {
+		sleep_ms(1);
+		DrawWithTexture(cache, second);
+	}
+	EXPECT_EQ_INT(cache.uploads, 2);
+	EXPECT_EQ_INT(gpuStats.numTextureDecodesFinished, 1);
+	EXPECT_EQ_INT((int)cache.lastDecoded.size(), 256 * 256 * 4);
+	const u32 *decoded32 = (const u32 *)&cache.lastDecoded[0];
+	for (int i = 0; i < 256 * 256; ++i) {
+		EXPECT_EQ_INT(decoded32[i], (u32)late[i]);
+	}
+	DrawWithTexture(cache, second);
+	EXPECT_EQ_INT(cache.uploads, 2);
+
+	// A pending decode goes away with its texture.
+	const TexDraw third = { TEX_BASE + 0x140000, GE_TFMT_8888, 7, 7, 128, false, 0, GE_CMODE_16BIT_BGR5650 };
+	DrawWithTexture(cache, third);
+	EXPECT_EQ_INT(gpuStats.numTextureDecodesQueued, 2);
+	cache.Clear(true);
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), 0);
+
+	// Next frame has budget again.
+	const int uploads = cache.uploads;
+	NextFrame(cache);
+	DrawWithTexture(cache, second);
+	EXPECT_EQ_INT(cache.uploads, uploads + 1);
+	cache.Clear(true);
+	return true;
+}
+
+// 16-bit textures and palettes stay 16-bit, and each format's memory and decode time is counted.
+static bool TestFormats(HeadlessTextureCache &cache) {
+	struct FormatCase {
+		const char *name;
+		TexDraw draw;
+		int bytesPerPixel;
+	};
+	const FormatCase cases[] = {
+		{ "5650", { TEX_BASE, GE_TFMT_5650, 8, 8, 256, false, 0, GE_CMODE_16BIT_BGR5650 }, 2 },
+		{ "4444 swizzled", { TEX_BASE + 0x40000, GE_TFMT_4444, 8, 8, 256, true, 0, GE_CMODE_16BIT_BGR5650 }, 2 },
+		{ "CLUT8 5551", { TEX_BASE + 0x80000, GE_TFMT_CLUT8, 8, 8, 256, false, CLUT_BASE, GE_CMODE_16BIT_ABGR5551 }, 2 },
+		{ "CLUT16 4444", { TEX_BASE + 0xC0000, GE_TFMT_CLUT16, 8, 8, 256, false, CLUT_BASE, GE_CMODE_16BIT_ABGR4444 }, 2 },
+		{ "8888", { TEX_BASE + 0x100000, GE_TFMT_8888, 8, 8, 256, false, 0, GE_CMODE_16BIT_BGR5650 }, 4 },
+		{ "DXT1", { TEX_BASE + 0x140000, GE_TFMT_DXT1, 8, 8, 256, false, 0, GE_CMODE_16BIT_BGR5650 }, 4 },
+	};
+	for (u32 p = TEX_BASE; p < TEX_BASE + 0x180000; p += 4) {
+		Memory::Write_U32(p * 0x9E3779B1, p);
+	}
+	for (u32 p = CLUT_BASE; p < CLUT_BASE + 0x400; p += 4) {
+		Memory::Write_U32(p * 0x01000193, p);
+	}
+
+	gpuStats.ResetFrame();
+	for (const FormatCase &c : cases) {
+		DrawWithTexture(cache, c.draw);
+		EXPECT_EQ_INT((int)cache.lastDecoded.size(), 256 * 256 * c.bytesPerPixel);
+		if (c.draw.format == GE_TFMT_5650) {
+			// Straight from memory, as is.
+			EXPECT_TRUE(memcmp(&cache.lastDecoded[0], Memory::GetPointer(c.draw.addr), 256 * 256 * 2) == 0);
+		}
+	}
+	NextFrame(cache);
+	for (const FormatCase &c : cases) {
+		printf("TextureCache: %-14s %4d KB, %0.3f ms to decode\n", c.name, gpuStats.textureBytesByFormat[c.draw.format] / 1024, gpuStats.msTextureDecodeByFormat[c.draw.format]);
+		EXPECT_EQ_INT(gpuStats.textureBytesByFormat[c.draw.format], 256 * 256 * c.bytesPerPixel);
+	}
+
+	cache.Clear(true);
+	return true;
+}
+
+// Over the budget, the textures used longest ago go first, and are counted when they come back.
+static bool TestBudget(HeadlessTextureCache &cache) {
+	const int TEXTURES = 5;
+	TexDraw draws[TEXTURES];
+	for (int i = 0; i < TEXTURES; ++i) {
+		const TexDraw draw = { TEX_BASE + i * 0x40000, GE_TFMT_8888, 8, 8, 256, false, 0, GE_CMODE_16BIT_BGR5650 };
+		draws[i] = draw;
+		Memory::Memset(draw.addr, (u8)(i + 1), 256 * 256 * 4);
+	}
+	const u32 textureBytes = 256 * 256 * 4;
+	gpuStats.numTextureEvictions = 0;
+	gpuStats.numTexturesRedecodedAfterEviction = 0;
+
+	// Exactly the budget is fine.
+	DrawWithTexture(cache, draws[0]);
+	DrawWithTexture(cache, draws[1]);
+	NextFrame(cache);
+	DrawWithTexture(cache, draws[2]);
+	NextFrame(cache);
+	DrawWithTexture(cache, draws[3]);
+	NextFrame(cache);
+	EXPECT_EQ_INT(gpuStats.textureCacheBytes, textureBytes * 4);
+	EXPECT_EQ_INT(gpuStats.numTextureEvictions, 0);
+
+	// One more isn't, and the ones used longest ago go until it's a bit under.
+	DrawWithTexture(cache, draws[0]);
+	DrawWithTexture(cache, draws[4]);
+	EXPECT_EQ_INT(cache.uploads, 5);
+	// Counted as soon as it's uploaded.
+	EXPECT_EQ_INT(gpuStats.textureCacheBytes, textureBytes * 5);
+	NextFrame(cache);
+	EXPECT_EQ_INT(gpuStats.numTextureEvictions, 2);
+	EXPECT_EQ_INT(gpuStats.textureCacheBytes, textureBytes * 3);
+	EXPECT_EQ_INT((int)cache.NumLoadedTextures(), 3);
+
+	DrawWithTexture(cache, draws[0]);
+	DrawWithTexture(cache, draws[3]);
+	DrawWithTexture(cache, draws[4]);
+	EXPECT_EQ_INT(cache.uploads, 5);
+	EXPECT_EQ_INT(gpuStats.numTexturesRedecodedAfterEviction, 0);
+	DrawWithTexture(cache, draws[1]);
+	DrawWithTexture(cache, draws[2]);
+	EXPECT_EQ_INT(cache.uploads, 7);
+	EXPECT_EQ_INT(gpuStats.numTexturesRedecodedAfterEviction, 2);
+
+	// Whatever the last frame used stays, even over the budget.
+	NextFrame(cache);
+	EXPECT_EQ_INT(gpuStats.numTextureEvictions, 2);
+	EXPECT_EQ_INT(gpuStats.textureCacheBytes, textureBytes * 5);
+
+	cache.Clear(true);
+	return true;
+}
+
+// Something like a frame of a 3D game: lots of static textures used over and over,
+// a few animated ones that change every frame, and a font.
+static bool TestReplay(HeadlessTextureCache &cache) {
+	std::vector<TexDraw> textures;
+	u32 addr = TEX_BASE;
+	u32 clutAddr = CLUT_BASE;
+	for (int i = 0; i < 48; ++i) {
+		TexDraw draw = { addr, GE_TFMT_8888, 6, 6, 64, false, 0, GE_CMODE_16BIT_BGR5650 };
+		switch (i % 6) {
+		case 0:
+			draw.format = GE_TFMT_CLUT8;
+			draw.wLog2 = 7;
+			draw.hLog2 = 7;
+			draw.bufw = 128;
+			draw.swizzled = true;
+			draw.clutAddr = clutAddr;
+			draw.clutFormat = GE_CMODE_32BIT_ABGR8888;
+			clutAddr += 1024;
+			break;
+		case 1:
+			draw.format = GE_TFMT_CLUT4;
+			draw.swizzled = true;
+			draw.clutAddr = clutAddr;
+			draw.clutFormat = GE_CMODE_16BIT_ABGR5551;
+			clutAddr += 1024;
+			break;
+		case 2:
+			draw.format = GE_TFMT_5650;
+			break;
+		case 3:
+			draw.format = GE_TFMT_4444;
+			draw.swizzled = true;
+			break;
+		case 4:
+			draw.format = GE_TFMT_DXT5;
+			break;
+		case 5:
+			draw.wLog2 = 7;
+			draw.hLog2 = 7;
+			draw.bufw = 128;
+			break;
+		}
+		textures.push_back(draw);
+		addr += 128 * 128 * 4;
+	}
+	const int STATIC_TEXTURES = (int)textures.size();
+	const int ANIMATED_TEXTURES = 4;
+	for (int i = 0; i < ANIMATED_TEXTURES; ++i) {
+		TexDraw draw = { addr, GE_TFMT_8888, 6, 6, 64, false, 0, GE_CMODE_16BIT_BGR5650 };
+		textures.push_back(draw);
+		addr += 64 * 64 * 4;
+	}
+	Memory::Memset(TEX_BASE, 0x5A, addr - TEX_BASE);
+	for (u32 p = CLUT_BASE; p < clutAddr; p += 4) {
+		Memory::Write_U32(p * 0x9E3779B1, p);
+	}
+
+	const int FRAMES = 300;
+	const int DRAWS_PER_FRAME = 400;
+	const int startUploads = cache.uploads;
+	double start = real_time_now();
+	for (int f = 0; f < FRAMES; ++f) {
+		for (int i = 0; i < ANIMATED_TEXTURES; ++i) {
+			const TexDraw &draw = textures[STATIC_TEXTURES + i];
+			Memory::Memset(draw.addr, (u8)(f * 5 + i), 64 * 64 * 4);
+		}
+		for (int d = 0; d < DRAWS_PER_FRAME; ++d) {
+			DrawWithTexture(cache, textures[(d * 7) % textures.size()]);
+		}
+		NextFrame(cache);
+	}
+	double elapsed = real_time_now() - start;
+	const int uploads = cache.uploads - startUploads;
+	printf("TextureCache: %d draws per frame in %0.3f ms per frame, %d uploads\n", DRAWS_PER_FRAME, elapsed * 1000.0 / FRAMES, uploads);
+
+	// Only the animated ones should get decoded again.
+	EXPECT_EQ_INT(uploads, STATIC_TEXTURES + ANIMATED_TEXTURES * FRAMES);
+	return true;
+}
+
+// Scaled textures survive into the next session, and the cache stays under its size.
+static bool TestScaledTextureDiskCache() {
+	const std::string dir = "unittest_scaled_textures";
+	File::DeleteDirRecursively(dir);
+
+	ScaledTextureKey key = { 0x9ABCDEF012345678ULL, GE_TFMT_CLUT8, 0x00FF00, 2, 64, 32, 0, 3, 0 };
+	const int pixels = 64 * 32 * 3 * 3;
+	std::vector<u32> scaled(pixels);
+	for (int i = 0; i < pixels; ++i) {
+		scaled[i] = i * 0x9E3779B1;
+	}
+	std::vector<u32> out;
+
+	{
+		ScaledTextureDiskCache disk;
+		disk.Open(dir + "/", 1024 * 1024);
+		disk.Flush();
+		EXPECT_FALSE(disk.Lookup(key, out));
+		disk.Store(key, &scaled[0]);
+		disk.Flush();
+		EXPECT_TRUE(disk.Contains(key));
+		EXPECT_TRUE(disk.Lookup(key, out));
+		EXPECT_TRUE(out == scaled);
+
+		// Any other scaling is a different texture.
+		ScaledTextureKey other = key;
+		other.factor = 2;
+		EXPECT_FALSE(disk.Contains(other));
+		EXPECT_FALSE(disk.Lookup(other, out));
+	}
+
+	{
+		// Read ahead when opened, and a write that never finished is cleaned up.
+		const std::string stale = dir + "/0123456789abcdef.stx.tmp";
+		FILE *f = File::OpenCFile(stale, "wb");
+		EXPECT_TRUE(f != nullptr);
+		fclose(f);
+		ScaledTextureDiskCache disk;
+		disk.Open(dir + "/", 1024 * 1024);
+		disk.Flush();
+		EXPECT_FALSE(File::Exists(stale));
+		EXPECT_TRUE(disk.Contains(key));
+		out.clear();
+		EXPECT_TRUE(disk.Lookup(key, out));
+		EXPECT_TRUE(out == scaled);
+		EXPECT_EQ_INT(disk.Hits(), 1);
+	}
+
+	{
+		// These hardly compress, so only a couple fit.
+		ScaledTextureDiskCache disk;
+		disk.Open(dir + "/", pixels * 4 * 5 / 2);
+		disk.Flush();
+		ScaledTextureKey more = key;
+		for (u32 i = 0; i < 4; ++i) {
+			more.contenthash = i;
+			disk.Store(more, &scaled[0]);
+		}
+		disk.Flush();
+		int found = disk.Contains(key) ? 1 : 0;
+		for (u32 i = 0; i < 4; ++i) {
+			more.contenthash = i;
+			found += disk.Contains(more) ? 1 : 0;
+		}
+		EXPECT_TRUE(found >= 1 && found <= 2);
+	}
+
+	File::DeleteDirRecursively(dir);
+	return true;
+}
+
+bool TestTextureCache() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	g_Config.bTextureBackoffCache = true;
+	g_Config.bTextureSecondaryCache = false;
+	g_Config.iRenderingMode = FB_BUFFERED_MODE;
+	g_Config.iTexScalingLevel = 1;
+	gpuStats.numFlips = 1;
+
+	bool valid;
+	{
+		HeadlessTextureCache cache;
+		valid = TestDecoding(cache);
+	}
+	if (valid) {
+		HeadlessTextureCache cache;
+		valid = TestManyCluts(cache);
+	}
+	if (valid) {
+		g_Config.bBackgroundTextureDecode = true;
+		g_Config.iNumWorkerThreads = 4;
+		HeadlessTextureCache cache;
+		valid = TestBackgroundDecode(cache);
+		g_Config.bBackgroundTextureDecode = false;
+	}
+	if (valid) {
+		HeadlessTextureCache cache;
+		valid = TestFormats(cache);
+	}
+	if (valid) {
+		g_Config.iTextureCacheBudgetMB = 1;
+		HeadlessTextureCache cache;
+		valid = TestBudget(cache);
+		g_Config.iTextureCacheBudgetMB = 0;
+	}
+	if (valid) {
+		HeadlessTextureCache cache;
+		valid = TestReplay(cache);
+	}
+	if (valid) {
+		valid = TestScaledTextureDiskCache();
+	}
+
+	Memory::Shutdown();
+	return valid;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/CPUDetect.h"
+#include "Common/MemoryUtil.h"
+#include "GPU/Common/TextureDecoder.h"
+
+#include "UnitTest.h"
+
+// Every index byte, then a pattern, so each kernel sees all values and all alignments of the tail.
+static void FillIndices(u8 *indices, int count) {
+	for (int i = 0; i < count; ++i) {
+		indices[i] = i < 256 ? (u8)i : (u8)(i * 167 + (i >> 3));
+	}
+}
+
+template <typename T>
+static bool CompareDecoded(const char *name, int length, const T *expected, const T *actual) {
+	for (int i = 0; i < length; ++i) {
+		if (expected[i] != actual[i]) {
+			printf("%s: length %d differs at %d: %08x, expected %08x\n", name, length, i, (u32)actual[i], (u32)expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename T>
+static bool TestDeIndex(const char *name, void (*basic)(T *, const u8 *, int, const T *), void (*func)(T *, const u8 *, int, const T *), int pixelsPerByte, const u8 *indices, const T *clut) {
+	const int maxLength = 4096;
+	std::vector<T> expected(maxLength + 1);
+	std::vector<T> actual(maxLength + 1);
+	for (int length = pixelsPerByte; length <= maxLength; length += length < 128 ? pixelsPerByte : 127 * pixelsPerByte) {
+		basic(&expected[0], indices, length, clut);
+		actual[length] = 0xBEEF;
+		func(&actual[0], indices, length, clut);
+		if (!CompareDecoded(name, length, &expected[0], &actual[0])) {
+			return false;
+		}
+		if (actual[length] != 0xBEEF) {
+			printf("%s: length %d wrote past the end\n", name, length);
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename T>
+static void BenchmarkDeIndex(const char *name, void (*func)(T *, const u8 *, int, const T *), int pixelsPerByte, const u8 *indices, const T *clut) {
+	// A 512x512 texture.
+	const int length = 512 * 512;
+	const int runs = 200;
+	std::vector<T> dest(length);
+	double start = real_time_now();
+	for (int r = 0; r < runs; ++r) {
+		func(&dest[0], indices, length, clut);
+	}
+	double elapsed = real_time_now() - start;
+	printf("%-26s %7.1f Mpixels/s\n", name, (double)length * runs / elapsed / 1e6);
+}
+
+static bool TestUnswizzle(const u8 *swizzled) {
+	// Block rows of 1 to 9 blocks (16 bytes wide, 8 lines tall) over 4 block rows.
+	const int byc = 4;
+	for (int bxc = 1; bxc <= 9; ++bxc) {
+		const u32 rowWidth = bxc * 16;
+		std::vector<u32> expected(rowWidth * 8 * byc / 4);
+		std::vector<u32> actual(expected.size());
+		DoUnswizzleTex16Basic(swizzled, &expected[0], bxc, byc, rowWidth / 4, rowWidth);
+		DoUnswizzleTex16(swizzled, &actual[0], bxc, byc, rowWidth / 4, rowWidth);
+		if (!CompareDecoded("DoUnswizzleTex16", (int)expected.size(), &expected[0], &actual[0])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Random blocks, with some equal endpoints so every DXT mode is used.
+static void FillDXTBlocks(u8 *blocks, int bytes) {
+	u32 seed = 0x12345678;
+	for (int i = 0; i < bytes; ++i) {
+		seed = seed * 1103515245 + 12345;
+		blocks[i] = (u8)(seed >> 16);
+	}
+	for (int i = 0; i + 16 <= bytes; i += 16 * 5) {
+		// The colors are at 4, the DXT5 alphas at 14 of each 16 byte block.
+		blocks[i + 6] = blocks[i + 4];
+		blocks[i + 7] = blocks[i + 5];
+		blocks[i + 15] = blocks[i + 14];
+	}
+}
+
+template <typename Block>
+static bool TestDXT(const char *name, void (*basic)(u32 *, const Block *, int, int), void (*func)(u32 *, const Block *, int, int), const u8 *blocks) {
+	const int maxBlocks = 19;
+	for (int count = 1; count <= maxBlocks; ++count) {
+		// One spare column, which must not be written.
+		const int pitch = count * 4 + 1;
+		std::vector<u32> expected(pitch * 4, 0xDEADBEEF);
+		std::vector<u32> actual(pitch * 4, 0xDEADBEEF);
+		for (int offset = 0; offset < 4; ++offset) {
+			const Block *src = (const Block *)blocks + offset * maxBlocks;
+			basic(&expected[0], src, count, pitch);
+			func(&actual[0], src, count, pitch);
+			if (!CompareDecoded(name, (int)expected.size(), &expected[0], &actual[0])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+template <typename Block>
+static void BenchmarkDXT(const char *name, void (*func)(u32 *, const Block *, int, int), const u8 *blocks) {
+	// A 256x256 texture.
+	const int size = 256;
+	const int runs = 200;
+	std::vector<u32> dest(size * size);
+	const Block *src = (const Block *)blocks;
+	double start = real_time_now();
+	for (int r = 0; r < runs; ++r) {
+		for (int y = 0; y < size; y += 4) {
+			func(&dest[y * size], src + (y / 4) * (size / 4), size / 4, size);
+		}
+	}
+	double elapsed = real_time_now() - start;
+	printf("%-26s %7.1f Mpixels/s\n", name, (double)size * size * runs / elapsed / 1e6);
+}
+
+bool TestTextureDecoder() {
+	SetupTextureDecoder();
+
+	// Swizzled textures are 16-byte aligned in PSP RAM.
+	const int maxIndices = 512 * 512;
+	u8 *indices = (u8 *)AllocateAlignedMemory(maxIndices, 16);
+	FillIndices(indices, maxIndices);
+	// The caches keep 4096 entries, so the 16-bit gather can safely read a little past 256.
+	u32 *clut32 = (u32 *)AllocateAlignedMemory(4096 * sizeof(u32), 16);
+	for (int i = 0; i < 4096; ++i) {
+		clut32[i] = 0x01020304U * (u32)(i + 1) ^ ((u32)i << 20);
+	}
+	const u16 *clut16 = (const u16 *)clut32;
+
+	bool valid = true;
+	valid = valid && TestDeIndex<u16>("DeIndexTexture4To16", &DeIndexTexture4To16Basic, DoDeIndexTexture4To16, 2, indices, clut16);
+	valid = valid && TestDeIndex<u32>("DeIndexTexture4To32", &DeIndexTexture4To32Basic, DoDeIndexTexture4To32, 2, indices, clut32);
+	valid = valid && TestDeIndex<u16>("DeIndexTexture8To16", &DeIndexTexture8To16Basic, DoDeIndexTexture8To16, 1, indices, clut16);
+	valid = valid && TestDeIndex<u32>("DeIndexTexture8To32", &DeIndexTexture8To32Basic, DoDeIndexTexture8To32, 1, indices, clut32);
+#ifdef HAVE_AVX2_INTRINSICS
+	// Also check these directly, in case the CPU picked something else.
+	if (cpu_info.bSSSE3) {
+		valid = valid && TestDeIndex<u16>("DeIndexTexture4To16SSSE3", &DeIndexTexture4To16Basic, &DeIndexTexture4To16SSSE3, 2, indices, clut16);
+		valid = valid && TestDeIndex<u32>("DeIndexTexture4To32SSSE3", &DeIndexTexture4To32Basic, &DeIndexTexture4To32SSSE3, 2, indices, clut32);
+	}
+	if (cpu_info.bAVX2) {
+		valid = valid && TestDeIndex<u16>("DeIndexTexture8To16AVX2", &DeIndexTexture8To16Basic, &DeIndexTexture8To16AVX2, 1, indices, clut16);
+		valid = valid && TestDeIndex<u32>("DeIndexTexture8To32AVX2", &DeIndexTexture8To32Basic, &DeIndexTexture8To32AVX2, 1, indices, clut32);
+	}
+#endif
+	valid = valid && TestUnswizzle(indices);
+
+	// Enough for a 256x256 DXT3 or DXT5 texture.
+	const int dxtBytes = 256 * 256;
+	u8 *blocks = (u8 *)AllocateAlignedMemory(dxtBytes, 16);
+	FillDXTBlocks(blocks, dxtBytes);
+	valid = valid && TestDXT<DXT1Block>("DecodeDXT1Blocks", &DecodeDXT1BlocksBasic, DoDecodeDXT1Blocks, blocks);
+	valid = valid && TestDXT<DXT3Block>("DecodeDXT3Blocks", &DecodeDXT3BlocksBasic, DoDecodeDXT3Blocks, blocks);
+	valid = valid && TestDXT<DXT5Block>("DecodeDXT5Blocks", &DecodeDXT5BlocksBasic, DoDecodeDXT5Blocks, blocks);
+#ifdef _M_SSE
+	valid = valid && TestDXT<DXT1Block>("DecodeDXT1BlocksSSE2", &DecodeDXT1BlocksBasic, &DecodeDXT1BlocksSSE2, blocks);
+	valid = valid && TestDXT<DXT3Block>("DecodeDXT3BlocksSSE2", &DecodeDXT3BlocksBasic, &DecodeDXT3BlocksSSE2, blocks);
+	valid = valid && TestDXT<DXT5Block>("DecodeDXT5BlocksSSE2", &DecodeDXT5BlocksBasic, &DecodeDXT5BlocksSSE2, blocks);
+#endif
+
+	BenchmarkDeIndex<u16>("DeIndexTexture4To16Basic", &DeIndexTexture4To16Basic, 2, indices, clut16);
+	BenchmarkDeIndex<u16>("DoDeIndexTexture4To16", DoDeIndexTexture4To16, 2, indices, clut16);
+	BenchmarkDeIndex<u32>("DeIndexTexture4To32Basic", &DeIndexTexture4To32Basic, 2, indices, clut32);
+	BenchmarkDeIndex<u32>("DoDeIndexTexture4To32", DoDeIndexTexture4To32, 2, indices, clut32);
+	BenchmarkDeIndex<u16>("DeIndexTexture8To16Basic", &DeIndexTexture8To16Basic, 1, indices, clut16);
+	BenchmarkDeIndex<u16>("DoDeIndexTexture8To16", DoDeIndexTexture8To16, 1, indices, clut16);
+	BenchmarkDeIndex<u32>("DeIndexTexture8To32Basic", &DeIndexTexture8To32Basic, 1, indices, clut32);
+	BenchmarkDeIndex<u32>("DoDeIndexTexture8To32", DoDeIndexTexture8To32, 1, indices, clut32);
+
+	BenchmarkDXT<DXT1Block>("DecodeDXT1BlocksBasic", &DecodeDXT1BlocksBasic, blocks);
+	BenchmarkDXT<DXT1Block>("DoDecodeDXT1Blocks", DoDecodeDXT1Blocks, blocks);
+	BenchmarkDXT<DXT3Block>("DecodeDXT3BlocksBasic", &DecodeDXT3BlocksBasic, blocks);
+	BenchmarkDXT<DXT3Block>("DoDecodeDXT3Blocks", DoDecodeDXT3Blocks, blocks);
+	BenchmarkDXT<DXT5Block>("DecodeDXT5BlocksBasic", &DecodeDXT5BlocksBasic, blocks);
+	BenchmarkDXT<DXT5Block>("DoDecodeDXT5Blocks", DoDecodeDXT5Blocks, blocks);
+#ifdef _M_SSE
+	BenchmarkDXT<DXT5Block>("DecodeDXT5BlocksSSE2", &DecodeDXT5BlocksSSE2, blocks);
+#endif
+
+	FreeAlignedMemory(blocks);
+	FreeAlignedMemory(clut32);
+	FreeAlignedMemory(indices);
+	return valid;
+}
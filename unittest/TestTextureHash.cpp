@@ -0,0 +1,139 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/CPUDetect.h"
+#include "Common/MemoryUtil.h"
+#include "GPU/Common/TextureDecoder.h"
+
+#include "UnitTest.h"
+
+typedef u64 (*HashFunc)(const void *data, u32 size);
+
+struct HashCandidate {
+	const char *name;
+	HashFunc func;
+	bool available;
+};
+
+static u64 QuickHashDefault(const void *data, u32 size) {
+	return DoQuickTexHash(data, size);
+}
+
+static u64 ReliableHash32(const void *data, u32 size) {
+	return XXH32(data, size, 0);
+}
+
+static u64 ReliableHash64(const void *data, u32 size) {
+	return XXH64(data, size, 0);
+}
+
+#ifdef _M_SSE
+static u64 QuickHashSSE2(const void *data, u32 size) {
+	return QuickTexHashSSE2(data, size);
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+static u64 QuickHashAVX2(const void *data, u32 size) {
+	return QuickTexHashAVX2(data, size);
+}
+
+static u64 ReliableHashAVX2(const void *data, u32 size) {
+	return ReliableHash64AVX2(data, size, 0);
+}
+#endif
+
+// A hash that misses a changed word would leave a stale texture or vertex buffer.
+static bool TestHashSensitivity(const HashCandidate &hash, u32 *data, u32 size) {
+	const u64 original = hash.func(data, size);
+	EXPECT_TRUE(hash.func(data, size) == original);
+	for (u32 i = 0; i < size / 4; ++i) {
+		data[i] ^= 0x00010000;
+		const u64 changed = hash.func(data, size);
+		data[i] ^= 0x00010000;
+		if (changed == original) {
+			printf("%s: change at word %d not seen\n", hash.name, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TestTextureHash() {
+	SetupTextureDecoder();
+
+	const HashCandidate hashes[] = {
+		{ "QuickTexHash", &QuickHashDefault, true },
+#ifdef _M_SSE
+		{ "QuickTexHashSSE2", &QuickHashSSE2, true },
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+		{ "QuickTexHashAVX2", &QuickHashAVX2, cpu_info.bAVX2 },
+#endif
+		{ "XXH32", &ReliableHash32, true },
+		{ "XXH64", &ReliableHash64, true },
+#ifdef HAVE_AVX2_INTRINSICS
+		{ "ReliableHash64AVX2", &ReliableHashAVX2, cpu_info.bAVX2 },
+#endif
+	};
+
+	// Textures are 16-byte aligned in PSP RAM, not more.
+	const u32 maxSize = 512 * 512 * 4;
+	u8 *buffer = (u8 *)AllocateAlignedMemory(maxSize + 16, 32);
+	u32 *data = (u32 *)(buffer + 16);
+	for (u32 i = 0; i < maxSize / 4; ++i) {
+		data[i] = i * 0x9E3779B1;
+	}
+
+	bool valid = true;
+	for (const HashCandidate &hash : hashes) {
+		if (hash.available && !TestHashSensitivity(hash, data, 4096)) {
+			valid = false;
+		}
+	}
+#ifdef HAVE_AVX2_INTRINSICS
+	// Sizes the AVX2 loop can't take go to SSE2.
+	if (cpu_info.bAVX2 && QuickTexHashAVX2(data, 64 * 3) != QuickTexHashSSE2(data, 64 * 3)) {
+		printf("QuickTexHashAVX2: odd size doesn't match SSE2\n");
+		valid = false;
+	}
+#endif
+
+	// 16-bit textures from 32x32 to 512x512, and 32-bit 512x512.
+	const u32 sizes[] = { 32 * 32 * 2, 128 * 128 * 2, 256 * 256 * 2, 512 * 512 * 2, 512 * 512 * 4 };
+	for (u32 size : sizes) {
+		const int runs = (int)(256 * 1024 * 1024 / size);
+		for (const HashCandidate &hash : hashes) {
+			if (!hash.available) {
+				continue;
+			}
+			double start = real_time_now();
+			for (int r = 0; r < runs; ++r) {
+				hash.func(data, size);
+			}
+			double elapsed = real_time_now() - start;
+			printf("%-20s %8d bytes: %6.2f GB/s\n", hash.name, size, (double)size * runs / elapsed / 1e9);
+		}
+	}
+
+	FreeAlignedMemory(buffer);
+	return valid;
+}
@@ -0,0 +1,257 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "GPU/Common/TextureScalerCommon.h"
+
+#include "UnitTest.h"
+
+static const int KERNEL_SPLAT[3][3] = {
+	{ 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 },
+};
+static const int KERNEL_SOBEL[3][3] = {
+	{ -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 },
+};
+
+struct ScalerSet {
+	const char *name;
+	ScalerKernelSet set;
+};
+
+static const ScalerSet scalerSets[] = {
+	{ "Basic", SCALER_KERNELS_BASIC },
+	{ "SSE4.1", SCALER_KERNELS_SSE41 },
+	{ "AVX2", SCALER_KERNELS_AVX2 },
+};
+
+// Posterized gradients, noise, flat blocks and transparent areas, so every path of the kernels is taken.
+static void FillTexture(u32 *data, int w, int h, u32 seed) {
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			seed = seed * 1103515245 + 12345;
+			u32 color;
+			if ((x / 8 + y / 8) % 5 == 0) {
+				color = seed ^ (seed << 13);
+			} else if ((x / 8 + y / 8) % 5 == 1) {
+				color = 0x80406020;
+			} else {
+				u32 r = (x * 255 / w) & 0xF0;
+				u32 g = (y * 255 / h) & 0xF8;
+				u32 b = ((x + y) * 127 / (w + h)) & 0xF0;
+				color = (b << 16) | (g << 8) | r;
+			}
+			u32 alpha = (x / 16 + y / 16) % 3 == 0 ? 0 : 0xFF000000;
+			data[y * w + x] = (color & 0x00FFFFFF) | alpha;
+		}
+	}
+}
+
+static void Bilinear(const ScalerKernels &kernels, int factor, u32 *source, u32 *dest, int w, int h, u32 *tmp) {
+	kernels.bilinearH(factor, source, tmp, w, 0, h);
+	kernels.bilinearV(factor, tmp, dest, w, 0, h, 0, h);
+}
+
+static void DePosterize(const ScalerKernels &kernels, u32 *source, u32 *dest, int w, int h, u32 *tmp) {
+	kernels.deposterizeH(source, tmp, w, 0, h);
+	kernels.deposterizeV(tmp, dest, w, h, 0, h);
+	kernels.deposterizeH(dest, tmp, w, 0, h);
+	kernels.deposterizeV(tmp, dest, w, h, 0, h);
+}
+
+// The hybrid scaler without the xBRZ pass: mask, splat, scale the mask, and mix dest with upscaled.
+static void HybridMask(const ScalerKernels &kernels, int factor, u32 *source, u32 *upscaled, u32 *dest, int w, int h, u32 *tmp1, u32 *tmp2, u32 *tmp3) {
+	kernels.generateDistanceMask(source, tmp1, w, h, 0, h);
+	kernels.convolve3x3(tmp1, tmp2, KERNEL_SPLAT, w, h, 0, h);
+	Bilinear(kernels, factor, tmp2, tmp3, w, h, tmp1);
+	kernels.mix(dest, upscaled, tmp3, 8192, w * factor, 0, h * factor);
+}
+
+static bool CompareScaled(const char *name, const char *set, int factor, int w, int h, const std::vector<u32> &expected, const std::vector<u32> &actual, int tolerance) {
+	for (size_t i = 0; i < expected.size(); ++i) {
+		for (int c = 0; c < 32; c += 8) {
+			int diff = abs((int)((expected[i] >> c) & 0xFF) - (int)((actual[i] >> c) & 0xFF));
+			if (diff > tolerance) {
+				printf("%s %s: %dx%d at %dx differs at %d: %08x, expected %08x\n", name, set, w, h, factor, (int)i, actual[i], expected[i]);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool CompareWords(const char *name, const char *set, int w, int h, const std::vector<u32> &expected, const std::vector<u32> &actual) {
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (expected[i] != actual[i]) {
+			printf("%s %s: %dx%d differs at %d: %08x, expected %08x\n", name, set, w, h, (int)i, actual[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Bicubic is compared with a tolerance, as SSE4.1 and AVX2 round where the basic version takes the ceiling.
+static bool TestKernels(const ScalerKernels &basic, const ScalerKernels &kernels, const char *set, int bicubicTolerance, int w, int h) {
+	std::vector<u32> source(w * h);
+	FillTexture(&source[0], w, h, w * 31 + h);
+
+	for (int factor = 2; factor <= 5; ++factor) {
+		// One spare pixel, which must not be written.
+		const size_t scaled = w * h * factor * factor;
+		std::vector<u32> expected(scaled + 1, 0xDEADBEEF), actual(scaled + 1, 0xDEADBEEF);
+		std::vector<u32> tmp(w * h * factor + 1);
+
+		Bilinear(basic, factor, &source[0], &expected[0], w, h, &tmp[0]);
+		Bilinear(kernels, factor, &source[0], &actual[0], w, h, &tmp[0]);
+		RET(CompareScaled("Bilinear", set, factor, w, h, expected, actual, 0));
+
+		basic.bicubicBSpline(factor, &source[0], &expected[0], w, h, 0, h);
+		kernels.bicubicBSpline(factor, &source[0], &actual[0], w, h, 0, h);
+		RET(CompareScaled("BicubicBSpline", set, factor, w, h, expected, actual, bicubicTolerance));
+		basic.bicubicMitchell(factor, &source[0], &expected[0], w, h, 0, h);
+		kernels.bicubicMitchell(factor, &source[0], &actual[0], w, h, 0, h);
+		RET(CompareScaled("BicubicMitchell", set, factor, w, h, expected, actual, bicubicTolerance));
+
+		// Mix the bicubic result into the bilinear one, with a mask that goes past the maximum.
+		std::vector<u32> upscaled(actual), mask(scaled), mixExpected(scaled + 1), mixActual(scaled + 1);
+		Bilinear(basic, factor, &source[0], &mixExpected[0], w, h, &tmp[0]);
+		mixActual = mixExpected;
+		for (size_t i = 0; i < scaled; ++i) {
+			mask[i] = (u32)((i * 2654435761U) % 12000);
+		}
+		basic.mix(&mixExpected[0], &upscaled[0], &mask[0], 8192, w * factor, 0, h * factor);
+		kernels.mix(&mixActual[0], &upscaled[0], &mask[0], 8192, w * factor, 0, h * factor);
+		RET(CompareScaled("Mix", set, factor, w, h, mixExpected, mixActual, 0));
+	}
+
+	std::vector<u32> expected(w * h + 1, 0xDEADBEEF), actual(w * h + 1, 0xDEADBEEF), tmp(w * h);
+	DePosterize(basic, &source[0], &expected[0], w, h, &tmp[0]);
+	DePosterize(kernels, &source[0], &actual[0], w, h, &tmp[0]);
+	RET(CompareWords("DePosterize", set, w, h, expected, actual));
+
+	basic.generateDistanceMask(&source[0], &expected[0], w, h, 0, h);
+	kernels.generateDistanceMask(&source[0], &actual[0], w, h, 0, h);
+	RET(CompareWords("DistanceMask", set, w, h, expected, actual));
+
+	std::vector<u32> mask(expected.begin(), expected.end() - 1);
+	basic.convolve3x3(&mask[0], &expected[0], KERNEL_SPLAT, w, h, 0, h);
+	kernels.convolve3x3(&mask[0], &actual[0], KERNEL_SPLAT, w, h, 0, h);
+	RET(CompareWords("Convolve3x3", set, w, h, expected, actual));
+	basic.convolve3x3(&mask[0], &expected[0], KERNEL_SOBEL, w, h, 0, h);
+	kernels.convolve3x3(&mask[0], &actual[0], KERNEL_SOBEL, w, h, 0, h);
+	RET(CompareWords("Convolve3x3 Sobel", set, w, h, expected, actual));
+	return true;
+}
+
+enum {
+	ALGO_BILINEAR,
+	ALGO_BSPLINE,
+	ALGO_MITCHELL,
+	ALGO_DEPOSTERIZE,
+	ALGO_HYBRID_MASK,
+	ALGO_COUNT,
+};
+
+static const char *const algorithmNames[ALGO_COUNT] = {
+	"Bilinear",
+	"BicubicBSpline",
+	"BicubicMitchell",
+	"DePosterize",
+	"HybridMask",
+};
+
+// Milliseconds per texture, on one thread.
+static double BenchmarkScaler(const ScalerKernels &kernels, int algorithm, int factor, u32 *source, int w, int h) {
+	const int runs = 3;
+	std::vector<u32> dest(w * h * factor * factor), upscaled(dest.size());
+	std::vector<u32> tmp1(w * h * factor), tmp2(w * h), tmp3(dest.size());
+	double start = real_time_now();
+	for (int r = 0; r < runs; ++r) {
+		switch (algorithm) {
+		case ALGO_BILINEAR:
+			Bilinear(kernels, factor, source, &dest[0], w, h, &tmp1[0]);
+			break;
+		case ALGO_BSPLINE:
+			kernels.bicubicBSpline(factor, source, &dest[0], w, h, 0, h);
+			break;
+		case ALGO_MITCHELL:
+			kernels.bicubicMitchell(factor, source, &dest[0], w, h, 0, h);
+			break;
+		case ALGO_DEPOSTERIZE:
+			DePosterize(kernels, source, &dest[0], w, h, &tmp1[0]);
+			break;
+		case ALGO_HYBRID_MASK:
+			HybridMask(kernels, factor, source, &upscaled[0], &dest[0], w, h, &tmp1[0], &tmp2[0], &tmp3[0]);
+			break;
+		}
+	}
+	return (real_time_now() - start) * 1000.0 / runs;
+}
+
+bool TestTextureScaler() {
+	SetupScalerKernels();
+	const ScalerKernels &basic = *GetScalerKernels(SCALER_KERNELS_BASIC);
+
+	bool valid = true;
+	// Small and odd sizes reach the borders and tails of each SIMD loop.
+	const int testSizes[][2] = { { 1, 1 }, { 2, 3 }, { 7, 5 }, { 13, 9 }, { 37, 23 }, { 64, 64 } };
+	for (const ScalerSet &set : scalerSets) {
+		const ScalerKernels *kernels = GetScalerKernels(set.set);
+		if (!kernels) {
+			continue;
+		}
+		for (auto size : testSizes) {
+			valid = valid && TestKernels(basic, *kernels, set.name, set.set == SCALER_KERNELS_BASIC ? 0 : 1, size[0], size[1]);
+		}
+	}
+	const ScalerKernels *sse41 = GetScalerKernels(SCALER_KERNELS_SSE41);
+	const ScalerKernels *avx2 = GetScalerKernels(SCALER_KERNELS_AVX2);
+	if (sse41 && avx2) {
+		// Both round the same way, so bicubic has to match exactly here.
+		for (auto size : testSizes) {
+			valid = valid && TestKernels(*sse41, *avx2, "AVX2 vs SSE4.1", 0, size[0], size[1]);
+		}
+	}
+
+	// The texture set: sizes games commonly upscale.
+	const int benchSizes[] = { 64, 128, 256 };
+	for (int algorithm = 0; algorithm < ALGO_COUNT; ++algorithm) {
+		for (int factor = 2; factor <= 5; ++factor) {
+			// Deposterize doesn't scale, so once is enough.
+			if (algorithm == ALGO_DEPOSTERIZE && factor != 2) {
+				continue;
+			}
+			for (int size : benchSizes) {
+				std::vector<u32> source(size * size);
+				FillTexture(&source[0], size, size, size);
+				printf("%-16s %dx %3dx%-3d", algorithmNames[algorithm], factor, size, size);
+				for (const ScalerSet &set : scalerSets) {
+					const ScalerKernels *kernels = GetScalerKernels(set.set);
+					if (kernels) {
+						printf("  %s %8.3f ms", set.name, BenchmarkScaler(*kernels, algorithm, factor, &source[0], size, size));
+					}
+				}
+				printf("\n");
+			}
+		}
+	}
+
+	return valid;
+}
@@ -369,6 +369,17 @@ struct TestItem {
 
 bool TestArmEmitter();
 bool TestX64Emitter();
+bool TestISOFileSystem();
+bool TestAsyncIOManager();
+bool TestCrypto();
+bool TestElfReader();
+bool TestHLE();
+bool TestPGF();
+bool TestCwCheat();
+bool TestTextureCache();
+bool TestTextureHash();
+bool TestTextureDecoder();
+bool TestTextureScaler();
 
 	
 TestItem availableTests[] = {
@@ -382,7 +393,18 @@ TestItem availableTests[] = {
 	TEST_ITEM(MathUtil),
 	TEST_ITEM(Parsers),
 	TEST_ITEM(Jit),
-	TEST_ITEM(MatrixTranspose)
+	TEST_ITEM(MatrixTranspose),
+	TEST_ITEM(ISOFileSystem),
+	TEST_ITEM(AsyncIOManager),
+	TEST_ITEM(Crypto),
+	TEST_ITEM(ElfReader),
+	TEST_ITEM(HLE),
+	TEST_ITEM(PGF),
+	TEST_ITEM(CwCheat),
+	TEST_ITEM(TextureCache),
+	TEST_ITEM(TextureHash),
+	TEST_ITEM(TextureDecoder),
+	TEST_ITEM(TextureScaler),
 };
 
 int main(int argc, const char *argv[]) {